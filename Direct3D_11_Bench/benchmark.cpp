@@ -0,0 +1,123 @@
+#include "benchmark.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	// Caps a batch for frames too cheap to ever reach min_time on a coarse clock
+	constexpr uint64_t max_frames = uint64_t(1) << 30;
+}
+
+benchmark::runner::runner(const description &runner_description) :
+	settings(runner_description)
+{
+	std::printf("%-40s %10s %10s %14s %14s\n", "benchmark", "objects", "frames", "ns/op", "calls/frame");
+}
+
+benchmark::runner::~runner()
+{}
+
+void benchmark::runner::run(std::string_view name,
+                            uint32_t object_count,
+                            uint64_t operations_per_frame,
+                            const std::function<void()> &frame,
+                            const call_counter &device_calls,
+                            const std::vector<rate_counter> &rate_counters)
+{
+	if (not settings.filter.empty() and name.find(settings.filter) == std::string_view::npos)
+	{
+		return;
+	}
+
+	// Warm caches and let lazily sized storage reach its working size
+	frame();
+
+	uint64_t frames = 1;
+	for (;;)
+	{
+		auto first_calls = device_calls ? device_calls() : 0;
+		std::vector<uint64_t> first_counts;
+		for (const auto &counter : rate_counters)
+		{
+			first_counts.push_back(counter.count());
+		}
+
+		auto start_time = clock::now();
+		for (uint64_t i = 0; i < frames; ++i)
+		{
+			frame();
+		}
+		std::chrono::duration<double> elapsed = clock::now() - start_time;
+		auto calls = device_calls ? device_calls() - first_calls : 0;
+
+		if (elapsed >= settings.min_time or frames >= max_frames)
+		{
+			std::vector<rate> rates;
+			for (size_t i = 0; i < rate_counters.size(); ++i)
+			{
+				auto count = rate_counters[i].count() - first_counts[i];
+				rates.push_back({ rate_counters[i].name, static_cast<double>(count) / elapsed.count() });
+			}
+
+			auto operations = static_cast<double>(frames * operations_per_frame);
+			results.push_back({ std::string(name),
+			                    object_count,
+			                    frames,
+			                    std::chrono::duration<double, std::nano>(elapsed).count() / operations,
+			                    static_cast<double>(calls) / frames,
+			                    rates });
+			break;
+		}
+		frames *= 2;
+	}
+
+	const auto &last = results.back();
+	std::printf("%-40s %10u %10llu %14.2f %14.1f",
+	            last.name.c_str(),
+	            last.object_count,
+	            static_cast<unsigned long long>(last.frames),
+	            last.ns_per_op,
+	            last.calls_per_frame);
+	for (const auto &entry : last.rates)
+	{
+		std::printf("   %s %.3g", entry.name.c_str(), entry.per_second);
+	}
+	std::printf("\n");
+	std::fflush(stdout);
+}
+
+const std::vector<benchmark::result> &benchmark::runner::get_results() const
+{
+	return results;
+}
+
+void benchmark::runner::write_csv(std::string_view file_name) const
+{
+	std::ofstream file{ std::string(file_name), std::ios::trunc };
+	if (not file)
+	{
+		throw std::runtime_error("Cannot create benchmark results file");
+	}
+
+	// Rates vary by benchmark, so they share one column as name=value pairs
+	file << "benchmark,objects,frames,ns_per_op,calls_per_frame,rates\n";
+	for (const auto &entry : results)
+	{
+		file << entry.name << ','
+		     << entry.object_count << ','
+		     << entry.frames << ','
+		     << entry.ns_per_op << ','
+		     << entry.calls_per_frame << ',';
+		for (size_t i = 0; i < entry.rates.size(); ++i)
+		{
+			file << (i > 0 ? ";" : "") << entry.rates[i].name << '=' << entry.rates[i].per_second;
+		}
+		file << '\n';
+	}
+}
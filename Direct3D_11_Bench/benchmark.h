@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Minimal timing harness. A benchmark is one frame of work doing a known
+	// number of operations, the runner repeats it, doubling the repetitions,
+	// until a batch takes at least min_time and reports that batch.
+	namespace benchmark
+	{
+		struct rate
+		{
+			std::string name;
+			double per_second;
+		};
+
+		struct result
+		{
+			std::string name;
+			uint32_t object_count;
+			uint64_t frames;
+			double ns_per_op;
+			double calls_per_frame; // render device calls, 0 where no device is involved
+			std::vector<rate> rates;
+		};
+
+		// Cumulative render device calls, sampled around the measured batch
+		using call_counter = std::function<uint64_t()>;
+
+		// Cumulative count of some other unit of work, triangles or bytes say,
+		// sampled the same way and reported per second of the batch
+		struct rate_counter
+		{
+			std::string name;
+			std::function<uint64_t()> count;
+		};
+
+		class runner
+		{
+		public:
+			struct description
+			{
+				std::chrono::duration<double> min_time;
+				std::string filter; // substring of the names to run, empty runs everything
+			};
+
+		public:
+			runner() = delete;
+			runner(const description &runner_description);
+			~runner();
+
+			void run(std::string_view name,
+			         uint32_t object_count,
+			         uint64_t operations_per_frame,
+			         const std::function<void()> &frame,
+			         const call_counter &device_calls = nullptr,
+			         const std::vector<rate_counter> &rate_counters = {});
+
+			const std::vector<result> &get_results() const;
+			void write_csv(std::string_view file_name) const;
+
+		private:
+			description settings{};
+			std::vector<result> results;
+		};
+	}
+}
@@ -0,0 +1,879 @@
+// CPU side cost of the renderer's primitives, measured against the headless
+// render devices so it runs without a GPU and on any platform.
+//
+//   Direct3D_11_Bench [filter] [--min-time milliseconds] [--csv file]
+//
+// mesh_generator, mesh_file and packed instance cases need DirectXMath and the Windows SDK,
+// they are left out elsewhere. Outside Visual Studio, from this directory:
+//   g++ -std=c++17 -O2 -pthread -I../Direct3D_11_Exe *.cpp ../Direct3D_11_Exe/{draw_queue,frame_statistics,frustum_culler,index_codec,input_queue,job_system,null_render_device,profiler,software_render_device,transform_hierarchy}.cpp -o bench
+
+#include "benchmark.h"
+
+#include "draw_queue.h"
+#include "frame_statistics.h"
+#include "frustum_culler.h"
+#include "index_codec.h"
+#include "input_queue.h"
+#include "job_system.h"
+#include "null_render_device.h"
+#include "profiler.h"
+#include "software_render_device.h"
+#include "transform_hierarchy.h"
+
+#ifdef _WIN32
+#include "mesh_file.h"
+#include "mesh_generator.h"
+#include "vertex.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using pipeline_handle = render_device::pipeline_handle;
+	using mesh_handle = render_device::mesh_handle;
+
+	// Stand-in bytecode, the headless devices only check that it is there
+	constexpr std::array<uint8_t, 4> shader_bytes{ 0x44, 0x58, 0x42, 0x43 };
+
+	// Mirrors graphics_renderer
+	constexpr uint32_t per_frame_slot = 0;
+	constexpr std::array<float, 4> clear_color{ 0.35f, 0.25f, 0.35f, 1.0f };
+
+	struct per_frame_constants
+	{
+		std::array<float, 16> view_projection;
+	};
+
+	constexpr per_frame_constants identity_constants{ { 1.0f, 0.0f, 0.0f, 0.0f,
+	                                                    0.0f, 1.0f, 0.0f, 0.0f,
+	                                                    0.0f, 0.0f, 1.0f, 0.0f,
+	                                                    0.0f, 0.0f, 0.0f, 1.0f } };
+
+	// Cycles through the state combinations so neighbouring pipelines differ
+	render_device::pipeline_description make_pipeline_description(uint32_t index)
+	{
+		return { static_cast<render_device::blend_e>(index % 4),
+		         static_cast<render_device::depth_stencil_e>(index / 4 % 3),
+		         static_cast<render_device::rasterizer_e>(index / 12 % 3),
+		         render_device::sampler_e::LinearClamp,
+		         render_device::input_layout_e::position,
+		         render_device::topology_e::triangle_list,
+		         { shader_bytes.data(), shader_bytes.size() },
+		         { shader_bytes.data(), shader_bytes.size() } };
+	}
+
+	// Square of two triangles in the XY plane, scaled and moved in clip space
+	struct quad
+	{
+		std::array<float, 12> positions;
+		std::array<uint32_t, 6> indices{ 0, 1, 2, 2, 1, 3 };
+
+		quad(float left, float top, float right, float bottom, float depth) :
+			positions{ left, top, depth,
+			           right, top, depth,
+			           left, bottom, depth,
+			           right, bottom, depth }
+		{}
+
+		render_device::mesh_description get_description() const
+		{
+			return { positions.data(), sizeof(float) * 3, 4,
+			         indices.data(), render_device::index_type_e::uint32, static_cast<uint32_t>(indices.size()) };
+		}
+	};
+
+	// Everything the null device was asked to do, creation included
+	uint64_t count_calls(const null_render_device &device)
+	{
+		const auto &total = device.get_total_statistics();
+		return uint64_t(total.pipelines_created) + total.meshes_created + total.clears
+		       + total.instance_streams_created + total.pipeline_binds + total.mesh_binds
+		       + total.instance_updates + total.instance_binds + total.constant_updates
+		       + total.draw_calls + total.presents;
+	}
+
+	// Small repeatable generator, the standard engines differ between libraries
+	uint32_t next_random(uint32_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// 1, 2, 4 ... threads up to one per core, the core count itself last
+	std::vector<uint32_t> get_thread_counts()
+	{
+		auto core_count = std::max(1U, std::thread::hardware_concurrency());
+
+		std::vector<uint32_t> thread_counts;
+		for (uint32_t count = 1; count < core_count; count *= 2)
+		{
+			thread_counts.push_back(count);
+		}
+		thread_counts.push_back(core_count);
+		return thread_counts;
+	}
+
+	// Overhead of the render_device calls themselves, against the null device.
+	// No pipeline_state or mesh_buffer is created, those need Direct3D and a GPU,
+	// so these are the floor every backend adds on top of its own work.
+	void null_device_benchmarks(benchmark::runner &runner)
+	{
+		for (uint32_t object_count : { 1U, 16U, 256U, 4096U })
+		{
+			// Handles are never reused, a fresh device keeps the tables from growing
+			uint64_t calls = 0;
+			runner.run("null_device/create_pipeline", object_count, object_count, [&]()
+			{
+				null_render_device device(true);
+				for (uint32_t i = 0; i < object_count; ++i)
+				{
+					device.create_pipeline(make_pipeline_description(i));
+				}
+				calls += count_calls(device);
+			},
+			[&]() { return calls; });
+		}
+
+		for (uint32_t object_count : { 1U, 16U, 256U, 4096U })
+		{
+			null_render_device device(true);
+			std::vector<pipeline_handle> pipelines;
+			for (uint32_t i = 0; i < object_count; ++i)
+			{
+				pipelines.push_back(device.create_pipeline(make_pipeline_description(i)));
+			}
+
+			runner.run("null_device/set_pipeline", object_count, object_count, [&]()
+			{
+				device.begin_frame();
+				for (auto pipeline : pipelines)
+				{
+					device.set_pipeline(pipeline);
+				}
+				device.end_frame();
+			},
+			[&]() { return count_calls(device); });
+		}
+
+		quad mesh_data(-0.5f, 0.5f, 0.5f, -0.5f, 0.5f);
+
+		for (uint32_t object_count : { 1U, 16U, 256U, 4096U })
+		{
+			uint64_t calls = 0;
+			runner.run("null_device/create_mesh", object_count, object_count, [&]()
+			{
+				null_render_device device(true);
+				for (uint32_t i = 0; i < object_count; ++i)
+				{
+					device.create_mesh(mesh_data.get_description());
+				}
+				calls += count_calls(device);
+			},
+			[&]() { return calls; });
+		}
+
+		for (uint32_t object_count : { 1U, 16U, 256U, 4096U })
+		{
+			null_render_device device(true);
+			std::vector<mesh_handle> meshes;
+			for (uint32_t i = 0; i < object_count; ++i)
+			{
+				meshes.push_back(device.create_mesh(mesh_data.get_description()));
+			}
+
+			runner.run("null_device/set_mesh_draw", object_count, object_count, [&]()
+			{
+				device.begin_frame();
+				for (auto mesh : meshes)
+				{
+					device.set_mesh(mesh);
+					device.draw();
+				}
+				device.end_frame();
+			},
+			[&]() { return count_calls(device); });
+
+			runner.run("null_device/draw_instanced", object_count, object_count, [&]()
+			{
+				device.begin_frame();
+				for (auto mesh : meshes)
+				{
+					device.set_mesh(mesh);
+					device.draw_instanced(16);
+				}
+				device.end_frame();
+			},
+			[&]() { return count_calls(device); });
+		}
+	}
+
+	// One mesh drawn object_count times: a constant update and draw per object,
+	// as graphics_renderer draws, against packing every transform into a mapped
+	// instance stream with pack_instances and one draw_instanced. Packing needs
+	// DirectXMath, so that side is Windows only. The null device does not copy
+	// constant data, so the per object side is a lower bound. Op is one object.
+	void instancing_benchmarks(benchmark::runner &runner)
+	{
+		constexpr uint32_t per_object_slot = 1;
+		quad mesh_data(-0.5f, 0.5f, 0.5f, -0.5f, 0.5f);
+
+		for (uint32_t object_count : { 16U, 256U, 4096U, 65'536U })
+		{
+			null_render_device device(true);
+			auto mesh = device.create_mesh(mesh_data.get_description());
+
+			std::vector<per_frame_constants> transforms(object_count, identity_constants);
+			for (uint32_t i = 0; i < object_count; ++i)
+			{
+				transforms[i].view_projection[12] = static_cast<float>(i);
+			}
+
+			runner.run("instancing/per_object_draws", object_count, object_count, [&]()
+			{
+				device.begin_frame();
+				device.set_mesh(mesh);
+				for (const auto &transform : transforms)
+				{
+					device.set_constants(render_device::shader_stage_e::vertex, per_object_slot, transform.view_projection.data(), sizeof(transform.view_projection));
+					device.draw();
+				}
+				device.end_frame();
+			},
+			[&]() { return count_calls(device); });
+
+#ifdef _WIN32
+			std::vector<DirectX::XMMATRIX> instance_transforms(object_count);
+			for (uint32_t i = 0; i < object_count; ++i)
+			{
+				instance_transforms[i] = DirectX::XMMatrixTranslation(static_cast<float>(i), 0.0f, 0.0f);
+			}
+			auto stream = device.create_instance_stream({ sizeof(instance), object_count });
+
+			runner.run("instancing/packed_instances", object_count, object_count, [&]()
+			{
+				device.begin_frame();
+				auto instances = static_cast<instance *>(device.map_instances(stream, object_count));
+				pack_instances(instance_transforms.data(), instance_transforms.size(), instances);
+				device.unmap_instances(stream);
+				device.set_mesh(mesh);
+				device.set_instances(stream);
+				device.draw_instanced(object_count);
+				device.end_frame();
+			},
+			[&]() { return count_calls(device); });
+#endif
+		}
+	}
+
+	// The swap chain is not there to resize, so this times the software
+	// device reallocating its colour and depth targets, one op per resize
+	void render_target_benchmarks(benchmark::runner &runner)
+	{
+		for (uint32_t size : { 256U, 512U, 1024U, 2048U })
+		{
+			software_render_device device({ size, size, 1, false });
+
+			runner.run("render_target/resize", size, 2, [&]()
+			{
+				device.resize_target(size - software_render_device::tile_size, size);
+				device.resize_target(size, size);
+			},
+			[&]() { return device.get_call_count(); });
+		}
+	}
+
+	// Same sequence of device calls as graphics_renderer::draw_frame and
+	// present_frame, with object_count items going through the draw_queue.
+	// Given a job system the items are submitted from its threads.
+	class frame_scene
+	{
+	public:
+		frame_scene(render_device &device, uint32_t object_count, uint32_t pipeline_count, uint32_t mesh_count, job_system *jobs = nullptr) :
+			device(device),
+			jobs(jobs),
+			draw_items(object_count)
+		{
+			for (uint32_t i = 0; i < pipeline_count; ++i)
+			{
+				auto pipeline = device.create_pipeline(make_pipeline_description(i));
+				pipeline_ids.push_back(draw_items.add_pipeline(pipeline));
+			}
+
+			// Quads laid out on a grid so the software device has real coverage
+			uint32_t columns = 1;
+			while (columns * columns < mesh_count)
+			{
+				columns++;
+			}
+			auto cell = 2.0f / columns;
+			for (uint32_t i = 0; i < mesh_count; ++i)
+			{
+				auto left = -1.0f + (i % columns) * cell,
+				     top = 1.0f - (i / columns) * cell;
+				quad mesh_data(left, top, left + cell, top - cell, 0.5f);
+				mesh_ids.push_back(draw_items.add_mesh(device.create_mesh(mesh_data.get_description())));
+			}
+
+			uint32_t random_state = 0x2545f491;
+			items.reserve(object_count);
+			for (uint32_t i = 0; i < object_count; ++i)
+			{
+				items.push_back({ pipeline_ids[next_random(random_state) % pipeline_count],
+				                  mesh_ids[next_random(random_state) % mesh_count],
+				                  (next_random(random_state) & 0xffff) / 65536.0f });
+			}
+		}
+
+		void draw_frame()
+		{
+			PROFILE_SCOPE("frame_scene::draw_frame");
+
+			device.wait_for_frame();
+			device.begin_frame();
+			device.clear(clear_color);
+			device.set_constants(render_device::shader_stage_e::vertex, per_frame_slot, &identity_constants, sizeof(identity_constants));
+
+			if (jobs)
+			{
+				jobs->parallel_for(static_cast<uint32_t>(items.size()), objects_per_job, [this](uint32_t first, uint32_t last)
+				{
+					submit_items(first, last);
+				});
+			}
+			else
+			{
+				submit_items(0, static_cast<uint32_t>(items.size()));
+			}
+			draw_items.execute(device);
+
+			device.end_frame();
+			device.present();
+		}
+
+		const draw_queue::statistics &get_statistics() const
+		{
+			return draw_items.get_statistics();
+		}
+
+	private:
+		struct item
+		{
+			draw_queue::pipeline_id pipeline;
+			draw_queue::mesh_id mesh;
+			float depth;
+		};
+
+		void submit_items(uint32_t first, uint32_t last)
+		{
+			draw_queue::batch batch(draw_items);
+			for (auto i = first; i < last; ++i)
+			{
+				batch.submit(items[i].pipeline, items[i].mesh, items[i].depth);
+			}
+		}
+
+		// Mirrors graphics_renderer
+		static constexpr uint32_t objects_per_job = 1'024;
+
+		render_device &device;
+		job_system *jobs;
+		draw_queue draw_items;
+		std::vector<draw_queue::pipeline_id> pipeline_ids;
+		std::vector<draw_queue::mesh_id> mesh_ids;
+		std::vector<item> items;
+	};
+
+	// Running totals of the software device's per frame statistics, for rate counters
+	struct software_totals
+	{
+		uint64_t triangles_rasterized;
+		uint64_t pixels_written;
+
+		void add(const software_render_device::statistics &frame)
+		{
+			triangles_rasterized += frame.triangles_rasterized;
+			pixels_written += frame.pixels_written;
+		}
+
+		std::vector<benchmark::rate_counter> get_rate_counters()
+		{
+			return { { "triangles/s", [this]() { return triangles_rasterized; } },
+			         { "pixels/s", [this]() { return pixels_written; } } };
+		}
+	};
+
+	void draw_frame_benchmarks(benchmark::runner &runner)
+	{
+		for (uint32_t object_count : { 100U, 1'000U, 10'000U, 100'000U })
+		{
+			null_render_device device(true);
+			frame_scene scene(device, object_count, 16, 256);
+
+			runner.run("draw_frame/null", object_count, object_count, [&]() { scene.draw_frame(); },
+			           [&]() { return count_calls(device); });
+		}
+
+		// Includes binning and rasterizing every quad, one op per draw item
+		for (uint32_t object_count : { 100U, 1'000U, 10'000U })
+		{
+			software_render_device device({ 512, 512, 0, false });
+			frame_scene scene(device, object_count, 16, 256);
+			software_totals totals{};
+
+			runner.run("draw_frame/software", object_count, object_count, [&]()
+			{
+				scene.draw_frame();
+				totals.add(device.get_last_frame_statistics());
+			},
+			[&]() { return device.get_call_count(); }, totals.get_rate_counters());
+		}
+
+		// Command building spread over the job system, against draw_frame/null above
+		for (auto thread_count : get_thread_counts())
+		{
+			job_system jobs({ thread_count, 4'096 });
+			null_render_device device(true);
+			frame_scene scene(device, 100'000, 16, 256, &jobs);
+
+			runner.run("draw_frame/null_jobs/threads_" + std::to_string(thread_count), 100'000, 100'000, [&]() { scene.draw_frame(); },
+			           [&]() { return count_calls(device); });
+		}
+
+		// Raster throughput against tile threads, at a size where fill dominates setup
+		for (auto thread_count : get_thread_counts())
+		{
+			software_render_device device({ 1024, 1024, thread_count, false });
+			frame_scene scene(device, 1'000, 16, 64);
+			software_totals totals{};
+
+			runner.run("draw_frame/software/threads_" + std::to_string(thread_count), 1'000, 1'000, [&]()
+			{
+				scene.draw_frame();
+				totals.add(device.get_last_frame_statistics());
+			},
+			[&]() { return device.get_call_count(); }, totals.get_rate_counters());
+		}
+	}
+
+	// Scheduler overhead and scaling, from one thread up to one per core.
+	// spawn_wait is empty jobs, so pure overhead, parallel_for does a little
+	// arithmetic per item, roughly a transform update.
+	void job_system_benchmarks(benchmark::runner &runner)
+	{
+		constexpr uint32_t job_count = 4'096;
+		constexpr uint32_t item_count = 262'144;
+
+		std::vector<std::array<float, 4>> values(item_count, { 1.0f, 2.0f, 3.0f, 1.0f });
+
+		for (auto thread_count : get_thread_counts())
+		{
+			job_system jobs({ thread_count, 8'192 });
+			auto suffix = "/threads_" + std::to_string(thread_count);
+
+			runner.run("job_system/spawn_wait" + suffix, job_count, job_count, [&]()
+			{
+				auto root = jobs.create([]() {});
+				for (uint32_t i = 0; i < job_count; ++i)
+				{
+					jobs.run(jobs.create([]() {}, root));
+				}
+				jobs.run(root);
+				jobs.wait(root);
+			});
+
+			runner.run("job_system/parallel_for" + suffix, item_count, item_count, [&]()
+			{
+				jobs.parallel_for(item_count, 1'024, [&](uint32_t first, uint32_t last)
+				{
+					for (auto i = first; i < last; ++i)
+					{
+						auto &v = values[i];
+						v = { v[0] * 0.5f + v[1] * 0.25f + v[3],
+						      v[1] * 0.5f - v[0] * 0.25f + v[3],
+						      v[2] * 0.5f + v[3],
+						      v[3] };
+					}
+				});
+			});
+		}
+	}
+
+	// Op is one object tested, objects culled per microsecond is 1000 over ns/op.
+	// Bounds are half spheres, half boxes, scattered all around a camera looking
+	// down +z with a 90 degree field of view, so about a sixth are visible.
+	void frustum_culler_benchmarks(benchmark::runner &runner)
+	{
+		constexpr float near_z = 0.1f, far_z = 1'000.0f, range = far_z / (far_z - near_z);
+		const float view_projection[4][4]{ { 1.0f, 0.0f, 0.0f, 0.0f },
+		                                   { 0.0f, 1.0f, 0.0f, 0.0f },
+		                                   { 0.0f, 0.0f, range, 1.0f },
+		                                   { 0.0f, 0.0f, -near_z * range, 0.0f } };
+
+		auto make_culler = [&](uint32_t object_count)
+		{
+			auto culler = std::make_unique<frustum_culler>(object_count);
+			uint32_t random_state = 0x2545f491;
+			auto coordinate = [&]() { return (next_random(random_state) & 0xffff) / 32768.0f * 500.0f - 500.0f; };
+			for (uint32_t i = 0; i < object_count; ++i)
+			{
+				auto x = coordinate(), y = coordinate(), z = coordinate();
+				auto size = (next_random(random_state) & 0xff) / 64.0f + 0.5f;
+				if (i % 2 == 0)
+				{
+					culler->add(frustum_culler::sphere{ x, y, z, size });
+				}
+				else
+				{
+					culler->add(frustum_culler::box{ x - size, y - size * 0.5f, z - size, x + size, y + size * 0.5f, z + size });
+				}
+			}
+			culler->set_frustum(view_projection);
+			return culler;
+		};
+
+		uint64_t visible_total = 0;
+		for (uint32_t object_count : { 1'000U, 10'000U, 100'000U })
+		{
+			auto culler = make_culler(object_count);
+			std::vector<frustum_culler::object_id> visible(object_count);
+
+			runner.run("frustum_culler/cull", object_count, object_count, [&]()
+			{
+				visible_total += culler->cull(0, object_count, visible.data());
+			});
+		}
+
+		// Spread over the job system as graphics_renderer does
+		constexpr uint32_t object_count = 100'000;
+		auto culler = make_culler(object_count);
+		std::vector<frustum_culler::object_id> visible(object_count);
+		for (auto thread_count : get_thread_counts())
+		{
+			job_system jobs({ thread_count, 4'096 });
+
+			runner.run("frustum_culler/cull_jobs/threads_" + std::to_string(thread_count), object_count, object_count, [&]()
+			{
+				jobs.parallel_for(object_count, 1'024, [&](uint32_t first, uint32_t last)
+				{
+					culler->cull(first, last, &visible[first]);
+				});
+			});
+		}
+	}
+
+	// Op is a whole update of a 100k node forest, 100 roots with four children
+	// per node, after dirtying dirty_count random nodes, so ns/op is the frame's cost.
+	void transform_hierarchy_benchmarks(benchmark::runner &runner)
+	{
+		constexpr uint32_t node_count = 100'000;
+		constexpr uint32_t root_count = 100;
+
+		transform_hierarchy::matrix local{ { { 1.0f, 0.0f, 0.0f, 0.0f },
+		                                     { 0.0f, 1.0f, 0.0f, 0.0f },
+		                                     { 0.0f, 0.0f, 1.0f, 0.0f },
+		                                     { 0.5f, 0.25f, 0.0f, 1.0f } } };
+
+		transform_hierarchy transforms(node_count);
+		for (uint32_t i = 0; i < node_count; ++i)
+		{
+			transforms.add(i < root_count ? transform_hierarchy::invalid_node : (i - root_count) / 4, local);
+		}
+		transforms.update();
+
+		uint32_t random_state = 0x9e3779b9;
+		auto update = [&](uint32_t dirty_count, job_system *jobs)
+		{
+			for (uint32_t i = 0; i < dirty_count; ++i)
+			{
+				transforms.set_local(dirty_count == node_count ? i : next_random(random_state) % node_count, local);
+			}
+			transforms.update(jobs);
+		};
+
+		for (uint32_t dirty_count : { 0U, 100U, 1'000U, node_count })
+		{
+			runner.run("transform_hierarchy/update/dirty_" + std::to_string(dirty_count), node_count, 1, [&]() { update(dirty_count, nullptr); });
+		}
+
+		for (auto thread_count : get_thread_counts())
+		{
+			job_system jobs({ thread_count, 4'096 });
+			for (uint32_t dirty_count : { 1'000U, node_count })
+			{
+				runner.run("transform_hierarchy/update_jobs/dirty_" + std::to_string(dirty_count) + "/threads_" + std::to_string(thread_count),
+				           node_count, 1, [&]() { update(dirty_count, &jobs); });
+			}
+		}
+	}
+
+	void instrumentation_benchmarks(benchmark::runner &runner)
+	{
+		runner.run("profiler/scope", 1, 1'000, [&]()
+		{
+			for (uint32_t i = 0; i < 1'000; ++i)
+			{
+				profiler::scope scope("benchmark");
+			}
+		});
+
+		latency_histogram histogram;
+		uint32_t random_state = 0x9e3779b9;
+		runner.run("latency_histogram/record", 1, 1'000, [&]()
+		{
+			for (uint32_t i = 0; i < 1'000; ++i)
+			{
+				histogram.record(next_random(random_state) & 0xffffff);
+			}
+		});
+	}
+
+	// The window's input ring against the std::function table it replaced, which
+	// copied the callback out for every message. Op is one message, the ring
+	// side includes taking the timestamp and draining in a batch.
+	void input_benchmarks(benchmark::runner &runner)
+	{
+		constexpr uint32_t messages_per_frame = 256;
+		uint64_t handled = 0;
+
+		using callback_method = std::function<bool(uintptr_t, uintptr_t)>;
+		std::array<callback_method, 3> callback_methods{};
+		for (auto &callback : callback_methods)
+		{
+			callback = [&](uintptr_t wParam, uintptr_t lParam) -> bool
+			{
+				handled += wParam + lParam;
+				return true;
+			};
+		}
+
+		runner.run("input/callback_dispatch", messages_per_frame, messages_per_frame, [&]()
+		{
+			for (uint32_t i = 0; i < messages_per_frame; ++i)
+			{
+				auto call = callback_methods.at(i % callback_methods.size());
+				if (call)
+				{
+					call(i, i);
+				}
+			}
+		});
+
+		runner.run("input/timestamp", 1, messages_per_frame, [&]()
+		{
+			for (uint32_t i = 0; i < messages_per_frame; ++i)
+			{
+				handled += input_event::clock::now().time_since_epoch().count() & 1;
+			}
+		});
+
+		input_queue input(4096);
+		std::vector<input_event> batch(messages_per_frame);
+		runner.run("input/ring_push_drain", messages_per_frame, messages_per_frame, [&]()
+		{
+			for (uint32_t i = 0; i < messages_per_frame; ++i)
+			{
+				input.push({ input_event::clock::now(),
+				             input_event::type_e::mouse_move,
+				             input_event::button_e::none,
+				             0,
+				             0,
+				             static_cast<int32_t>(i),
+				             static_cast<int32_t>(i) });
+			}
+
+			auto count = input.pop_batch(batch.data(), messages_per_frame);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				handled += batch[i].x + batch[i].y;
+			}
+		});
+	}
+
+	// The mesh loading path, op is one index
+	void index_codec_benchmarks(benchmark::runner &runner)
+	{
+		for (uint32_t index_count : { 6'144U, 393'216U })
+		{
+			// Triangle list of a grid, the usual shape of a cache friendly mesh
+			std::vector<uint32_t> indices;
+			uint32_t columns = 64;
+			for (uint32_t quad_index = 0; indices.size() < index_count; ++quad_index)
+			{
+				auto row = quad_index / columns,
+				     column = quad_index % columns,
+				     corner = row * (columns + 1) + column;
+				for (auto offset : { 0U, columns + 1, 1U, 1U, columns + 1, columns + 2 })
+				{
+					indices.push_back(corner + offset);
+				}
+			}
+
+			std::vector<uint8_t> encoded;
+			runner.run("index_codec/encode", index_count, index_count, [&]()
+			{
+				encoded = index_codec::encode(indices.data(), indices.size());
+			});
+
+			std::vector<uint32_t> decoded(indices.size());
+			runner.run("index_codec/decode", index_count, index_count, [&]()
+			{
+				index_codec::decode(encoded.data(), encoded.size(), decoded.data());
+			});
+		}
+	}
+
+#ifdef _WIN32
+	// Op is one triangle, from one thread up to one per core. The sphere leans
+	// on the SIMD trig tables, the grid is little more than stores.
+	void mesh_generator_benchmarks(benchmark::runner &runner)
+	{
+		constexpr uint32_t segments = 512;
+		auto sphere = mesh_generator::sphere_size(segments, segments);
+		auto grid = mesh_generator::grid_size(segments, segments);
+		auto vertex_count = std::max(sphere.vertex_count, grid.vertex_count);
+
+		std::vector<DirectX::XMFLOAT3> positions(vertex_count), normals(vertex_count);
+		std::vector<DirectX::XMFLOAT2> texcoords(vertex_count);
+		std::vector<uint32_t> indices(std::max(sphere.index_count, grid.index_count));
+		mesh_generator::mesh_output output{ positions.data(), normals.data(), texcoords.data(), indices.data(), 0 };
+
+		uint64_t triangles = 0;
+		std::vector<benchmark::rate_counter> triangle_rate{ { "triangles/s", [&]() { return triangles; } } };
+
+		for (auto thread_count : get_thread_counts())
+		{
+			auto suffix = "/threads_" + std::to_string(thread_count);
+
+			runner.run("mesh_generator/sphere" + suffix, sphere.index_count / 3, sphere.index_count / 3, [&]()
+			{
+				mesh_generator::make_sphere(output, 1.0f, segments, segments, thread_count);
+				triangles += sphere.index_count / 3;
+			},
+			nullptr, triangle_rate);
+
+			runner.run("mesh_generator/grid" + suffix, grid.index_count / 3, grid.index_count / 3, [&]()
+			{
+				mesh_generator::make_grid(output, 1.0f, 1.0f, segments, segments, thread_count);
+				triangles += grid.index_count / 3;
+			},
+			nullptr, triangle_rate);
+		}
+	}
+
+	// Reads a byte per cache line, so the pages are in memory as an upload would need them
+	uint64_t touch_pages(const void *data, size_t size, uint32_t &checksum)
+	{
+		auto bytes = static_cast<const uint8_t *>(data);
+		for (size_t i = 0; i < size; i += 64)
+		{
+			checksum += bytes[i];
+		}
+		return size;
+	}
+
+	// Op is one mesh file opened, mapped and validated. open_read also reads
+	// the vertex and index blobs, which the first upload would page in.
+	void mesh_file_benchmarks(benchmark::runner &runner)
+	{
+		for (uint32_t segments : { 32U, 256U, 1'024U })
+		{
+			auto size = mesh_generator::sphere_size(segments, segments);
+			std::vector<vertex> vertices(size.vertex_count);
+			std::vector<uint32_t> indices(size.index_count);
+			mesh_generator::make_sphere({ &vertices[0].position, nullptr, nullptr, indices.data(), 0 }, 1.0f, segments, segments);
+
+			auto path = (std::filesystem::temp_directory_path() / ("Direct3D_11_Bench_" + std::to_string(segments) + ".mesh")).wstring();
+			mesh_format::write(path, vertices, { { indices.data(), size.index_count, 0.0f } });
+
+			uint32_t checksum = 0;
+			runner.run("mesh_file/open", size.vertex_count, 1, [&]()
+			{
+				mesh_file file(path);
+				checksum += file.get_vertex_count();
+			});
+
+			uint64_t bytes_read = 0;
+			runner.run("mesh_file/open_read", size.vertex_count, 1, [&]()
+			{
+				mesh_file file(path);
+				bytes_read += touch_pages(file.get_vertex_data(), size_t(file.get_vertex_stride()) * file.get_vertex_count(), checksum);
+				bytes_read += touch_pages(file.get_index_data(0), size_t(file.get_index_size()) * file.get_lod(0).index_count, checksum);
+			},
+			nullptr, { { "bytes/s", [&]() { return bytes_read; } } });
+
+			std::filesystem::remove(path);
+		}
+	}
+#endif
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	benchmark::runner::description settings{ std::chrono::milliseconds(200), {} };
+	std::string csv_file;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view argument = argv[i];
+		if (argument == "--min-time" and i + 1 < argc)
+		{
+			settings.min_time = std::chrono::milliseconds(std::atoi(argv[++i]));
+		}
+		else if (argument == "--csv" and i + 1 < argc)
+		{
+			csv_file = argv[++i];
+		}
+		else
+		{
+			settings.filter = argument;
+		}
+	}
+
+	try
+	{
+		benchmark::runner runner(settings);
+
+		null_device_benchmarks(runner);
+		instancing_benchmarks(runner);
+		render_target_benchmarks(runner);
+		draw_frame_benchmarks(runner);
+		job_system_benchmarks(runner);
+		frustum_culler_benchmarks(runner);
+		transform_hierarchy_benchmarks(runner);
+		instrumentation_benchmarks(runner);
+		input_benchmarks(runner);
+		index_codec_benchmarks(runner);
+#ifdef _WIN32
+		mesh_generator_benchmarks(runner);
+		mesh_file_benchmarks(runner);
+#endif
+
+		if (not csv_file.empty())
+		{
+			runner.write_csv(csv_file);
+		}
+	}
+	catch (const std::exception &error)
+	{
+		std::fprintf(stderr, "%s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,61 +1,201 @@
 #include "application.h"
+#include "profiler.h"
 
+#include <chrono>
+#include <exception>
 #include <functional>
 #include <ratio>
 
 using namespace direct3d_11_eg;
 
+namespace
+{
+	// Two buffer flip chain with one queued frame keeps input latency to a frame
+	constexpr direct3d::presentation present_settings{
+		direct3d::present_mode_e::flip_discard_waitable,
+		2,
+		1,
+		true
+	};
+
+	// Software limit on top of the swap chain, zero leaves pacing to vsync
+	constexpr std::chrono::microseconds frame_limit{ 0 };
+
+	// Simulation runs at 120 Hz whatever the frame rate, catching up at most 8 steps a frame
+	constexpr simulation_clock::description simulation_settings{
+		std::chrono::duration_cast<simulation_clock::clock::duration>(std::chrono::duration<int64_t, std::ratio<1, 120>>(1)),
+		8,
+		std::chrono::milliseconds(250)
+	};
+
+	// Radians per second
+	constexpr double rotation_speed = 0.5;
+
+	constexpr render_thread::description render_thread_settings{
+		256,                           // input events per batch
+		std::chrono::milliseconds(10)  // input polling while minimised
+	};
+
+	constexpr auto frame_statistics_csv = L"frame_statistics.csv";
+	constexpr auto frame_statistics_json = L"frame_statistics.json";
+	constexpr auto profiler_trace_json = L"profiler_trace.json";
+}
 
 application::application()
 {
+	profiler::set_thread_name("main");
+	PROFILE_SCOPE("application::application");
+
 	constexpr uint16_t height = 600;
 	constexpr uint16_t width = height * 16 / 10;
 
 	app_window = std::make_unique<window>(L"Direct3D 11.x Example",
 	                                      window::size{ width, height });
 
-	app_window->set_message_callback(window::message_type::keypress, 
-	                                 [&](uintptr_t key_code, uintptr_t extension) -> bool
-	                                 {
-	                                 	return keypress_callback(key_code, extension);
-	                                 });
-
-	app_window->set_message_callback(window::message_type::resize,
-	                                 [&](uintptr_t wParam, uintptr_t lParam) -> bool
-	                                 {
-	                                 	return resize_callback(wParam, lParam);
-	                                 });
-
-	gfx_renderer = std::make_unique<graphics_renderer>(app_window->handle());
+	gfx_renderer = std::make_unique<graphics_renderer>(app_window->handle(), present_settings);
+	pacer = std::make_unique<frame_pacer>(frame_limit);
+	frame_stats = std::make_unique<frame_statistics>();
+	sim_clock = std::make_unique<simulation_clock>(simulation_settings);
 }
 
 int application::run()
 {
 	app_window->show();
 
-	while (app_window->handle() and (not exit_application))
+	renderer_thread = std::make_unique<render_thread>(render_thread_settings, app_window->get_input(), render_thread::handlers{
+		[&](const input_event &event)
+		{
+			render_input(event);
+		},
+		[&](uint32_t width, uint32_t height)
+		{
+			render_resize(width, height);
+		},
+		[&](render_thread::clock::duration event_time)
+		{
+			render_frame(event_time);
+		}
+	});
+
+	// The render thread presents into the window, so it has to be gone before
+	// the window is, however the close was asked for
+	app_window->set_close_handler([&]()
 	{
-		gfx_renderer->draw_frame();
+		renderer_thread->stop();
+	});
 
+	// Frames and input handling run on the render thread, this one only
+	// waits for and dispatches messages until the window is gone
+	while (app_window->handle())
+	{
+		app_window->wait_for_messages();
 		app_window->process_messages();
 	}
 
+	// Already stopped by the close handler, unless the window went some other way
+	renderer_thread->stop();
+
+	write_diagnostics();
 	return 0;
 }
 
-bool application::keypress_callback(uintptr_t key_code, uintptr_t extension)
+void application::render_input(const input_event &event)
 {
-	switch (key_code)
+	if (not has_frame_input)
+	{
+		has_frame_input = true;
+		oldest_frame_input = event.timestamp;
+	}
+
+	if (event.type == input_event::type_e::key_up)
 	{
-		case VK_ESCAPE:
-			exit_application = true;
-			break;
+		switch (event.key)
+		{
+			case VK_ESCAPE:
+				app_window->close();
+				break;
+			case VK_F2:
+				write_diagnostics();
+				break;
+		}
 	}
-	return true;
 }
 
-bool direct3d_11_eg::application::resize_callback(uintptr_t wParam, uintptr_t lParam)
+void application::render_resize(uint32_t, uint32_t)
 {
+	frame_statistics::scoped_timer timer(*frame_stats, frame_statistics::phase_e::resize);
 	gfx_renderer->resize_frame();
-	return false;
+}
+
+void application::render_frame(render_thread::clock::duration event_time)
+{
+	using phase_e = frame_statistics::phase_e;
+
+	frame_stats->record(phase_e::window_events, event_time);
+	if (has_frame_input)
+	{
+		frame_stats->record(phase_e::input_latency, input_event::clock::now() - oldest_frame_input);
+		has_frame_input = false;
+	}
+	auto steps = sim_clock->advance();
+	for (uint32_t i = 0; i < steps; ++i)
+	{
+		simulate(sim_clock->get_step_seconds());
+	}
+
+	// Draw between the last two states, so motion is smooth at any frame rate
+	auto alpha = sim_clock->get_interpolation();
+	auto rotation = previous_state.rotation + (current_state.rotation - previous_state.rotation) * alpha;
+
+	DirectX::XMFLOAT4X4 view_projection{};
+	DirectX::XMStoreFloat4x4(&view_projection, DirectX::XMMatrixRotationZ(static_cast<float>(rotation)));
+	{
+		frame_statistics::scoped_timer timer(*frame_stats, phase_e::draw_frame);
+		gfx_renderer->draw_frame(view_projection);
+	}
+	{
+		frame_statistics::scoped_timer timer(*frame_stats, phase_e::present);
+		gfx_renderer->present_frame();
+	}
+
+	pacer->end_frame();
+	frame_stats->end_frame();
+}
+
+void application::simulate(double step_seconds)
+{
+	PROFILE_SCOPE("application::simulate");
+
+	previous_state = current_state;
+	current_state.rotation += rotation_speed * step_seconds;
+
+	// Wrapped together, so interpolating between them never turns the long way round
+	if (current_state.rotation >= DirectX::XM_2PI)
+	{
+		previous_state.rotation -= DirectX::XM_2PI;
+		current_state.rotation -= DirectX::XM_2PI;
+	}
+}
+
+// Runs on the render thread for F2, a file that cannot be written must not end the program.
+// Each file is written on its own, failures go to the debugger output.
+void application::write_diagnostics()
+{
+	auto try_write = [](const std::function<void()> &write)
+	{
+		try
+		{
+			write();
+		}
+		catch (const std::exception &error)
+		{
+			OutputDebugStringA("Diagnostics not written: ");
+			OutputDebugStringA(error.what());
+			OutputDebugStringA("\n");
+		}
+	};
+
+	try_write([&]() { frame_stats->write_csv(frame_statistics_csv); });
+	try_write([&]() { frame_stats->write_json(frame_statistics_json); });
+	try_write([&]() { profiler::write_chrome_trace(profiler_trace_json); });
 }
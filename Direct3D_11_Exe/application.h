@@ -2,6 +2,10 @@
 
 #include "window.h"
 #include "graphics_renderer.h"
+#include "frame_pacer.h"
+#include "frame_statistics.h"
+#include "render_thread.h"
+#include "simulation_clock.h"
 
 #include <memory>
 
@@ -11,18 +15,41 @@ namespace direct3d_11_eg
 	class application
 	{
 	public:
+		// Everything the fixed step simulation advances, interpolated for drawing
+		struct simulation_state
+		{
+			double rotation;
+		};
+
 		application();
 
 		int run();
 
 	private:
-		bool keypress_callback(uintptr_t key_code, uintptr_t extension);
-		bool resize_callback(uintptr_t wParam, uintptr_t lParam);
+		void write_diagnostics();
+
+		// Render thread
+		void render_input(const input_event &event);
+		void render_resize(uint32_t width, uint32_t height);
+		void render_frame(render_thread::clock::duration event_time);
+		void simulate(double step_seconds);
 
 	private:
-		bool exit_application = false;
 		std::unique_ptr<window> app_window = nullptr;
 		std::unique_ptr<graphics_renderer> gfx_renderer = nullptr;
+		std::unique_ptr<frame_pacer> pacer = nullptr;
+		std::unique_ptr<frame_statistics> frame_stats = nullptr;
+
+		std::unique_ptr<simulation_clock> sim_clock = nullptr;
+		simulation_state previous_state{};
+		simulation_state current_state{};
+
+		// Oldest input handled since the last frame, for input to frame latency
+		bool has_frame_input = false;
+		input_event::clock::time_point oldest_frame_input{};
+
+		// Declared last so it stops before anything a frame touches is destroyed
+		std::unique_ptr<render_thread> renderer_thread = nullptr;
 	};
 
 };
\ No newline at end of file
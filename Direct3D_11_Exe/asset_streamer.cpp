@@ -0,0 +1,194 @@
+#include "asset_streamer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace direct3d_11_eg;
+
+asset_streamer::asset_streamer(const description &streamer_description, time_source clock) :
+	settings(streamer_description),
+	clock(std::move(clock))
+{
+	settings.worker_count = std::max(1U, settings.worker_count);
+	settings.max_pending_uploads = std::max(1U, settings.max_pending_uploads);
+
+	workers.reserve(settings.worker_count);
+	for (uint32_t i = 0; i < settings.worker_count; ++i)
+	{
+		workers.emplace_back(&asset_streamer::worker_loop, this);
+	}
+}
+
+asset_streamer::~asset_streamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_lock);
+		stopping = true;
+	}
+	load_ready.notify_all();
+	upload_space.notify_all();
+
+	// Anything still queued is dropped, uploads may reference objects being destroyed
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+asset_streamer::asset_id asset_streamer::request(load_function load)
+{
+	asset_id asset = invalid_asset;
+	{
+		std::lock_guard<std::mutex> lock(queue_lock);
+		asset = static_cast<asset_id>(states.size());
+		states.push_back(asset_state::queued);
+		load_queue.push_back({ asset, std::move(load) });
+		stats.requested++;
+	}
+	load_ready.notify_one();
+
+	return asset;
+}
+
+asset_streamer::asset_state asset_streamer::get_state(asset_id asset) const
+{
+	std::lock_guard<std::mutex> lock(queue_lock);
+	return (asset < states.size()) ? states[asset] : asset_state::failed;
+}
+
+bool asset_streamer::is_ready(asset_id asset) const
+{
+	return get_state(asset) == asset_state::ready;
+}
+
+void asset_streamer::process_uploads()
+{
+	auto start_time = clock();
+
+	uint64_t bytes_spent = 0;
+	uint32_t upload_count = 0;
+	bool deferred = false;
+
+	for (;;)
+	{
+		pending_upload next{};
+		{
+			std::lock_guard<std::mutex> lock(queue_lock);
+			if (upload_queue.empty())
+			{
+				break;
+			}
+
+			if (upload_count > 0 and bytes_spent + upload_queue.front().prepared.upload_bytes > settings.frame_upload_budget)
+			{
+				deferred = true;
+				break;
+			}
+
+			next = std::move(upload_queue.front());
+			upload_queue.pop_front();
+		}
+		upload_space.notify_one();
+
+		auto succeeded = true;
+		try
+		{
+			next.prepared.upload();
+		}
+		catch (const std::exception &)
+		{
+			succeeded = false;
+		}
+
+		bytes_spent += next.prepared.upload_bytes;
+		upload_count++;
+
+		std::lock_guard<std::mutex> lock(queue_lock);
+		if (succeeded)
+		{
+			states[next.asset] = asset_state::ready;
+			stats.uploaded++;
+		}
+		else
+		{
+			states[next.asset] = asset_state::failed;
+			stats.failed++;
+		}
+	}
+
+	std::chrono::duration<double, std::milli> upload_time = clock() - start_time;
+
+	std::lock_guard<std::mutex> lock(queue_lock);
+	stats.bytes_uploaded += bytes_spent;
+	stats.budget_deferrals += deferred ? 1 : 0;
+	stats.hitches += (upload_time > settings.hitch_threshold) ? 1 : 0;
+	stats.last_upload_time = upload_time;
+	stats.max_upload_time = std::max(stats.max_upload_time, upload_time);
+}
+
+asset_streamer::statistics asset_streamer::get_statistics() const
+{
+	std::lock_guard<std::mutex> lock(queue_lock);
+	return stats;
+}
+
+void asset_streamer::worker_loop()
+{
+	profiler::set_thread_name("asset_streamer");
+
+	for (;;)
+	{
+		pending_load next{};
+		{
+			std::unique_lock<std::mutex> lock(queue_lock);
+			load_ready.wait(lock, [this]()
+			{
+				return stopping or not load_queue.empty();
+			});
+			if (stopping)
+			{
+				return;
+			}
+
+			next = std::move(load_queue.front());
+			load_queue.pop_front();
+			states[next.asset] = asset_state::loading;
+		}
+
+		prepared_asset prepared{};
+		auto succeeded = true;
+		try
+		{
+			PROFILE_SCOPE("asset_streamer::load");
+			prepared = next.load();
+		}
+		catch (const std::exception &)
+		{
+			succeeded = false;
+		}
+
+		std::unique_lock<std::mutex> lock(queue_lock);
+		if (not succeeded)
+		{
+			states[next.asset] = asset_state::failed;
+			stats.failed++;
+			continue;
+		}
+
+		// Back pressure lands here, on the worker, never on the render thread
+		upload_space.wait(lock, [this]()
+		{
+			return stopping or upload_queue.size() < settings.max_pending_uploads;
+		});
+		if (stopping)
+		{
+			return;
+		}
+
+		upload_queue.push_back({ next.asset, std::move(prepared) });
+		states[next.asset] = asset_state::waiting_upload;
+		stats.loaded++;
+	}
+}
+
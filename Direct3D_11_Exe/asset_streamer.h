@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Loads assets in the background and uploads them a frame budget at a time.
+	//  * load functions run on worker threads, reading and decoding files
+	//  * what they return waits in a bounded upload queue, full queues stall the workers, never a frame
+	//  * process_uploads runs on the render thread and creates device resources
+	//    until the frame's byte budget is spent
+	// The streamer never touches the device itself, uploads are whatever closure the
+	// load function hands back, so a stand-in device is enough to exercise it.
+	class asset_streamer
+	{
+	public:
+		using asset_id = uint32_t;
+		static constexpr asset_id invalid_asset = UINT32_MAX;
+
+		enum class asset_state : uint8_t
+		{
+			queued,
+			loading,
+			waiting_upload,
+			ready,
+			failed
+		};
+
+		// Result of a load, upload_bytes is charged against the frame budget
+		struct prepared_asset
+		{
+			uint64_t upload_bytes;
+			std::function<void()> upload;
+		};
+		using load_function = std::function<prepared_asset()>;
+
+		using time_point = std::chrono::steady_clock::time_point;
+		using time_source = std::function<time_point()>;
+
+		struct description
+		{
+			uint32_t worker_count;
+			uint64_t frame_upload_budget;
+			uint32_t max_pending_uploads;
+			std::chrono::duration<double, std::milli> hitch_threshold;
+		};
+
+		struct statistics
+		{
+			uint32_t requested;
+			uint32_t loaded;
+			uint32_t uploaded;
+			uint32_t failed;
+			uint64_t bytes_uploaded;
+			uint32_t budget_deferrals; // frames that left uploads waiting on the budget
+			uint32_t hitches;          // frames whose uploads took longer than hitch_threshold
+			std::chrono::duration<double, std::milli> last_upload_time;
+			std::chrono::duration<double, std::milli> max_upload_time;
+		};
+
+	public:
+		asset_streamer() = delete;
+		asset_streamer(const description &streamer_description, time_source clock = std::chrono::steady_clock::now);
+		~asset_streamer();
+
+		asset_streamer(const asset_streamer &) = delete;
+		asset_streamer &operator=(const asset_streamer &) = delete;
+
+		asset_id request(load_function load);
+		asset_state get_state(asset_id asset) const;
+		bool is_ready(asset_id asset) const;
+
+		// Render thread, once per frame. At least one upload always goes through,
+		// so an asset larger than the whole budget still arrives.
+		void process_uploads();
+
+		statistics get_statistics() const;
+
+	private:
+		struct pending_load
+		{
+			asset_id asset;
+			load_function load;
+		};
+
+		struct pending_upload
+		{
+			asset_id asset;
+			prepared_asset prepared;
+		};
+
+		void worker_loop();
+
+	private:
+		description settings{};
+		time_source clock;
+
+		mutable std::mutex queue_lock;
+		std::condition_variable load_ready;
+		std::condition_variable upload_space;
+		bool stopping = false;
+
+		std::deque<pending_load> load_queue;
+		std::deque<pending_upload> upload_queue;
+		std::vector<asset_state> states;
+
+		std::vector<std::thread> workers;
+
+		statistics stats{};
+	};
+}
@@ -0,0 +1,256 @@
+#include "d3d11_render_device.h"
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Room for many small meshes per pool, larger meshes get a pool of their own size
+	constexpr uint32_t pool_vertices = 256 * 1024;
+	constexpr uint32_t pool_indices = 3 * pool_vertices;
+}
+
+d3d11_render_device::d3d11_render_device(HWND hWnd, const direct3d::presentation &present_settings, uint32_t constant_buffer_size)
+{
+	d3d = std::make_unique<direct3d>(hWnd, present_settings);
+	make_render_target();
+
+	state_objects = std::make_unique<state_cache>(d3d11_state_factory(d3d->get_device()));
+	context_state = std::make_unique<state_tracker>(d3d11_context(d3d->get_context()));
+	shader_constants = std::make_unique<constant_buffer_ring>(d3d->get_device(), d3d->get_context(), constant_buffer_size);
+}
+
+d3d11_render_device::~d3d11_render_device()
+{}
+
+render_device::pipeline_handle d3d11_render_device::create_pipeline(const pipeline_description &description)
+{
+	pipelines.push_back(std::make_unique<pipeline_state>(d3d->get_device(), *state_objects, description));
+	return static_cast<pipeline_handle>(pipelines.size() - 1);
+}
+
+void d3d11_render_device::destroy_pipeline(pipeline_handle pipeline)
+{
+	assert(pipeline < pipelines.size());
+
+	pipelines[pipeline].reset(nullptr);
+}
+
+render_device::mesh_handle d3d11_render_device::create_mesh(const mesh_description &description)
+{
+	add_to_pool(description, pack_indices(description));
+	return static_cast<mesh_handle>(meshes.size() - 1);
+}
+
+void d3d11_render_device::destroy_mesh(mesh_handle mesh)
+{
+	assert(mesh < meshes.size() and meshes[mesh].pool);
+
+	if (current_mesh == mesh)
+	{
+		current_mesh = invalid_handle;
+	}
+	meshes[mesh].pool->remove_mesh(meshes[mesh].pooled_mesh);
+	meshes[mesh] = { nullptr, geometry_pool::invalid_mesh };
+}
+
+render_device::instance_stream_handle d3d11_render_device::create_instance_stream(const instance_stream_description &description)
+{
+	instance_streams.push_back(std::make_unique<instance_buffer>(d3d->get_device(), description));
+	return static_cast<instance_stream_handle>(instance_streams.size() - 1);
+}
+
+void d3d11_render_device::destroy_instance_stream(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size());
+
+	if (current_instances == instance_streams[stream].get())
+	{
+		current_instances = nullptr;
+	}
+	instance_streams[stream].reset(nullptr);
+}
+
+void *d3d11_render_device::map_instances(instance_stream_handle stream, uint32_t instance_count)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream]);
+
+	return instance_streams[stream]->map(d3d->get_context(), instance_count);
+}
+
+void d3d11_render_device::unmap_instances(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream]);
+
+	instance_streams[stream]->unmap(d3d->get_context());
+}
+
+void d3d11_render_device::wait_for_frame()
+{
+	d3d->wait_for_frame();
+}
+
+void d3d11_render_device::begin_frame()
+{
+	context_state->begin_frame();
+	shader_constants->begin_frame();
+
+	// Flip model presents unbind the back buffer, so it is bound again every frame
+	draw_buffer->activate(d3d->get_context());
+}
+
+void d3d11_render_device::end_frame()
+{
+	shader_constants->end_frame();
+}
+
+void d3d11_render_device::present()
+{
+	d3d->present();
+}
+
+void d3d11_render_device::resize()
+{
+	draw_buffer.reset(nullptr);
+
+	d3d->resize_swap_chain();
+
+	make_render_target();
+}
+
+void d3d11_render_device::clear(const std::array<float, 4> &clear_color)
+{
+	draw_buffer->clear_views(d3d->get_context(), clear_color);
+}
+
+void d3d11_render_device::set_pipeline(pipeline_handle pipeline)
+{
+	assert(pipeline < pipelines.size() and pipelines[pipeline]);
+
+	pipelines[pipeline]->activate(*context_state);
+}
+
+void d3d11_render_device::set_mesh(mesh_handle mesh)
+{
+	assert(mesh < meshes.size() and meshes[mesh].pool);
+
+	// Already bound whenever the last mesh came from the same pool
+	current_mesh = mesh;
+	meshes[mesh].pool->activate(*context_state);
+}
+
+void d3d11_render_device::set_instances(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream]);
+
+	current_instances = instance_streams[stream].get();
+	current_instances->activate(*context_state);
+}
+
+void d3d11_render_device::set_constants(shader_stage_e stage, uint32_t slot, const void *data, uint32_t size)
+{
+	auto allocation = shader_constants->allocate(data, size);
+
+	switch (stage)
+	{
+		case shader_stage_e::vertex:
+			shader_constants->bind_vertex_shader(slot, allocation);
+			break;
+		case shader_stage_e::pixel:
+			shader_constants->bind_pixel_shader(slot, allocation);
+			break;
+	}
+}
+
+void d3d11_render_device::draw()
+{
+	assert(current_mesh != invalid_handle);
+
+	const auto &mesh = meshes[current_mesh];
+	mesh.pool->draw(d3d->get_context(), mesh.pooled_mesh);
+}
+
+void d3d11_render_device::draw_instanced(uint32_t instance_count)
+{
+	assert(current_mesh != invalid_handle);
+	assert(not current_instances or instance_count <= current_instances->get_instance_count());
+
+	const auto &mesh = meshes[current_mesh];
+	mesh.pool->draw_instanced(d3d->get_context(), mesh.pooled_mesh, instance_count);
+}
+
+const state_tracker::statistics &d3d11_render_device::get_last_frame_statistics() const
+{
+	return context_state->get_last_frame_statistics();
+}
+
+void d3d11_render_device::make_render_target()
+{
+	draw_buffer = std::make_unique<render_target>(d3d->get_device(), d3d->get_swap_chain());
+}
+
+// Into the first pool of the same layout with room, compacting one if that makes
+// room, otherwise into a new pool
+void d3d11_render_device::add_to_pool(const mesh_description &description, const index_codec::packed_indices &indices)
+{
+	auto index_format = get_index_format(indices.index_size);
+	auto add_mesh = [&](geometry_pool &pool)
+	{
+		return pool.add_mesh(d3d->get_context(),
+		                     description.vertex_data,
+		                     description.vertex_count,
+		                     indices.data.data(),
+		                     indices.index_count);
+	};
+	auto is_added = [](const geometry_pool::mesh &pooled_mesh)
+	{
+		return pooled_mesh.vertex_handle != geometry_pool::invalid_mesh.vertex_handle;
+	};
+
+	for (auto &pool : geometry_pools)
+	{
+		if (pool->get_vertex_stride() != description.vertex_stride or pool->get_index_format() != index_format)
+		{
+			continue;
+		}
+
+		auto pooled_mesh = add_mesh(*pool);
+		if (not is_added(pooled_mesh))
+		{
+			auto stats = pool->get_statistics();
+			if (stats.vertices.free_size < description.vertex_count or stats.indices.free_size < indices.index_count)
+			{
+				continue;
+			}
+
+			pool->defragment(d3d->get_device(), d3d->get_context());
+			pooled_mesh = add_mesh(*pool);
+
+			// Buffers were replaced, the bound ones would draw stale offsets
+			if (current_mesh != invalid_handle and meshes[current_mesh].pool == pool.get())
+			{
+				pool->activate(*context_state);
+			}
+		}
+
+		if (is_added(pooled_mesh))
+		{
+			meshes.push_back({ pool.get(), pooled_mesh });
+			return;
+		}
+	}
+
+	geometry_pools.push_back(std::make_unique<geometry_pool>(d3d->get_device(), geometry_pool::description{
+	                                                             description.vertex_stride,
+	                                                             index_format,
+	                                                             std::max(pool_vertices, description.vertex_count),
+	                                                             std::max(pool_indices, indices.index_count) }));
+
+	auto pooled_mesh = add_mesh(*geometry_pools.back());
+	assert(is_added(pooled_mesh));
+
+	meshes.push_back({ geometry_pools.back().get(), pooled_mesh });
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "render_device.h"
+#include "direct3d.h"
+
+#include <Windows.h>
+#include <memory>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// render_device over the window's Direct3D 11 device and swap chain.
+	// Pipelines and instance streams are pipeline_state and instance_buffer objects.
+	// Meshes are suballocated from geometry_pools, one set per vertex stride and
+	// index format, so drawing meshes of one pool binds its buffers only once.
+	// Binds go through a state_tracker and constants through a constant_buffer_ring.
+	class d3d11_render_device : public render_device
+	{
+	public:
+		d3d11_render_device() = delete;
+		d3d11_render_device(HWND hWnd, const direct3d::presentation &present_settings, uint32_t constant_buffer_size);
+		~d3d11_render_device() override;
+
+		pipeline_handle create_pipeline(const pipeline_description &description) override;
+		void destroy_pipeline(pipeline_handle pipeline) override;
+
+		mesh_handle create_mesh(const mesh_description &description) override;
+		void destroy_mesh(mesh_handle mesh) override;
+
+		instance_stream_handle create_instance_stream(const instance_stream_description &description) override;
+		void destroy_instance_stream(instance_stream_handle stream) override;
+		void *map_instances(instance_stream_handle stream, uint32_t instance_count) override;
+		void unmap_instances(instance_stream_handle stream) override;
+
+		void wait_for_frame() override;
+		void begin_frame() override;
+		void end_frame() override;
+		void present() override;
+		void resize() override;
+
+		void clear(const std::array<float, 4> &clear_color) override;
+		void set_pipeline(pipeline_handle pipeline) override;
+		void set_mesh(mesh_handle mesh) override;
+		void set_instances(instance_stream_handle stream) override;
+		void set_constants(shader_stage_e stage, uint32_t slot, const void *data, uint32_t size) override;
+
+		void draw() override;
+		void draw_instanced(uint32_t instance_count) override;
+
+		const state_tracker::statistics &get_last_frame_statistics() const;
+
+	private:
+		void make_render_target();
+		void add_to_pool(const mesh_description &description, const index_codec::packed_indices &indices);
+
+	private:
+		std::unique_ptr<direct3d> d3d = nullptr;
+		std::unique_ptr<render_target> draw_buffer = nullptr;
+		std::unique_ptr<state_cache> state_objects = nullptr;
+		std::unique_ptr<state_tracker> context_state = nullptr;
+		std::unique_ptr<constant_buffer_ring> shader_constants = nullptr;
+
+		struct mesh_entry
+		{
+			geometry_pool *pool;
+			geometry_pool::mesh pooled_mesh;
+		};
+
+		// Indexed by handle, destroyed slots stay empty and handles are never reused
+		std::vector<std::unique_ptr<pipeline_state>> pipelines;
+		std::vector<mesh_entry> meshes;
+		std::vector<std::unique_ptr<instance_buffer>> instance_streams;
+
+		std::vector<std::unique_ptr<geometry_pool>> geometry_pools;
+
+		mesh_handle current_mesh = invalid_handle;
+		instance_buffer *current_instances = nullptr;
+	};
+}
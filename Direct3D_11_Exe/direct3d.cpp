@@ -8,12 +8,19 @@
 
 #include "direct3d.h"
 #include "vertex.h"
+#include "index_codec.h"
+#include "mesh_file.h"
+#include "profiler.h"
 
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
 #include <array>
 #include <vector>
 #include <DirectXColors.h>
+#include <dxgi1_3.h>
 
 using namespace direct3d_11_eg;
 using namespace direct3d_11_eg::direct3d_types;
@@ -24,10 +31,18 @@ namespace
 	constexpr uint16_t msaa_quality_level = 4U;
 	constexpr uint32_t max_anisotropy = 16U;
 
-	using element_desc = std::vector<D3D11_INPUT_ELEMENT_DESC>;
-	constexpr D3D11_INPUT_ELEMENT_DESC position = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
-	constexpr D3D11_INPUT_ELEMENT_DESC normal = { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
-	constexpr D3D11_INPUT_ELEMENT_DESC texcoord = { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	// Input layouts, generated and validated at compile time
+	using position_layout = vertex::layout;
+	using position_texcoord_layout = vertex_layout<vertex_attribute<position_semantic, DXGI_FORMAT_R32G32B32_FLOAT>,
+	                                               vertex_attribute<texcoord_semantic, DXGI_FORMAT_R32G32_FLOAT>>;
+	using position_instanced_layout = vertex_layout<vertex_attribute<position_semantic, DXGI_FORMAT_R32G32B32_FLOAT>,
+	                                                instance_attribute<instance_transform_semantic, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, instance_buffer::input_slot>,
+	                                                instance_attribute<instance_transform_semantic, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, instance_buffer::input_slot>,
+	                                                instance_attribute<instance_transform_semantic, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, instance_buffer::input_slot>,
+	                                                instance_attribute<instance_transform_semantic, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, instance_buffer::input_slot>>;
+	using packed_layout = packed_vertex::layout;
+
+	static_assert(position_instanced_layout::stride(instance_buffer::input_slot) == sizeof(instance), "instance does not match its layout");
 
 	const std::array<uint16_t, 2> get_window_size(HWND window_handle)
 	{
@@ -52,6 +67,16 @@ namespace
 		};
 	}
 
+	// Depth has to match the back buffer, which is never multisampled in flip model
+	const DXGI_SAMPLE_DESC get_swap_chain_sample_desc(swap_chain_t swap_chain)
+	{
+		DXGI_SWAP_CHAIN_DESC sd{};
+		auto hr = swap_chain->GetDesc(&sd);
+		assert(hr == S_OK);
+
+		return sd.SampleDesc;
+	}
+
 	const DXGI_RATIONAL get_refresh_rate(CComPtr<IDXGIAdapter> dxgiAdapter, HWND window_handle, bool vSync = true)
 	{
 		DXGI_RATIONAL refresh_rate{ 0, 1 };
@@ -115,29 +140,61 @@ namespace
 		return sd;
 	}
 
+	D3D11_PRIMITIVE_TOPOLOGY get_primitive_topology(render_device::topology_e topology)
+	{
+		switch (topology)
+		{
+			case render_device::topology_e::triangle_list:
+				return D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			case render_device::topology_e::triangle_strip:
+				return D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+			case render_device::topology_e::line_list:
+				return D3D11_PRIMITIVE_TOPOLOGY_LINELIST;
+			case render_device::topology_e::point_list:
+				return D3D11_PRIMITIVE_TOPOLOGY_POINTLIST;
+		}
+		return D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	}
+
 }
 
 #pragma region "Device, Context and Swap Chain"
 
-direct3d::direct3d(HWND hWnd) :
-	window_handle(hWnd)
+direct3d::direct3d(HWND hWnd, const presentation &present_settings) :
+	window_handle(hWnd),
+	settings(present_settings)
 {
 	make_device();
 	make_swap_chain();
 }
 
 direct3d::~direct3d()
-{}
+{
+	if (frame_latency_waitable)
+	{
+		CloseHandle(frame_latency_waitable);
+	}
+}
 
 void direct3d::resize_swap_chain()
 {
-	auto hr = swap_chain->ResizeBuffers(NULL, NULL, NULL, DXGI_FORMAT_UNKNOWN, NULL);
+	// Flags have to match creation, waitable chains refuse to resize otherwise
+	auto hr = swap_chain->ResizeBuffers(NULL, NULL, NULL, DXGI_FORMAT_UNKNOWN, swap_chain_flags);
 	assert(hr == S_OK);
 }
 
-void direct3d::present(bool vSync)
+void direct3d::present()
+{
+	swap_chain->Present((settings.vsync ? TRUE : FALSE), NULL);
+}
+
+void direct3d::wait_for_frame()
 {
-	swap_chain->Present((vSync ? TRUE : FALSE), NULL);
+	if (frame_latency_waitable)
+	{
+		constexpr DWORD max_wait_ms = 1000;
+		WaitForSingleObjectEx(frame_latency_waitable, max_wait_ms, TRUE);
+	}
 }
 
 context_t direct3d::get_context() const
@@ -199,20 +256,64 @@ void direct3d::make_swap_chain()
 	
 	auto [width, height] = get_window_size(window_handle);
 
-	DXGI_SWAP_CHAIN_DESC sd{};
-	sd.BufferCount = 1;
-	sd.BufferDesc.Width = width;
-	sd.BufferDesc.Height = height;
-	sd.BufferDesc.Format = swap_chain_format;
-	sd.BufferDesc.RefreshRate = get_refresh_rate(dxgi_adapter, window_handle);
-	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	sd.OutputWindow = window_handle;
-	sd.SampleDesc = get_msaa_level(device);
-	sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
-	sd.Windowed = TRUE;
-
-	hr = dxgi_factory->CreateSwapChain(device, &sd, &swap_chain);
-	assert(hr == S_OK);
+	if (settings.mode == present_mode_e::blit)
+	{
+		swap_chain_flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+
+		DXGI_SWAP_CHAIN_DESC sd{};
+		sd.BufferCount = 1;
+		sd.BufferDesc.Width = width;
+		sd.BufferDesc.Height = height;
+		sd.BufferDesc.Format = swap_chain_format;
+		sd.BufferDesc.RefreshRate = get_refresh_rate(dxgi_adapter, window_handle);
+		sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		sd.OutputWindow = window_handle;
+		sd.SampleDesc = get_msaa_level(device);
+		sd.Flags = swap_chain_flags;
+		sd.Windowed = TRUE;
+
+		hr = dxgi_factory->CreateSwapChain(device, &sd, &swap_chain);
+		assert(hr == S_OK);
+	}
+	else
+	{
+		CComPtr<IDXGIFactory2> dxgi_factory2{};
+		hr = dxgi_factory->QueryInterface<IDXGIFactory2>(&dxgi_factory2);
+		assert(hr == S_OK);
+
+		auto waitable = (settings.mode == present_mode_e::flip_discard_waitable);
+		swap_chain_flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH
+		                 | (waitable ? DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT : 0);
+
+		DXGI_SWAP_CHAIN_DESC1 sd{};
+		sd.Width = width;
+		sd.Height = height;
+		sd.Format = swap_chain_format;
+		sd.SampleDesc = { 1, 0 };
+		sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		sd.BufferCount = std::clamp(settings.buffer_count, 2U, 3U);
+		sd.Scaling = DXGI_SCALING_STRETCH;
+		sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+		sd.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+		sd.Flags = swap_chain_flags;
+
+		CComPtr<IDXGISwapChain1> swap_chain1{};
+		hr = dxgi_factory2->CreateSwapChainForHwnd(device, window_handle, &sd, nullptr, nullptr, &swap_chain1);
+		assert(hr == S_OK);
+		swap_chain = swap_chain1.p;
+
+		if (waitable)
+		{
+			CComPtr<IDXGISwapChain2> swap_chain2{};
+			hr = swap_chain1->QueryInterface<IDXGISwapChain2>(&swap_chain2);
+			assert(hr == S_OK);
+
+			hr = swap_chain2->SetMaximumFrameLatency(std::max(1U, settings.max_frame_latency));
+			assert(hr == S_OK);
+
+			frame_latency_waitable = swap_chain2->GetFrameLatencyWaitableObject();
+		}
+	}
 
 	dxgi_factory->MakeWindowAssociation(window_handle, DXGI_MWA_NO_ALT_ENTER | DXGI_MWA_NO_WINDOW_CHANGES);
 }
@@ -226,7 +327,7 @@ render_target::render_target(direct3d_types::device_t device, direct3d_types::sw
 	auto [width, height] = get_swap_chain_size(swap_chain);
 
 	make_target_view(device, swap_chain);
-	make_stencil_view(device, {width, height});
+	make_stencil_view(device, {width, height}, get_swap_chain_sample_desc(swap_chain));
 
 	viewport = {};
 	viewport.Width = width;
@@ -263,7 +364,7 @@ void render_target::make_target_view(device_t device, swap_chain_t swap_chain)
 	assert(hr == S_OK);
 }
 
-void render_target::make_stencil_view(device_t device, const std::array<uint16_t, 2> &buffer_size)
+void render_target::make_stencil_view(device_t device, const std::array<uint16_t, 2> &buffer_size, const DXGI_SAMPLE_DESC &sample_desc)
 {
 	auto [width, height] = buffer_size;
 
@@ -275,7 +376,7 @@ void render_target::make_stencil_view(device_t device, const std::array<uint16_t
 	td.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	td.Usage = D3D11_USAGE_DEFAULT;
 	td.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-	td.SampleDesc = get_msaa_level(device);
+	td.SampleDesc = sample_desc;
 
 	auto hr = device->CreateTexture2D(&td,
 	                                  0,
@@ -290,65 +391,107 @@ void render_target::make_stencil_view(device_t device, const std::array<uint16_t
 
 #pragma endregion
 
-#pragma region "Pipeline State"
-
-pipeline_state::pipeline_state(device_t device, const description &state_description)
-{
-	make_blend_state(device, state_description.blend);
-	make_depth_stencil_state(device, state_description.depth_stencil);
-	make_rasterizer_state(device, state_description.rasterizer);
-	make_sampler_state(device, state_description.sampler);
-
-	make_input_layout(device, state_description.input_layout, state_description.vertex_shader_file);
-	make_vertex_shader(device, state_description.vertex_shader_file);
-	make_pixel_shader(device, state_description.pixel_shader_file);
+#pragma region "Context"
 
-	primitive_topology = state_description.primitive_topology;
-}
+d3d11_context::d3d11_context(context_t context) :
+	context(context)
+{}
 
-pipeline_state::~pipeline_state()
+d3d11_context::~d3d11_context()
 {}
 
-void pipeline_state::activate(context_t context)
+void d3d11_context::set_blend_state(const blend_state_t &blend_state)
 {
 	context->OMSetBlendState(blend_state,
 	                         DirectX::Colors::Transparent,
 	                         0xffff'ffff);
+}
+
+void d3d11_context::set_depth_stencil_state(const depth_stencil_state_t &depth_stencil_state)
+{
 	context->OMSetDepthStencilState(depth_stencil_state,
 	                                NULL);
+}
+
+void d3d11_context::set_rasterizer_state(const rasterizer_state_t &rasterizer_state)
+{
 	context->RSSetState(rasterizer_state);
+}
+
+void d3d11_context::set_sampler_state(const sampler_state_t &sampler_state)
+{
 	context->PSSetSamplers(0,
 	                       1,
 	                       &sampler_state.p);
+}
 
-
+void d3d11_context::set_primitive_topology(topology_t primitive_topology)
+{
 	context->IASetPrimitiveTopology(primitive_topology);
+}
+
+void d3d11_context::set_input_layout(const input_layout_t &input_layout)
+{
 	context->IASetInputLayout(input_layout);
+}
 
+void d3d11_context::set_vertex_shader(const vertex_shader_t &vertex_shader)
+{
 	context->VSSetShader(vertex_shader, nullptr, 0);
+}
+
+void d3d11_context::set_pixel_shader(const pixel_shader_t &pixel_shader)
+{
 	context->PSSetShader(pixel_shader, nullptr, 0);
 }
 
-void pipeline_state::make_blend_state(device_t device, blend_e blend)
+void d3d11_context::set_vertex_buffer(uint32_t slot, const buffer_t &vertex_buffer, uint32_t stride, uint32_t offset)
+{
+	context->IASetVertexBuffers(slot,
+	                            1,
+	                            &vertex_buffer.p,
+	                            &stride,
+	                            &offset);
+}
+
+void d3d11_context::set_index_buffer(const buffer_t &index_buffer, format_t format, uint32_t offset)
+{
+	context->IASetIndexBuffer(index_buffer,
+	                          format,
+	                          offset);
+}
+
+#pragma endregion
+
+#pragma region "State Factory"
+
+d3d11_state_factory::d3d11_state_factory(device_t device) :
+	device(device)
+{}
+
+d3d11_state_factory::~d3d11_state_factory()
+{}
+
+blend_state_t d3d11_state_factory::make_blend_state(render_device::blend_e blend) const
 {
 	D3D11_BLEND src{}, dst{};
 	D3D11_BLEND_OP op{ D3D11_BLEND_OP_ADD };
 
 	switch (blend)
 	{
-		case blend_e::Opaque:
+		case render_device::blend_e::Opaque:
 			src = D3D11_BLEND_ONE;
 			dst = D3D11_BLEND_ZERO;
 			break;
-		case blend_e::Alpha:
+		case render_device::blend_e::Alpha:
 			src = D3D11_BLEND_ONE;
 			dst = D3D11_BLEND_INV_SRC_ALPHA;
 			break;
-		case blend_e::Additive:
+		case render_device::blend_e::Additive:
 			src = D3D11_BLEND_SRC_ALPHA;
 			dst = D3D11_BLEND_ONE;
 			break;
-		case blend_e::NonPremultipled:
+		case render_device::blend_e::NonPremultipled:
 			src = D3D11_BLEND_SRC_ALPHA;
 			dst = D3D11_BLEND_INV_SRC_ALPHA;
 			break;
@@ -368,25 +511,28 @@ void pipeline_state::make_blend_state(device_t device, blend_e blend)
 
 	bd.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
+	blend_state_t blend_state{};
 	auto hr = device->CreateBlendState(&bd, &blend_state);
 	assert(hr == S_OK);
+
+	return blend_state;
 }
 
-void pipeline_state::make_depth_stencil_state(device_t device, depth_stencil_e depth_stencil)
+depth_stencil_state_t d3d11_state_factory::make_depth_stencil_state(render_device::depth_stencil_e depth_stencil) const
 {
 	bool depth_enable{ false }, write_enable{ false };
 
 	switch (depth_stencil)
 	{
-		case depth_stencil_e::None:
+		case render_device::depth_stencil_e::None:
 			depth_enable = false;
 			write_enable = false;
 			break;
-		case depth_stencil_e::ReadWrite:
+		case render_device::depth_stencil_e::ReadWrite:
 			depth_enable = true;
 			write_enable = true;
 			break;
-		case depth_stencil_e::ReadOnly:
+		case render_device::depth_stencil_e::ReadOnly:
 			depth_enable = true;
 			write_enable = false;
 			break;
@@ -409,30 +555,33 @@ void pipeline_state::make_depth_stencil_state(device_t device, depth_stencil_e d
 
 	dsd.BackFace = dsd.FrontFace;
 
+	depth_stencil_state_t depth_stencil_state{};
 	auto hr = device->CreateDepthStencilState(&dsd, &depth_stencil_state);
 	assert(hr == S_OK);
+
+	return depth_stencil_state;
 }
 
-void pipeline_state::make_rasterizer_state(device_t device, rasterizer_e rasterizer)
+rasterizer_state_t d3d11_state_factory::make_rasterizer_state(render_device::rasterizer_e rasterizer) const
 {
 	D3D11_CULL_MODE cull_mode{};
 	D3D11_FILL_MODE fill_mode{};
 
 	switch (rasterizer)
 	{
-		case rasterizer_e::CullNone:
+		case render_device::rasterizer_e::CullNone:
 			cull_mode = D3D11_CULL_NONE;
 			fill_mode = D3D11_FILL_SOLID;
 			break;
-		case rasterizer_e::CullClockwise:
+		case render_device::rasterizer_e::CullClockwise:
 			cull_mode = D3D11_CULL_FRONT;
 			fill_mode = D3D11_FILL_SOLID;
 			break;
-		case rasterizer_e::CullAntiClockwise:
+		case render_device::rasterizer_e::CullAntiClockwise:
 			cull_mode = D3D11_CULL_BACK;
 			fill_mode = D3D11_FILL_SOLID;
 			break;
-		case rasterizer_e::Wireframe:
+		case render_device::rasterizer_e::Wireframe:
 			cull_mode = D3D11_CULL_BACK;
 			fill_mode = D3D11_FILL_WIREFRAME;
 			break;
@@ -446,38 +595,41 @@ void pipeline_state::make_rasterizer_state(device_t device, rasterizer_e rasteri
 	rd.MultisampleEnable = true;
 
 	
+	rasterizer_state_t rasterizer_state{};
 	auto hr = device->CreateRasterizerState(&rd, &rasterizer_state);
 	assert(hr == S_OK);
+
+	return rasterizer_state;
 }
 
-void pipeline_state::make_sampler_state(device_t device, sampler_e sampler)
+sampler_state_t d3d11_state_factory::make_sampler_state(render_device::sampler_e sampler) const
 {
 	D3D11_FILTER filter{};
 	D3D11_TEXTURE_ADDRESS_MODE texture_address_mode{};
 
 	switch (sampler)
 	{
-		case sampler_e::PointWrap:
+		case render_device::sampler_e::PointWrap:
 			filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
 			texture_address_mode = D3D11_TEXTURE_ADDRESS_WRAP;
 			break;
-		case sampler_e::PointClamp:
+		case render_device::sampler_e::PointClamp:
 			filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
 			texture_address_mode = D3D11_TEXTURE_ADDRESS_CLAMP;
 			break;
-		case sampler_e::LinearWrap:
+		case render_device::sampler_e::LinearWrap:
 			filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
 			texture_address_mode = D3D11_TEXTURE_ADDRESS_WRAP;
 			break;
-		case sampler_e::LinearClamp:
+		case render_device::sampler_e::LinearClamp:
 			filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
 			texture_address_mode = D3D11_TEXTURE_ADDRESS_CLAMP;
 			break;
-		case sampler_e::AnisotropicWrap:
+		case render_device::sampler_e::AnisotropicWrap:
 			filter = D3D11_FILTER_ANISOTROPIC;
 			texture_address_mode = D3D11_TEXTURE_ADDRESS_WRAP;
 			break;
-		case sampler_e::AnisotropicClamp:
+		case render_device::sampler_e::AnisotropicClamp:
 			filter = D3D11_FILTER_ANISOTROPIC;
 			texture_address_mode = D3D11_TEXTURE_ADDRESS_CLAMP;
 			break;
@@ -496,44 +648,124 @@ void pipeline_state::make_sampler_state(device_t device, sampler_e sampler)
 	sd.MaxLOD = FLT_MAX;
 	sd.ComparisonFunc = D3D11_COMPARISON_NEVER;
 
+	sampler_state_t sampler_state{};
 	auto hr = device->CreateSamplerState(&sd, &sampler_state);
 	assert(hr == S_OK);
+
+	return sampler_state;
+}
+
+#pragma endregion
+
+#pragma region "Pipeline State"
+
+pipeline_state::pipeline_state(device_t device, state_cache &state_objects, const description &state_description)
+{
+	PROFILE_SCOPE("pipeline_state");
+
+	make_states(state_objects,
+	            state_description.blend,
+	            state_description.depth_stencil,
+	            state_description.rasterizer,
+	            state_description.sampler);
+
+	render_device::shader_code vso{ state_description.vertex_shader_file->data(), state_description.vertex_shader_file->size() },
+	                           pso{ state_description.pixel_shader_file->data(), state_description.pixel_shader_file->size() };
+
+	make_input_layout(device, state_description.input_layout, vso);
+	make_vertex_shader(device, vso);
+	make_pixel_shader(device, pso);
+
+	primitive_topology = state_description.primitive_topology;
 }
 
-void pipeline_state::make_input_layout(device_t device, input_layout_e layout, const std::vector<byte> &vso)
+pipeline_state::pipeline_state(device_t device, state_cache &state_objects, const render_device::pipeline_description &state_description)
 {
-	element_desc elements;
+	PROFILE_SCOPE("pipeline_state");
+
+	make_states(state_objects,
+	            state_description.blend,
+	            state_description.depth_stencil,
+	            state_description.rasterizer,
+	            state_description.sampler);
+
+	make_input_layout(device, state_description.input_layout, state_description.vertex_shader);
+	make_vertex_shader(device, state_description.vertex_shader);
+	make_pixel_shader(device, state_description.pixel_shader);
+
+	primitive_topology = get_primitive_topology(state_description.topology);
+}
+
+pipeline_state::~pipeline_state()
+{}
+
+void pipeline_state::activate(state_tracker &context_state)
+{
+	context_state.set_blend_state(blend_state);
+	context_state.set_depth_stencil_state(depth_stencil_state);
+	context_state.set_rasterizer_state(rasterizer_state);
+	context_state.set_sampler_state(sampler_state);
+
+	context_state.set_primitive_topology(primitive_topology);
+	context_state.set_input_layout(input_layout);
+
+	context_state.set_vertex_shader(vertex_shader);
+	context_state.set_pixel_shader(pixel_shader);
+}
+
+void pipeline_state::make_states(state_cache &state_objects, blend_e blend, depth_stencil_e depth_stencil, rasterizer_e rasterizer, sampler_e sampler)
+{
+	blend_state = state_objects.get_blend_state(blend);
+	depth_stencil_state = state_objects.get_depth_stencil_state(depth_stencil);
+	rasterizer_state = state_objects.get_rasterizer_state(rasterizer);
+	sampler_state = state_objects.get_sampler_state(sampler);
+}
+
+void pipeline_state::make_input_layout(device_t device, input_layout_e layout, const render_device::shader_code &vso)
+{
+	const D3D11_INPUT_ELEMENT_DESC *elements = nullptr;
+	uint32_t element_count = 0;
 	switch (layout)
 	{
 		case input_layout_e::position:
-			elements = { position };
+			elements = position_layout::elements.data();
+			element_count = position_layout::element_count;
 			break;
 		case input_layout_e::position_texcoord:
-			elements = { position, texcoord };
+			elements = position_texcoord_layout::elements.data();
+			element_count = position_texcoord_layout::element_count;
+			break;
+		case input_layout_e::position_instanced:
+			elements = position_instanced_layout::elements.data();
+			element_count = position_instanced_layout::element_count;
+			break;
+		case input_layout_e::packed_position_normal_texcoord:
+			elements = packed_layout::elements.data();
+			element_count = packed_layout::element_count;
 			break;
 	}
 
-	auto hr = device->CreateInputLayout(elements.data(),
-	                                    static_cast<uint32_t>(elements.size()),
-	                                    vso.data(),
-	                                    static_cast<uint32_t>(vso.size()),
+	auto hr = device->CreateInputLayout(elements,
+	                                    element_count,
+	                                    vso.data,
+	                                    vso.size,
 	                                    &input_layout);
 	assert(hr == S_OK);
 }
 
-void pipeline_state::make_vertex_shader(device_t device, const std::vector<byte> &vso)
+void pipeline_state::make_vertex_shader(device_t device, const render_device::shader_code &vso)
 {
-	auto hr = device->CreateVertexShader(vso.data(),
-	                                     vso.size(),
+	auto hr = device->CreateVertexShader(vso.data,
+	                                     vso.size,
 	                                     NULL,
 	                                     &vertex_shader);
 	assert(hr == S_OK);
 }
 
-void pipeline_state::make_pixel_shader(device_t device, const std::vector<byte> &pso)
+void pipeline_state::make_pixel_shader(device_t device, const render_device::shader_code &pso)
 {
-	auto hr = device->CreatePixelShader(pso.data(),
-	                                    pso.size(),
+	auto hr = device->CreatePixelShader(pso.data,
+	                                    pso.size,
 	                                    NULL,
 	                                    &pixel_shader);
 	assert(hr == S_OK);
@@ -543,26 +775,27 @@ void pipeline_state::make_pixel_shader(device_t device, const std::vector<byte>
 
 #pragma region "Mesh Buffer"
 
-mesh_buffer::mesh_buffer(device_t device, const std::vector<vertex> &vertex_array, const std::vector<uint32_t> &index_array)
+mesh_buffer::mesh_buffer(device_t device, const mesh_file &file, uint32_t lod)
 {
-	make_vertex_buffer(device, vertex_array);
-	make_index_buffer(device, index_array);
+	make_vertex_buffer(device, file.get_vertex_data(), file.get_vertex_stride(), file.get_vertex_count());
+
+	index_count = file.get_lod(lod).index_count;
+	create_index_buffer(device, file.get_index_data(lod), file.get_index_size());
 }
 
 mesh_buffer::~mesh_buffer()
 {}
 
-void mesh_buffer::activate(context_t context)
+void mesh_buffer::activate(state_tracker &context_state)
 {
-	context->IASetVertexBuffers(0,
-	                            1,
-	                            &(vertex_buffer.p),
-	                            &vertex_size,
-	                            &vertex_offset);
-
-	context->IASetIndexBuffer(index_buffer,
-	                          DXGI_FORMAT_R32_UINT,
-	                          index_offset);
+	context_state.set_vertex_buffer(0,
+	                                vertex_buffer,
+	                                vertex_size,
+	                                vertex_offset);
+
+	context_state.set_index_buffer(index_buffer,
+	                               index_format,
+	                               index_offset);
 }
 
 void mesh_buffer::draw(context_t context)
@@ -572,18 +805,29 @@ void mesh_buffer::draw(context_t context)
 	                     0);
 }
 
-void mesh_buffer::make_vertex_buffer(device_t device, const std::vector<vertex> &vertex_array)
+void mesh_buffer::draw_instanced(context_t context, uint32_t instance_count)
+{
+	context->DrawIndexedInstanced(index_count,
+	                              instance_count,
+	                              0,
+	                              0,
+	                              0);
+}
+
+void mesh_buffer::make_vertex_buffer(device_t device, const void *vertex_array, uint32_t vertex_stride, uint32_t vertex_count)
 {
-	vertex_size = sizeof(vertex_array.back());
+	PROFILE_SCOPE("mesh_buffer::make_vertex_buffer");
+
+	vertex_size = vertex_stride;
 
 	D3D11_BUFFER_DESC bd{};
 	bd.Usage = D3D11_USAGE_DEFAULT;
 	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	bd.CPUAccessFlags = NULL;
-	bd.ByteWidth = vertex_size * static_cast<uint32_t>(vertex_array.size());
+	bd.ByteWidth = vertex_size * vertex_count;
 
 	D3D11_SUBRESOURCE_DATA vertex_data{};
-	vertex_data.pSysMem = reinterpret_cast<const void *>(vertex_array.data());
+	vertex_data.pSysMem = vertex_array;
 
 	auto hr = device->CreateBuffer(&bd,
 	                               &vertex_data,
@@ -591,23 +835,443 @@ void mesh_buffer::make_vertex_buffer(device_t device, const std::vector<vertex>
 	assert(hr == S_OK);
 }
 
-void mesh_buffer::make_index_buffer(device_t device, const std::vector<uint32_t>& index_array)
+void mesh_buffer::make_index_buffer(device_t device, const index_codec::packed_indices &indices)
+{
+	index_count = indices.index_count;
+	create_index_buffer(device, indices.data.data(), indices.index_size);
+}
+
+void mesh_buffer::create_index_buffer(device_t device, const void *index_data, uint32_t index_size)
 {
-	index_count = static_cast<uint32_t>(index_array.size());
+	PROFILE_SCOPE("mesh_buffer::create_index_buffer");
+
+	index_format = get_index_format(index_size);
 
 	D3D11_BUFFER_DESC bd{};
 	bd.Usage = D3D11_USAGE_DEFAULT;
 	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	bd.CPUAccessFlags = NULL;
-	bd.ByteWidth = sizeof(uint32_t) * index_count;
+	bd.ByteWidth = index_size * index_count;
 
-	D3D11_SUBRESOURCE_DATA index_data{};
-	index_data.pSysMem = reinterpret_cast<const void *>(index_array.data());
+	D3D11_SUBRESOURCE_DATA subresource_data{};
+	subresource_data.pSysMem = index_data;
 
 	auto hr = device->CreateBuffer(&bd,
-								   &index_data,
+								   &subresource_data,
 								   &index_buffer);
 	assert(hr == S_OK);
 }
 
+#pragma endregion
+
+#pragma region "Instance Buffer"
+
+instance_buffer::instance_buffer(device_t device, const render_device::instance_stream_description &stream_description) :
+	instance_stride(stream_description.instance_stride),
+	max_instance_count(stream_description.max_instances)
+{
+	assert(instance_stride > 0 and instance_stride % 16 == 0);
+
+	make_buffer(device);
+}
+
+instance_buffer::~instance_buffer()
+{}
+
+void *instance_buffer::map(context_t context, uint32_t count)
+{
+	assert(count <= max_instance_count);
+
+	instance_count = count;
+
+	// Mapped memory is 16 byte aligned and write-combined,
+	// so callers store whole rows with aligned stores and never read back
+	D3D11_MAPPED_SUBRESOURCE mapped_buffer{};
+	auto hr = context->Map(buffer,
+	                       0,
+	                       D3D11_MAP_WRITE_DISCARD,
+	                       NULL,
+	                       &mapped_buffer);
+	assert(hr == S_OK);
+
+	return mapped_buffer.pData;
+}
+
+void instance_buffer::unmap(context_t context)
+{
+	context->Unmap(buffer, 0);
+}
+
+void instance_buffer::activate(state_tracker &context_state)
+{
+	context_state.set_vertex_buffer(input_slot,
+	                                buffer,
+	                                instance_stride,
+	                                0);
+}
+
+uint32_t instance_buffer::get_instance_count() const
+{
+	return instance_count;
+}
+
+void instance_buffer::make_buffer(device_t device)
+{
+	D3D11_BUFFER_DESC bd{};
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.ByteWidth = instance_stride * max_instance_count;
+
+	auto hr = device->CreateBuffer(&bd,
+	                               nullptr,
+	                               &buffer);
+	assert(hr == S_OK);
+}
+
+#pragma endregion
+
+#pragma region "Constant Buffer Ring"
+
+constant_buffer_ring::constant_buffer_ring(device_t device, context_t immediate_context, uint32_t size) :
+	ring(size, max_frames_in_flight)
+{
+	auto hr = immediate_context->QueryInterface<ID3D11DeviceContext1>(&context);
+	assert(hr == S_OK);
+
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+	hr = device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	if (hr != S_OK or not options.ConstantBufferOffsetting or not options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		throw std::runtime_error("Device cannot offset or map no overwrite dynamic constant buffers");
+	}
+
+	make_buffer(device, size);
+	make_queries(device);
+}
+
+constant_buffer_ring::~constant_buffer_ring()
+{}
+
+void constant_buffer_ring::begin_frame()
+{
+	// Retire every frame the GPU has finished with, without forcing a flush
+	while (completed_frame < frame_number)
+	{
+		auto &query = frame_queries[completed_frame % max_frames_in_flight];
+
+		// A failed query, as after device removal, fences nothing the GPU will still read
+		BOOL is_done = FALSE;
+		auto hr = context->GetData(query, &is_done, sizeof(is_done), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		if (hr == S_FALSE or (hr == S_OK and not is_done))
+		{
+			break;
+		}
+
+		completed_frame++;
+	}
+
+	ring.release_frames(completed_frame);
+}
+
+void constant_buffer_ring::end_frame()
+{
+	// Too many frames in flight, wait for the oldest one rather than lose track of it
+	while (ring.get_frames_in_flight() == max_frames_in_flight)
+	{
+		wait_for_oldest_frame();
+	}
+
+	frame_number++;
+	context->End(frame_queries[(frame_number - 1) % max_frames_in_flight]);
+
+	auto recorded = ring.end_frame(frame_number);
+	assert(recorded);
+}
+
+constant_buffer_ring::allocation constant_buffer_ring::allocate(const void *data, uint32_t size)
+{
+	auto aligned_size = (size + constant_alignment - 1) & ~(constant_alignment - 1);
+
+	auto map_type = is_first_map ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+
+	// Ring is full of in flight data. Discarding would also lose what this frame
+	// has already bound, so wait for earlier frames to retire instead.
+	auto offset = ring.allocate(aligned_size, constant_alignment);
+	while (offset == ring_allocator::invalid_offset and ring.get_frames_in_flight() > 0)
+	{
+		wait_for_oldest_frame();
+		offset = ring.allocate(aligned_size, constant_alignment);
+	}
+
+	// Nothing left to wait for, this frame alone outgrew the ring
+	assert(offset != ring_allocator::invalid_offset and "constant buffer ring is smaller than one frame's constants");
+	if (offset == ring_allocator::invalid_offset)
+	{
+		return { 0, 0 };
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped_buffer{};
+	auto hr = context->Map(buffer,
+	                       0,
+	                       map_type,
+	                       NULL,
+	                       &mapped_buffer);
+	assert(hr == S_OK);
+
+	std::memcpy(reinterpret_cast<byte *>(mapped_buffer.pData) + offset, data, size);
+
+	context->Unmap(buffer, 0);
+	is_first_map = false;
+
+	constexpr uint32_t constant_size = 16;
+	return { offset / constant_size, aligned_size / constant_size };
+}
+
+void constant_buffer_ring::bind_vertex_shader(uint32_t slot, const allocation &constants)
+{
+	if (constants.constant_count == 0)
+	{
+		return;
+	}
+
+	context->VSSetConstantBuffers1(slot,
+	                               1,
+	                               &buffer.p,
+	                               &constants.first_constant,
+	                               &constants.constant_count);
+}
+
+void constant_buffer_ring::bind_pixel_shader(uint32_t slot, const allocation &constants)
+{
+	if (constants.constant_count == 0)
+	{
+		return;
+	}
+
+	context->PSSetConstantBuffers1(slot,
+	                               1,
+	                               &buffer.p,
+	                               &constants.first_constant,
+	                               &constants.constant_count);
+}
+
+const ring_allocator::statistics &constant_buffer_ring::get_statistics() const
+{
+	return ring.get_statistics();
+}
+
+// Blocks until the GPU is done with the oldest frame in flight, then retires it
+void constant_buffer_ring::wait_for_oldest_frame()
+{
+	auto &query = frame_queries[completed_frame % max_frames_in_flight];
+
+	// Only S_FALSE means still pending, a failure retires the frame as begin_frame does
+	BOOL is_done = FALSE;
+	auto hr = context->GetData(query, &is_done, sizeof(is_done), NULL);
+	while (hr == S_FALSE)
+	{
+		hr = context->GetData(query, &is_done, sizeof(is_done), NULL);
+	}
+
+	completed_frame++;
+	ring.release_frames(completed_frame);
+}
+
+void constant_buffer_ring::make_buffer(device_t device, uint32_t size)
+{
+	D3D11_BUFFER_DESC bd{};
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.ByteWidth = size;
+
+	auto hr = device->CreateBuffer(&bd,
+	                               nullptr,
+	                               &buffer);
+	assert(hr == S_OK);
+}
+
+void constant_buffer_ring::make_queries(device_t device)
+{
+	D3D11_QUERY_DESC qd{};
+	qd.Query = D3D11_QUERY_EVENT;
+
+	for (auto &query : frame_queries)
+	{
+		auto hr = device->CreateQuery(&qd, &query);
+		assert(hr == S_OK);
+	}
+}
+
+#pragma endregion
+
+#pragma region "Geometry Pool"
+
+geometry_pool::geometry_pool(device_t device, const description &pool_description) :
+	vertex_stride(pool_description.vertex_stride),
+	index_format(pool_description.index_format),
+	index_size((pool_description.index_format == DXGI_FORMAT_R16_UINT) ? sizeof(uint16_t) : sizeof(uint32_t)),
+	vertex_allocator(pool_description.max_vertices),
+	index_allocator(pool_description.max_indices)
+{
+	assert(index_format == DXGI_FORMAT_R16_UINT or index_format == DXGI_FORMAT_R32_UINT);
+
+	vertex_buffer = make_buffer(device, D3D11_BIND_VERTEX_BUFFER, pool_description.max_vertices * vertex_stride);
+	index_buffer = make_buffer(device, D3D11_BIND_INDEX_BUFFER, pool_description.max_indices * index_size);
+}
+
+geometry_pool::~geometry_pool()
+{}
+
+geometry_pool::mesh geometry_pool::add_mesh(context_t context, const void *vertex_data, uint32_t vertex_count, const void *index_data, uint32_t index_count)
+{
+	auto vertices = vertex_allocator.allocate(vertex_count);
+	if (vertices.handle == offset_allocator::invalid_handle)
+	{
+		return invalid_mesh;
+	}
+
+	auto indices = index_allocator.allocate(index_count);
+	if (indices.handle == offset_allocator::invalid_handle)
+	{
+		vertex_allocator.free(vertices.handle);
+		return invalid_mesh;
+	}
+
+	upload(context, vertex_buffer, vertices.offset * vertex_stride, vertex_data, vertex_count * vertex_stride);
+	upload(context, index_buffer, indices.offset * index_size, index_data, index_count * index_size);
+
+	return { vertices.handle, indices.handle };
+}
+
+void geometry_pool::remove_mesh(const mesh &pooled_mesh)
+{
+	vertex_allocator.free(pooled_mesh.vertex_handle);
+	index_allocator.free(pooled_mesh.index_handle);
+}
+
+void geometry_pool::defragment(device_t device, context_t context)
+{
+	vertex_buffer = compact(device, context, vertex_buffer, D3D11_BIND_VERTEX_BUFFER, vertex_allocator, vertex_stride);
+	index_buffer = compact(device, context, index_buffer, D3D11_BIND_INDEX_BUFFER, index_allocator, index_size);
+}
+
+void geometry_pool::activate(state_tracker &context_state)
+{
+	context_state.set_vertex_buffer(0,
+	                                vertex_buffer,
+	                                vertex_stride,
+	                                0);
+
+	context_state.set_index_buffer(index_buffer,
+	                               index_format,
+	                               0);
+}
+
+void geometry_pool::draw(context_t context, const mesh &pooled_mesh)
+{
+	context->DrawIndexed(index_allocator.get_size(pooled_mesh.index_handle),
+	                     index_allocator.get_offset(pooled_mesh.index_handle),
+	                     static_cast<int32_t>(vertex_allocator.get_offset(pooled_mesh.vertex_handle)));
+}
+
+void geometry_pool::draw_instanced(context_t context, const mesh &pooled_mesh, uint32_t instance_count)
+{
+	context->DrawIndexedInstanced(index_allocator.get_size(pooled_mesh.index_handle),
+	                              instance_count,
+	                              index_allocator.get_offset(pooled_mesh.index_handle),
+	                              static_cast<int32_t>(vertex_allocator.get_offset(pooled_mesh.vertex_handle)),
+	                              0);
+}
+
+uint32_t geometry_pool::get_vertex_stride() const
+{
+	return vertex_stride;
+}
+
+DXGI_FORMAT geometry_pool::get_index_format() const
+{
+	return index_format;
+}
+
+geometry_pool::statistics geometry_pool::get_statistics() const
+{
+	return {
+		vertex_allocator.get_statistics(),
+		index_allocator.get_statistics()
+	};
+}
+
+buffer_t geometry_pool::make_buffer(device_t device, uint32_t bind_flags, uint32_t byte_width)
+{
+	D3D11_BUFFER_DESC bd{};
+	bd.Usage = D3D11_USAGE_DEFAULT;
+	bd.BindFlags = bind_flags;
+	bd.CPUAccessFlags = NULL;
+	bd.ByteWidth = byte_width;
+
+	buffer_t buffer{};
+	auto hr = device->CreateBuffer(&bd,
+	                               nullptr,
+	                               &buffer);
+	assert(hr == S_OK);
+
+	return buffer;
+}
+
+void geometry_pool::upload(context_t context, buffer_t buffer, uint32_t byte_offset, const void *data, uint32_t byte_size)
+{
+	D3D11_BOX region{ byte_offset, 0, 0, byte_offset + byte_size, 1, 1 };
+
+	context->UpdateSubresource(buffer,
+	                           0,
+	                           &region,
+	                           data,
+	                           0,
+	                           0);
+}
+
+// Moves can overlap within a buffer, so live ranges are copied into a fresh
+// buffer at their new offsets and the old buffer is released.
+buffer_t geometry_pool::compact(device_t device, context_t context, buffer_t buffer, uint32_t bind_flags, offset_allocator &allocator, uint32_t element_size)
+{
+	auto moves = allocator.defragment();
+	if (moves.empty())
+	{
+		return buffer;
+	}
+
+	auto capacity = allocator.get_statistics().capacity;
+	auto compacted_buffer = make_buffer(device, bind_flags, capacity * element_size);
+
+	auto copy_range = [&](uint32_t old_offset, uint32_t new_offset, uint32_t size)
+	{
+		D3D11_BOX region{ old_offset * element_size, 0, 0, (old_offset + size) * element_size, 1, 1 };
+		context->CopySubresourceRegion(compacted_buffer,
+		                               0,
+		                               new_offset * element_size,
+		                               0,
+		                               0,
+		                               buffer,
+		                               0,
+		                               &region);
+	};
+
+	// Everything in front of the first move is already packed,
+	// every live range after it has moved
+	auto unmoved_size = moves.front().new_offset;
+	if (unmoved_size > 0)
+	{
+		copy_range(0, 0, unmoved_size);
+	}
+
+	for (auto &block_move : moves)
+	{
+		copy_range(block_move.old_offset, block_move.new_offset, block_move.size);
+	}
+
+	return compacted_buffer;
+}
+
 #pragma endregion
\ No newline at end of file
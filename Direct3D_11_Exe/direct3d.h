@@ -1,21 +1,31 @@
 #pragma once
 
+#include "shader_store.h"
+#include "render_device.h"
+#include "index_codec.h"
+#include "ring_allocator.h"
+#include "offset_allocator.h"
+#include "state_cache.h"
+#include "state_tracker.h"
+
 #include <Windows.h>
 #include <d3d11_1.h>
 #include <dxgi1_2.h>
 #include <atlbase.h>
+#include <DirectXMath.h>
 #include <array>
 #include <vector>
 
 namespace direct3d_11_eg
 {
-	struct vertex;
+	class mesh_file;
 
 	namespace direct3d_types
 	{
 		using device_t = CComPtr<ID3D11Device>;
 		using swap_chain_t = CComPtr<IDXGISwapChain>;
 		using context_t = CComPtr<ID3D11DeviceContext>;
+		using context1_t = CComPtr<ID3D11DeviceContext1>;
 
 		using render_target_view_t = CComPtr<ID3D11RenderTargetView>;
 		using depth_stencil_view_t = CComPtr<ID3D11DepthStencilView>;
@@ -31,17 +41,40 @@ namespace direct3d_11_eg
 		using input_layout_t = CComPtr<ID3D11InputLayout>;
 
 		using buffer_t = CComPtr<ID3D11Buffer>;
+		using query_t = CComPtr<ID3D11Query>;
 	};
 
 	class direct3d
 	{
+	public:
+		enum class present_mode_e
+		{
+			blit,                 // legacy single buffer chain, keeps MSAA back buffers
+			flip_discard,         // flip model, back buffers are never multisampled
+			flip_discard_waitable // flip_discard, frames wait on the swap chain's latency object
+		};
+
+		struct presentation
+		{
+			present_mode_e mode;
+			uint32_t buffer_count;      // 2 or 3 for the flip modes
+			uint32_t max_frame_latency; // queued frames before wait_for_frame blocks, waitable mode only
+			bool vsync;
+		};
+
+		static constexpr presentation default_presentation{ present_mode_e::blit, 1, 1, false };
+
 	public:
 		direct3d() = delete;
-		direct3d(HWND hWnd);
+		direct3d(HWND hWnd, const presentation &present_settings = default_presentation);
 		~direct3d();
 
 		void resize_swap_chain();
-		void present(bool vSync = false);
+		void present();
+
+		// Blocks until the swap chain can accept another frame, call before
+		// sampling input for that frame. Returns at once outside waitable mode.
+		void wait_for_frame();
 
 		direct3d_types::context_t get_context() const;
 		direct3d_types::swap_chain_t get_swap_chain() const;
@@ -57,6 +90,9 @@ namespace direct3d_11_eg
 		direct3d_types::context_t context;
 
 		HWND window_handle;
+		presentation settings{};
+		uint32_t swap_chain_flags = 0;
+		HANDLE frame_latency_waitable = nullptr;
 	};
 
 	class render_target
@@ -71,7 +107,7 @@ namespace direct3d_11_eg
 
 	private:
 		void make_target_view(direct3d_types::device_t device, direct3d_types::swap_chain_t swap_chain);
-		void make_stencil_view(direct3d_types::device_t device, const std::array<uint16_t, 2> &buffer_size);
+		void make_stencil_view(direct3d_types::device_t device, const std::array<uint16_t, 2> &buffer_size, const DXGI_SAMPLE_DESC &sample_desc);
 
 	private:
 		direct3d_types::render_target_view_t render_view;
@@ -80,47 +116,79 @@ namespace direct3d_11_eg
 		D3D11_VIEWPORT viewport;
 	};
 
-	class pipeline_state
+	// The immediate context calls a state_tracker lets through
+	class d3d11_context
 	{
 	public:
-		enum class blend_e
-		{
-			Opaque,
-			Alpha,
-			Additive,
-			NonPremultipled
-		};
+		using blend_state_t = direct3d_types::blend_state_t;
+		using depth_stencil_state_t = direct3d_types::depth_stencil_state_t;
+		using rasterizer_state_t = direct3d_types::rasterizer_state_t;
+		using sampler_state_t = direct3d_types::sampler_state_t;
+		using input_layout_t = direct3d_types::input_layout_t;
+		using vertex_shader_t = direct3d_types::vertex_shader_t;
+		using pixel_shader_t = direct3d_types::pixel_shader_t;
+		using buffer_t = direct3d_types::buffer_t;
+		using topology_t = D3D11_PRIMITIVE_TOPOLOGY;
+		using format_t = DXGI_FORMAT;
 
-		enum class depth_stencil_e
-		{
-			None,
-			ReadWrite,
-			ReadOnly
-		};
+	public:
+		d3d11_context() = delete;
+		explicit d3d11_context(direct3d_types::context_t context);
+		~d3d11_context();
 
-		enum class rasterizer_e
-		{
-			CullNone,
-			CullClockwise,
-			CullAntiClockwise,
-			Wireframe
-		};
+		void set_blend_state(const blend_state_t &blend_state);
+		void set_depth_stencil_state(const depth_stencil_state_t &depth_stencil_state);
+		void set_rasterizer_state(const rasterizer_state_t &rasterizer_state);
+		void set_sampler_state(const sampler_state_t &sampler_state);
 
-		enum class sampler_e
-		{
-			PointWrap,
-			PointClamp,
-			LinearWrap,
-			LinearClamp,
-			AnisotropicWrap,
-			AnisotropicClamp
-		};
+		void set_primitive_topology(topology_t primitive_topology);
+		void set_input_layout(const input_layout_t &input_layout);
+		void set_vertex_shader(const vertex_shader_t &vertex_shader);
+		void set_pixel_shader(const pixel_shader_t &pixel_shader);
 
-		enum class input_layout_e
-		{
-			position,
-			position_texcoord
-		};
+		void set_vertex_buffer(uint32_t slot, const buffer_t &vertex_buffer, uint32_t stride, uint32_t offset);
+		void set_index_buffer(const buffer_t &index_buffer, format_t format, uint32_t offset);
+
+	private:
+		direct3d_types::context_t context;
+	};
+
+	using state_tracker = basic_state_tracker<d3d11_context>;
+
+	// Creates the Direct3D 11 state objects a state_cache shares
+	class d3d11_state_factory
+	{
+	public:
+		using blend_state_t = direct3d_types::blend_state_t;
+		using depth_stencil_state_t = direct3d_types::depth_stencil_state_t;
+		using rasterizer_state_t = direct3d_types::rasterizer_state_t;
+		using sampler_state_t = direct3d_types::sampler_state_t;
+
+	public:
+		d3d11_state_factory() = delete;
+		explicit d3d11_state_factory(direct3d_types::device_t device);
+		~d3d11_state_factory();
+
+		blend_state_t make_blend_state(render_device::blend_e blend) const;
+		depth_stencil_state_t make_depth_stencil_state(render_device::depth_stencil_e depth_stencil) const;
+		rasterizer_state_t make_rasterizer_state(render_device::rasterizer_e rasterizer) const;
+		sampler_state_t make_sampler_state(render_device::sampler_e sampler) const;
+
+	private:
+		direct3d_types::device_t device;
+	};
+
+	using state_cache = basic_state_cache<d3d11_state_factory>;
+
+	class pipeline_state
+	{
+	public:
+		// Shared with render_device, backends pass them straight through
+		using blend_e = render_device::blend_e;
+		using depth_stencil_e = render_device::depth_stencil_e;
+		using rasterizer_e = render_device::rasterizer_e;
+		using sampler_e = render_device::sampler_e;
+		using input_layout_e = render_device::input_layout_e;
 
 		struct description
 		{
@@ -131,26 +199,23 @@ namespace direct3d_11_eg
 
 			input_layout_e input_layout;
 			D3D11_PRIMITIVE_TOPOLOGY primitive_topology;
-			const std::vector<byte> &vertex_shader_file;
-			const std::vector<byte> &pixel_shader_file;
+			shader_blob_t vertex_shader_file;
+			shader_blob_t pixel_shader_file;
 		};
 
 	public:
 		pipeline_state() = delete;
-		pipeline_state(direct3d_types::device_t device, const description &state_description);
+		pipeline_state(direct3d_types::device_t device, state_cache &state_objects, const description &state_description);
+		pipeline_state(direct3d_types::device_t device, state_cache &state_objects, const render_device::pipeline_description &state_description);
 		~pipeline_state();
 
-		void activate(direct3d_types::context_t context);
+		void activate(state_tracker &context_state);
 
 	private:
-		void make_blend_state(direct3d_types::device_t device, blend_e blend);
-		void make_depth_stencil_state(direct3d_types::device_t device, depth_stencil_e depth_stencil);
-		void make_rasterizer_state(direct3d_types::device_t device, rasterizer_e rasterizer);
-		void make_sampler_state(direct3d_types::device_t device, sampler_e sampler);
-
-		void make_input_layout(direct3d_types::device_t device, input_layout_e input_layout, const std::vector<byte> &vso);
-		void make_vertex_shader(direct3d_types::device_t device, const std::vector<byte> &vso);
-		void make_pixel_shader(direct3d_types::device_t device, const std::vector<byte> &pso);
+		void make_states(state_cache &state_objects, blend_e blend, depth_stencil_e depth_stencil, rasterizer_e rasterizer, sampler_e sampler);
+		void make_input_layout(direct3d_types::device_t device, input_layout_e input_layout, const render_device::shader_code &vso);
+		void make_vertex_shader(direct3d_types::device_t device, const render_device::shader_code &vso);
+		void make_pixel_shader(direct3d_types::device_t device, const render_device::shader_code &pso);
 
 	private:
 		direct3d_types::blend_state_t blend_state;
@@ -168,23 +233,188 @@ namespace direct3d_11_eg
 	{
 	public:
 		mesh_buffer() = delete;
-		mesh_buffer(direct3d_types::device_t device, const std::vector<vertex> &vertex_array, const std::vector<uint32_t> &index_array);
+		// Any vertex type with a matching vertex_layout, stride comes from sizeof
+		template <typename vertex_t>
+		mesh_buffer(direct3d_types::device_t device, const std::vector<vertex_t> &vertex_array, const std::vector<uint32_t> &index_array)
+		{
+			static_assert(sizeof(vertex_t) == vertex_t::layout::vertex_stride, "vertex type does not match its layout");
+			make_vertex_buffer(device, vertex_array.data(), sizeof(vertex_t), static_cast<uint32_t>(vertex_array.size()));
+			make_index_buffer(device, index_codec::pack_indices(index_array.data(), index_array.size()));
+		}
+		// Indices in index_codec encoding
+		template <typename vertex_t>
+		mesh_buffer(direct3d_types::device_t device, const std::vector<vertex_t> &vertex_array, const std::vector<uint8_t> &encoded_indices)
+		{
+			static_assert(sizeof(vertex_t) == vertex_t::layout::vertex_stride, "vertex type does not match its layout");
+			make_vertex_buffer(device, vertex_array.data(), sizeof(vertex_t), static_cast<uint32_t>(vertex_array.size()));
+			make_index_buffer(device, index_codec::pack_indices(encoded_indices.data(), encoded_indices.size()));
+		}
+		// Buffers are created straight from the file mapping, no copy is made
+		mesh_buffer(direct3d_types::device_t device, const mesh_file &file, uint32_t lod = 0);
 		~mesh_buffer();
 
-		void activate(direct3d_types::context_t context);
+		void activate(state_tracker &context_state);
 		void draw(direct3d_types::context_t context);
+		void draw_instanced(direct3d_types::context_t context, uint32_t instance_count);
 
 	private:
-		void make_vertex_buffer(direct3d_types::device_t device, const std::vector<vertex> &vertex_array);
-		void make_index_buffer(direct3d_types::device_t device, const std::vector<uint32_t> &index_array);
+		void make_vertex_buffer(direct3d_types::device_t device, const void *vertex_array, uint32_t vertex_stride, uint32_t vertex_count);
+		void make_index_buffer(direct3d_types::device_t device, const index_codec::packed_indices &indices);
+		void create_index_buffer(direct3d_types::device_t device, const void *index_data, uint32_t index_size);
 
 	private:
 		direct3d_types::buffer_t vertex_buffer;
 		direct3d_types::buffer_t index_buffer;
 
+		DXGI_FORMAT index_format = DXGI_FORMAT_R32_UINT;
 		uint32_t index_count = 0;
 		uint32_t index_offset = 0;
 		uint32_t vertex_size = 0;
 		uint32_t vertex_offset = 0;
 	};
+
+	// Per-instance data stream, bound as the second vertex buffer
+	// alongside a mesh_buffer for input_layout_e::position_instanced.
+	class instance_buffer
+	{
+	public:
+		static constexpr uint32_t input_slot = 1;
+
+	public:
+		instance_buffer() = delete;
+		instance_buffer(direct3d_types::device_t device, const render_device::instance_stream_description &stream_description);
+		~instance_buffer();
+
+		// Maps with WRITE_DISCARD, instances are written straight into the buffer
+		void *map(direct3d_types::context_t context, uint32_t count);
+		void unmap(direct3d_types::context_t context);
+		void activate(state_tracker &context_state);
+
+		uint32_t get_instance_count() const;
+
+	private:
+		void make_buffer(direct3d_types::device_t device);
+
+	private:
+		direct3d_types::buffer_t buffer;
+
+		uint32_t instance_stride = 0;
+		uint32_t max_instance_count = 0;
+		uint32_t instance_count = 0;
+	};
+
+	// One large dynamic constant buffer, suballocated per frame and per draw.
+	// Writes use MAP_WRITE_NO_OVERWRITE, regions are fenced with event queries so
+	// nothing the GPU may still read is overwritten. If the GPU falls too far
+	// behind the CPU waits for the oldest frame, so size it for the worst frame's constants.
+	// Needs Direct3D 11.1 constant buffer offsets, construction throws without them.
+	class constant_buffer_ring
+	{
+	public:
+		// Constant buffer offsets are in 16 byte constants, and must be multiples of 16 constants
+		static constexpr uint32_t constant_alignment = 256;
+		static constexpr uint32_t max_frames_in_flight = 3;
+
+		struct allocation
+		{
+			uint32_t first_constant;
+			uint32_t constant_count;
+		};
+
+	public:
+		constant_buffer_ring() = delete;
+		constant_buffer_ring(direct3d_types::device_t device, direct3d_types::context_t context, uint32_t size);
+		~constant_buffer_ring();
+
+		void begin_frame();
+		void end_frame();
+
+		allocation allocate(const void *data, uint32_t size);
+		void bind_vertex_shader(uint32_t slot, const allocation &constants);
+		void bind_pixel_shader(uint32_t slot, const allocation &constants);
+
+		const ring_allocator::statistics &get_statistics() const;
+
+	private:
+		void wait_for_oldest_frame();
+		void make_buffer(direct3d_types::device_t device, uint32_t size);
+		void make_queries(direct3d_types::device_t device);
+
+	private:
+		direct3d_types::context1_t context;
+		direct3d_types::buffer_t buffer;
+		std::array<direct3d_types::query_t, max_frames_in_flight> frame_queries;
+
+		ring_allocator ring;
+		bool is_first_map = true;
+		uint64_t frame_number = 0;
+		uint64_t completed_frame = 0;
+	};
+
+	// Many meshes suballocated from one shared vertex buffer and one shared index buffer.
+	// Buffers are bound once, switching between pooled meshes is just a different
+	// base vertex and start index on the draw call. Every mesh in a pool shares its
+	// vertex stride and index format, indices are relative to the mesh's first vertex.
+	class geometry_pool
+	{
+	public:
+		struct description
+		{
+			uint32_t vertex_stride;
+			DXGI_FORMAT index_format; // DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+			uint32_t max_vertices;
+			uint32_t max_indices;
+		};
+
+		struct mesh
+		{
+			uint32_t vertex_handle;
+			uint32_t index_handle;
+		};
+
+		struct statistics
+		{
+			offset_allocator::statistics vertices;
+			offset_allocator::statistics indices;
+		};
+
+		static constexpr mesh invalid_mesh{ offset_allocator::invalid_handle, offset_allocator::invalid_handle };
+
+	public:
+		geometry_pool() = delete;
+		geometry_pool(direct3d_types::device_t device, const description &pool_description);
+		~geometry_pool();
+
+		// Data is vertex_count strides and index_count indices of the pool's format.
+		// Returns invalid_mesh if either buffer is out of space.
+		mesh add_mesh(direct3d_types::context_t context, const void *vertex_data, uint32_t vertex_count, const void *index_data, uint32_t index_count);
+		void remove_mesh(const mesh &pooled_mesh);
+
+		// Compacts both buffers, existing mesh handles remain valid
+		void defragment(direct3d_types::device_t device, direct3d_types::context_t context);
+
+		void activate(state_tracker &context_state);
+		void draw(direct3d_types::context_t context, const mesh &pooled_mesh);
+		void draw_instanced(direct3d_types::context_t context, const mesh &pooled_mesh, uint32_t instance_count);
+
+		uint32_t get_vertex_stride() const;
+		DXGI_FORMAT get_index_format() const;
+		statistics get_statistics() const;
+
+	private:
+		direct3d_types::buffer_t make_buffer(direct3d_types::device_t device, uint32_t bind_flags, uint32_t byte_width);
+		void upload(direct3d_types::context_t context, direct3d_types::buffer_t buffer, uint32_t byte_offset, const void *data, uint32_t byte_size);
+		direct3d_types::buffer_t compact(direct3d_types::device_t device, direct3d_types::context_t context, direct3d_types::buffer_t buffer, uint32_t bind_flags, offset_allocator &allocator, uint32_t element_size);
+
+	private:
+		direct3d_types::buffer_t vertex_buffer;
+		direct3d_types::buffer_t index_buffer;
+
+		uint32_t vertex_stride = 0;
+		DXGI_FORMAT index_format = DXGI_FORMAT_R32_UINT;
+		uint32_t index_size = 0;
+
+		offset_allocator vertex_allocator;
+		offset_allocator index_allocator;
+	};
 };
\ No newline at end of file
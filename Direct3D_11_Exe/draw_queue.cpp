@@ -0,0 +1,280 @@
+#include "draw_queue.h"
+
+#include <array>
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Sort key layout, most significant bits first
+	// | layer : 8 | pipeline : 16 | mesh : 16 | depth : 24 |
+	constexpr uint32_t depth_bits = 24;
+	constexpr uint32_t mesh_shift = depth_bits;
+	constexpr uint32_t pipeline_shift = mesh_shift + 16;
+	constexpr uint32_t layer_shift = pipeline_shift + 16;
+
+	constexpr uint64_t depth_mask = (1ULL << depth_bits) - 1;
+
+	constexpr uint32_t radix_bits = 8;
+	constexpr uint32_t radix_size = 1 << radix_bits;
+	constexpr uint32_t radix_passes = 64 / radix_bits;
+
+	uint64_t make_sort_key(draw_queue::pipeline_id pipeline, draw_queue::mesh_id mesh, float depth, uint8_t layer)
+	{
+		// NaN fails every comparison and would reach the cast unclamped, it sorts to the front
+		auto depth_key = not (depth > 0.0f)
+		               ? 0
+		               : static_cast<uint64_t>(std::min(depth, 1.0f) * depth_mask);
+
+		return (static_cast<uint64_t>(layer) << layer_shift)
+		     | (static_cast<uint64_t>(pipeline) << pipeline_shift)
+		     | (static_cast<uint64_t>(mesh) << mesh_shift)
+		     | depth_key;
+	}
+
+	draw_queue::pipeline_id get_pipeline_id(uint64_t sort_key)
+	{
+		return static_cast<draw_queue::pipeline_id>(sort_key >> pipeline_shift);
+	}
+
+	draw_queue::mesh_id get_mesh_id(uint64_t sort_key)
+	{
+		return static_cast<draw_queue::mesh_id>(sort_key >> mesh_shift);
+	}
+}
+
+draw_queue::draw_queue(uint32_t max_draw_items) :
+	sort_keys(max_draw_items),
+	scratch_keys(max_draw_items),
+	item_objects(max_draw_items),
+	scratch_objects(max_draw_items)
+{}
+
+draw_queue::~draw_queue()
+{}
+
+draw_queue::pipeline_id draw_queue::add_pipeline(render_device::pipeline_handle pipeline)
+{
+	assert(pipelines.size() < std::numeric_limits<pipeline_id>::max());
+
+	pipelines.push_back(pipeline);
+	return static_cast<pipeline_id>(pipelines.size() - 1);
+}
+
+draw_queue::mesh_id draw_queue::add_mesh(render_device::mesh_handle mesh)
+{
+	assert(meshes.size() < std::numeric_limits<mesh_id>::max());
+
+	meshes.push_back(mesh);
+	return static_cast<mesh_id>(meshes.size() - 1);
+}
+
+void draw_queue::submit(pipeline_id pipeline, mesh_id mesh, float depth, uint8_t layer, uint32_t object)
+{
+	assert(pipeline < pipelines.size());
+	assert(mesh < meshes.size());
+
+	auto sort_key = make_sort_key(pipeline, mesh, depth, layer);
+	append(&sort_key, &object, 1);
+}
+
+void draw_queue::set_object_constants(uint32_t slot, const void *data, uint32_t stride, uint32_t size)
+{
+	assert(data == nullptr or size <= stride);
+
+	object_slot = slot;
+	object_data = static_cast<const uint8_t *>(data);
+	object_stride = stride;
+	object_size = size;
+}
+
+void draw_queue::execute(render_device &device)
+{
+	using clock = std::chrono::high_resolution_clock;
+	auto start_time = clock::now();
+
+	// Submitters have been joined by now, whatever synchronised with them made their keys visible
+	auto draw_count = std::min(item_count.load(std::memory_order_relaxed), static_cast<uint32_t>(sort_keys.size()));
+	sort(draw_count);
+
+	auto sorted_time = clock::now();
+
+	stats.draw_count = draw_count;
+	stats.pipeline_changes = 0;
+	stats.mesh_changes = 0;
+
+	auto current_pipeline = std::numeric_limits<uint32_t>::max(),
+	     current_mesh = std::numeric_limits<uint32_t>::max();
+
+	for (uint32_t i = 0; i < draw_count; ++i)
+	{
+		auto sort_key = sort_keys[i];
+		auto pipeline = get_pipeline_id(sort_key);
+		auto mesh = get_mesh_id(sort_key);
+
+		if (pipeline != current_pipeline)
+		{
+			device.set_pipeline(pipelines[pipeline]);
+			current_pipeline = pipeline;
+			stats.pipeline_changes++;
+		}
+
+		if (mesh != current_mesh)
+		{
+			device.set_mesh(meshes[mesh]);
+			current_mesh = mesh;
+			stats.mesh_changes++;
+		}
+
+		if (object_data)
+		{
+			auto object = item_objects[i];
+			device.set_constants(render_device::shader_stage_e::vertex, object_slot, object_data + size_t(object) * object_stride, object_size);
+		}
+
+		device.draw();
+	}
+
+	item_count.store(0, std::memory_order_relaxed);
+
+	stats.sort_time = sorted_time - start_time;
+	stats.submit_time = clock::now() - sorted_time;
+}
+
+const draw_queue::statistics &draw_queue::get_statistics() const
+{
+	return stats;
+}
+
+void draw_queue::append(const uint64_t *keys, const uint32_t *objects, uint32_t count)
+{
+	auto first = item_count.fetch_add(count, std::memory_order_relaxed);
+	if (first + count > sort_keys.size())
+	{
+		assert(false && "draw queue is full");
+		if (first >= sort_keys.size())
+		{
+			return;
+		}
+		count = static_cast<uint32_t>(sort_keys.size()) - first;
+	}
+
+	std::copy(keys, keys + count, sort_keys.data() + first);
+	std::copy(objects, objects + count, item_objects.data() + first);
+}
+
+draw_queue::batch::batch(draw_queue &queue) :
+	queue(queue)
+{}
+
+draw_queue::batch::~batch()
+{
+	flush();
+}
+
+void draw_queue::batch::submit(pipeline_id pipeline, mesh_id mesh, float depth, uint8_t layer, uint32_t object)
+{
+	assert(pipeline < queue.pipelines.size());
+	assert(mesh < queue.meshes.size());
+
+	if (key_count == capacity)
+	{
+		flush();
+	}
+	keys[key_count] = make_sort_key(pipeline, mesh, depth, layer);
+	objects[key_count++] = object;
+}
+
+void draw_queue::batch::flush()
+{
+	if (key_count > 0)
+	{
+		queue.append(keys.data(), objects.data(), key_count);
+		key_count = 0;
+	}
+}
+
+// LSD radix sort, 8 bits per pass.
+// Histograms for every pass are built in one sweep over the keys, and
+// passes where all keys share the same digit are skipped entirely,
+// which is the common case for the layer and pipeline bytes.
+void draw_queue::sort(uint32_t count)
+{
+	if (count < 2)
+	{
+		return;
+	}
+
+	std::array<std::array<uint32_t, radix_size>, radix_passes> histograms{};
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		auto sort_key = sort_keys[i];
+		for (uint32_t pass = 0; pass < radix_passes; ++pass)
+		{
+			histograms[pass][(sort_key >> (pass * radix_bits)) & (radix_size - 1)]++;
+		}
+	}
+
+	auto *source = sort_keys.data(),
+	     *destination = scratch_keys.data();
+	auto *source_objects = item_objects.data(),
+	     *destination_objects = scratch_objects.data();
+
+	// Objects only matter when their constants are set, otherwise they are left behind
+	auto move_objects = object_data != nullptr;
+
+	for (uint32_t pass = 0; pass < radix_passes; ++pass)
+	{
+		auto &histogram = histograms[pass];
+		auto shift = pass * radix_bits;
+
+		auto digit = (source[0] >> shift) & (radix_size - 1);
+		if (histogram[digit] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (auto &bucket : histogram)
+		{
+			auto bucket_size = bucket;
+			bucket = offset;
+			offset += bucket_size;
+		}
+
+		if (move_objects)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				auto sort_key = source[i];
+				auto position = histogram[(sort_key >> shift) & (radix_size - 1)]++;
+				destination[position] = sort_key;
+				destination_objects[position] = source_objects[i];
+			}
+			std::swap(source_objects, destination_objects);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				auto sort_key = source[i];
+				destination[histogram[(sort_key >> shift) & (radix_size - 1)]++] = sort_key;
+			}
+		}
+
+		std::swap(source, destination);
+	}
+
+	if (source != sort_keys.data())
+	{
+		sort_keys.swap(scratch_keys);
+	}
+	if (source_objects != item_objects.data())
+	{
+		item_objects.swap(scratch_objects);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "render_device.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Collects draw items for a frame, orders them by a packed 64-bit sort key
+	// and submits them with the fewest pipeline and mesh changes.
+	// All storage is sized up front, submitting and executing never allocates.
+	// Any number of threads may submit at once, execute runs after they are done.
+	// Threads submitting many items go through a batch, one atomic add per batch.
+	// Items may name an object, whose constants are set before its draw.
+	class draw_queue
+	{
+	public:
+		using pipeline_id = uint16_t;
+		using mesh_id = uint16_t;
+
+		struct statistics
+		{
+			uint32_t draw_count;
+			uint32_t pipeline_changes;
+			uint32_t mesh_changes;
+			std::chrono::duration<double, std::micro> sort_time;
+			std::chrono::duration<double, std::micro> submit_time;
+		};
+
+		// Gathers sort keys locally and claims queue slots for all of them at once,
+		// flushed when full and on destruction
+		class batch
+		{
+		public:
+			batch() = delete;
+			explicit batch(draw_queue &queue);
+			~batch();
+
+			batch(const batch &) = delete;
+			batch &operator=(const batch &) = delete;
+
+			void submit(pipeline_id pipeline, mesh_id mesh, float depth, uint8_t layer = 0, uint32_t object = 0);
+			void flush();
+
+		private:
+			static constexpr uint32_t capacity = 256;
+
+			draw_queue &queue;
+			std::array<uint64_t, capacity> keys;
+			std::array<uint32_t, capacity> objects;
+			uint32_t key_count = 0;
+		};
+
+	public:
+		draw_queue() = delete;
+		draw_queue(uint32_t max_draw_items);
+		~draw_queue();
+
+		pipeline_id add_pipeline(render_device::pipeline_handle pipeline);
+		mesh_id add_mesh(render_device::mesh_handle mesh);
+
+		// depth is expected in [0, 1], items in a layer are drawn front to back
+		void submit(pipeline_id pipeline, mesh_id mesh, float depth, uint8_t layer = 0, uint32_t object = 0);
+
+		// Vertex shader constants per object, an item's object indexes data in steps of stride.
+		// data must stay valid until execute, null turns them off.
+		void set_object_constants(uint32_t slot, const void *data, uint32_t stride, uint32_t size);
+
+		void execute(render_device &device);
+
+		const statistics &get_statistics() const;
+
+	private:
+		void append(const uint64_t *keys, const uint32_t *objects, uint32_t count);
+		void sort(uint32_t count);
+
+	private:
+		std::vector<render_device::pipeline_handle> pipelines;
+		std::vector<render_device::mesh_handle> meshes;
+
+		std::vector<uint64_t> sort_keys;
+		std::vector<uint64_t> scratch_keys;
+		std::vector<uint32_t> item_objects;
+		std::vector<uint32_t> scratch_objects;
+		std::atomic<uint32_t> item_count{ 0 }; // may run past the capacity, execute clamps it
+
+		uint32_t object_slot = 0;
+		const uint8_t *object_data = nullptr;
+		uint32_t object_stride = 0;
+		uint32_t object_size = 0;
+
+		statistics stats{};
+	};
+}
@@ -0,0 +1,146 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// High resolution timer wakeups land within about half a millisecond
+	constexpr auto spin_margin = std::chrono::microseconds(500);
+
+#ifdef _WIN32
+	class waitable_timer
+	{
+	public:
+		waitable_timer()
+		{
+			// High resolution timers need Windows 10 1803, fall back to a regular one
+			handle = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+			if (handle == nullptr)
+			{
+				handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+			}
+		}
+
+		~waitable_timer()
+		{
+			if (handle)
+			{
+				CloseHandle(handle);
+			}
+		}
+
+		HANDLE handle = nullptr;
+	};
+#endif
+
+	using milliseconds = std::chrono::duration<double, std::milli>;
+}
+
+frame_pacer::frame_pacer(clock::duration target_interval, time_source now, wait_function wait) :
+	target_interval(target_interval),
+	now(std::move(now)),
+	wait(std::move(wait))
+{}
+
+frame_pacer::~frame_pacer()
+{}
+
+void frame_pacer::set_target_interval(clock::duration interval)
+{
+	target_interval = interval;
+	has_deadline = false;
+}
+
+void frame_pacer::end_frame()
+{
+	auto frame_end = now();
+
+	if (target_interval > clock::duration::zero())
+	{
+		if (has_deadline and frame_end > next_deadline)
+		{
+			stats.late_frames++;
+		}
+
+		while (has_deadline and frame_end < next_deadline)
+		{
+			wait(next_deadline - frame_end);
+			frame_end = now();
+		}
+
+		auto caught_up = has_deadline and (frame_end - next_deadline) < target_interval;
+		next_deadline = (caught_up ? next_deadline : frame_end) + target_interval;
+		has_deadline = true;
+	}
+
+	record_frame(frame_end);
+}
+
+const frame_pacer::statistics &frame_pacer::get_statistics() const
+{
+	return stats;
+}
+
+void frame_pacer::precise_wait(clock::duration remaining)
+{
+#ifdef _WIN32
+	if (remaining > spin_margin)
+	{
+		static thread_local waitable_timer timer{};
+
+		// Negative due time is relative, in 100ns units
+		LARGE_INTEGER due_time{};
+		due_time.QuadPart = -std::chrono::duration_cast<std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>>(remaining - spin_margin).count();
+
+		if (timer.handle and SetWaitableTimer(timer.handle, &due_time, 0, nullptr, nullptr, FALSE))
+		{
+			WaitForSingleObject(timer.handle, INFINITE);
+			return;
+		}
+	}
+
+	YieldProcessor();
+#else
+	if (remaining > spin_margin)
+	{
+		std::this_thread::sleep_for(remaining - spin_margin);
+		return;
+	}
+
+	std::this_thread::yield();
+#endif
+}
+
+void frame_pacer::record_frame(clock::time_point frame_end)
+{
+	if (not has_previous_frame)
+	{
+		has_previous_frame = true;
+		previous_frame_end = frame_end;
+		return;
+	}
+
+	milliseconds interval = frame_end - previous_frame_end;
+	previous_frame_end = frame_end;
+
+	stats.frame_count++;
+	auto count = static_cast<double>(stats.frame_count);
+
+	if (stats.frame_count > 1)
+	{
+		stats.last_jitter = milliseconds(std::abs((interval - stats.last_interval).count()));
+		stats.mean_jitter += (stats.last_jitter - stats.mean_jitter) / (count - 1.0);
+		stats.max_jitter = std::max(stats.max_jitter, stats.last_jitter);
+	}
+
+	stats.last_interval = interval;
+	stats.mean_interval += (interval - stats.mean_interval) / count;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace direct3d_11_eg
+{
+	// CPU side frame limiter and pacing statistics.
+	// Deadlines advance by the target interval from the previous deadline, so
+	// small overruns are caught up, a frame more than a whole interval late resyncs.
+	// Clock and wait are injectable so the pacing logic runs against a fake clock.
+	class frame_pacer
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+		using time_source = std::function<clock::time_point()>;
+		// Waits at most the given time, may return early, the pacer re-checks the clock
+		using wait_function = std::function<void(clock::duration)>;
+
+		struct statistics
+		{
+			uint64_t frame_count;
+			uint64_t late_frames; // ended after their deadline had already passed
+			std::chrono::duration<double, std::milli> last_interval;
+			std::chrono::duration<double, std::milli> mean_interval;
+			std::chrono::duration<double, std::milli> last_jitter; // |interval - previous interval|
+			std::chrono::duration<double, std::milli> mean_jitter;
+			std::chrono::duration<double, std::milli> max_jitter;
+		};
+
+	public:
+		frame_pacer() = delete;
+		frame_pacer(clock::duration target_interval, time_source now = clock::now, wait_function wait = precise_wait);
+		~frame_pacer();
+
+		// Zero turns limiting off, statistics are still recorded
+		void set_target_interval(clock::duration target_interval);
+
+		// Once per frame, after present
+		void end_frame();
+
+		const statistics &get_statistics() const;
+
+		// Sleeps on a high resolution waitable timer until just short of the
+		// deadline, then spins, timer wakeups alone are too coarse.
+		// Elsewhere a plain sleep stands in for the timer.
+		static void precise_wait(clock::duration remaining);
+
+	private:
+		void record_frame(clock::time_point frame_end);
+
+	private:
+		clock::duration target_interval{};
+		time_source now;
+		wait_function wait;
+
+		bool has_deadline = false;
+		clock::time_point next_deadline{};
+
+		bool has_previous_frame = false;
+		clock::time_point previous_frame_end{};
+
+		statistics stats{};
+	};
+}
@@ -0,0 +1,327 @@
+#include "frame_statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	constexpr std::array<double, 4> reported_percentiles{ 50.0, 95.0, 99.0, 99.9 };
+
+	uint32_t find_highest_bit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index{};
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return static_cast<uint32_t>(63 - __builtin_clzll(value));
+#endif
+	}
+
+	// Values below sub_bucket_count map linearly, above that each power of two
+	// gets sub_bucket_count buckets
+	uint32_t get_bucket(uint64_t value)
+	{
+		constexpr uint64_t max_value = (uint64_t(1) << latency_histogram::max_value_bits) - 1;
+		value = std::min(value, max_value);
+
+		if (value < latency_histogram::sub_bucket_count)
+		{
+			return static_cast<uint32_t>(value);
+		}
+
+		auto highest_bit = find_highest_bit(value);
+		auto shift = highest_bit - latency_histogram::sub_bucket_bits;
+		auto sub_bucket = static_cast<uint32_t>(value >> shift) - latency_histogram::sub_bucket_count;
+		return (shift + 1) * latency_histogram::sub_bucket_count + sub_bucket;
+	}
+
+	uint64_t get_bucket_highest_value(uint32_t bucket)
+	{
+		if (bucket < latency_histogram::sub_bucket_count)
+		{
+			return bucket;
+		}
+
+		auto shift = bucket / latency_histogram::sub_bucket_count - 1;
+		auto sub_bucket = bucket % latency_histogram::sub_bucket_count;
+		auto lowest = uint64_t(latency_histogram::sub_bucket_count + sub_bucket) << shift;
+		return lowest + (uint64_t(1) << shift) - 1;
+	}
+
+	double to_milliseconds(uint64_t nanoseconds)
+	{
+		return static_cast<double>(nanoseconds) / 1'000'000.0;
+	}
+
+	std::ofstream open_output(std::wstring_view file_name)
+	{
+		std::ofstream file(std::filesystem::path(file_name), std::ios::trunc);
+		if (not file)
+		{
+			throw std::runtime_error("Cannot create statistics file");
+		}
+		return file;
+	}
+}
+
+#pragma region "Latency Histogram"
+
+latency_histogram::latency_histogram()
+{
+	reset();
+}
+
+latency_histogram::~latency_histogram()
+{}
+
+void latency_histogram::record(uint64_t value)
+{
+	counts[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+	total_count.fetch_add(1, std::memory_order_relaxed);
+	total_sum.fetch_add(value, std::memory_order_relaxed);
+
+	auto current_max = max_value.load(std::memory_order_relaxed);
+	while (value > current_max and not max_value.compare_exchange_weak(current_max, value, std::memory_order_relaxed))
+	{}
+}
+
+void latency_histogram::reset()
+{
+	for (auto &count : counts)
+	{
+		count.store(0, std::memory_order_relaxed);
+	}
+	total_count.store(0, std::memory_order_relaxed);
+	total_sum.store(0, std::memory_order_relaxed);
+	max_value.store(0, std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::get_count() const
+{
+	return total_count.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::get_max() const
+{
+	return max_value.load(std::memory_order_relaxed);
+}
+
+double latency_histogram::get_mean() const
+{
+	auto count = get_count();
+	return count ? static_cast<double>(total_sum.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+uint64_t latency_histogram::get_percentile(double percentile) const
+{
+	// Counts may move while we walk them, use the sum of what we actually see
+	uint64_t count = 0;
+	for (const auto &bucket_count : counts)
+	{
+		count += bucket_count.load(std::memory_order_relaxed);
+	}
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	auto rank = static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * count));
+	rank = std::max<uint64_t>(rank, 1);
+
+	uint64_t seen = 0;
+	for (uint32_t bucket = 0; bucket < bucket_count; ++bucket)
+	{
+		seen += counts[bucket].load(std::memory_order_relaxed);
+		if (seen >= rank)
+		{
+			return std::min(get_bucket_highest_value(bucket), get_max());
+		}
+	}
+	return get_max();
+}
+
+#pragma endregion
+
+#pragma region "Frame Statistics"
+
+frame_statistics::scoped_timer::scoped_timer(frame_statistics &statistics, phase_e phase) :
+	statistics(statistics),
+	phase(phase),
+	start_time(clock::now())
+{}
+
+frame_statistics::scoped_timer::~scoped_timer()
+{
+	statistics.record(phase, clock::now() - start_time);
+}
+
+frame_statistics::frame_statistics()
+{
+	for (auto &row : history)
+	{
+		for (auto &value : row)
+		{
+			value.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+frame_statistics::~frame_statistics()
+{}
+
+void frame_statistics::record(phase_e phase, clock::duration duration)
+{
+	auto nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	auto phase_index = static_cast<size_t>(phase);
+
+	histograms[phase_index].record(nanoseconds);
+
+	// Phases can run more than once a frame, the history keeps their sum
+	auto row = frame_index.load(std::memory_order_relaxed) % history_size;
+	history[row][phase_index].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void frame_statistics::end_frame()
+{
+	auto now = clock::now();
+	if (has_last_frame)
+	{
+		record(phase_e::frame, now - last_frame_end);
+	}
+	last_frame_end = now;
+	has_last_frame = true;
+
+	// Clear the row about to be reused before publishing the new index
+	auto next_index = frame_index.load(std::memory_order_relaxed) + 1;
+	for (auto &value : history[next_index % history_size])
+	{
+		value.store(0, std::memory_order_relaxed);
+	}
+	frame_index.store(next_index, std::memory_order_release);
+}
+
+frame_statistics::snapshot frame_statistics::get_snapshot() const
+{
+	snapshot result{};
+
+	for (size_t phase = 0; phase < phase_count; ++phase)
+	{
+		const auto &histogram = histograms[phase];
+		auto &summary = result.phases[phase];
+
+		summary.count = histogram.get_count();
+		summary.mean_ms = histogram.get_mean() / 1'000'000.0;
+		summary.p50_ms = to_milliseconds(histogram.get_percentile(reported_percentiles[0]));
+		summary.p95_ms = to_milliseconds(histogram.get_percentile(reported_percentiles[1]));
+		summary.p99_ms = to_milliseconds(histogram.get_percentile(reported_percentiles[2]));
+		summary.p999_ms = to_milliseconds(histogram.get_percentile(reported_percentiles[3]));
+		summary.max_ms = to_milliseconds(histogram.get_max());
+	}
+
+	// Completed frames only, the row at the current index is still being written.
+	// Rows can be overwritten while copying if the recorder laps us, which
+	// costs a stale frame in the export and nothing else.
+	auto end_index = frame_index.load(std::memory_order_acquire);
+	auto frame_count = std::min<uint64_t>(end_index, history_size - 1);
+
+	result.history.reserve(static_cast<size_t>(frame_count));
+	for (auto index = end_index - frame_count; index < end_index; ++index)
+	{
+		std::array<double, phase_count> row{};
+		for (size_t phase = 0; phase < phase_count; ++phase)
+		{
+			row[phase] = to_milliseconds(history[index % history_size][phase].load(std::memory_order_relaxed));
+		}
+		result.history.push_back(row);
+	}
+
+	return result;
+}
+
+void frame_statistics::write_csv(std::wstring_view file_name) const
+{
+	auto stats = get_snapshot();
+	auto file = open_output(file_name);
+
+	file << "frame";
+	for (size_t phase = 0; phase < phase_count; ++phase)
+	{
+		file << ',' << get_phase_name(static_cast<phase_e>(phase)) << "_ms";
+	}
+	file << '\n';
+
+	for (size_t frame = 0; frame < stats.history.size(); ++frame)
+	{
+		file << frame;
+		for (auto value : stats.history[frame])
+		{
+			file << ',' << value;
+		}
+		file << '\n';
+	}
+}
+
+void frame_statistics::write_json(std::wstring_view file_name) const
+{
+	auto stats = get_snapshot();
+	auto file = open_output(file_name);
+
+	file << "{\n\t\"phases\": {\n";
+	for (size_t phase = 0; phase < phase_count; ++phase)
+	{
+		const auto &summary = stats.phases[phase];
+		file << "\t\t\"" << get_phase_name(static_cast<phase_e>(phase)) << "\": { "
+		     << "\"count\": " << summary.count << ", "
+		     << "\"mean_ms\": " << summary.mean_ms << ", "
+		     << "\"p50_ms\": " << summary.p50_ms << ", "
+		     << "\"p95_ms\": " << summary.p95_ms << ", "
+		     << "\"p99_ms\": " << summary.p99_ms << ", "
+		     << "\"p99.9_ms\": " << summary.p999_ms << ", "
+		     << "\"max_ms\": " << summary.max_ms << " }"
+		     << ((phase + 1 < phase_count) ? ",\n" : "\n");
+	}
+	file << "\t},\n\t\"history_ms\": [\n";
+
+	for (size_t frame = 0; frame < stats.history.size(); ++frame)
+	{
+		file << "\t\t[";
+		for (size_t phase = 0; phase < phase_count; ++phase)
+		{
+			file << stats.history[frame][phase] << ((phase + 1 < phase_count) ? ", " : "");
+		}
+		file << ((frame + 1 < stats.history.size()) ? "],\n" : "]\n");
+	}
+	file << "\t]\n}\n";
+}
+
+const char *frame_statistics::get_phase_name(phase_e phase)
+{
+	switch (phase)
+	{
+		case phase_e::frame:
+			return "frame";
+		case phase_e::window_events:
+			return "window_events";
+		case phase_e::draw_frame:
+			return "draw_frame";
+		case phase_e::present:
+			return "present";
+		case phase_e::resize:
+			return "resize";
+		case phase_e::input_latency:
+			return "input_latency";
+	}
+	return "unknown";
+}
+
+#pragma endregion
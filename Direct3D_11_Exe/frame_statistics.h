@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Log-linear histogram of nanosecond durations, HdrHistogram style.
+	// Each power of two is split into sub_bucket_count buckets, so reported
+	// values are within about 3% of the recorded ones. Counters are relaxed
+	// atomics, recording never locks and readers may run on any thread.
+	class latency_histogram
+	{
+	public:
+		static constexpr uint32_t sub_bucket_bits = 5;
+		static constexpr uint32_t sub_bucket_count = 1 << sub_bucket_bits;
+		static constexpr uint32_t max_value_bits = 40; // about 18 minutes, longer values are clamped
+		static constexpr uint32_t bucket_count = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+	public:
+		latency_histogram();
+		~latency_histogram();
+
+		void record(uint64_t value);
+		void reset();
+
+		uint64_t get_count() const;
+		uint64_t get_max() const;
+		double get_mean() const;
+		// percentile in [0, 100], returns the highest value equivalent to the bucket it lands in
+		uint64_t get_percentile(double percentile) const;
+
+	private:
+		std::array<std::atomic<uint64_t>, bucket_count> counts{};
+		std::atomic<uint64_t> total_count{ 0 };
+		std::atomic<uint64_t> total_sum{ 0 };
+		std::atomic<uint64_t> max_value{ 0 };
+	};
+
+	// Per phase timings of the main loop: a rolling history of recent frames
+	// plus a histogram per phase over the whole run, exportable as CSV or JSON.
+	class frame_statistics
+	{
+	public:
+		enum class phase_e : uint8_t
+		{
+			frame,         // end_frame to end_frame, recorded by end_frame itself
+			window_events, // drained by the render thread before each frame
+			draw_frame,
+			present,
+			resize,        // nested inside window_events, resizes arrive as window messages
+			input_latency  // oldest input a frame handled to the start of its draw, frames without input record nothing
+		};
+		static constexpr size_t phase_count = 6;
+
+		// Frames kept in the rolling history, power of two
+		static constexpr uint32_t history_size = 1024;
+
+		struct phase_summary
+		{
+			uint64_t count;
+			double mean_ms;
+			double p50_ms;
+			double p95_ms;
+			double p99_ms;
+			double p999_ms;
+			double max_ms;
+		};
+
+		struct snapshot
+		{
+			std::array<phase_summary, phase_count> phases;
+			std::vector<std::array<double, phase_count>> history; // milliseconds, oldest frame first
+		};
+
+		using clock = std::chrono::steady_clock;
+
+		// Records the lifetime of the scope against a phase
+		class scoped_timer
+		{
+		public:
+			scoped_timer() = delete;
+			scoped_timer(frame_statistics &statistics, phase_e phase);
+			~scoped_timer();
+
+			scoped_timer(const scoped_timer &) = delete;
+			scoped_timer &operator=(const scoped_timer &) = delete;
+
+		private:
+			frame_statistics &statistics;
+			phase_e phase;
+			clock::time_point start_time;
+		};
+
+	public:
+		frame_statistics();
+		~frame_statistics();
+
+		void record(phase_e phase, clock::duration duration);
+		void end_frame();
+
+		snapshot get_snapshot() const;
+
+		void write_csv(std::wstring_view file_name) const;
+		void write_json(std::wstring_view file_name) const;
+
+		static const char *get_phase_name(phase_e phase);
+
+	private:
+		std::array<latency_histogram, phase_count> histograms;
+
+		// Written by the recording thread, the row at frame_index is the frame in progress
+		std::array<std::array<std::atomic<uint64_t>, phase_count>, history_size> history{};
+		std::atomic<uint64_t> frame_index{ 0 };
+
+		clock::time_point last_frame_end{};
+		bool has_last_frame = false;
+	};
+}
@@ -0,0 +1,260 @@
+#include "frustum_culler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Widest instruction set the build targets, lanes per test.
+// Define as 0 in the project's preprocessor definitions to force the scalar path.
+#ifndef FRUSTUM_CULLER_SIMD
+#if defined(__AVX__)
+#define FRUSTUM_CULLER_SIMD 8
+#elif defined(_M_X64) || defined(__SSE2__)
+#define FRUSTUM_CULLER_SIMD 4
+#else
+#define FRUSTUM_CULLER_SIMD 0
+#endif
+#endif
+
+#if FRUSTUM_CULLER_SIMD == 8
+#include <immintrin.h>
+#elif FRUSTUM_CULLER_SIMD == 4
+#include <xmmintrin.h>
+#endif
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Arrays run this far past the last object, a group starting on any object loads in bounds
+	constexpr uint32_t padding = 8;
+
+#if FRUSTUM_CULLER_SIMD == 8
+	struct avx
+	{
+		using type = __m256;
+		static constexpr uint32_t width = 8;
+
+		static type load(const float *source) { return _mm256_loadu_ps(source); }
+		static type set(float value) { return _mm256_set1_ps(value); }
+		static type add(type a, type b) { return _mm256_add_ps(a, b); }
+		static type multiply(type a, type b) { return _mm256_mul_ps(a, b); }
+		static type both(type a, type b) { return _mm256_and_ps(a, b); }
+		static type not_negative(type a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GE_OQ); }
+		static type all_set() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+		static uint32_t mask(type a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+	};
+	using simd = avx;
+#elif FRUSTUM_CULLER_SIMD == 4
+	struct sse
+	{
+		using type = __m128;
+		static constexpr uint32_t width = 4;
+
+		static type load(const float *source) { return _mm_loadu_ps(source); }
+		static type set(float value) { return _mm_set1_ps(value); }
+		static type add(type a, type b) { return _mm_add_ps(a, b); }
+		static type multiply(type a, type b) { return _mm_mul_ps(a, b); }
+		static type both(type a, type b) { return _mm_and_ps(a, b); }
+		static type not_negative(type a) { return _mm_cmpge_ps(a, _mm_setzero_ps()); }
+		static type all_set() { return _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); }
+		static uint32_t mask(type a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+	};
+	using simd = sse;
+#endif
+}
+
+#if FRUSTUM_CULLER_SIMD
+const uint32_t frustum_culler::simd_width = simd::width;
+#else
+const uint32_t frustum_culler::simd_width = 1;
+#endif
+
+frustum_culler::frustum_culler(uint32_t max_objects) :
+	capacity(max_objects),
+	center_x(max_objects + padding),
+	center_y(max_objects + padding),
+	center_z(max_objects + padding),
+	extent_x(max_objects + padding),
+	extent_y(max_objects + padding),
+	extent_z(max_objects + padding),
+	radius(max_objects + padding)
+{}
+
+frustum_culler::~frustum_culler()
+{}
+
+frustum_culler::object_id frustum_culler::add(const sphere &bounds)
+{
+	assert(object_count < capacity && "frustum culler is full");
+
+	auto object = object_count++;
+	update(object, bounds);
+	return object;
+}
+
+frustum_culler::object_id frustum_culler::add(const box &bounds)
+{
+	assert(object_count < capacity && "frustum culler is full");
+
+	auto object = object_count++;
+	update(object, bounds);
+	return object;
+}
+
+void frustum_culler::update(object_id object, const sphere &bounds)
+{
+	assert(bounds.radius >= 0.0f);
+
+	store(object, bounds.x, bounds.y, bounds.z, 0.0f, 0.0f, 0.0f, bounds.radius);
+}
+
+void frustum_culler::update(object_id object, const box &bounds)
+{
+	assert(bounds.min_x <= bounds.max_x and bounds.min_y <= bounds.max_y and bounds.min_z <= bounds.max_z);
+
+	store(object,
+	      (bounds.min_x + bounds.max_x) * 0.5f,
+	      (bounds.min_y + bounds.max_y) * 0.5f,
+	      (bounds.min_z + bounds.max_z) * 0.5f,
+	      (bounds.max_x - bounds.min_x) * 0.5f,
+	      (bounds.max_y - bounds.min_y) * 0.5f,
+	      (bounds.max_z - bounds.min_z) * 0.5f,
+	      0.0f);
+}
+
+uint32_t frustum_culler::get_object_count() const
+{
+	return object_count;
+}
+
+// Gribb and Hartmann, each plane is a sum or difference of the matrix columns.
+// The near plane is the third column alone, as depth starts at 0 rather than -w.
+void frustum_culler::set_frustum(const float (&view_projection)[4][4])
+{
+	auto column = [&](uint32_t index)
+	{
+		return std::array<float, 4>{ view_projection[0][index], view_projection[1][index],
+		                             view_projection[2][index], view_projection[3][index] };
+	};
+	auto x = column(0), y = column(1), z = column(2), w = column(3);
+
+	std::array<std::array<float, 4>, plane_count> equations{};
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		equations[0][i] = w[i] + x[i]; // left
+		equations[1][i] = w[i] - x[i]; // right
+		equations[2][i] = w[i] + y[i]; // bottom
+		equations[3][i] = w[i] - y[i]; // top
+		equations[4][i] = z[i];        // near
+		equations[5][i] = w[i] - z[i]; // far
+	}
+
+	for (uint32_t i = 0; i < plane_count; ++i)
+	{
+		const auto &e = equations[i];
+		auto length = std::sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+		auto scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+		planes[i] = { e[0] * scale, e[1] * scale, e[2] * scale, e[3] * scale,
+		              std::abs(e[0] * scale), std::abs(e[1] * scale), std::abs(e[2] * scale) };
+	}
+}
+
+uint32_t frustum_culler::cull(uint32_t first, uint32_t last, object_id *visible) const
+{
+	assert(first <= last and last <= object_count);
+
+#if FRUSTUM_CULLER_SIMD
+	return cull_groups<simd>(first, last, visible);
+#else
+	return cull_scalar(first, last, visible);
+#endif
+}
+
+void frustum_culler::store(object_id object, float x, float y, float z, float half_x, float half_y, float half_z, float sphere_radius)
+{
+	assert(object < object_count);
+
+	center_x[object] = x;
+	center_y[object] = y;
+	center_z[object] = z;
+	extent_x[object] = half_x;
+	extent_y[object] = half_y;
+	extent_z[object] = half_z;
+	radius[object] = sphere_radius;
+}
+
+// An object is outside once its centre lies further behind any plane than
+// its bounds reach, the radius plus the extents projected onto the normal.
+// Objects straddling a corner outside the frustum are kept, as usual.
+template <typename simd_t>
+uint32_t frustum_culler::cull_groups(uint32_t first, uint32_t last, object_id *visible) const
+{
+	using type = typename simd_t::type;
+
+	struct lane_plane
+	{
+		type x, y, z, w;
+		type abs_x, abs_y, abs_z;
+	};
+
+	std::array<lane_plane, plane_count> lane_planes;
+	for (uint32_t i = 0; i < plane_count; ++i)
+	{
+		const auto &p = planes[i];
+		lane_planes[i] = { simd_t::set(p.x), simd_t::set(p.y), simd_t::set(p.z), simd_t::set(p.w),
+		                   simd_t::set(p.abs_x), simd_t::set(p.abs_y), simd_t::set(p.abs_z) };
+	}
+
+	uint32_t visible_count = 0;
+	for (auto group = first; group < last; group += simd_t::width)
+	{
+		auto x = simd_t::load(&center_x[group]),
+		     y = simd_t::load(&center_y[group]),
+		     z = simd_t::load(&center_z[group]),
+		     half_x = simd_t::load(&extent_x[group]),
+		     half_y = simd_t::load(&extent_y[group]),
+		     half_z = simd_t::load(&extent_z[group]),
+		     reach_base = simd_t::load(&radius[group]);
+
+		auto inside = simd_t::all_set();
+		for (const auto &p : lane_planes)
+		{
+			auto distance = simd_t::add(simd_t::add(simd_t::multiply(p.x, x), simd_t::multiply(p.y, y)),
+			                            simd_t::add(simd_t::multiply(p.z, z), p.w));
+			auto reach = simd_t::add(simd_t::add(simd_t::multiply(p.abs_x, half_x), simd_t::multiply(p.abs_y, half_y)),
+			                         simd_t::add(simd_t::multiply(p.abs_z, half_z), reach_base));
+			inside = simd_t::both(inside, simd_t::not_negative(simd_t::add(distance, reach)));
+		}
+
+		// Compact without branching, every lane writes its id and only visible ones advance
+		auto mask = simd_t::mask(inside);
+		auto lane_count = std::min(simd_t::width, last - group);
+		for (uint32_t lane = 0; lane < lane_count; ++lane)
+		{
+			visible[visible_count] = group + lane;
+			visible_count += (mask >> lane) & 1;
+		}
+	}
+	return visible_count;
+}
+
+uint32_t frustum_culler::cull_scalar(uint32_t first, uint32_t last, object_id *visible) const
+{
+	uint32_t visible_count = 0;
+	for (auto object = first; object < last; ++object)
+	{
+		auto inside = true;
+		for (const auto &p : planes)
+		{
+			auto distance = p.x * center_x[object] + p.y * center_y[object] + p.z * center_z[object] + p.w;
+			auto reach = p.abs_x * extent_x[object] + p.abs_y * extent_y[object] + p.abs_z * extent_z[object] + radius[object];
+			inside &= distance + reach >= 0.0f;
+		}
+
+		visible[visible_count] = object;
+		visible_count += inside ? 1 : 0;
+	}
+	return visible_count;
+}
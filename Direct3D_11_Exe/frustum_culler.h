@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Tests object bounds against the camera frustum and lists what is visible.
+	// Bounds are kept as structure of arrays, one array per component, and are
+	// tested 8 at a time with AVX, 4 with SSE, or one by one where neither is built for.
+	// Spheres and boxes share the arrays, a sphere is a box with no extents
+	// and a box a sphere of no radius, so both go through the same test.
+	// Culling only reads, any number of threads may cull disjoint ranges at once.
+	// It loads whole groups though, up to simd_width - 1 objects past a range's end,
+	// so ranges updated while others cull have to start on multiples of simd_width.
+	class frustum_culler
+	{
+	public:
+		using object_id = uint32_t;
+
+		// Lanes tested per instruction in this build
+		static const uint32_t simd_width;
+
+		struct sphere
+		{
+			float x, y, z;
+			float radius;
+		};
+
+		struct box
+		{
+			float min_x, min_y, min_z;
+			float max_x, max_y, max_z;
+		};
+
+	public:
+		frustum_culler() = delete;
+		frustum_culler(uint32_t max_objects);
+		~frustum_culler();
+
+		object_id add(const sphere &bounds);
+		object_id add(const box &bounds);
+		void update(object_id object, const sphere &bounds);
+		void update(object_id object, const box &bounds);
+
+		uint32_t get_object_count() const;
+
+		// Row vector matrix as DirectXMath lays it out, clip space depth in [0, w].
+		// Until the first call nothing is culled.
+		void set_frustum(const float (&view_projection)[4][4]);
+
+		// Writes the visible objects in [first, last) to visible in ascending
+		// order and returns how many there are. visible holds last - first ids.
+		uint32_t cull(uint32_t first, uint32_t last, object_id *visible) const;
+
+	private:
+		void store(object_id object, float x, float y, float z, float half_x, float half_y, float half_z, float sphere_radius);
+
+		// Instantiated for the instruction sets built for, in the .cpp
+		template <typename simd_t>
+		uint32_t cull_groups(uint32_t first, uint32_t last, object_id *visible) const;
+		uint32_t cull_scalar(uint32_t first, uint32_t last, object_id *visible) const;
+
+	private:
+		static constexpr uint32_t plane_count = 6;
+
+		// Normalised, so distances are in world units, and the absolute normal
+		// that projects box extents onto it
+		struct plane
+		{
+			float x, y, z, w;
+			float abs_x, abs_y, abs_z;
+		};
+
+		uint32_t capacity = 0;
+		uint32_t object_count = 0;
+
+		std::vector<float> center_x;
+		std::vector<float> center_y;
+		std::vector<float> center_z;
+		std::vector<float> extent_x;
+		std::vector<float> extent_y;
+		std::vector<float> extent_z;
+		std::vector<float> radius;
+
+		std::array<plane, plane_count> planes{};
+	};
+}
@@ -1,33 +1,64 @@
 #include "graphics_renderer.h"
+#include "d3d11_render_device.h"
 #include "vertex.h"
+#include "mesh_optimizer.h"
+#include "profiler.h"
 
+#include <algorithm>
 #include <array>
-#include <fstream>
+#include <cmath>
 #include <vector>
 #include <cstdint>
 #include <tuple>
+#include <chrono>
+#include <memory>
 
 using namespace direct3d_11_eg;
 
 namespace
 {
-	// TODO: Move somewhere else later
-	using file_in_mem = std::vector<byte>;
-	// TODO: Move somewhere else later
-	file_in_mem read_binary_file(const std::wstring &fileName)
+	constexpr uint32_t max_draw_items = 100'000;
+
+	// Every draw item's world matrix takes an aligned slot, plus one for the per frame
+	// constants, with room for two frames so the CPU can fill one while the GPU reads the other
+	constexpr uint32_t constant_buffer_size = 2 * (max_draw_items + 1) * constant_buffer_ring::constant_alignment;
+
+	constexpr job_system::description job_settings{
+		0,     // threads, one per core
+		4'096  // jobs in flight per thread
+	};
+	constexpr uint32_t objects_per_job = 1'024;
+
+	constexpr asset_streamer::description streaming_settings{
+		2,                // worker threads
+		8 * 1024 * 1024,  // bytes uploaded per frame
+		16,               // loaded assets waiting for upload
+		std::chrono::duration<double, std::milli>(2.0)
+	};
+
+	constexpr uint32_t per_frame_slot = 0;
+	struct per_frame_constants
 	{
-		file_in_mem buffer;
+		DirectX::XMFLOAT4X4 view_projection;
+	};
+	static_assert(sizeof(per_frame_constants) <= constant_buffer_ring::constant_alignment, "per frame constants take one slot");
 
-		std::ifstream inFile(fileName, std::ios::in | std::ios::binary);
+	// The world matrices themselves, position.vs declares them row major
+	constexpr uint32_t per_object_slot = 1;
+	static_assert(sizeof(transform_hierarchy::matrix) == sizeof(DirectX::XMFLOAT4X4), "world matrices are read as XMFLOAT4X4");
 
-		if (!inFile.is_open())
-		{
-			throw std::runtime_error("Cannot open file");
-		}
+	// Moves the centre and grows the radius by the largest axis scale
+	frustum_culler::sphere transform_bounds(const frustum_culler::sphere &bounds, const transform_hierarchy::matrix &world)
+	{
+		auto transform = DirectX::XMLoadFloat4x4(reinterpret_cast<const DirectX::XMFLOAT4X4 *>(&world));
+		auto center = DirectX::XMVector3Transform(DirectX::XMVectorSet(bounds.x, bounds.y, bounds.z, 1.0f), transform);
 
-		buffer.assign((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+		auto scale = std::max({ DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(transform.r[0])),
+		                        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(transform.r[1])),
+		                        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(transform.r[2])) });
 
-		return buffer;
+		return { DirectX::XMVectorGetX(center), DirectX::XMVectorGetY(center), DirectX::XMVectorGetZ(center),
+		         bounds.radius * std::sqrt(scale) };
 	}
 
 	using vertex_array_t = std::vector<vertex>;
@@ -55,57 +86,174 @@ namespace
 	}
 }
 
-graphics_renderer::graphics_renderer(HWND hWnd)
+graphics_renderer::graphics_renderer(HWND hWnd, const direct3d::presentation &present_settings) :
+	graphics_renderer(std::make_unique<d3d11_render_device>(hWnd, present_settings, constant_buffer_size))
+{}
+
+graphics_renderer::graphics_renderer(std::unique_ptr<render_device> &&render_backend) :
+	device(std::move(render_backend))
 {
-	d3d = std::make_unique<direct3d>(hWnd);
-	
-	draw_buffer = std::make_unique<render_target>(d3d->get_device(), d3d->get_swap_chain());
-	draw_buffer->activate(d3d->get_context());
-
-	auto vso = read_binary_file(L"position.vs.cso"),
-	     pso = read_binary_file(L"green.ps.cso");
-	draw_pipeline = std::make_unique<pipeline_state>(d3d->get_device(),
-	                                                 pipeline_state::description{
-	                                                     pipeline_state::blend_e::Opaque,
-	                                                     pipeline_state::depth_stencil_e::ReadWrite,
-	                                                     pipeline_state::rasterizer_e::CullAntiClockwise,
-	                                                     pipeline_state::sampler_e::AnisotropicClamp,
-	                                                     
-	                                                     pipeline_state::input_layout_e::position,
-	                                                     D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST,
-	                                                     vso,
-	                                                     pso});
-
-	auto[vertex_array, index_array] = get_triangle_mesh(1.0f, 1.0f, 0.0f);
-	mesh = std::make_unique<mesh_buffer>(d3d->get_device(),
-	                                     vertex_array,
-	                                     index_array);
+	shaders = std::make_unique<shader_store>();
+
+	draw_items = std::make_unique<draw_queue>(max_draw_items);
+	jobs = std::make_unique<job_system>(job_settings);
+
+	// Everything in the scene is the one streamed triangle so far
+	transforms = std::make_unique<transform_hierarchy>(max_draw_items);
+	culler = std::make_unique<frustum_culler>(max_draw_items);
+	visible_objects.resize(max_draw_items);
+
+	transform_hierarchy::matrix identity{};
+	DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4 *>(&identity), DirectX::XMMatrixIdentity());
+
+	scene_object triangle{ transforms->add(transform_hierarchy::invalid_node, identity), { 0.0f, 0.0f, 0.5f, 0.71f } };
+	culler->add(triangle.local_bounds);
+	objects.push_back(triangle);
+
+	// Storage is reserved up front, the world array never moves
+	draw_items->set_object_constants(per_object_slot, transforms->get_world_matrices(),
+	                                 sizeof(transform_hierarchy::matrix), sizeof(transform_hierarchy::matrix));
+	assets = std::make_unique<asset_streamer>(streaming_settings);
+
+	// Shaders are mapped on a worker, the pipeline is built at upload time on this thread
+	pipeline_asset = assets->request([this]()
+	{
+		auto vso = shaders->load(L"position.vs.cso"),
+		     pso = shaders->load(L"green.ps.cso");
+
+		return asset_streamer::prepared_asset{
+			vso->size() + pso->size(),
+			[this, vso, pso]()
+			{
+				draw_pipeline = device->create_pipeline(render_device::pipeline_description{
+				                                            render_device::blend_e::Opaque,
+				                                            render_device::depth_stencil_e::ReadWrite,
+				                                            render_device::rasterizer_e::CullAntiClockwise,
+				                                            render_device::sampler_e::AnisotropicClamp,
+
+				                                            render_device::input_layout_e::packed_position_normal_texcoord,
+				                                            render_device::topology_e::triangle_list,
+				                                            { vso->data(), vso->size() },
+				                                            { pso->data(), pso->size() }});
+				draw_pipeline_id = draw_items->add_pipeline(draw_pipeline);
+			}
+		};
+	});
+
+	// Mesh is generated, optimised and packed on a worker
+	mesh_asset = assets->request([this]()
+	{
+		auto[vertex_array, index_array] = get_triangle_mesh(1.0f, 1.0f, 0.0f);
+		mesh_optimizer::optimize(vertex_array, index_array);
+
+		// Upload quantised, the float copy is only needed for optimisation
+		std::vector<DirectX::XMFLOAT3> positions;
+		positions.reserve(vertex_array.size());
+		for (const auto &v : vertex_array)
+		{
+			positions.push_back(v.position);
+		}
+		auto packed_array = std::make_shared<std::vector<packed_vertex>>(vertex_array.size());
+		pack_vertices(positions.data(), nullptr, nullptr, positions.size(), packed_array->data());
+
+		// The device picks the index width at upload
+		auto indices = std::make_shared<index_array_t>(std::move(index_array));
+
+		return asset_streamer::prepared_asset{
+			packed_array->size() * sizeof(packed_vertex) + indices->size() * sizeof(uint32_t),
+			[this, packed_array, indices]()
+			{
+				mesh = device->create_mesh(render_device::mesh_description{
+				                               packed_array->data(),
+				                               sizeof(packed_vertex),
+				                               static_cast<uint32_t>(packed_array->size()),
+				                               indices->data(),
+				                               render_device::index_type_e::uint32,
+				                               static_cast<uint32_t>(indices->size()) });
+				mesh_id = draw_items->add_mesh(mesh);
+			}
+		};
+	});
 }
 
 graphics_renderer::~graphics_renderer()
 {}
 
-void graphics_renderer::draw_frame()
+void graphics_renderer::draw_frame(const DirectX::XMFLOAT4X4 &view_projection)
 {
-	static std::array<float, 4> clear_color{ 0.35f, 0.25f, 0.35f, 1.0f };
-	draw_buffer->clear_views(d3d->get_context(), clear_color);
+	PROFILE_SCOPE("graphics_renderer::draw_frame");
 
-	draw_pipeline->activate(d3d->get_context());
+	device->wait_for_frame();
+	device->begin_frame();
+	{
+		PROFILE_SCOPE("asset_streamer::process_uploads");
+		assets->process_uploads();
+	}
+
+	static std::array<float, 4> clear_color{ 0.35f, 0.25f, 0.35f, 1.0f };
+	device->clear(clear_color);
 
 	// set per frame shader constants 
+	per_frame_constants frame_constants{};
+	DirectX::XMStoreFloat4x4(&frame_constants.view_projection,
+	                         DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&view_projection)));
+
+	device->set_constants(render_device::shader_stage_e::vertex, per_frame_slot, &frame_constants, sizeof(frame_constants));
+
+	// Draw only what has finished streaming in, never wait for it
+	if (assets->is_ready(pipeline_asset) and assets->is_ready(mesh_asset))
+	{
+		PROFILE_SCOPE("graphics_renderer::build_commands");
+		transforms->update(jobs.get());
+		culler->set_frustum(view_projection.m);
+
+		// Each job refreshes the bounds of whatever moved in its range, culls the range
+		// into its own part of the visible list, then submits what survived.
+		// Ranges are split on whole SIMD groups, culling loads the full group at the
+		// end of a range, which must not hold a neighbouring job's objects mid-update.
+		auto group_width = frustum_culler::simd_width,
+		     object_count = culler->get_object_count(),
+		     group_count = (object_count + group_width - 1) / group_width;
+		jobs->parallel_for(group_count, objects_per_job / group_width, [this, group_width, object_count](uint32_t first_group, uint32_t last_group)
+		{
+			auto first = first_group * group_width,
+			     last = std::min(last_group * group_width, object_count);
 
-	mesh->activate(d3d->get_context());
-	mesh->draw(d3d->get_context());
-	
-	d3d->present();
+			for (auto i = first; i < last; ++i)
+			{
+				if (transforms->was_updated(objects[i].node))
+				{
+					culler->update(i, transform_bounds(objects[i].local_bounds, transforms->get_world(objects[i].node)));
+				}
+			}
+
+			auto visible = &visible_objects[first];
+			auto visible_count = culler->cull(first, last, visible);
+
+			draw_queue::batch batch(*draw_items);
+			for (uint32_t i = 0; i < visible_count; ++i)
+			{
+				auto node = objects[visible[i]].node;
+				batch.submit(draw_pipeline_id, mesh_id, 0.5f, 0, transforms->get_index(node));
+			}
+		});
+	}
+	{
+		PROFILE_SCOPE("draw_queue::execute");
+		draw_items->execute(*device);
+	}
+
+	device->end_frame();
 }
 
-void graphics_renderer::resize_frame()
+void graphics_renderer::present_frame()
 {
-	draw_buffer.reset(nullptr);
-
-	d3d->resize_swap_chain();
+	PROFILE_SCOPE("graphics_renderer::present_frame");
 
-	draw_buffer = std::make_unique<render_target>(d3d->get_device(), d3d->get_swap_chain());
-	draw_buffer->activate(d3d->get_context());
+	device->present();
 }
+
+void graphics_renderer::resize_frame()
+{
+	device->resize();
+}
\ No newline at end of file
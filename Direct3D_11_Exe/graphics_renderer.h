@@ -1,8 +1,16 @@
 #pragma once
 
+#include "render_device.h"
 #include "direct3d.h"
+#include "shader_store.h"
+#include "draw_queue.h"
+#include "asset_streamer.h"
+#include "job_system.h"
+#include "frustum_culler.h"
+#include "transform_hierarchy.h"
 
 #include <Windows.h>
+#include <DirectXMath.h>
 #include <memory>
 #include <vector>
 
@@ -14,16 +22,43 @@ namespace direct3d_11_eg
 	{
 	public:
 		graphics_renderer() = delete;
-		graphics_renderer(HWND hWnd);
+		graphics_renderer(HWND hWnd, const direct3d::presentation &present_settings);
+		// Any backend, a null_render_device runs the CPU side without a window or GPU
+		explicit graphics_renderer(std::unique_ptr<render_device> &&render_backend);
 		~graphics_renderer();
 
-		void draw_frame();
+		void draw_frame(const DirectX::XMFLOAT4X4 &view_projection);
+		void present_frame();
 		void resize_frame();
 
 	private:
-		std::unique_ptr<direct3d> d3d = nullptr;
-		std::unique_ptr<render_target> draw_buffer = nullptr;
-		std::unique_ptr<pipeline_state> draw_pipeline = nullptr;
-		std::unique_ptr<mesh_buffer> mesh = nullptr;
+		std::unique_ptr<shader_store> shaders = nullptr;
+		std::unique_ptr<render_device> device = nullptr;
+		render_device::pipeline_handle draw_pipeline = render_device::invalid_handle;
+		render_device::mesh_handle mesh = render_device::invalid_handle;
+
+		std::unique_ptr<draw_queue> draw_items = nullptr;
+		draw_queue::pipeline_id draw_pipeline_id = 0;
+		draw_queue::mesh_id mesh_id = 0;
+
+		// Frame work such as command building is spread across its threads
+		std::unique_ptr<job_system> jobs = nullptr;
+
+		// Drawable objects, indexed by their id in the culler
+		struct scene_object
+		{
+			transform_hierarchy::node_id node;
+			frustum_culler::sphere local_bounds;
+		};
+
+		std::unique_ptr<transform_hierarchy> transforms = nullptr;
+		std::unique_ptr<frustum_culler> culler = nullptr;
+		std::vector<scene_object> objects;
+		std::vector<frustum_culler::object_id> visible_objects;
+
+		// Declared last so workers stop before anything their uploads touch is destroyed
+		std::unique_ptr<asset_streamer> assets = nullptr;
+		asset_streamer::asset_id pipeline_asset = asset_streamer::invalid_asset;
+		asset_streamer::asset_id mesh_asset = asset_streamer::invalid_asset;
 	};
 };
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "index_codec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	void write_varint(std::vector<uint8_t> &output, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	uint32_t read_varint(const uint8_t *&data, const uint8_t *end)
+	{
+		// Single byte values are the overwhelmingly common case
+		if (data < end and *data < 0x80)
+		{
+			return *data++;
+		}
+
+		uint32_t value = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7)
+		{
+			if (data == end)
+			{
+				throw std::runtime_error("Truncated index stream");
+			}
+
+			auto next_byte = *data++;
+
+			// Fifth byte only has room for the top 4 bits, anything above would be lost
+			if (shift == 28 and (next_byte & 0x70) != 0)
+			{
+				throw std::runtime_error("Malformed index stream");
+			}
+
+			value |= static_cast<uint32_t>(next_byte & 0x7f) << shift;
+			if (next_byte < 0x80)
+			{
+				return value;
+			}
+		}
+
+		throw std::runtime_error("Malformed index stream");
+	}
+
+	uint32_t zigzag_encode(int32_t value)
+	{
+		return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	}
+
+	int32_t zigzag_decode(uint32_t value)
+	{
+		return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+	}
+
+	template <typename index_t>
+	void decode_indices(const uint8_t *data, size_t size, index_t *output)
+	{
+		auto end = data + size;
+		auto stream_header = index_codec::read_header(data, size);
+		data += stream_header.header_size;
+
+		if (stream_header.max_index > std::numeric_limits<index_t>::max())
+		{
+			throw std::runtime_error("Index stream does not fit the output index size");
+		}
+
+		// Every index is checked against the header, the output width was picked from it
+		uint32_t previous = 0;
+		for (uint32_t i = 0; i < stream_header.index_count; ++i)
+		{
+			previous += static_cast<uint32_t>(zigzag_decode(read_varint(data, end)));
+			if (previous > stream_header.max_index)
+			{
+				throw std::runtime_error("Index exceeds the stream's max index");
+			}
+			output[i] = static_cast<index_t>(previous);
+		}
+
+		if (data != end)
+		{
+			throw std::runtime_error("Trailing data after index stream");
+		}
+	}
+}
+
+uint32_t index_codec::find_max_index(const uint32_t *indices, size_t count)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	return *std::max_element(indices, indices + count);
+}
+
+bool index_codec::fits_16bit(const uint32_t *indices, size_t count)
+{
+	return find_max_index(indices, count) <= max_16bit_index;
+}
+
+void index_codec::narrow_to_16bit(const uint32_t *indices, size_t count, uint16_t *output)
+{
+	std::transform(indices, indices + count, output, [](uint32_t index)
+	{
+		assert(index <= max_16bit_index);
+		return static_cast<uint16_t>(index);
+	});
+}
+
+uint32_t index_codec::select_index_size(uint32_t max_index)
+{
+	// Half the memory and bandwidth whenever every index fits in 16 bits
+	return (max_index <= max_16bit_index) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void index_codec::write_indices(const uint32_t *indices, size_t count, uint32_t index_size, uint8_t *output)
+{
+	assert(index_size == sizeof(uint16_t) or index_size == sizeof(uint32_t));
+
+	if (index_size == sizeof(uint16_t))
+	{
+		// Byte output may not be aligned for uint16_t stores
+		for (size_t i = 0; i < count; ++i)
+		{
+			assert(indices[i] <= max_16bit_index);
+			auto index = static_cast<uint16_t>(indices[i]);
+			std::memcpy(output + i * sizeof(uint16_t), &index, sizeof(uint16_t));
+		}
+		return;
+	}
+
+	std::memcpy(output, indices, count * sizeof(uint32_t));
+}
+
+index_codec::packed_indices index_codec::pack_indices(const uint32_t *indices, size_t count)
+{
+	assert(count <= UINT32_MAX);
+
+	packed_indices packed{};
+	packed.index_size = select_index_size(find_max_index(indices, count));
+	packed.index_count = static_cast<uint32_t>(count);
+	packed.data.resize(count * packed.index_size);
+	write_indices(indices, count, packed.index_size, packed.data.data());
+
+	return packed;
+}
+
+index_codec::packed_indices index_codec::pack_indices(const uint8_t *data, size_t size)
+{
+	auto stream_header = read_header(data, size);
+
+	packed_indices packed{};
+	packed.index_size = select_index_size(stream_header.max_index);
+	packed.index_count = stream_header.index_count;
+	packed.data.resize(size_t(packed.index_count) * packed.index_size);
+
+	// vector storage is aligned for any index type
+	if (packed.index_size == sizeof(uint16_t))
+	{
+		decode(data, size, reinterpret_cast<uint16_t *>(packed.data.data()));
+	}
+	else
+	{
+		decode(data, size, reinterpret_cast<uint32_t *>(packed.data.data()));
+	}
+
+	return packed;
+}
+
+std::vector<uint8_t> index_codec::encode(const uint32_t *indices, size_t count)
+{
+	assert(count <= UINT32_MAX);
+
+	std::vector<uint8_t> output;
+	output.reserve(count + 10);
+
+	write_varint(output, static_cast<uint32_t>(count));
+	write_varint(output, find_max_index(indices, count));
+
+	uint32_t previous = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		write_varint(output, zigzag_encode(static_cast<int32_t>(indices[i] - previous)));
+		previous = indices[i];
+	}
+
+	return output;
+}
+
+index_codec::header index_codec::read_header(const uint8_t *data, size_t size)
+{
+	auto cursor = data;
+	auto end = data + size;
+
+	header stream_header{};
+	stream_header.index_count = read_varint(cursor, end);
+	stream_header.max_index = read_varint(cursor, end);
+	stream_header.header_size = static_cast<size_t>(cursor - data);
+
+	// Every index takes at least one byte, reject counts the body cannot hold
+	// before a caller sizes its output from them
+	if (stream_header.index_count > size - stream_header.header_size)
+	{
+		throw std::runtime_error("Truncated index stream");
+	}
+
+	return stream_header;
+}
+
+void index_codec::decode(const uint8_t *data, size_t size, uint16_t *output)
+{
+	decode_indices(data, size, output);
+}
+
+void index_codec::decode(const uint8_t *data, size_t size, uint32_t *output)
+{
+	decode_indices(data, size, output);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Compact encoding of triangle index lists for storage on disk.
+	// Each index is stored as the zigzag varint of its difference from the previous
+	// index, which is one byte for most indices of a cache optimised mesh.
+	// Stream starts with the index count and the largest index, so the decoder
+	// can pick 16 or 32 bit output before touching the body.
+	namespace index_codec
+	{
+		struct header
+		{
+			uint32_t index_count;
+			uint32_t max_index;
+			size_t header_size;
+		};
+
+		// Indices at the width select_index_size picked for them, ready to upload
+		struct packed_indices
+		{
+			std::vector<uint8_t> data;
+			uint32_t index_size;
+			uint32_t index_count;
+		};
+
+		// Largest index that still fits 16 bit buffers, 0xffff is left free for strip cuts
+		constexpr uint32_t max_16bit_index = 0xfffe;
+
+		uint32_t find_max_index(const uint32_t *indices, size_t count);
+		bool fits_16bit(const uint32_t *indices, size_t count);
+		void narrow_to_16bit(const uint32_t *indices, size_t count, uint16_t *output);
+
+		// Bytes per index for a buffer holding indices up to max_index, 2 whenever
+		// they fit in 16 bits. Everything that uploads or stores indices asks here.
+		uint32_t select_index_size(uint32_t max_index);
+		// Output must hold count indices of index_size bytes, 16 bit output is narrowed
+		void write_indices(const uint32_t *indices, size_t count, uint32_t index_size, uint8_t *output);
+		packed_indices pack_indices(const uint32_t *indices, size_t count);
+		// Decodes straight to the width the stream's max index needs
+		packed_indices pack_indices(const uint8_t *data, size_t size);
+
+		std::vector<uint8_t> encode(const uint32_t *indices, size_t count);
+
+		// Malformed, truncated or out of range streams throw std::runtime_error
+		header read_header(const uint8_t *data, size_t size);
+		// Decode into caller memory, output must hold header.index_count indices
+		void decode(const uint8_t *data, size_t size, uint16_t *output);
+		void decode(const uint8_t *data, size_t size, uint32_t *output);
+	}
+}
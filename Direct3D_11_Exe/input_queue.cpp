@@ -0,0 +1,76 @@
+#include "input_queue.h"
+
+#include <cassert>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Counters only the producer writes, a plain store is enough and avoids a locked add per event
+	void increment(std::atomic<uint64_t> &counter)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+}
+
+input_queue::input_queue(uint32_t capacity) :
+	events(capacity)
+{}
+
+input_queue::~input_queue()
+{}
+
+bool input_queue::push(const input_event &event)
+{
+	if (event.type == input_event::type_e::resize)
+	{
+		assert(event.x >= 0 and event.y >= 0);
+
+		auto previous = pending_size.exchange(resize_pending | (uint64_t(event.x) << 32) | uint32_t(event.y), std::memory_order_acq_rel);
+		if (previous & resize_pending)
+		{
+			increment(coalesced_resize_count);
+		}
+		increment(resize_count);
+	}
+
+	if (not events.try_push(event))
+	{
+		increment(dropped_count);
+		return false;
+	}
+
+	increment(pushed_count);
+	return true;
+}
+
+uint32_t input_queue::pop_batch(input_event *events_out, uint32_t max_count)
+{
+	return events.try_pop_batch(events_out, max_count);
+}
+
+bool input_queue::take_resize(uint32_t &width, uint32_t &height)
+{
+	auto size = pending_size.exchange(0, std::memory_order_acq_rel);
+	if ((size & resize_pending) == 0)
+	{
+		return false;
+	}
+
+	width = static_cast<uint32_t>((size & ~resize_pending) >> 32);
+	height = static_cast<uint32_t>(size);
+	return true;
+}
+
+uint32_t input_queue::get_queued_count() const
+{
+	return events.size();
+}
+
+input_queue::statistics input_queue::get_statistics() const
+{
+	return { pushed_count.load(std::memory_order_relaxed),
+	         dropped_count.load(std::memory_order_relaxed),
+	         resize_count.load(std::memory_order_relaxed),
+	         coalesced_resize_count.load(std::memory_order_relaxed) };
+}
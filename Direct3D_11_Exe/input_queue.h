@@ -0,0 +1,97 @@
+#pragma once
+
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace direct3d_11_eg
+{
+	// One window message of interest, stamped when the window procedure saw it
+	struct input_event
+	{
+		using clock = std::chrono::steady_clock;
+
+		enum class type_e : uint8_t
+		{
+			key_down,
+			key_up,
+			character,
+			mouse_move,
+			mouse_down,
+			mouse_up,
+			mouse_wheel,
+			raw_mouse,
+			resize,
+			activate
+		};
+
+		enum class button_e : uint8_t
+		{
+			none,
+			left,
+			right,
+			middle,
+			x1,
+			x2
+		};
+
+		clock::time_point timestamp;
+		type_e type;
+		button_e button;
+		uint16_t repeat_count; // key_down auto repeats
+		uint32_t key;          // virtual key code, or UTF-16 code unit for character
+		int32_t x;             // cursor position, raw motion, wheel delta in x, new client size, activate 1 or 0
+		int32_t y;
+	};
+
+	// Preallocated lock-free ring of input events, written by the window thread
+	// and drained in batches by one consumer, usually the render thread.
+	// Nothing blocks and nothing allocates once constructed. A full ring drops
+	// the event and counts it, except that the latest client size is also kept
+	// in a single slot mailbox, so a resize is never lost, only coalesced.
+	class input_queue
+	{
+	public:
+		struct statistics
+		{
+			uint64_t pushed;
+			uint64_t dropped;
+			uint64_t resizes;
+			uint64_t coalesced_resizes; // replaced in the mailbox before being taken
+		};
+
+	public:
+		input_queue() = delete;
+		// capacity must be a power of two
+		explicit input_queue(uint32_t capacity);
+		~input_queue();
+
+		input_queue(const input_queue &) = delete;
+		input_queue &operator=(const input_queue &) = delete;
+
+		// Producer thread only
+		bool push(const input_event &event);
+
+		// Consumer thread only. Returns the number of events copied, oldest first.
+		uint32_t pop_batch(input_event *events, uint32_t max_count);
+		// Consumer thread only. False when the size has not changed since last taken.
+		bool take_resize(uint32_t &width, uint32_t &height);
+
+		uint32_t get_queued_count() const;
+		statistics get_statistics() const;
+
+	private:
+		// Pending flag in the top bit, then a 31 bit width and a 32 bit height
+		static constexpr uint64_t resize_pending = uint64_t(1) << 63;
+
+		spsc_queue<input_event> events;
+		std::atomic<uint64_t> pending_size{ 0 };
+
+		std::atomic<uint64_t> pushed_count{ 0 };
+		std::atomic<uint64_t> dropped_count{ 0 };
+		std::atomic<uint64_t> resize_count{ 0 };
+		std::atomic<uint64_t> coalesced_resize_count{ 0 };
+	};
+}
@@ -0,0 +1,309 @@
+#include "job_system.h"
+#include "profiler.h"
+
+#include <cassert>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Which system and slot the current thread runs jobs for, other threads use slot 0
+	thread_local const job_system *current_system = nullptr;
+	thread_local uint32_t current_index = 0;
+
+	// Attempts at finding work before a worker goes to sleep
+	constexpr uint32_t idle_spins = 64;
+
+	uint32_t next_random(uint32_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+}
+
+#pragma region "Work Deque"
+
+job_system::work_deque::work_deque(uint32_t capacity) :
+	mask(int64_t(capacity) - 1),
+	slots(std::make_unique<std::atomic<job *>[]>(capacity))
+{
+	assert(capacity > 0 and (capacity & (capacity - 1)) == 0);
+}
+
+bool job_system::work_deque::push(job *ready_job)
+{
+	auto b = bottom.load(std::memory_order_relaxed),
+	     t = top.load(std::memory_order_acquire);
+	if (b - t > mask)
+	{
+		return false;
+	}
+
+	slots[b & mask].store(ready_job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+job_system::job *job_system::work_deque::pop()
+{
+	auto b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	auto popped = slots[b & mask].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// Last job, race any thief for it
+		if (not top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			popped = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return popped;
+}
+
+job_system::job *job_system::work_deque::steal()
+{
+	auto t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+	{
+		return nullptr;
+	}
+
+	auto stolen = slots[t & mask].load(std::memory_order_relaxed);
+	if (not top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+	return stolen;
+}
+
+#pragma endregion
+
+#pragma region "Job System"
+
+job_system::thread_state::thread_state(uint32_t max_jobs) :
+	deque(max_jobs),
+	jobs(std::make_unique<job[]>(max_jobs)),
+	random_state(static_cast<uint32_t>(0x9e3779b9U ^ reinterpret_cast<uintptr_t>(this)))
+{}
+
+job_system::job_system(const description &system_description)
+{
+	assert(system_description.max_jobs_per_thread > 0
+	       and (system_description.max_jobs_per_thread & (system_description.max_jobs_per_thread - 1)) == 0);
+
+	job_mask = system_description.max_jobs_per_thread - 1;
+
+	auto thread_count = system_description.thread_count ? system_description.thread_count
+	                                                    : std::max(1U, std::thread::hardware_concurrency());
+	for (uint32_t i = 0; i < thread_count; ++i)
+	{
+		states.push_back(std::make_unique<thread_state>(system_description.max_jobs_per_thread));
+	}
+
+	workers.reserve(thread_count - 1);
+	for (uint32_t i = 1; i < thread_count; ++i)
+	{
+		workers.emplace_back(&job_system::worker_loop, this, i);
+	}
+}
+
+job_system::~job_system()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_lock);
+		stopping.store(true, std::memory_order_seq_cst);
+	}
+	wake.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void job_system::run(job *ready_job)
+{
+	auto &state = get_thread_state();
+	if (not state.deque.push(ready_job))
+	{
+		state.jobs_run_inline.store(state.jobs_run_inline.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		execute(ready_job, state);
+		return;
+	}
+
+	// Paired with the sleeping count a worker raises before its last look for work,
+	// one side always sees the other
+	queued_jobs.fetch_add(1, std::memory_order_seq_cst);
+	if (sleeping_workers.load(std::memory_order_seq_cst) > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_lock);
+		}
+		wake.notify_one();
+	}
+}
+
+void job_system::wait(const job *pending_job)
+{
+	PROFILE_SCOPE("job_system::wait");
+
+	auto &state = get_thread_state();
+	while (not is_finished(pending_job))
+	{
+		if (auto next = find_job(state))
+		{
+			execute(next, state);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool job_system::is_finished(const job *pending_job) const
+{
+	return pending_job->unfinished.load(std::memory_order_acquire) == 0;
+}
+
+uint32_t job_system::get_thread_count() const
+{
+	return static_cast<uint32_t>(states.size());
+}
+
+job_system::statistics job_system::get_statistics() const
+{
+	statistics stats{};
+	for (const auto &state : states)
+	{
+		stats.jobs_run += state->jobs_run.load(std::memory_order_relaxed);
+		stats.jobs_stolen += state->jobs_stolen.load(std::memory_order_relaxed);
+		stats.jobs_run_inline += state->jobs_run_inline.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+job_system::job *job_system::allocate(job *parent)
+{
+	auto &state = get_thread_state();
+
+	auto new_job = &state.jobs[state.next_job++ & job_mask];
+	assert(new_job->unfinished.load(std::memory_order_relaxed) == 0 && "job ring wrapped onto a job still in flight");
+
+	new_job->parent = parent;
+	new_job->unfinished.store(1, std::memory_order_relaxed);
+	if (parent)
+	{
+		parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+	}
+	return new_job;
+}
+
+void job_system::execute(job *ready_job, thread_state &state)
+{
+	ready_job->function(*ready_job);
+	finish(ready_job);
+
+	state.jobs_run.store(state.jobs_run.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void job_system::finish(job *done_job)
+{
+	// Release publishes everything the job wrote to whoever sees it finished.
+	// The parent is read first, a finished job's slot may be reused right away.
+	while (done_job)
+	{
+		auto parent = done_job->parent;
+		if (done_job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			break;
+		}
+		done_job = parent;
+	}
+}
+
+job_system::job *job_system::find_job(thread_state &state)
+{
+	auto found = state.deque.pop();
+	if (not found)
+	{
+		// Start from a random victim, so thieves spread out
+		auto thread_count = static_cast<uint32_t>(states.size());
+		auto first = next_random(state.random_state) % thread_count;
+		for (uint32_t i = 0; i < thread_count and not found; ++i)
+		{
+			auto &victim = *states[(first + i) % thread_count];
+			if (&victim != &state)
+			{
+				found = victim.deque.steal();
+			}
+		}
+
+		if (found)
+		{
+			state.jobs_stolen.store(state.jobs_stolen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	}
+
+	if (found)
+	{
+		queued_jobs.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return found;
+}
+
+job_system::thread_state &job_system::get_thread_state()
+{
+	return *states[current_system == this ? current_index : 0];
+}
+
+void job_system::worker_loop(uint32_t index)
+{
+	current_system = this;
+	current_index = index;
+	profiler::set_thread_name("job_system");
+
+	auto &state = *states[index];
+	uint32_t idle_count = 0;
+	while (not stopping.load(std::memory_order_relaxed))
+	{
+		if (auto next = find_job(state))
+		{
+			execute(next, state);
+			idle_count = 0;
+			continue;
+		}
+
+		if (++idle_count < idle_spins)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_lock);
+		sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+		wake.wait(lock, [this]()
+		{
+			return stopping.load(std::memory_order_seq_cst) or queued_jobs.load(std::memory_order_seq_cst) > 0;
+		});
+		sleeping_workers.fetch_sub(1, std::memory_order_seq_cst);
+		idle_count = 0;
+	}
+}
+
+#pragma endregion
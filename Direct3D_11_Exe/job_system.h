@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Work stealing job scheduler.
+	//  * every thread has a fixed size Chase-Lev deque, its owner pushes and pops
+	//    at the bottom, idle threads steal the oldest jobs from the top
+	//  * jobs come from a ring per thread and carry their captures inline,
+	//    nothing allocates once the system is running
+	//  * a job is finished once it and all its children have run, children
+	//    count their parent down as they finish
+	//  * waiting runs other jobs instead of blocking, so jobs may wait too
+	// Threads that are not workers share the first slot, so only one of them
+	// may use the system at a time, normally the one running the frame.
+	class job_system
+	{
+	public:
+		static constexpr size_t job_data_size = 40;
+
+		struct description
+		{
+			uint32_t thread_count;        // workers plus the calling thread, 0 for one per core
+			uint32_t max_jobs_per_thread; // power of two, jobs a thread may have in flight
+		};
+
+		struct statistics
+		{
+			uint64_t jobs_run;
+			uint64_t jobs_stolen;
+			uint64_t jobs_run_inline; // deque was full, ran on the spot instead
+		};
+
+		// Cache line sized, the callable is stored in data
+		struct alignas(64) job
+		{
+			void (*function)(job &);
+			job *parent;
+			std::atomic<int32_t> unfinished;
+			alignas(8) std::array<std::byte, job_data_size> data;
+		};
+
+	public:
+		job_system() = delete;
+		job_system(const description &system_description);
+		~job_system();
+
+		job_system(const job_system &) = delete;
+		job_system &operator=(const job_system &) = delete;
+
+		// The callable takes no arguments. It must fit in job_data_size and be
+		// trivially destructible, capture pointers to anything larger.
+		template <typename function_t>
+		job *create(function_t &&function, job *parent = nullptr)
+		{
+			using callable_t = std::decay_t<function_t>;
+			static_assert(sizeof(callable_t) <= job_data_size, "job captures too large, capture a pointer instead");
+			static_assert(alignof(callable_t) <= 8, "job captures over aligned");
+			static_assert(std::is_trivially_destructible_v<callable_t>, "job captures are never destroyed");
+
+			auto new_job = allocate(parent);
+			new (new_job->data.data()) callable_t(std::forward<function_t>(function));
+			new_job->function = [](job &self)
+			{
+				(*std::launder(reinterpret_cast<callable_t *>(self.data.data())))();
+			};
+			return new_job;
+		}
+
+		void run(job *ready_job);
+		// Runs other jobs until this one and its children are done
+		void wait(const job *pending_job);
+		bool is_finished(const job *pending_job) const;
+
+		// Calls function(first, last) over [0, count) in pieces of at least
+		// grain_size, split in halves so thieves take the biggest pieces first.
+		// Returns once every piece has run.
+		template <typename function_t>
+		void parallel_for(uint32_t count, uint32_t grain_size, const function_t &function)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+
+			auto root = create([]() {});
+			run(create(range_task<function_t>{ this, &function, root, 0, count, std::max(grain_size, 1U) }, root));
+			run(root);
+			wait(root);
+		}
+
+		// Workers plus the calling thread
+		uint32_t get_thread_count() const;
+		statistics get_statistics() const;
+
+	private:
+		template <typename function_t>
+		struct range_task
+		{
+			job_system *system;
+			const function_t *function;
+			job *root;
+			uint32_t first;
+			uint32_t last;
+			uint32_t grain_size;
+
+			void operator()() const
+			{
+				auto end = last;
+				while (end - first > grain_size)
+				{
+					auto middle = first + (end - first) / 2;
+					system->run(system->create(range_task{ system, function, root, middle, end, grain_size }, root));
+					end = middle;
+				}
+				(*function)(first, end);
+			}
+		};
+
+		// Fixed capacity Chase-Lev deque of job pointers
+		class work_deque
+		{
+		public:
+			work_deque() = delete;
+			explicit work_deque(uint32_t capacity);
+
+			// Owner only
+			bool push(job *ready_job);
+			job *pop();
+			// Any thread
+			job *steal();
+
+		private:
+			const int64_t mask;
+			std::unique_ptr<std::atomic<job *>[]> slots;
+			alignas(64) std::atomic<int64_t> top{ 0 };
+			alignas(64) std::atomic<int64_t> bottom{ 0 };
+		};
+
+		struct alignas(64) thread_state
+		{
+			thread_state(uint32_t max_jobs);
+
+			work_deque deque;
+			std::unique_ptr<job[]> jobs;
+			uint32_t next_job = 0;
+			uint32_t random_state;
+
+			// Written by the owner only
+			std::atomic<uint64_t> jobs_run{ 0 };
+			std::atomic<uint64_t> jobs_stolen{ 0 };
+			std::atomic<uint64_t> jobs_run_inline{ 0 };
+		};
+
+	private:
+		job *allocate(job *parent);
+		void execute(job *ready_job, thread_state &state);
+		void finish(job *done_job);
+		job *find_job(thread_state &state);
+		thread_state &get_thread_state();
+		void worker_loop(uint32_t index);
+
+	private:
+		uint32_t job_mask = 0;
+		std::vector<std::unique_ptr<thread_state>> states;
+		std::vector<std::thread> workers;
+
+		// Lets idle workers sleep, woken as jobs are queued
+		std::atomic<int64_t> queued_jobs{ 0 };
+		std::atomic<uint32_t> sleeping_workers{ 0 };
+		std::mutex sleep_lock;
+		std::condition_variable wake;
+		std::atomic<bool> stopping{ false };
+	};
+}
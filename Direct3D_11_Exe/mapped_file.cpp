@@ -0,0 +1,81 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace direct3d_11_eg;
+
+mapped_file::mapped_file(std::wstring_view file_name)
+{
+	const std::wstring file_path{ file_name };
+
+	file_handle = CreateFileW(file_path.c_str(),
+	                          GENERIC_READ,
+	                          FILE_SHARE_READ,
+	                          nullptr,
+	                          OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+	                          nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Cannot open file");
+	}
+
+	LARGE_INTEGER file_size{};
+	if (not GetFileSizeEx(file_handle, &file_size))
+	{
+		CloseHandle(file_handle);
+		throw std::runtime_error("Cannot get file size");
+	}
+
+	view_size = static_cast<size_t>(file_size.QuadPart);
+
+	// Windows refuses to map empty files, leave view as nullptr
+	if (view_size == 0)
+	{
+		return;
+	}
+
+	mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle == nullptr)
+	{
+		CloseHandle(file_handle);
+		throw std::runtime_error("Cannot map file");
+	}
+
+	view = reinterpret_cast<const byte *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (view == nullptr)
+	{
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		throw std::runtime_error("Cannot map view of file");
+	}
+}
+
+mapped_file::~mapped_file()
+{
+	if (view)
+	{
+		UnmapViewOfFile(view);
+	}
+
+	if (mapping_handle)
+	{
+		CloseHandle(mapping_handle);
+	}
+
+	if (file_handle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file_handle);
+	}
+}
+
+const byte *mapped_file::data() const
+{
+	return view;
+}
+
+size_t mapped_file::size() const
+{
+	return view_size;
+}
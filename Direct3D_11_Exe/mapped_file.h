@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Windows.h>
+#include <cstdint>
+#include <string_view>
+
+namespace direct3d_11_eg
+{
+	// Read-only, memory mapped view of a file on disk.
+	// Contents are paged in by the OS on first access, no copy is made.
+	class mapped_file
+	{
+	public:
+		mapped_file() = delete;
+		mapped_file(std::wstring_view file_name);
+		~mapped_file();
+
+		mapped_file(const mapped_file &) = delete;
+		mapped_file &operator=(const mapped_file &) = delete;
+
+		const byte *data() const;
+		size_t size() const;
+
+	private:
+		HANDLE file_handle = INVALID_HANDLE_VALUE;
+		HANDLE mapping_handle = nullptr;
+		const byte *view = nullptr;
+		size_t view_size = 0;
+	};
+}
@@ -0,0 +1,309 @@
+#include "mesh_file.h"
+#include "index_codec.h"
+#include "vertex_layout.h"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	uint64_t align_up(uint64_t offset)
+	{
+		return (offset + mesh_format::blob_alignment - 1) & ~uint64_t(mesh_format::blob_alignment - 1);
+	}
+
+	bool is_aligned(uint64_t offset)
+	{
+		return offset % mesh_format::blob_alignment == 0;
+	}
+
+	// Reads a position as floats, for the formats a POSITION element can reasonably use
+	bool read_position(const uint8_t *data, uint32_t format, std::array<float, 3> &position)
+	{
+		switch (format)
+		{
+			case DXGI_FORMAT_R32G32B32_FLOAT:
+			case DXGI_FORMAT_R32G32B32A32_FLOAT:
+				std::memcpy(position.data(), data, sizeof(float) * 3);
+				return true;
+
+			case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			{
+				DirectX::PackedVector::HALF halves[3];
+				std::memcpy(halves, data, sizeof(halves));
+				for (size_t i = 0; i < 3; ++i)
+				{
+					position[i] = DirectX::PackedVector::XMConvertHalfToFloat(halves[i]);
+				}
+				return true;
+			}
+
+			default:
+				return false;
+		}
+	}
+
+	void compute_bounds(const mesh_format::source &mesh, mesh_format::header &header)
+	{
+		header.bounds_min = { 0.0f, 0.0f, 0.0f };
+		header.bounds_max = { 0.0f, 0.0f, 0.0f };
+
+		auto position_element = std::find_if(mesh.elements, mesh.elements + mesh.element_count, [](const D3D11_INPUT_ELEMENT_DESC &element)
+		{
+			return std::strcmp(element.SemanticName, "POSITION") == 0 and element.SemanticIndex == 0;
+		});
+		if (position_element == mesh.elements + mesh.element_count or mesh.vertex_count == 0)
+		{
+			return;
+		}
+
+		header.bounds_min.fill(std::numeric_limits<float>::max());
+		header.bounds_max.fill(std::numeric_limits<float>::lowest());
+
+		auto vertex = reinterpret_cast<const uint8_t *>(mesh.vertices) + position_element->AlignedByteOffset;
+		for (uint32_t i = 0; i < mesh.vertex_count; ++i, vertex += mesh.vertex_stride)
+		{
+			std::array<float, 3> position{};
+			if (not read_position(vertex, position_element->Format, position))
+			{
+				throw std::runtime_error("Unsupported POSITION format for mesh bounds");
+			}
+
+			for (size_t axis = 0; axis < 3; ++axis)
+			{
+				header.bounds_min[axis] = std::min(header.bounds_min[axis], position[axis]);
+				header.bounds_max[axis] = std::max(header.bounds_max[axis], position[axis]);
+			}
+		}
+	}
+}
+
+#pragma region "Writer"
+
+void mesh_format::write(std::wstring_view file_name, const source &mesh)
+{
+	if (mesh.element_count == 0 or mesh.element_count > max_elements)
+	{
+		throw std::runtime_error("Mesh layout element count out of range");
+	}
+	if (mesh.lods.empty() or mesh.lods.size() > max_lods)
+	{
+		throw std::runtime_error("Mesh lod count out of range");
+	}
+
+	// Narrow every level or none, the index format is per file
+	uint32_t max_index = 0;
+	for (const auto &level : mesh.lods)
+	{
+		max_index = std::max(max_index, index_codec::find_max_index(level.indices, level.index_count));
+	}
+	auto index_size = index_codec::select_index_size(max_index);
+
+	header file_header{};
+	file_header.magic = magic;
+	file_header.version_major = version_major;
+	file_header.version_minor = version_minor;
+	file_header.header_size = sizeof(header);
+	file_header.element_count = mesh.element_count;
+	file_header.vertex_stride = mesh.vertex_stride;
+	file_header.vertex_count = mesh.vertex_count;
+	file_header.index_format = get_index_format(index_size);
+	file_header.lod_count = static_cast<uint32_t>(mesh.lods.size());
+	compute_bounds(mesh, file_header);
+
+	file_header.elements_offset = align_up(sizeof(header));
+	file_header.lods_offset = align_up(file_header.elements_offset + sizeof(element) * mesh.element_count);
+	file_header.vertex_offset = align_up(file_header.lods_offset + sizeof(lod) * mesh.lods.size());
+
+	std::vector<element> elements(mesh.element_count);
+	for (uint32_t i = 0; i < mesh.element_count; ++i)
+	{
+		const auto &desc = mesh.elements[i];
+		auto semantic_length = std::strlen(desc.SemanticName);
+		if (semantic_length >= max_semantic_length)
+		{
+			throw std::runtime_error("Mesh semantic name too long");
+		}
+		if (desc.InputSlot != 0 or desc.AlignedByteOffset == D3D11_APPEND_ALIGNED_ELEMENT)
+		{
+			throw std::runtime_error("Mesh layout must be a single slot with explicit offsets");
+		}
+
+		std::memcpy(elements[i].semantic_name, desc.SemanticName, semantic_length + 1);
+		elements[i].semantic_index = desc.SemanticIndex;
+		elements[i].format = desc.Format;
+		elements[i].offset = desc.AlignedByteOffset;
+	}
+
+	std::vector<lod> lods(mesh.lods.size());
+	auto index_offset = align_up(file_header.vertex_offset + uint64_t(mesh.vertex_stride) * mesh.vertex_count);
+	for (size_t i = 0; i < mesh.lods.size(); ++i)
+	{
+		lods[i].index_offset = index_offset;
+		lods[i].index_count = mesh.lods[i].index_count;
+		lods[i].switch_distance = mesh.lods[i].switch_distance;
+		index_offset = align_up(index_offset + uint64_t(index_size) * mesh.lods[i].index_count);
+	}
+
+	std::ofstream file(std::filesystem::path(file_name), std::ios::binary | std::ios::trunc);
+	if (not file)
+	{
+		throw std::runtime_error("Cannot create mesh file");
+	}
+
+	auto write_at = [&file](uint64_t offset, const void *data, size_t size)
+	{
+		// Zero padding up to the aligned offset
+		static constexpr char padding[mesh_format::blob_alignment]{};
+		auto position = static_cast<uint64_t>(file.tellp());
+		file.write(padding, static_cast<std::streamsize>(offset - position));
+		file.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+	};
+
+	write_at(0, &file_header, sizeof(file_header));
+	write_at(file_header.elements_offset, elements.data(), sizeof(element) * elements.size());
+	write_at(file_header.lods_offset, lods.data(), sizeof(lod) * lods.size());
+	write_at(file_header.vertex_offset, mesh.vertices, size_t(mesh.vertex_stride) * mesh.vertex_count);
+
+	for (size_t i = 0; i < mesh.lods.size(); ++i)
+	{
+		const auto &level = mesh.lods[i];
+		std::vector<uint8_t> level_indices(size_t(level.index_count) * index_size);
+		index_codec::write_indices(level.indices, level.index_count, index_size, level_indices.data());
+		write_at(lods[i].index_offset, level_indices.data(), level_indices.size());
+	}
+
+	if (not file)
+	{
+		throw std::runtime_error("Cannot write mesh file");
+	}
+}
+
+#pragma endregion
+
+#pragma region "Mesh File"
+
+mesh_file::mesh_file(std::wstring_view file_name) :
+	file(file_name)
+{
+	validate();
+}
+
+mesh_file::~mesh_file()
+{}
+
+void mesh_file::validate()
+{
+	auto file_size = static_cast<uint64_t>(file.size());
+	auto in_file = [file_size](uint64_t offset, uint64_t size)
+	{
+		return offset <= file_size and size <= file_size - offset;
+	};
+
+	if (file_size < sizeof(header))
+	{
+		throw std::runtime_error("Mesh file truncated");
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	if (header.magic != mesh_format::magic)
+	{
+		throw std::runtime_error("Not a mesh file");
+	}
+	// Newer minor versions only append to the header, which we can skip
+	if (header.version_major != mesh_format::version_major or header.header_size < sizeof(header))
+	{
+		throw std::runtime_error("Unsupported mesh file version");
+	}
+	if (header.index_format != DXGI_FORMAT_R16_UINT and header.index_format != DXGI_FORMAT_R32_UINT)
+	{
+		throw std::runtime_error("Unsupported mesh index format");
+	}
+	if (header.element_count == 0 or header.element_count > mesh_format::max_elements
+	    or header.lod_count == 0 or header.lod_count > mesh_format::max_lods)
+	{
+		throw std::runtime_error("Mesh file counts out of range");
+	}
+
+	if (not is_aligned(header.elements_offset) or not is_aligned(header.lods_offset) or not is_aligned(header.vertex_offset)
+	    or not in_file(header.elements_offset, uint64_t(sizeof(mesh_format::element)) * header.element_count)
+	    or not in_file(header.lods_offset, uint64_t(sizeof(mesh_format::lod)) * header.lod_count)
+	    or not in_file(header.vertex_offset, uint64_t(header.vertex_stride) * header.vertex_count))
+	{
+		throw std::runtime_error("Mesh file blob out of range");
+	}
+
+	elements = reinterpret_cast<const mesh_format::element *>(file.data() + header.elements_offset);
+	lods = reinterpret_cast<const mesh_format::lod *>(file.data() + header.lods_offset);
+
+	for (uint32_t i = 0; i < header.element_count; ++i)
+	{
+		const auto &name = elements[i].semantic_name;
+		if (std::find(std::begin(name), std::end(name), '\0') == std::end(name))
+		{
+			throw std::runtime_error("Mesh semantic name not terminated");
+		}
+	}
+
+	for (uint32_t i = 0; i < header.lod_count; ++i)
+	{
+		if (not is_aligned(lods[i].index_offset)
+		    or not in_file(lods[i].index_offset, uint64_t(get_index_size()) * lods[i].index_count))
+		{
+			throw std::runtime_error("Mesh file blob out of range");
+		}
+	}
+}
+
+const mesh_format::header &mesh_file::get_header() const
+{
+	return header;
+}
+
+const mesh_format::element *mesh_file::get_elements() const
+{
+	return elements;
+}
+
+const void *mesh_file::get_vertex_data() const
+{
+	return file.data() + header.vertex_offset;
+}
+
+uint32_t mesh_file::get_vertex_stride() const
+{
+	return header.vertex_stride;
+}
+
+uint32_t mesh_file::get_vertex_count() const
+{
+	return header.vertex_count;
+}
+
+uint32_t mesh_file::get_lod_count() const
+{
+	return header.lod_count;
+}
+
+const mesh_format::lod &mesh_file::get_lod(uint32_t level) const
+{
+	return lods[std::min(level, header.lod_count - 1)];
+}
+
+const void *mesh_file::get_index_data(uint32_t level) const
+{
+	return file.data() + get_lod(level).index_offset;
+}
+
+uint32_t mesh_file::get_index_size() const
+{
+	return (header.index_format == DXGI_FORMAT_R16_UINT) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+#pragma endregion
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <d3d11_1.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Binary mesh container, little endian:
+	//   header | layout elements | lod table | vertex blob | index blob per lod
+	// Every table and blob starts on a blob_alignment boundary, so a mapped
+	// file can hand its blobs to CreateBuffer without a copy.
+	namespace mesh_format
+	{
+		constexpr uint32_t magic = 0x4853454d; // "MESH"
+		constexpr uint16_t version_major = 1;  // bumped on incompatible changes
+		constexpr uint16_t version_minor = 0;  // bumped when fields are appended to header
+		constexpr uint32_t blob_alignment = 16;
+		constexpr uint32_t max_semantic_length = 16;
+		constexpr uint32_t max_elements = 16;
+		constexpr uint32_t max_lods = 8;
+
+		struct header
+		{
+			uint32_t magic;
+			uint16_t version_major;
+			uint16_t version_minor;
+			uint32_t header_size;
+
+			uint32_t element_count;
+			uint32_t vertex_stride;
+			uint32_t vertex_count;
+			uint32_t index_format; // DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+			uint32_t lod_count;
+
+			std::array<float, 3> bounds_min;
+			std::array<float, 3> bounds_max;
+
+			uint64_t elements_offset;
+			uint64_t lods_offset;
+			uint64_t vertex_offset;
+		};
+		static_assert(sizeof(header) == 80, "mesh_format::header layout changed");
+
+		struct element
+		{
+			char semantic_name[max_semantic_length]; // null terminated
+			uint32_t semantic_index;
+			uint32_t format;
+			uint32_t offset;
+			uint32_t reserved;
+		};
+		static_assert(sizeof(element) == 32, "mesh_format::element layout changed");
+
+		// Level 0 is the full detail mesh, all levels share the vertex blob
+		struct lod
+		{
+			uint64_t index_offset;
+			uint32_t index_count;
+			float switch_distance;
+		};
+		static_assert(sizeof(lod) == 16, "mesh_format::lod layout changed");
+
+		struct lod_source
+		{
+			const uint32_t *indices;
+			uint32_t index_count;
+			float switch_distance;
+		};
+
+		struct source
+		{
+			const void *vertices;
+			uint32_t vertex_stride;
+			uint32_t vertex_count;
+			const D3D11_INPUT_ELEMENT_DESC *elements;
+			uint32_t element_count;
+			std::vector<lod_source> lods;
+		};
+
+		// Offline conversion. Indices are stored 16 bit when every level fits,
+		// bounds come from the POSITION element.
+		void write(std::wstring_view file_name, const source &mesh);
+
+		template <typename vertex_t>
+		void write(std::wstring_view file_name, const std::vector<vertex_t> &vertices, const std::vector<lod_source> &lods)
+		{
+			using layout = typename vertex_t::layout;
+			write(file_name, source{ vertices.data(),
+			                         sizeof(vertex_t),
+			                         static_cast<uint32_t>(vertices.size()),
+			                         layout::elements.data(),
+			                         layout::element_count,
+			                         lods });
+		}
+	}
+
+	// Mesh container mapped read-only and validated on open. Vertex and index
+	// pointers point into the mapping and live as long as the mesh_file.
+	class mesh_file
+	{
+	public:
+		mesh_file() = delete;
+		mesh_file(std::wstring_view file_name);
+		~mesh_file();
+
+		mesh_file(const mesh_file &) = delete;
+		mesh_file &operator=(const mesh_file &) = delete;
+
+		const mesh_format::header &get_header() const;
+		const mesh_format::element *get_elements() const;
+
+		const void *get_vertex_data() const;
+		uint32_t get_vertex_stride() const;
+		uint32_t get_vertex_count() const;
+
+		uint32_t get_lod_count() const;
+		const mesh_format::lod &get_lod(uint32_t level) const;
+		const void *get_index_data(uint32_t level) const;
+		uint32_t get_index_size() const;
+
+		// True when the file's vertices can be drawn with a compile time vertex_layout
+		template <typename layout_t>
+		bool matches_layout() const
+		{
+			if (header.element_count != layout_t::element_count or header.vertex_stride != layout_t::vertex_stride)
+			{
+				return false;
+			}
+
+			for (uint32_t i = 0; i < layout_t::element_count; ++i)
+			{
+				const auto &stored = elements[i];
+				const auto &expected = layout_t::elements[i];
+				if (std::strcmp(stored.semantic_name, expected.SemanticName) != 0
+				    or stored.semantic_index != expected.SemanticIndex
+				    or stored.format != static_cast<uint32_t>(expected.Format)
+				    or stored.offset != expected.AlignedByteOffset)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		void validate();
+
+	private:
+		mapped_file file;
+
+		mesh_format::header header{};
+		const mesh_format::element *elements = nullptr;
+		const mesh_format::lod *lods = nullptr;
+	};
+}
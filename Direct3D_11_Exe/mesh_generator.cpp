@@ -0,0 +1,303 @@
+#include "mesh_generator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+using namespace direct3d_11_eg;
+using namespace DirectX;
+
+namespace
+{
+	using mesh_output_t = mesh_generator::mesh_output;
+
+	// Below this many vertices per worker a thread costs more than it saves
+	constexpr uint32_t min_vertices_per_worker = 16 * 1024;
+
+	uint32_t worker_count(uint32_t requested, uint64_t vertex_count)
+	{
+		auto available = requested ? requested : std::max(1U, std::thread::hardware_concurrency());
+		auto useful = static_cast<uint32_t>(std::max<uint64_t>(1, vertex_count / min_vertices_per_worker));
+		return std::min(available, useful);
+	}
+
+	// Calls work(first_row, last_row) over contiguous row ranges, the
+	// calling thread takes the first range itself
+	template <typename work_t>
+	void parallel_rows(uint32_t row_count, uint32_t thread_count, const work_t &work)
+	{
+		thread_count = std::max(1U, std::min(thread_count, row_count));
+		auto rows_per_worker = (row_count + thread_count - 1) / thread_count;
+
+		std::vector<std::thread> workers;
+		workers.reserve(thread_count - 1);
+		for (uint32_t first = rows_per_worker; first < row_count; first += rows_per_worker)
+		{
+			auto last = std::min(row_count, first + rows_per_worker);
+			workers.emplace_back([&work, first, last]()
+			{
+				work(first, last);
+			});
+		}
+
+		work(0, std::min(row_count, rows_per_worker));
+
+		for (auto &worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	// sin (x) and cos (y) of start + i * step for i in [0, count], four angles
+	// per SIMD call. Closed rings repeat the first entry so seams weld exactly.
+	std::vector<XMFLOAT2> make_sin_cos_table(uint32_t count, float start, float step, bool closed)
+	{
+		std::vector<XMFLOAT2> table(count + 1);
+
+		const XMVECTOR lane_offsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+		for (uint32_t i = 0; i <= count; i += 4)
+		{
+			auto angles = XMVectorMultiplyAdd(XMVectorAdd(XMVectorReplicate(static_cast<float>(i)), lane_offsets),
+			                                  XMVectorReplicate(step),
+			                                  XMVectorReplicate(start));
+			XMVECTOR sines, cosines;
+			XMVectorSinCos(&sines, &cosines, angles);
+
+			XMFLOAT4A sin_lanes, cos_lanes;
+			XMStoreFloat4A(&sin_lanes, sines);
+			XMStoreFloat4A(&cos_lanes, cosines);
+
+			auto lanes = std::min(4U, count + 1 - i);
+			for (uint32_t lane = 0; lane < lanes; ++lane)
+			{
+				table[i + lane] = { (&sin_lanes.x)[lane], (&cos_lanes.x)[lane] };
+			}
+		}
+
+		if (closed)
+		{
+			table[count] = table[0];
+		}
+		return table;
+	}
+
+	// A (columns + 1) x (rows + 1) vertex patch, evaluate(column, row, position, normal)
+	// gives each vertex. Texcoords run 0 to 1 across the patch.
+	template <typename evaluate_t>
+	void fill_patch_vertices(const mesh_output_t &output, uint32_t first_vertex, uint32_t columns, uint32_t rows, uint32_t first_row, uint32_t last_row, const evaluate_t &evaluate)
+	{
+		const float du = 1.0f / columns,
+		            dv = 1.0f / rows;
+
+		for (uint32_t row = first_row; row < last_row; ++row)
+		{
+			auto vertex = first_vertex + row * (columns + 1);
+			for (uint32_t column = 0; column <= columns; ++column, ++vertex)
+			{
+				XMVECTOR position, normal;
+				evaluate(column, row, position, normal);
+
+				XMStoreFloat3(&output.positions[vertex], position);
+				if (output.normals)
+				{
+					XMStoreFloat3(&output.normals[vertex], normal);
+				}
+				if (output.texcoords)
+				{
+					output.texcoords[vertex] = { column * du, row * dv };
+				}
+			}
+		}
+	}
+
+	// Two clockwise triangles per quad of a patch, for quad rows [first_row, last_row)
+	void fill_patch_indices(const mesh_output_t &output, uint32_t first_index, uint32_t first_vertex, uint32_t columns, uint32_t first_row, uint32_t last_row)
+	{
+		auto *indices = output.indices + first_index + first_row * columns * 6;
+		auto base = output.base_vertex + first_vertex;
+
+		for (uint32_t row = first_row; row < last_row; ++row)
+		{
+			for (uint32_t column = 0; column < columns; ++column)
+			{
+				auto a = base + row * (columns + 1) + column,
+				     b = a + 1,
+				     c = a + columns + 1,
+				     d = c + 1;
+
+				*indices++ = a; *indices++ = b; *indices++ = c;
+				*indices++ = b; *indices++ = d; *indices++ = c;
+			}
+		}
+	}
+
+	mesh_generator::mesh_size patch_size(uint32_t columns, uint32_t rows)
+	{
+		assert(columns > 0 and rows > 0);
+		assert(uint64_t(columns + 1) * (rows + 1) <= UINT32_MAX);
+
+		return { (columns + 1) * (rows + 1), columns * rows * 6 };
+	}
+
+	// Fills vertices and indices of a patch, parallel over vertex rows
+	template <typename evaluate_t>
+	void make_patch(const mesh_output_t &output, uint32_t first_vertex, uint32_t first_index, uint32_t columns, uint32_t rows, uint32_t thread_count, const evaluate_t &evaluate)
+	{
+		auto threads = worker_count(thread_count, uint64_t(columns + 1) * (rows + 1));
+		parallel_rows(rows + 1, threads, [&](uint32_t first_row, uint32_t last_row)
+		{
+			fill_patch_vertices(output, first_vertex, columns, rows, first_row, last_row, evaluate);
+			fill_patch_indices(output, first_index, first_vertex, columns, first_row, std::min(last_row, rows));
+		});
+	}
+}
+
+mesh_generator::mesh_size mesh_generator::grid_size(uint32_t columns, uint32_t rows)
+{
+	return patch_size(columns, rows);
+}
+
+void mesh_generator::make_grid(const mesh_output &output, float width, float depth, uint32_t columns, uint32_t rows, uint32_t thread_count)
+{
+	// Rows run towards -Z to keep the winding clockwise from above
+	const XMVECTOR origin = XMVectorSet(-0.5f * width, 0.0f, 0.5f * depth, 0.0f);
+	const XMVECTOR step = XMVectorSet(width / columns, 0.0f, -depth / rows, 0.0f);
+	const XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	make_patch(output, 0, 0, columns, rows, thread_count, [&](uint32_t column, uint32_t row, XMVECTOR &position, XMVECTOR &normal)
+	{
+		position = XMVectorMultiplyAdd(XMVectorSet(static_cast<float>(column), 0.0f, static_cast<float>(row), 0.0f), step, origin);
+		normal = up;
+	});
+}
+
+mesh_generator::mesh_size mesh_generator::heightfield_size(uint32_t columns, uint32_t rows)
+{
+	return patch_size(columns, rows);
+}
+
+void mesh_generator::make_heightfield(const mesh_output &output, const float *heights, float width, float depth, float height_scale, uint32_t columns, uint32_t rows, uint32_t thread_count)
+{
+	const XMVECTOR origin = XMVectorSet(-0.5f * width, 0.0f, 0.5f * depth, 0.0f);
+	const XMVECTOR step = XMVectorSet(width / columns, height_scale, -depth / rows, 0.0f);
+	const float dx = width / columns,
+	            dz = -depth / rows;
+
+	auto height = [&](uint32_t column, uint32_t row)
+	{
+		return heights[row * (columns + 1) + column] * height_scale;
+	};
+
+	make_patch(output, 0, 0, columns, rows, thread_count, [&](uint32_t column, uint32_t row, XMVECTOR &position, XMVECTOR &normal)
+	{
+		position = XMVectorMultiplyAdd(XMVectorSet(static_cast<float>(column), heights[row * (columns + 1) + column], static_cast<float>(row), 0.0f), step, origin);
+
+		// Central differences, one sided on the borders
+		auto left = column > 0 ? column - 1 : column,
+		     right = column < columns ? column + 1 : column,
+		     near_row = row > 0 ? row - 1 : row,
+		     far_row = row < rows ? row + 1 : row;
+
+		auto slope_x = (height(right, row) - height(left, row)) / ((right - left) * dx),
+		     slope_z = (height(column, far_row) - height(column, near_row)) / ((far_row - near_row) * dz);
+
+		normal = XMVector3Normalize(XMVectorSet(-slope_x, 1.0f, -slope_z, 0.0f));
+	});
+}
+
+mesh_generator::mesh_size mesh_generator::sphere_size(uint32_t slices, uint32_t stacks)
+{
+	return patch_size(slices, stacks);
+}
+
+void mesh_generator::make_sphere(const mesh_output &output, float radius, uint32_t slices, uint32_t stacks, uint32_t thread_count)
+{
+	// Columns go round the Y axis, rows from the north pole down
+	auto azimuth = make_sin_cos_table(slices, 0.0f, XM_2PI / slices, true);
+	auto polar = make_sin_cos_table(stacks, 0.0f, XM_PI / stacks, false);
+	polar[stacks] = { 0.0f, -1.0f }; // exact south pole, pole quads collapse to zero area
+	const XMVECTOR scale = XMVectorReplicate(radius);
+
+	make_patch(output, 0, 0, slices, stacks, thread_count, [&](uint32_t column, uint32_t row, XMVECTOR &position, XMVECTOR &normal)
+	{
+		auto ring = polar[row].x;
+		normal = XMVectorSet(ring * azimuth[column].y, polar[row].y, ring * azimuth[column].x, 0.0f);
+		position = XMVectorMultiply(normal, scale);
+	});
+}
+
+mesh_generator::mesh_size mesh_generator::cylinder_size(uint32_t slices, uint32_t stacks)
+{
+	auto side = patch_size(slices, stacks);
+
+	// Each cap is a centre vertex and its own rim, for flat normals
+	return { side.vertex_count + 2 * (slices + 2), side.index_count + 2 * slices * 3 };
+}
+
+void mesh_generator::make_cylinder(const mesh_output &output, float radius, float height, uint32_t slices, uint32_t stacks, uint32_t thread_count)
+{
+	auto azimuth = make_sin_cos_table(slices, 0.0f, XM_2PI / slices, true);
+	const float top = 0.5f * height,
+	            dy = height / stacks;
+
+	make_patch(output, 0, 0, slices, stacks, thread_count, [&](uint32_t column, uint32_t row, XMVECTOR &position, XMVECTOR &normal)
+	{
+		normal = XMVectorSet(azimuth[column].y, 0.0f, azimuth[column].x, 0.0f);
+		position = XMVectorSetY(XMVectorScale(normal, radius), top - row * dy);
+	});
+
+	// Caps are O(slices), not worth spreading over threads
+	auto side = patch_size(slices, stacks);
+	auto vertex = side.vertex_count;
+	auto *indices = output.indices + side.index_count;
+
+	for (auto cap_y : { top, -top })
+	{
+		auto centre = vertex;
+		auto facing = cap_y > 0.0f ? 1.0f : -1.0f;
+
+		for (uint32_t i = 0; i <= slices + 1; ++i, ++vertex)
+		{
+			// First vertex is the centre, then the rim
+			auto sin_cos = (i == 0) ? XMFLOAT2{ 0.0f, 0.0f } : azimuth[i - 1];
+			output.positions[vertex] = { radius * sin_cos.y, cap_y, radius * sin_cos.x };
+			if (output.normals)
+			{
+				output.normals[vertex] = { 0.0f, facing, 0.0f };
+			}
+			if (output.texcoords)
+			{
+				output.texcoords[vertex] = { 0.5f + 0.5f * sin_cos.y, 0.5f + 0.5f * sin_cos.x };
+			}
+		}
+
+		auto base = output.base_vertex + centre;
+		for (uint32_t i = 0; i < slices; ++i)
+		{
+			auto rim = base + 1 + i;
+			*indices++ = base;
+			*indices++ = (facing > 0.0f) ? rim + 1 : rim;
+			*indices++ = (facing > 0.0f) ? rim : rim + 1;
+		}
+	}
+}
+
+mesh_generator::mesh_size mesh_generator::torus_size(uint32_t major_segments, uint32_t minor_segments)
+{
+	return patch_size(major_segments, minor_segments);
+}
+
+void mesh_generator::make_torus(const mesh_output &output, float major_radius, float minor_radius, uint32_t major_segments, uint32_t minor_segments, uint32_t thread_count)
+{
+	// Minor angle runs backwards so the winding faces outwards
+	auto major = make_sin_cos_table(major_segments, 0.0f, XM_2PI / major_segments, true);
+	auto minor = make_sin_cos_table(minor_segments, 0.0f, -XM_2PI / minor_segments, true);
+
+	make_patch(output, 0, 0, major_segments, minor_segments, thread_count, [&](uint32_t column, uint32_t row, XMVECTOR &position, XMVECTOR &normal)
+	{
+		auto around = XMVectorSet(major[column].y, 0.0f, major[column].x, 0.0f);
+		normal = XMVectorSetY(XMVectorScale(around, minor[row].y), minor[row].x);
+		position = XMVectorMultiplyAdd(normal, XMVectorReplicate(minor_radius), XMVectorScale(around, major_radius));
+	});
+}
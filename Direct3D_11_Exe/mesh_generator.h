@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+namespace direct3d_11_eg
+{
+	// Procedural geometry written straight into caller owned streams.
+	// Size the streams with the matching *_size function first, every
+	// shape is generated in parallel rows with SIMD trig tables.
+	// Triangles are clockwise when seen from outside, as the pipeline expects.
+	namespace mesh_generator
+	{
+		struct mesh_size
+		{
+			uint32_t vertex_count;
+			uint32_t index_count;
+		};
+
+		// normals and texcoords may be null, indices are offset by base_vertex
+		// so a shape can be generated directly into a shared or pooled buffer
+		struct mesh_output
+		{
+			DirectX::XMFLOAT3 *positions;
+			DirectX::XMFLOAT3 *normals;
+			DirectX::XMFLOAT2 *texcoords;
+			uint32_t *indices;
+			uint32_t base_vertex;
+		};
+
+		// thread_count of 0 uses every hardware thread, small meshes stay on the caller's thread
+
+		// XZ plane centred on the origin, facing +Y
+		mesh_size grid_size(uint32_t columns, uint32_t rows);
+		void make_grid(const mesh_output &output, float width, float depth, uint32_t columns, uint32_t rows, uint32_t thread_count = 0);
+
+		// Grid displaced by (columns + 1) * (rows + 1) heights, row major
+		mesh_size heightfield_size(uint32_t columns, uint32_t rows);
+		void make_heightfield(const mesh_output &output, const float *heights, float width, float depth, float height_scale, uint32_t columns, uint32_t rows, uint32_t thread_count = 0);
+
+		// UV sphere, poles on the Y axis
+		mesh_size sphere_size(uint32_t slices, uint32_t stacks);
+		void make_sphere(const mesh_output &output, float radius, uint32_t slices, uint32_t stacks, uint32_t thread_count = 0);
+
+		// Capped cylinder along the Y axis
+		mesh_size cylinder_size(uint32_t slices, uint32_t stacks);
+		void make_cylinder(const mesh_output &output, float radius, float height, uint32_t slices, uint32_t stacks, uint32_t thread_count = 0);
+
+		// Torus around the Y axis
+		mesh_size torus_size(uint32_t major_segments, uint32_t minor_segments);
+		void make_torus(const mesh_output &output, float major_radius, float minor_radius, uint32_t major_segments, uint32_t minor_segments, uint32_t thread_count = 0);
+	}
+}
@@ -0,0 +1,504 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <thread>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	constexpr uint32_t invalid_index = UINT32_MAX;
+
+	// Triangle count past which vertex cache optimisation is split across threads,
+	// chunks are large enough that the seams cost next to nothing in ACMR
+	constexpr size_t parallel_chunk_triangles = 64 * 1024;
+
+	// Overdraw clusters, minimum size keeps most of the vertex cache locality
+	constexpr size_t min_cluster_triangles = 64;
+
+	// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+	constexpr uint32_t forsyth_cache_size = 32;
+	constexpr float cache_decay_power = 1.5f;
+	constexpr float last_triangle_score = 0.75f;
+	constexpr float valence_boost_scale = 2.0f;
+	constexpr float valence_boost_power = 0.5f;
+
+	struct score_tables
+	{
+		std::array<float, forsyth_cache_size> cache_scores{};
+		std::array<float, 64> valence_scores{};
+
+		score_tables()
+		{
+			for (uint32_t i = 0; i < forsyth_cache_size; ++i)
+			{
+				if (i < 3)
+				{
+					cache_scores[i] = last_triangle_score;
+				}
+				else
+				{
+					auto scaler = 1.0f / (forsyth_cache_size - 3);
+					cache_scores[i] = std::pow(1.0f - (i - 3) * scaler, cache_decay_power);
+				}
+			}
+
+			for (uint32_t i = 1; i < valence_scores.size(); ++i)
+			{
+				valence_scores[i] = valence_boost_scale * std::pow(static_cast<float>(i), -valence_boost_power);
+			}
+		}
+
+		float vertex_score(int32_t cache_position, uint32_t active_triangles) const
+		{
+			if (active_triangles == 0)
+			{
+				return -1.0f;
+			}
+
+			auto score = (cache_position < 0) ? 0.0f : cache_scores[cache_position];
+
+			if (active_triangles < valence_scores.size())
+			{
+				return score + valence_scores[active_triangles];
+			}
+
+			return score + valence_boost_scale * std::pow(static_cast<float>(active_triangles), -valence_boost_power);
+		}
+	};
+
+	const score_tables &get_score_tables()
+	{
+		static const score_tables tables{};
+		return tables;
+	}
+
+	// Optimises triangles [0, triangle_count) of indices in place.
+	// Vertex indices are used as is, so vertex_count is the range they fall in.
+	void forsyth_optimize(uint32_t *indices, size_t triangle_count, uint32_t vertex_count)
+	{
+		const auto &tables = get_score_tables();
+
+		struct vertex_state
+		{
+			float score;
+			uint32_t active_triangles;
+			uint32_t first_triangle; // into triangle_lists
+			int32_t cache_position;
+		};
+
+		std::vector<vertex_state> vertices(vertex_count, { 0.0f, 0, 0, -1 });
+
+		for (size_t i = 0; i < triangle_count * 3; ++i)
+		{
+			vertices[indices[i]].active_triangles++;
+		}
+
+		uint32_t running_offset = 0;
+		for (auto &v : vertices)
+		{
+			v.first_triangle = running_offset;
+			running_offset += v.active_triangles;
+		}
+
+		// Per vertex lists of adjacent triangles, the first active_triangles entries are live
+		std::vector<uint32_t> triangle_lists(running_offset);
+		{
+			std::vector<uint32_t> fill(vertex_count, 0);
+			for (size_t t = 0; t < triangle_count; ++t)
+			{
+				for (size_t c = 0; c < 3; ++c)
+				{
+					auto v = indices[t * 3 + c];
+					triangle_lists[vertices[v].first_triangle + fill[v]++] = static_cast<uint32_t>(t);
+				}
+			}
+		}
+
+		for (auto &v : vertices)
+		{
+			v.score = tables.vertex_score(v.cache_position, v.active_triangles);
+		}
+
+		std::vector<float> triangle_scores(triangle_count);
+		std::vector<bool> is_emitted(triangle_count, false);
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			triangle_scores[t] = vertices[indices[t * 3]].score
+			                   + vertices[indices[t * 3 + 1]].score
+			                   + vertices[indices[t * 3 + 2]].score;
+		}
+
+		std::vector<uint32_t> output(triangle_count * 3);
+
+		std::array<uint32_t, forsyth_cache_size + 3> cache{}, next_cache{};
+		uint32_t cache_count = 0;
+
+		auto best_triangle = static_cast<uint32_t>(std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin());
+		size_t scan_position = 0;
+
+		for (size_t emitted = 0; emitted < triangle_count; ++emitted)
+		{
+			if (best_triangle == invalid_index)
+			{
+				// Cache ran dry, continue with the next triangle not yet emitted
+				while (is_emitted[scan_position])
+				{
+					scan_position++;
+				}
+				best_triangle = static_cast<uint32_t>(scan_position);
+			}
+
+			is_emitted[best_triangle] = true;
+
+			uint32_t next_count = 0;
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				auto v = indices[best_triangle * 3 + c];
+				output[emitted * 3 + c] = v;
+				next_cache[next_count++] = v;
+
+				// Swap-remove the triangle from the vertex's live list
+				auto &state = vertices[v];
+				auto list = &triangle_lists[state.first_triangle];
+				auto position = std::find(list, list + state.active_triangles, best_triangle);
+				assert(position != list + state.active_triangles);
+				std::swap(*position, list[state.active_triangles - 1]);
+				state.active_triangles--;
+			}
+
+			// Emitted triangle's vertices go to the front of the LRU cache
+			for (uint32_t i = 0; i < cache_count; ++i)
+			{
+				auto v = cache[i];
+				if (v != next_cache[0] and v != next_cache[1] and v != next_cache[2])
+				{
+					next_cache[next_count++] = v;
+				}
+			}
+
+			std::swap(cache, next_cache);
+			cache_count = next_count;
+
+			// Rescore everything that was touched, including vertices just pushed out of the cache
+			for (uint32_t i = 0; i < cache_count; ++i)
+			{
+				auto &state = vertices[cache[i]];
+				state.cache_position = (i < forsyth_cache_size) ? static_cast<int32_t>(i) : -1;
+				state.score = tables.vertex_score(state.cache_position, state.active_triangles);
+			}
+
+			auto best_score = -1.0f;
+			best_triangle = invalid_index;
+
+			for (uint32_t i = 0; i < cache_count; ++i)
+			{
+				auto &state = vertices[cache[i]];
+				auto list = &triangle_lists[state.first_triangle];
+				for (uint32_t j = 0; j < state.active_triangles; ++j)
+				{
+					auto t = list[j];
+					auto score = vertices[indices[t * 3]].score
+					           + vertices[indices[t * 3 + 1]].score
+					           + vertices[indices[t * 3 + 2]].score;
+					triangle_scores[t] = score;
+
+					if (score > best_score)
+					{
+						best_score = score;
+						best_triangle = t;
+					}
+				}
+			}
+
+			cache_count = std::min(cache_count, forsyth_cache_size);
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	// Renumbers the chunk's vertices to [0, referenced count) around forsyth_optimize,
+	// so its per vertex state is sized to the chunk rather than the whole mesh.
+	// global_to_local holds invalid_index for every mesh vertex and is left that way.
+	void forsyth_optimize_chunk(uint32_t *indices, size_t triangle_count, std::vector<uint32_t> &global_to_local, std::vector<uint32_t> &local_to_global)
+	{
+		local_to_global.clear();
+		for (size_t i = 0; i < triangle_count * 3; ++i)
+		{
+			auto &local = global_to_local[indices[i]];
+			if (local == invalid_index)
+			{
+				local = static_cast<uint32_t>(local_to_global.size());
+				local_to_global.push_back(indices[i]);
+			}
+			indices[i] = local;
+		}
+
+		forsyth_optimize(indices, triangle_count, static_cast<uint32_t>(local_to_global.size()));
+
+		for (size_t i = 0; i < triangle_count * 3; ++i)
+		{
+			indices[i] = local_to_global[indices[i]];
+		}
+
+		for (auto v : local_to_global)
+		{
+			global_to_local[v] = invalid_index;
+		}
+	}
+
+	uint32_t worker_count()
+	{
+		return std::max(1U, std::thread::hardware_concurrency());
+	}
+}
+
+mesh_optimizer::cache_statistics mesh_optimizer::analyze_vertex_cache(const std::vector<uint32_t> &indices, uint32_t vertex_count, uint32_t cache_size)
+{
+	if (indices.empty() or vertex_count == 0)
+	{
+		return { 0.0f, 0.0f };
+	}
+
+	// FIFO cache, a vertex is resident if it entered within the last cache_size misses
+	std::vector<uint32_t> entered_at(vertex_count, 0);
+	std::vector<bool> is_referenced(vertex_count, false);
+	uint32_t misses = 0, referenced = 0;
+
+	for (auto v : indices)
+	{
+		if (not is_referenced[v])
+		{
+			is_referenced[v] = true;
+			referenced++;
+		}
+
+		if (entered_at[v] == 0 or misses - entered_at[v] + 1 > cache_size)
+		{
+			misses++;
+			entered_at[v] = misses;
+		}
+	}
+
+	return {
+		static_cast<float>(misses) / (indices.size() / 3),
+		static_cast<float>(misses) / referenced
+	};
+}
+
+void mesh_optimizer::optimize_vertex_cache(std::vector<uint32_t> &indices, uint32_t vertex_count)
+{
+	auto triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	auto chunk_count = (triangle_count + parallel_chunk_triangles - 1) / parallel_chunk_triangles;
+	if (chunk_count == 1)
+	{
+		forsyth_optimize(indices.data(), triangle_count, vertex_count);
+		return;
+	}
+
+	// Group triangles by their lowest vertex index first, so each chunk covers
+	// a coherent range of vertices even if the input order was scattered
+	{
+		std::vector<uint32_t> bucket_offsets(vertex_count + 1, 0);
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			auto lowest = std::min({ indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] });
+			bucket_offsets[lowest + 1]++;
+		}
+
+		for (uint32_t v = 0; v < vertex_count; ++v)
+		{
+			bucket_offsets[v + 1] += bucket_offsets[v];
+		}
+
+		std::vector<uint32_t> grouped_indices(indices.size());
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			auto lowest = std::min({ indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] });
+			auto destination = bucket_offsets[lowest]++;
+			std::copy_n(indices.begin() + t * 3, 3, grouped_indices.begin() + destination * 3);
+		}
+
+		indices.swap(grouped_indices);
+	}
+
+	// Chunks are independent, hand them out round robin to the workers
+	auto thread_count = std::min<size_t>(worker_count(), chunk_count);
+	std::vector<std::thread> workers;
+	workers.reserve(thread_count);
+
+	for (size_t w = 0; w < thread_count; ++w)
+	{
+		workers.emplace_back([&, w]()
+		{
+			// One lookup per worker, each chunk only resets the entries it used
+			std::vector<uint32_t> global_to_local(vertex_count, invalid_index), local_to_global;
+			local_to_global.reserve(parallel_chunk_triangles * 3);
+
+			for (auto chunk = w; chunk < chunk_count; chunk += thread_count)
+			{
+				auto first = chunk * parallel_chunk_triangles;
+				auto count = std::min(parallel_chunk_triangles, triangle_count - first);
+				forsyth_optimize_chunk(indices.data() + first * 3, count, global_to_local, local_to_global);
+			}
+		});
+	}
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void mesh_optimizer::optimize_overdraw(std::vector<uint32_t> &indices, const float *positions, size_t stride, uint32_t vertex_count)
+{
+	auto triangle_count = indices.size() / 3;
+	if (triangle_count <= min_cluster_triangles)
+	{
+		return;
+	}
+
+	auto get_position = [&](uint32_t v) -> const float *
+	{
+		assert(v < vertex_count);
+		return reinterpret_cast<const float *>(reinterpret_cast<const uint8_t *>(positions) + v * stride);
+	};
+
+	// Split into clusters where the simulated cache starts over,
+	// ie a triangle whose vertices all miss, once the cluster is big enough
+	std::vector<size_t> cluster_starts{ 0 };
+	{
+		std::vector<uint32_t> entered_at(vertex_count, 0);
+		uint32_t misses = 0;
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			uint32_t triangle_misses = 0;
+			for (size_t c = 0; c < 3; ++c)
+			{
+				auto v = indices[t * 3 + c];
+				if (entered_at[v] == 0 or misses - entered_at[v] + 1 > default_cache_size)
+				{
+					misses++;
+					triangle_misses++;
+					entered_at[v] = misses;
+				}
+			}
+
+			if (triangle_misses == 3 and t - cluster_starts.back() >= min_cluster_triangles)
+			{
+				cluster_starts.push_back(t);
+			}
+		}
+	}
+	cluster_starts.push_back(triangle_count);
+
+	if (cluster_starts.size() <= 2)
+	{
+		return;
+	}
+
+	// Mesh centroid, weighted by triangle
+	std::array<double, 3> mesh_center{};
+	for (auto v : indices)
+	{
+		auto p = get_position(v);
+		for (size_t a = 0; a < 3; ++a)
+		{
+			mesh_center[a] += p[a];
+		}
+	}
+	for (auto &c : mesh_center)
+	{
+		c /= static_cast<double>(indices.size());
+	}
+
+	// Clusters facing away from the centre are likely occluders, draw those first
+	struct cluster
+	{
+		size_t first_triangle;
+		size_t triangle_count;
+		float sort_value;
+	};
+
+	std::vector<cluster> clusters;
+	clusters.reserve(cluster_starts.size() - 1);
+
+	for (size_t i = 0; i + 1 < cluster_starts.size(); ++i)
+	{
+		std::array<double, 3> center{}, normal{};
+
+		for (auto t = cluster_starts[i]; t < cluster_starts[i + 1]; ++t)
+		{
+			auto p0 = get_position(indices[t * 3]),
+			     p1 = get_position(indices[t * 3 + 1]),
+			     p2 = get_position(indices[t * 3 + 2]);
+
+			std::array<double, 3> e1{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] },
+			                      e2{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+			// Area weighted normal
+			normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+			normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+			normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+
+			for (size_t a = 0; a < 3; ++a)
+			{
+				center[a] += (p0[a] + p1[a] + p2[a]) / 3.0;
+			}
+		}
+
+		auto count = cluster_starts[i + 1] - cluster_starts[i];
+		auto normal_length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		auto sort_value = 0.0;
+		if (normal_length > 0.0)
+		{
+			for (size_t a = 0; a < 3; ++a)
+			{
+				sort_value += (center[a] / count - mesh_center[a]) * normal[a] / normal_length;
+			}
+		}
+
+		clusters.push_back({ cluster_starts[i], count, static_cast<float>(sort_value) });
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const cluster &a, const cluster &b)
+	{
+		return a.sort_value > b.sort_value;
+	});
+
+	std::vector<uint32_t> sorted_indices;
+	sorted_indices.reserve(indices.size());
+	for (auto &c : clusters)
+	{
+		auto first = indices.begin() + c.first_triangle * 3;
+		sorted_indices.insert(sorted_indices.end(), first, first + c.triangle_count * 3);
+	}
+
+	indices.swap(sorted_indices);
+}
+
+std::vector<uint32_t> mesh_optimizer::make_fetch_remap(std::vector<uint32_t> &indices, uint32_t vertex_count, uint32_t &new_vertex_count)
+{
+	std::vector<uint32_t> remap(vertex_count, invalid_index);
+	new_vertex_count = 0;
+
+	for (auto &index : indices)
+	{
+		auto &new_index = remap[index];
+		if (new_index == invalid_index)
+		{
+			new_index = new_vertex_count++;
+		}
+		index = new_index;
+	}
+
+	return remap;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// CPU side reordering of indexed triangle lists for GPU efficiency.
+	//  * vertex cache: Forsyth's linear speed vertex cache optimisation
+	//  * overdraw: clusters of the cache optimised order sorted outside in (Sander et al.)
+	//  * vertex fetch: vertices renumbered in order of first use
+	namespace mesh_optimizer
+	{
+		// Post transform cache size assumed when reporting, typical of current hardware
+		constexpr uint32_t default_cache_size = 16;
+
+		struct cache_statistics
+		{
+			float acmr; // average cache miss ratio, transformed vertices per triangle
+			float atvr; // average transform to vertex ratio, 1.0 is ideal
+		};
+
+		struct report
+		{
+			cache_statistics before;
+			cache_statistics after;
+		};
+
+		cache_statistics analyze_vertex_cache(const std::vector<uint32_t> &indices, uint32_t vertex_count, uint32_t cache_size = default_cache_size);
+
+		// Meshes over 64k triangles (parallel_chunk_triangles) are split into chunks
+		// that are optimised independently on all available cores
+		void optimize_vertex_cache(std::vector<uint32_t> &indices, uint32_t vertex_count);
+
+		// Expects cache optimised input, keeps most of its locality while
+		// putting likely occluders first. positions are float3, stride bytes apart.
+		void optimize_overdraw(std::vector<uint32_t> &indices, const float *positions, size_t stride, uint32_t vertex_count);
+
+		// Returns new vertex index for each old vertex, or UINT32_MAX for unreferenced ones.
+		// Indices are rewritten, new vertex count is the number of referenced vertices.
+		std::vector<uint32_t> make_fetch_remap(std::vector<uint32_t> &indices, uint32_t vertex_count, uint32_t &new_vertex_count);
+
+		template <typename vertex_t>
+		void optimize_vertex_fetch(std::vector<vertex_t> &vertices, std::vector<uint32_t> &indices)
+		{
+			uint32_t new_vertex_count{};
+			auto remap = make_fetch_remap(indices, static_cast<uint32_t>(vertices.size()), new_vertex_count);
+
+			std::vector<vertex_t> remapped_vertices(new_vertex_count);
+			for (size_t i = 0; i < remap.size(); ++i)
+			{
+				if (remap[i] != UINT32_MAX)
+				{
+					remapped_vertices[remap[i]] = vertices[i];
+				}
+			}
+
+			vertices.swap(remapped_vertices);
+		}
+
+		// All three passes in order, vertex_t must have a float3 position member
+		template <typename vertex_t>
+		report optimize(std::vector<vertex_t> &vertices, std::vector<uint32_t> &indices)
+		{
+			auto vertex_count = static_cast<uint32_t>(vertices.size());
+
+			report result{};
+			result.before = analyze_vertex_cache(indices, vertex_count);
+
+			if (not vertices.empty())
+			{
+				optimize_vertex_cache(indices, vertex_count);
+				optimize_overdraw(indices, &vertices[0].position.x, sizeof(vertex_t), vertex_count);
+				optimize_vertex_fetch(vertices, indices);
+			}
+
+			result.after = analyze_vertex_cache(indices, static_cast<uint32_t>(vertices.size()));
+			return result;
+		}
+	}
+}
@@ -0,0 +1,231 @@
+#include "null_render_device.h"
+
+#include <cassert>
+
+using namespace direct3d_11_eg;
+
+null_render_device::null_render_device(bool record_commands) :
+	record_commands(record_commands)
+{}
+
+null_render_device::~null_render_device()
+{}
+
+render_device::pipeline_handle null_render_device::create_pipeline(const pipeline_description &description)
+{
+	assert(description.vertex_shader.data and description.pixel_shader.data);
+
+	count(&statistics::pipelines_created, 1U);
+
+	pipelines.push_back(true);
+	return static_cast<pipeline_handle>(pipelines.size() - 1);
+}
+
+void null_render_device::destroy_pipeline(pipeline_handle pipeline)
+{
+	assert(pipeline < pipelines.size() and pipelines[pipeline]);
+
+	pipelines[pipeline] = false;
+}
+
+render_device::mesh_handle null_render_device::create_mesh(const mesh_description &description)
+{
+	// Packed as a real backend would, so the upload size and cost match
+	auto indices = pack_indices(description);
+	auto vertex_bytes = uint64_t(description.vertex_stride) * description.vertex_count,
+	     index_bytes = uint64_t(indices.data.size());
+
+	count(&statistics::meshes_created, 1U);
+	count(&statistics::bytes_uploaded, vertex_bytes + index_bytes);
+
+	meshes.push_back({ indices.index_count, true });
+	return static_cast<mesh_handle>(meshes.size() - 1);
+}
+
+void null_render_device::destroy_mesh(mesh_handle mesh)
+{
+	assert(mesh < meshes.size() and meshes[mesh].is_alive);
+
+	if (current_mesh == mesh)
+	{
+		current_mesh = invalid_handle;
+	}
+	meshes[mesh].is_alive = false;
+}
+
+render_device::instance_stream_handle null_render_device::create_instance_stream(const instance_stream_description &description)
+{
+	assert(description.instance_stride > 0 and description.instance_stride % sizeof(instance_row) == 0);
+
+	count(&statistics::instance_streams_created, 1U);
+
+	instance_stream_entry stream{};
+	stream.rows.resize(size_t(description.instance_stride / sizeof(instance_row)) * description.max_instances);
+	stream.instance_stride = description.instance_stride;
+	stream.max_instances = description.max_instances;
+	stream.is_alive = true;
+
+	instance_streams.push_back(std::move(stream));
+	return static_cast<instance_stream_handle>(instance_streams.size() - 1);
+}
+
+void null_render_device::destroy_instance_stream(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream].is_alive);
+
+	if (current_instances == stream)
+	{
+		current_instances = invalid_handle;
+	}
+	instance_streams[stream] = {};
+}
+
+void *null_render_device::map_instances(instance_stream_handle stream, uint32_t instance_count)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream].is_alive);
+
+	auto &entry = instance_streams[stream];
+	assert(not entry.is_mapped and instance_count <= entry.max_instances);
+
+	entry.instance_count = instance_count;
+	entry.is_mapped = true;
+
+	count(&statistics::instance_updates, 1U);
+	count(&statistics::bytes_uploaded, uint64_t(entry.instance_stride) * instance_count);
+
+	return entry.rows.data();
+}
+
+void null_render_device::unmap_instances(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream].is_mapped);
+
+	instance_streams[stream].is_mapped = false;
+}
+
+void null_render_device::wait_for_frame()
+{}
+
+void null_render_device::begin_frame()
+{
+	commands.clear();
+}
+
+void null_render_device::end_frame()
+{
+	last_frame_stats = frame_stats;
+	frame_stats = {};
+	frame_count++;
+}
+
+void null_render_device::present()
+{
+	count(&statistics::presents, 1U);
+}
+
+void null_render_device::resize()
+{}
+
+void null_render_device::clear(const std::array<float, 4> &)
+{
+	count(&statistics::clears, 1U);
+	record(command_e::clear, 0, 0);
+}
+
+void null_render_device::set_pipeline(pipeline_handle pipeline)
+{
+	assert(pipeline < pipelines.size() and pipelines[pipeline]);
+
+	count(&statistics::pipeline_binds, 1U);
+	record(command_e::set_pipeline, pipeline, 0);
+}
+
+void null_render_device::set_mesh(mesh_handle mesh)
+{
+	assert(mesh < meshes.size() and meshes[mesh].is_alive);
+
+	current_mesh = mesh;
+
+	count(&statistics::mesh_binds, 1U);
+	record(command_e::set_mesh, mesh, 0);
+}
+
+void null_render_device::set_instances(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream].is_alive);
+
+	current_instances = stream;
+
+	count(&statistics::instance_binds, 1U);
+	record(command_e::set_instances, stream, instance_streams[stream].instance_count);
+}
+
+void null_render_device::set_constants(shader_stage_e, uint32_t slot, const void *data, uint32_t size)
+{
+	assert(data);
+
+	count(&statistics::constant_updates, 1U);
+	count(&statistics::bytes_uploaded, uint64_t(size));
+	record(command_e::set_constants, slot, size);
+}
+
+void null_render_device::draw()
+{
+	assert(current_mesh != invalid_handle);
+
+	count(&statistics::draw_calls, 1U);
+	count(&statistics::instances_drawn, uint64_t(1));
+	count(&statistics::indices_drawn, uint64_t(meshes[current_mesh].index_count));
+	record(command_e::draw, current_mesh, 1);
+}
+
+void null_render_device::draw_instanced(uint32_t instance_count)
+{
+	assert(current_mesh != invalid_handle);
+	assert(current_instances == invalid_handle or instance_count <= instance_streams[current_instances].instance_count);
+
+	count(&statistics::draw_calls, 1U);
+	count(&statistics::instances_drawn, uint64_t(instance_count));
+	count(&statistics::indices_drawn, uint64_t(meshes[current_mesh].index_count) * instance_count);
+	record(command_e::draw_instanced, current_mesh, instance_count);
+}
+
+const null_render_device::statistics &null_render_device::get_frame_statistics() const
+{
+	return frame_stats;
+}
+
+const null_render_device::statistics &null_render_device::get_last_frame_statistics() const
+{
+	return last_frame_stats;
+}
+
+const null_render_device::statistics &null_render_device::get_total_statistics() const
+{
+	return total_stats;
+}
+
+uint64_t null_render_device::get_frame_count() const
+{
+	return frame_count;
+}
+
+const std::vector<null_render_device::command> &null_render_device::get_commands() const
+{
+	return commands;
+}
+
+template <typename value_t>
+void null_render_device::count(value_t statistics::*counter, value_t amount)
+{
+	frame_stats.*counter += amount;
+	total_stats.*counter += amount;
+}
+
+void null_render_device::record(command_e type, uint32_t handle, uint32_t value)
+{
+	if (record_commands)
+	{
+		commands.push_back({ type, handle, value });
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "render_device.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Headless render_device, nothing reaches a GPU.
+	// Counts every call and the bytes a real backend would upload, per frame
+	// and over its lifetime, and can record the command stream for inspection.
+	// Handles are validated as a real backend would, so misuse still asserts.
+	class null_render_device : public render_device
+	{
+	public:
+		struct statistics
+		{
+			uint32_t pipelines_created;
+			uint32_t meshes_created;
+			uint32_t instance_streams_created;
+			uint32_t clears;
+			uint32_t pipeline_binds;
+			uint32_t mesh_binds;
+			uint32_t instance_updates;
+			uint32_t instance_binds;
+			uint32_t constant_updates;
+			uint32_t draw_calls;
+			uint32_t presents;
+			uint64_t instances_drawn;
+			uint64_t indices_drawn;
+			uint64_t bytes_uploaded; // mesh data, instances mapped and constants
+		};
+
+		enum class command_e : uint8_t
+		{
+			clear,
+			set_pipeline,
+			set_mesh,
+			set_instances,
+			set_constants,
+			draw,
+			draw_instanced
+		};
+
+		struct command
+		{
+			command_e type;
+			uint32_t handle; // pipeline, mesh, instance stream or constant slot
+			uint32_t value;  // constant bytes or instance count
+		};
+
+	public:
+		null_render_device(bool record_commands = false);
+		~null_render_device() override;
+
+		pipeline_handle create_pipeline(const pipeline_description &description) override;
+		void destroy_pipeline(pipeline_handle pipeline) override;
+
+		mesh_handle create_mesh(const mesh_description &description) override;
+		void destroy_mesh(mesh_handle mesh) override;
+
+		instance_stream_handle create_instance_stream(const instance_stream_description &description) override;
+		void destroy_instance_stream(instance_stream_handle stream) override;
+		void *map_instances(instance_stream_handle stream, uint32_t instance_count) override;
+		void unmap_instances(instance_stream_handle stream) override;
+
+		void wait_for_frame() override;
+		void begin_frame() override;
+		void end_frame() override;
+		void present() override;
+		void resize() override;
+
+		void clear(const std::array<float, 4> &clear_color) override;
+		void set_pipeline(pipeline_handle pipeline) override;
+		void set_mesh(mesh_handle mesh) override;
+		void set_instances(instance_stream_handle stream) override;
+		void set_constants(shader_stage_e stage, uint32_t slot, const void *data, uint32_t size) override;
+
+		void draw() override;
+		void draw_instanced(uint32_t instance_count) override;
+
+		// Calls made outside begin_frame and end_frame count towards the next frame
+		const statistics &get_frame_statistics() const;
+		const statistics &get_last_frame_statistics() const;
+		const statistics &get_total_statistics() const;
+		uint64_t get_frame_count() const;
+
+		// Commands recorded since the last begin_frame
+		const std::vector<command> &get_commands() const;
+
+	private:
+		template <typename value_t>
+		void count(value_t statistics::*counter, value_t amount);
+		void record(command_e type, uint32_t handle, uint32_t value);
+
+	private:
+		struct mesh_entry
+		{
+			uint32_t index_count;
+			bool is_alive;
+		};
+
+		// Mapped memory is real, so writes to it cost what they would on a backend
+		struct alignas(16) instance_row
+		{
+			float values[4];
+		};
+
+		struct instance_stream_entry
+		{
+			std::vector<instance_row> rows;
+			uint32_t instance_stride;
+			uint32_t max_instances;
+			uint32_t instance_count;
+			bool is_mapped;
+			bool is_alive;
+		};
+
+		bool record_commands = false;
+		std::vector<command> commands;
+
+		std::vector<bool> pipelines;
+		std::vector<mesh_entry> meshes;
+		std::vector<instance_stream_entry> instance_streams;
+		mesh_handle current_mesh = invalid_handle;
+		instance_stream_handle current_instances = invalid_handle;
+
+		statistics frame_stats{};
+		statistics last_frame_stats{};
+		statistics total_stats{};
+		uint64_t frame_count = 0;
+	};
+}
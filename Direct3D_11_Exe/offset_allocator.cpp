@@ -0,0 +1,384 @@
+#include "offset_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	uint32_t find_lowest_bit(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index{};
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+	}
+
+	uint32_t find_highest_bit(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index{};
+		_BitScanReverse(&index, value);
+		return index;
+#else
+		return static_cast<uint32_t>(31 - __builtin_clz(value));
+#endif
+	}
+
+	struct bin_index
+	{
+		uint32_t first_level;
+		uint32_t second_level;
+	};
+
+	// Sizes below small_size map linearly onto first level 0,
+	// above that each power of two is split into second_level_count bins.
+	template <uint32_t second_level_bits>
+	bin_index get_bin(uint32_t size)
+	{
+		constexpr uint32_t small_size = 1 << second_level_bits;
+		if (size < small_size)
+		{
+			return { 0, size };
+		}
+
+		auto highest_bit = find_highest_bit(size);
+		return {
+			highest_bit - second_level_bits + 1,
+			(size >> (highest_bit - second_level_bits)) ^ small_size
+		};
+	}
+
+	// Rounds size up to the next bin boundary, so any block in the returned bin fits
+	template <uint32_t second_level_bits>
+	bin_index get_search_bin(uint32_t size)
+	{
+		constexpr uint32_t small_size = 1 << second_level_bits;
+		if (size < small_size)
+		{
+			return { 0, size };
+		}
+
+		auto round_up = (1ULL << (find_highest_bit(size) - second_level_bits)) - 1;
+		auto rounded_size = std::min<uint64_t>(size + round_up, UINT32_MAX);
+		return get_bin<second_level_bits>(static_cast<uint32_t>(rounded_size));
+	}
+}
+
+offset_allocator::offset_allocator(uint32_t capacity) :
+	capacity(capacity)
+{
+	for (auto &list : free_lists)
+	{
+		list.fill(invalid_handle);
+	}
+
+	if (capacity > 0)
+	{
+		first_physical = make_block(0, capacity);
+		insert_free_block(first_physical);
+	}
+}
+
+offset_allocator::~offset_allocator()
+{}
+
+offset_allocator::allocation offset_allocator::allocate(uint32_t size)
+{
+	if (size == 0)
+	{
+		return { invalid_offset, invalid_handle };
+	}
+
+	auto index = find_free_block(size);
+	if (index == invalid_handle)
+	{
+		return { invalid_offset, invalid_handle };
+	}
+
+	remove_free_block(index);
+
+	// Return the tail end to the free lists
+	auto remainder = blocks[index].size - size;
+	if (remainder > 0)
+	{
+		auto tail = make_block(blocks[index].offset + size, remainder);
+		auto next = blocks[index].next_physical;
+
+		blocks[tail].prev_physical = index;
+		blocks[tail].next_physical = next;
+		if (next != invalid_handle)
+		{
+			blocks[next].prev_physical = tail;
+		}
+		blocks[index].next_physical = tail;
+		blocks[index].size = size;
+
+		insert_free_block(tail);
+	}
+
+	blocks[index].is_free = false;
+	used_size += size;
+	allocation_count++;
+
+	return { blocks[index].offset, index };
+}
+
+void offset_allocator::free(uint32_t handle)
+{
+	assert(handle < blocks.size() and not blocks[handle].is_free);
+
+	used_size -= blocks[handle].size;
+	allocation_count--;
+
+	auto index = handle;
+	blocks[index].is_free = true;
+
+	// Merge with the following block
+	auto next = blocks[index].next_physical;
+	if (next != invalid_handle and blocks[next].is_free)
+	{
+		remove_free_block(next);
+
+		blocks[index].size += blocks[next].size;
+		blocks[index].next_physical = blocks[next].next_physical;
+		if (blocks[index].next_physical != invalid_handle)
+		{
+			blocks[blocks[index].next_physical].prev_physical = index;
+		}
+
+		release_block(next);
+	}
+
+	// Merge into the preceding block
+	auto prev = blocks[index].prev_physical;
+	if (prev != invalid_handle and blocks[prev].is_free)
+	{
+		remove_free_block(prev);
+
+		blocks[prev].size += blocks[index].size;
+		blocks[prev].next_physical = blocks[index].next_physical;
+		if (blocks[prev].next_physical != invalid_handle)
+		{
+			blocks[blocks[prev].next_physical].prev_physical = prev;
+		}
+
+		release_block(index);
+		index = prev;
+	}
+
+	insert_free_block(index);
+}
+
+uint32_t offset_allocator::get_offset(uint32_t handle) const
+{
+	return blocks[handle].offset;
+}
+
+uint32_t offset_allocator::get_size(uint32_t handle) const
+{
+	return blocks[handle].size;
+}
+
+std::vector<offset_allocator::move> offset_allocator::defragment()
+{
+	std::vector<move> moves;
+	std::vector<uint32_t> used_blocks;
+	used_blocks.reserve(allocation_count);
+
+	for (auto index = first_physical; index != invalid_handle;)
+	{
+		auto next = blocks[index].next_physical;
+		if (blocks[index].is_free)
+		{
+			remove_free_block(index);
+			release_block(index);
+		}
+		else
+		{
+			used_blocks.push_back(index);
+		}
+		index = next;
+	}
+
+	uint32_t offset = 0;
+	uint32_t prev = invalid_handle;
+	for (auto index : used_blocks)
+	{
+		auto &used_block = blocks[index];
+		if (used_block.offset != offset)
+		{
+			moves.push_back({ index, used_block.offset, offset, used_block.size });
+			used_block.offset = offset;
+		}
+
+		used_block.prev_physical = prev;
+		used_block.next_physical = invalid_handle;
+		if (prev != invalid_handle)
+		{
+			blocks[prev].next_physical = index;
+		}
+
+		offset += used_block.size;
+		prev = index;
+	}
+
+	first_physical = used_blocks.empty() ? invalid_handle : used_blocks.front();
+
+	if (offset < capacity)
+	{
+		auto tail = make_block(offset, capacity - offset);
+		blocks[tail].prev_physical = prev;
+		if (prev != invalid_handle)
+		{
+			blocks[prev].next_physical = tail;
+		}
+		else
+		{
+			first_physical = tail;
+		}
+
+		insert_free_block(tail);
+	}
+
+	return moves;
+}
+
+offset_allocator::statistics offset_allocator::get_statistics() const
+{
+	statistics stats{};
+	stats.capacity = capacity;
+	stats.used_size = used_size;
+	stats.free_size = capacity - used_size;
+	stats.allocation_count = allocation_count;
+
+	for (uint32_t fl = 0; fl < first_level_count; ++fl)
+	{
+		for (uint32_t sl = 0; sl < second_level_count; ++sl)
+		{
+			for (auto index = free_lists[fl][sl]; index != invalid_handle; index = blocks[index].next_free)
+			{
+				stats.free_block_count++;
+				stats.largest_free_block = std::max(stats.largest_free_block, blocks[index].size);
+			}
+		}
+	}
+
+	if (stats.free_size > 0)
+	{
+		stats.fragmentation = 1.0f - static_cast<float>(stats.largest_free_block) / stats.free_size;
+	}
+
+	return stats;
+}
+
+uint32_t offset_allocator::make_block(uint32_t offset, uint32_t size)
+{
+	block new_block{ offset, size, invalid_handle, invalid_handle, invalid_handle, invalid_handle, true };
+
+	if (not unused_blocks.empty())
+	{
+		auto index = unused_blocks.back();
+		unused_blocks.pop_back();
+		blocks[index] = new_block;
+		return index;
+	}
+
+	blocks.push_back(new_block);
+	return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void offset_allocator::release_block(uint32_t index)
+{
+	unused_blocks.push_back(index);
+}
+
+void offset_allocator::insert_free_block(uint32_t index)
+{
+	auto [fl, sl] = get_bin<second_level_bits>(blocks[index].size);
+	auto &head = free_lists[fl][sl];
+
+	blocks[index].is_free = true;
+	blocks[index].prev_free = invalid_handle;
+	blocks[index].next_free = head;
+	if (head != invalid_handle)
+	{
+		blocks[head].prev_free = index;
+	}
+	head = index;
+
+	first_level_bitmap |= 1U << fl;
+	second_level_bitmaps[fl] |= 1U << sl;
+}
+
+void offset_allocator::remove_free_block(uint32_t index)
+{
+	auto [fl, sl] = get_bin<second_level_bits>(blocks[index].size);
+	auto prev = blocks[index].prev_free,
+	     next = blocks[index].next_free;
+
+	if (prev != invalid_handle)
+	{
+		blocks[prev].next_free = next;
+	}
+	else
+	{
+		free_lists[fl][sl] = next;
+	}
+
+	if (next != invalid_handle)
+	{
+		blocks[next].prev_free = prev;
+	}
+
+	if (free_lists[fl][sl] == invalid_handle)
+	{
+		second_level_bitmaps[fl] &= ~(1U << sl);
+		if (second_level_bitmaps[fl] == 0)
+		{
+			first_level_bitmap &= ~(1U << fl);
+		}
+	}
+}
+
+uint32_t offset_allocator::find_free_block(uint32_t size) const
+{
+	auto [fl, sl] = get_search_bin<second_level_bits>(size);
+
+	auto second_level_map = (fl < first_level_count) ? (second_level_bitmaps[fl] & (~0U << sl)) : 0;
+	if (second_level_map == 0)
+	{
+		auto first_level_map = (fl + 1 < first_level_count) ? (first_level_bitmap & (~0U << (fl + 1))) : 0;
+		if (first_level_map != 0)
+		{
+			fl = find_lowest_bit(first_level_map);
+			second_level_map = second_level_bitmaps[fl];
+		}
+	}
+
+	if (second_level_map != 0)
+	{
+		sl = find_lowest_bit(second_level_map);
+		return free_lists[fl][sl];
+	}
+
+	// Nothing in the rounded up bins, a block in the exact bin may still be large enough
+	auto [exact_fl, exact_sl] = get_bin<second_level_bits>(size);
+	for (auto index = free_lists[exact_fl][exact_sl]; index != invalid_handle; index = blocks[index].next_free)
+	{
+		if (blocks[index].size >= size)
+		{
+			return index;
+		}
+	}
+
+	return invalid_handle;
+}
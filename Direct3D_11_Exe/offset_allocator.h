@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Two level segregated fit (TLSF) allocator over a range of offsets.
+	// Allocation and free are O(1), freed blocks are merged with free neighbours.
+	// Handles stay valid across defragment(), only their offsets move.
+	class offset_allocator
+	{
+	public:
+		static constexpr uint32_t invalid_handle = UINT32_MAX;
+		static constexpr uint32_t invalid_offset = UINT32_MAX;
+
+		struct allocation
+		{
+			uint32_t offset;
+			uint32_t handle;
+		};
+
+		struct move
+		{
+			uint32_t handle;
+			uint32_t old_offset;
+			uint32_t new_offset;
+			uint32_t size;
+		};
+
+		struct statistics
+		{
+			uint32_t capacity;
+			uint32_t used_size;
+			uint32_t free_size;
+			uint32_t largest_free_block;
+			uint32_t free_block_count;
+			uint32_t allocation_count;
+			float fragmentation; // 0 when all free space is one block, approaches 1 as it scatters
+		};
+
+	public:
+		offset_allocator() = delete;
+		offset_allocator(uint32_t capacity);
+		~offset_allocator();
+
+		allocation allocate(uint32_t size);
+		void free(uint32_t handle);
+
+		uint32_t get_offset(uint32_t handle) const;
+		uint32_t get_size(uint32_t handle) const;
+
+		// Packs every allocation to the front of the range, leaving one free block at the end.
+		// Returned moves are in ascending offset order, caller must relocate the data.
+		std::vector<move> defragment();
+
+		statistics get_statistics() const;
+
+	private:
+		static constexpr uint32_t second_level_bits = 3;
+		static constexpr uint32_t second_level_count = 1 << second_level_bits;
+		static constexpr uint32_t first_level_count = 32 - second_level_bits + 1;
+
+		struct block
+		{
+			uint32_t offset;
+			uint32_t size;
+			uint32_t prev_physical;
+			uint32_t next_physical;
+			uint32_t prev_free;
+			uint32_t next_free;
+			bool is_free;
+		};
+
+		uint32_t make_block(uint32_t offset, uint32_t size);
+		void release_block(uint32_t index);
+
+		void insert_free_block(uint32_t index);
+		void remove_free_block(uint32_t index);
+		uint32_t find_free_block(uint32_t size) const;
+
+	private:
+		uint32_t capacity = 0;
+		uint32_t used_size = 0;
+		uint32_t allocation_count = 0;
+
+		std::vector<block> blocks;
+		std::vector<uint32_t> unused_blocks;
+		uint32_t first_physical = invalid_handle;
+
+		uint32_t first_level_bitmap = 0;
+		std::array<uint32_t, first_level_count> second_level_bitmaps{};
+		std::array<std::array<uint32_t, second_level_count>, first_level_count> free_lists{};
+	};
+}
@@ -1,5 +1,16 @@
 
+cbuffer per_frame : register(b0)
+{
+    float4x4 view_projection;
+};
+
+// Straight from the transform hierarchy, which keeps DirectXMath's row major layout
+cbuffer per_object : register(b1)
+{
+    row_major float4x4 world;
+};
+
 float4 main(float4 pos : POSITION) : SV_POSITION
 {
-    return pos;
+    return mul(mul(pos, world), view_projection);
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+
+cbuffer per_frame : register(b0)
+{
+    float4x4 view_projection;
+};
+
+struct vs_input
+{
+    float4 pos : POSITION;
+    float4x4 transform : INSTANCE_TRANSFORM;
+};
+
+float4 main(vs_input input) : SV_POSITION
+{
+    return mul(mul(input.pos, input.transform), view_projection);
+}
\ No newline at end of file
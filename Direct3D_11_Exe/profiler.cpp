@@ -0,0 +1,295 @@
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	// Timestamps are nanoseconds since the profiler was first used
+	const clock::time_point epoch = clock::now();
+
+	uint64_t get_time()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count());
+	}
+
+	// Slot fields are atomics so the exporting thread can read a slot the
+	// owner may be overwriting, it then discards the slot rather than
+	// racing on it
+	struct event_slot
+	{
+		std::atomic<const char *> name{ nullptr };
+		std::atomic<uint64_t> start_time{ 0 };
+		std::atomic<uint64_t> duration{ 0 };
+		std::atomic<uint32_t> depth{ 0 };
+	};
+
+	struct event
+	{
+		const char *name;
+		uint64_t start_time;
+		uint64_t duration;
+		uint32_t depth;
+	};
+
+	// Single producer ring, written only by its owning thread
+	class thread_buffer
+	{
+	public:
+		thread_buffer(uint32_t thread_id) :
+			thread_id(thread_id)
+		{}
+
+		// Called by the next owner with the registry locked, the previous owner's events are dropped
+		void reuse(uint32_t new_thread_id)
+		{
+			thread_id = new_thread_id;
+			thread_name.store(nullptr, std::memory_order_relaxed);
+			write_index.store(0, std::memory_order_relaxed);
+		}
+
+		void push(const char *name, uint64_t start_time, uint64_t duration, uint32_t depth)
+		{
+			auto index = write_index.load(std::memory_order_relaxed);
+			if (not slots)
+			{
+				// Allocated on the first event, threads that only name themselves cost nothing.
+				// Readers only touch slots once write_index says there is something there.
+				slots = std::make_unique<event_slot[]>(profiler::max_events_per_thread);
+			}
+
+			auto &slot = slots[index % profiler::max_events_per_thread];
+
+			slot.name.store(name, std::memory_order_relaxed);
+			slot.start_time.store(start_time, std::memory_order_relaxed);
+			slot.duration.store(duration, std::memory_order_relaxed);
+			slot.depth.store(depth, std::memory_order_relaxed);
+
+			write_index.store(index + 1, std::memory_order_release);
+		}
+
+		std::vector<event> read() const
+		{
+			auto end = write_index.load(std::memory_order_acquire);
+			if (end == 0)
+			{
+				return {};
+			}
+			auto begin = (end > profiler::max_events_per_thread) ? end - profiler::max_events_per_thread : 0;
+
+			std::vector<event> events;
+			events.reserve(static_cast<size_t>(end - begin));
+			for (auto index = begin; index < end; ++index)
+			{
+				const auto &slot = slots[index % profiler::max_events_per_thread];
+				events.push_back({ slot.name.load(std::memory_order_relaxed),
+				                   slot.start_time.load(std::memory_order_relaxed),
+				                   slot.duration.load(std::memory_order_relaxed),
+				                   slot.depth.load(std::memory_order_relaxed) });
+			}
+
+			// Drop whatever the owner lapped while we were copying
+			std::atomic_thread_fence(std::memory_order_acquire);
+			auto end_after = write_index.load(std::memory_order_relaxed);
+			auto valid_begin = (end_after > profiler::max_events_per_thread) ? end_after - profiler::max_events_per_thread : 0;
+			if (valid_begin > begin)
+			{
+				events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(std::min(valid_begin - begin, uint64_t(events.size()))));
+			}
+
+			return events;
+		}
+
+		// Changed only under the registry lock
+		uint32_t thread_id;
+		std::atomic<const char *> thread_name{ nullptr };
+
+	private:
+		std::unique_ptr<event_slot[]> slots = nullptr;
+		std::atomic<uint64_t> write_index{ 0 };
+	};
+
+	struct thread_trace
+	{
+		uint32_t thread_id;
+		const char *thread_name;
+		std::vector<event> events;
+	};
+
+	// Buffers outlive their threads so a trace still shows work from finished workers,
+	// until a new thread takes the buffer over. Memory is bounded by the most threads
+	// alive at once rather than by every thread ever started.
+	class buffer_registry
+	{
+	public:
+		thread_buffer *add_thread()
+		{
+			std::lock_guard<std::mutex> lock(registry_lock);
+			auto thread_id = ++last_thread_id;
+
+			if (not retired_buffers.empty())
+			{
+				auto buffer = retired_buffers.back();
+				retired_buffers.pop_back();
+				buffer->reuse(thread_id);
+				return buffer;
+			}
+
+			buffers.push_back(std::make_unique<thread_buffer>(thread_id));
+			return buffers.back().get();
+		}
+
+		void retire_thread(thread_buffer *buffer)
+		{
+			std::lock_guard<std::mutex> lock(registry_lock);
+			retired_buffers.push_back(buffer);
+		}
+
+		// Read under the lock, so no buffer changes hands halfway through
+		std::vector<thread_trace> read_traces()
+		{
+			std::lock_guard<std::mutex> lock(registry_lock);
+
+			std::vector<thread_trace> traces;
+			traces.reserve(buffers.size());
+			for (const auto &buffer : buffers)
+			{
+				traces.push_back({ buffer->thread_id, buffer->thread_name.load(std::memory_order_relaxed), buffer->read() });
+			}
+			return traces;
+		}
+
+	private:
+		std::mutex registry_lock;
+		std::vector<std::unique_ptr<thread_buffer>> buffers;
+		std::vector<thread_buffer *> retired_buffers;
+		uint32_t last_thread_id = 0;
+	};
+
+	buffer_registry &get_registry()
+	{
+		static buffer_registry registry{};
+		return registry;
+	}
+
+	// Hands the buffer back to the registry when its thread exits
+	struct thread_state
+	{
+		~thread_state()
+		{
+			if (buffer)
+			{
+				get_registry().retire_thread(buffer);
+			}
+		}
+
+		thread_buffer *buffer = nullptr;
+		uint32_t depth = 0;
+	};
+
+	// Registration takes the registry lock once per thread, never per scope
+	thread_state &get_thread_state()
+	{
+		thread_local thread_state state{};
+		if (state.buffer == nullptr)
+		{
+			state.buffer = get_registry().add_thread();
+		}
+		return state;
+	}
+
+	void write_json_string(std::ofstream &file, const char *text)
+	{
+		file << '"';
+		for (auto c = text; c and *c; ++c)
+		{
+			if (*c == '"' or *c == '\\')
+			{
+				file << '\\';
+			}
+			file << *c;
+		}
+		file << '"';
+	}
+}
+
+profiler::scope::scope(const char *name) :
+	name(name),
+	start_time(get_time())
+{
+	get_thread_state().depth++;
+}
+
+profiler::scope::~scope()
+{
+	auto end_time = get_time();
+
+	auto &state = get_thread_state();
+	state.depth--;
+	state.buffer->push(name, start_time, end_time - start_time, state.depth);
+}
+
+void profiler::set_thread_name(const char *name)
+{
+	get_thread_state().buffer->thread_name.store(name, std::memory_order_relaxed);
+}
+
+void profiler::write_chrome_trace(std::wstring_view file_name)
+{
+	std::ofstream file(std::filesystem::path(file_name), std::ios::trunc);
+	if (not file)
+	{
+		throw std::runtime_error("Cannot create trace file");
+	}
+
+	// Complete ("X") events in microseconds, the viewer nests them by time
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	auto first_event = true;
+	auto separator = [&]()
+	{
+		file << (first_event ? "" : ",\n");
+		first_event = false;
+	};
+
+	file.setf(std::ios::fixed);
+	file.precision(3);
+
+	for (const auto &trace : get_registry().read_traces())
+	{
+		if (trace.thread_name)
+		{
+			separator();
+			file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << trace.thread_id << ",\"args\":{\"name\":";
+			write_json_string(file, trace.thread_name);
+			file << "}}";
+		}
+
+		for (const auto &e : trace.events)
+		{
+			separator();
+			file << "{\"ph\":\"X\",\"name\":";
+			write_json_string(file, e.name);
+			file << ",\"pid\":1,\"tid\":" << trace.thread_id
+			     << ",\"ts\":" << e.start_time / 1000.0
+			     << ",\"dur\":" << e.duration / 1000.0
+			     << ",\"args\":{\"depth\":" << e.depth << "}}";
+		}
+	}
+
+	file << "\n]}\n";
+}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Set to 0 in the project's preprocessor definitions to compile the profiler out,
+// PROFILE_SCOPE expands to nothing and the functions below to empty inlines
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+namespace direct3d_11_eg
+{
+	// Hierarchical CPU profiler.
+	// Scopes record into a buffer owned by their thread, so recording never
+	// locks; the buffers are merged only when a trace is written. Each buffer
+	// keeps its most recent max_events_per_thread scopes, and is handed to a
+	// new thread once its own has exited.
+	namespace profiler
+	{
+		constexpr uint32_t max_events_per_thread = 64 * 1024;
+
+#if PROFILER_ENABLED
+		// Names must outlive the profiler, string literals in practice
+		class scope
+		{
+		public:
+			scope() = delete;
+			explicit scope(const char *name);
+			~scope();
+
+			scope(const scope &) = delete;
+			scope &operator=(const scope &) = delete;
+
+		private:
+			const char *name;
+			uint64_t start_time;
+		};
+
+		// Shown as the thread's name in the trace viewer
+		void set_thread_name(const char *name);
+
+		// Chrome trace_event JSON, open in chrome://tracing or ui.perfetto.dev
+		void write_chrome_trace(std::wstring_view file_name);
+#else
+		class scope
+		{
+		public:
+			scope() = delete;
+			explicit scope(const char *)
+			{}
+
+			scope(const scope &) = delete;
+			scope &operator=(const scope &) = delete;
+		};
+
+		inline void set_thread_name(const char *)
+		{}
+
+		inline void write_chrome_trace(std::wstring_view)
+		{}
+#endif
+	}
+}
+
+#define PROFILE_CONCATENATE_IMPL(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_IMPL(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) ::direct3d_11_eg::profiler::scope PROFILE_CONCATENATE(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
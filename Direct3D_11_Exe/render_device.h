@@ -0,0 +1,176 @@
+#pragma once
+
+#include "index_codec.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace direct3d_11_eg
+{
+	// Backend agnostic device and immediate context, just wide enough for the renderer.
+	// Resources are owned by the device and referred to by handles, binds and draws
+	// go through the same object, so a backend sees everything a frame does.
+	// No platform headers are included here, code written against render_device
+	// builds and runs wherever a backend does.
+	class render_device
+	{
+	public:
+		using pipeline_handle = uint32_t;
+		using mesh_handle = uint32_t;
+		using instance_stream_handle = uint32_t;
+
+		static constexpr uint32_t invalid_handle = std::numeric_limits<uint32_t>::max();
+
+		enum class blend_e
+		{
+			Opaque,
+			Alpha,
+			Additive,
+			NonPremultipled
+		};
+
+		enum class depth_stencil_e
+		{
+			None,
+			ReadWrite,
+			ReadOnly
+		};
+
+		enum class rasterizer_e
+		{
+			CullNone,
+			CullClockwise,
+			CullAntiClockwise,
+			Wireframe
+		};
+
+		enum class sampler_e
+		{
+			PointWrap,
+			PointClamp,
+			LinearWrap,
+			LinearClamp,
+			AnisotropicWrap,
+			AnisotropicClamp
+		};
+
+		enum class input_layout_e
+		{
+			position,
+			position_texcoord,
+			position_instanced,
+			packed_position_normal_texcoord
+		};
+
+		enum class topology_e
+		{
+			triangle_list,
+			triangle_strip,
+			line_list,
+			point_list
+		};
+
+		enum class shader_stage_e
+		{
+			vertex,
+			pixel
+		};
+
+		// Either way a backend stores 16 bit indices whenever every index fits
+		enum class index_type_e
+		{
+			uint32,
+			encoded // index_codec stream
+		};
+
+		// Compiled bytecode, only has to live until create_pipeline returns
+		struct shader_code
+		{
+			const void *data;
+			size_t size;
+		};
+
+		struct pipeline_description
+		{
+			blend_e blend;
+			depth_stencil_e depth_stencil;
+			rasterizer_e rasterizer;
+			sampler_e sampler;
+
+			input_layout_e input_layout;
+			topology_e topology;
+			shader_code vertex_shader;
+			shader_code pixel_shader;
+		};
+
+		// Vertex and index data only have to live until create_mesh returns
+		struct mesh_description
+		{
+			const void *vertex_data;
+			uint32_t vertex_stride;
+			uint32_t vertex_count;
+
+			const void *index_data;
+			index_type_e index_type;
+			uint32_t index_count; // indices, or bytes of an encoded stream
+		};
+
+		// Per-instance vertex data for input_layout_e::position_instanced, a
+		// row major float4x4 per instance. Strides are whole float4 registers.
+		struct instance_stream_description
+		{
+			uint32_t instance_stride;
+			uint32_t max_instances;
+		};
+
+	public:
+		virtual ~render_device() = default;
+
+		virtual pipeline_handle create_pipeline(const pipeline_description &description) = 0;
+		virtual void destroy_pipeline(pipeline_handle pipeline) = 0;
+
+		virtual mesh_handle create_mesh(const mesh_description &description) = 0;
+		virtual void destroy_mesh(mesh_handle mesh) = 0;
+
+		virtual instance_stream_handle create_instance_stream(const instance_stream_description &description) = 0;
+		virtual void destroy_instance_stream(instance_stream_handle stream) = 0;
+		// Write only memory for instance_count instances, 16 byte aligned and possibly
+		// write-combined, so fill it with aligned stores and never read it back.
+		// Earlier contents are discarded, the pointer is valid until unmap_instances.
+		virtual void *map_instances(instance_stream_handle stream, uint32_t instance_count) = 0;
+		virtual void unmap_instances(instance_stream_handle stream) = 0;
+
+		// Blocks until the backend can accept another frame
+		virtual void wait_for_frame() = 0;
+		virtual void begin_frame() = 0;
+		virtual void end_frame() = 0;
+		virtual void present() = 0;
+		virtual void resize() = 0;
+
+		virtual void clear(const std::array<float, 4> &clear_color) = 0;
+		virtual void set_pipeline(pipeline_handle pipeline) = 0;
+		virtual void set_mesh(mesh_handle mesh) = 0;
+		virtual void set_instances(instance_stream_handle stream) = 0;
+		// Copied at once, data may be reused as soon as the call returns
+		virtual void set_constants(shader_stage_e stage, uint32_t slot, const void *data, uint32_t size) = 0;
+
+		// Draws every index of the bound mesh
+		virtual void draw() = 0;
+		// With input_layout_e::position_instanced each instance reads the bound stream,
+		// so instance_count may not exceed the count last mapped
+		virtual void draw_instanced(uint32_t instance_count) = 0;
+	};
+
+	// Indices of a mesh at the width a backend uploads them, the one place
+	// create_mesh implementations turn either index type into buffer data
+	inline index_codec::packed_indices pack_indices(const render_device::mesh_description &description)
+	{
+		if (description.index_type == render_device::index_type_e::encoded)
+		{
+			return index_codec::pack_indices(static_cast<const uint8_t *>(description.index_data), description.index_count);
+		}
+		return index_codec::pack_indices(static_cast<const uint32_t *>(description.index_data), description.index_count);
+	}
+}
@@ -0,0 +1,112 @@
+#include "render_thread.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace direct3d_11_eg;
+
+render_thread::render_thread(const description &thread_description, input_queue &window_input, const handlers &thread_handlers) :
+	settings(thread_description),
+	input(window_input),
+	callbacks(thread_handlers),
+	batch(thread_description.max_batch_size)
+{
+	assert(settings.max_batch_size > 0);
+	assert(callbacks.input and callbacks.resize and callbacks.frame);
+
+	thread = std::thread(&render_thread::thread_loop, this);
+}
+
+render_thread::~render_thread()
+{
+	stop();
+}
+
+void render_thread::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(wake_lock);
+		stopping.store(true, std::memory_order_release);
+	}
+	wake.notify_one();
+
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+render_thread::statistics render_thread::get_statistics() const
+{
+	return { frame_count.load(std::memory_order_relaxed),
+	         event_count.load(std::memory_order_relaxed),
+	         resize_count.load(std::memory_order_relaxed),
+	         max_queued_events.load(std::memory_order_relaxed) };
+}
+
+void render_thread::thread_loop()
+{
+	profiler::set_thread_name("render");
+
+	while (not stopping.load(std::memory_order_acquire))
+	{
+		auto start_time = clock::now();
+		process_input();
+		auto event_time = clock::now() - start_time;
+
+		if (is_paused)
+		{
+			// Only stop wakes the thread early, input and resizes wait for the poll
+			std::unique_lock<std::mutex> lock(wake_lock);
+			wake.wait_for(lock, settings.paused_poll, [this]()
+			{
+				return stopping.load(std::memory_order_relaxed);
+			});
+			continue;
+		}
+
+		callbacks.frame(event_time);
+		frame_count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void render_thread::process_input()
+{
+	PROFILE_SCOPE("render_thread::process_input");
+
+	// Only what is queued now, a flood of input cannot hold the frame back forever
+	auto queued = input.get_queued_count();
+	if (queued > max_queued_events.load(std::memory_order_relaxed))
+	{
+		max_queued_events.store(queued, std::memory_order_relaxed);
+	}
+
+	while (queued > 0)
+	{
+		auto count = input.pop_batch(batch.data(), std::min(queued, settings.max_batch_size));
+		if (count == 0)
+		{
+			break;
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			callbacks.input(batch[i]);
+		}
+		event_count.fetch_add(count, std::memory_order_relaxed);
+		queued -= count;
+	}
+
+	uint32_t width = 0,
+	         height = 0;
+	if (input.take_resize(width, height))
+	{
+		is_paused = (width == 0 or height == 0);
+		if (not is_paused)
+		{
+			callbacks.resize(width, height);
+			resize_count.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "input_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Runs frames on a thread of their own, so the message pump and rendering
+	// never wait on each other. The window thread only produces input:
+	//  * input events are drained from the input_queue in batches before every frame
+	//  * only the latest client size is applied, once, before the frame
+	//  * a zero size pauses frames until a real size arrives, as when minimised
+	//  * stop lets the frame in flight finish, then joins
+	// The thread knows nothing about the renderer, it only calls the handlers.
+	class render_thread
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		// Handlers all run on the render thread. frame is told how long
+		// the input and resize before it took.
+		struct handlers
+		{
+			std::function<void(const input_event &)> input;
+			std::function<void(uint32_t width, uint32_t height)> resize;
+			std::function<void(clock::duration event_time)> frame;
+		};
+
+		struct description
+		{
+			uint32_t max_batch_size;               // events drained per pass
+			std::chrono::milliseconds paused_poll; // how often a paused thread drains input
+		};
+
+		struct statistics
+		{
+			uint64_t frames;
+			uint64_t events;
+			uint64_t resizes;
+			uint32_t max_queued_events; // seen at the start of a frame
+		};
+
+	public:
+		render_thread() = delete;
+		render_thread(const description &thread_description, input_queue &window_input, const handlers &thread_handlers);
+		~render_thread();
+
+		render_thread(const render_thread &) = delete;
+		render_thread &operator=(const render_thread &) = delete;
+
+		// Waits for the current frame to finish, safe to call more than once
+		void stop();
+
+		statistics get_statistics() const;
+
+	private:
+		void thread_loop();
+		void process_input();
+
+	private:
+		description settings{};
+		input_queue &input;
+		handlers callbacks{};
+
+		std::vector<input_event> batch;
+		bool is_paused = false;
+
+		std::mutex wake_lock;
+		std::condition_variable wake;
+		std::atomic<bool> stopping{ false };
+		std::thread thread;
+
+		std::atomic<uint64_t> frame_count{ 0 };
+		std::atomic<uint64_t> event_count{ 0 };
+		std::atomic<uint64_t> resize_count{ 0 };
+		std::atomic<uint32_t> max_queued_events{ 0 };
+	};
+}
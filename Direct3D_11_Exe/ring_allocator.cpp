@@ -0,0 +1,151 @@
+#include "ring_allocator.h"
+
+#include <cassert>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	uint32_t align_up(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+ring_allocator::ring_allocator(uint32_t capacity, uint32_t max_frames_in_flight) :
+	capacity(capacity),
+	frames(max_frames_in_flight)
+{
+	assert(max_frames_in_flight > 0);
+}
+
+ring_allocator::~ring_allocator()
+{}
+
+uint32_t ring_allocator::allocate(uint32_t size, uint32_t alignment)
+{
+	assert(alignment > 0 and (alignment & (alignment - 1)) == 0);
+
+	if (size == 0 or size > capacity)
+	{
+		stats.failed_allocations++;
+		return invalid_offset;
+	}
+
+	// Nothing in flight, start again from the front to keep allocations contiguous
+	if (used_size == 0)
+	{
+		write_offset = retire_offset = 0;
+	}
+
+	uint64_t aligned_offset = align_up(write_offset, alignment);
+	uint32_t consumed = 0;
+	uint32_t offset = invalid_offset;
+
+	if (write_offset >= retire_offset and used_size < capacity)
+	{
+		// Free space is [write_offset, capacity) and [0, retire_offset)
+		if (aligned_offset + size <= capacity)
+		{
+			offset = static_cast<uint32_t>(aligned_offset);
+			consumed = offset + size - write_offset;
+		}
+		else if (size <= retire_offset)
+		{
+			// Skip the tail end of the buffer, offset 0 satisfies any alignment
+			offset = 0;
+			consumed = capacity - write_offset + size;
+			stats.wraps++;
+		}
+	}
+	else if (write_offset < retire_offset)
+	{
+		// Free space is [write_offset, retire_offset)
+		if (aligned_offset + size <= retire_offset)
+		{
+			offset = static_cast<uint32_t>(aligned_offset);
+			consumed = offset + size - write_offset;
+		}
+	}
+
+	if (offset == invalid_offset)
+	{
+		stats.failed_allocations++;
+		return invalid_offset;
+	}
+
+	write_offset = offset + size;
+	used_size += consumed;
+	total_used += consumed;
+
+	stats.allocations++;
+	stats.bytes_allocated += size;
+	stats.bytes_wasted += consumed - size;
+
+	return offset;
+}
+
+bool ring_allocator::end_frame(uint64_t fence_value)
+{
+	if (frame_count == frames.size())
+	{
+		return false;
+	}
+
+	auto last_frame = (first_frame + frame_count) % frames.size();
+	frames[last_frame] = { fence_value, write_offset, total_used };
+	frame_count++;
+
+	return true;
+}
+
+void ring_allocator::release_frames(uint64_t completed_fence_value)
+{
+	while (frame_count > 0)
+	{
+		auto &frame = frames[first_frame];
+		if (frame.fence_value > completed_fence_value)
+		{
+			break;
+		}
+
+		// Frames that allocated nothing do not move the retire point,
+		// their end offset may predate a restart from the front of the ring
+		if (frame.total_used != total_retired)
+		{
+			used_size -= static_cast<uint32_t>(frame.total_used - total_retired);
+			total_retired = frame.total_used;
+			retire_offset = frame.end_offset;
+		}
+
+		first_frame = static_cast<uint32_t>((first_frame + 1) % frames.size());
+		frame_count--;
+	}
+}
+
+void ring_allocator::reset()
+{
+	write_offset = retire_offset = used_size = 0;
+	total_retired = total_used;
+	first_frame = frame_count = 0;
+}
+
+uint32_t ring_allocator::get_capacity() const
+{
+	return capacity;
+}
+
+uint32_t ring_allocator::get_used_size() const
+{
+	return used_size;
+}
+
+uint32_t ring_allocator::get_frames_in_flight() const
+{
+	return frame_count;
+}
+
+const ring_allocator::statistics &ring_allocator::get_statistics() const
+{
+	return stats;
+}
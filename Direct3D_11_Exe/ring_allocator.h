@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Linear ring suballocator for transient per-frame data.
+	// Allocations are retired a whole frame at a time, once the fence
+	// value recorded at the end of that frame is known to have completed.
+	// Only deals in offsets, the memory itself belongs to the caller.
+	class ring_allocator
+	{
+	public:
+		static constexpr uint32_t invalid_offset = UINT32_MAX;
+
+		struct statistics
+		{
+			uint32_t allocations;
+			uint32_t failed_allocations;
+			uint32_t wraps;
+			uint64_t bytes_allocated;
+			uint64_t bytes_wasted; // alignment padding and skipped tail space
+		};
+
+	public:
+		ring_allocator() = delete;
+		ring_allocator(uint32_t capacity, uint32_t max_frames_in_flight);
+		~ring_allocator();
+
+		// Returns offset of the allocation, or invalid_offset if all free space is still in flight.
+		// alignment must be a power of two.
+		uint32_t allocate(uint32_t size, uint32_t alignment);
+
+		// Closes current frame, its allocations stay live until fence_value is released.
+		// Returns false if too many frames are in flight to record another.
+		bool end_frame(uint64_t fence_value);
+		void release_frames(uint64_t completed_fence_value);
+
+		// Drops every allocation, including in flight ones
+		void reset();
+
+		uint32_t get_capacity() const;
+		uint32_t get_used_size() const;
+		uint32_t get_frames_in_flight() const;
+		const statistics &get_statistics() const;
+
+	private:
+		struct frame_marker
+		{
+			uint64_t fence_value;
+			uint32_t end_offset;
+			uint64_t total_used; // running total of bytes consumed, at end of the frame
+		};
+
+	private:
+		uint32_t capacity = 0;
+		uint32_t write_offset = 0;
+		uint32_t retire_offset = 0;
+		uint32_t used_size = 0;
+
+		uint64_t total_used = 0;
+		uint64_t total_retired = 0;
+
+		// Fixed size circular queue of frames in flight
+		std::vector<frame_marker> frames;
+		uint32_t first_frame = 0;
+		uint32_t frame_count = 0;
+
+		statistics stats{};
+	};
+}
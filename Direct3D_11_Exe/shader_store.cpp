@@ -0,0 +1,112 @@
+#include "shader_store.h"
+
+#include <cstring>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// 64-bit FNV-1a, bytecode files are small so this is not worth anything fancier
+	uint64_t hash_bytes(const byte *data, size_t size)
+	{
+		constexpr uint64_t fnv_offset_basis = 0xcbf2'9ce4'8422'2325ULL;
+		constexpr uint64_t fnv_prime = 0x0000'0100'0000'01b3ULL;
+
+		uint64_t hash = fnv_offset_basis;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= data[i];
+			hash *= fnv_prime;
+		}
+
+		return hash;
+	}
+
+	bool same_contents(const shader_blob &blob, const mapped_file &file)
+	{
+		return (blob.size() == file.size())
+		   and (blob.size() == 0 or std::memcmp(blob.data(), file.data(), file.size()) == 0);
+	}
+}
+
+#pragma region "Shader Blob"
+
+shader_blob::shader_blob(std::unique_ptr<mapped_file> &&file, uint64_t content_hash) :
+	file(std::move(file)),
+	content_hash(content_hash)
+{}
+
+shader_blob::~shader_blob()
+{}
+
+const byte *shader_blob::data() const
+{
+	return file->data();
+}
+
+size_t shader_blob::size() const
+{
+	return file->size();
+}
+
+uint64_t shader_blob::hash() const
+{
+	return content_hash;
+}
+
+#pragma endregion
+
+#pragma region "Shader Store"
+
+shader_store::~shader_store()
+{}
+
+shader_blob_t shader_store::load(std::wstring_view file_name)
+{
+	std::lock_guard<std::mutex> lock(lookup_lock);
+
+	using clock = std::chrono::high_resolution_clock;
+	auto start_time = clock::now();
+
+	std::wstring key{ file_name };
+
+	auto path_it = path_lookup.find(key);
+	if (path_it != path_lookup.end())
+	{
+		stats.path_hits++;
+		stats.load_time += clock::now() - start_time;
+		return path_it->second;
+	}
+
+	auto file = std::make_unique<mapped_file>(file_name);
+	auto content_hash = hash_bytes(file->data(), file->size());
+
+	shader_blob_t blob{};
+
+	auto content_it = content_lookup.find(content_hash);
+	if (content_it != content_lookup.end() and same_contents(*content_it->second, *file))
+	{
+		// Same bytecode under another name, drop the new mapping
+		stats.content_hits++;
+		blob = content_it->second;
+	}
+	else
+	{
+		stats.files_mapped++;
+		stats.bytes_mapped += file->size();
+		blob = std::make_shared<const shader_blob>(std::move(file), content_hash);
+		content_lookup.insert({ content_hash, blob });
+	}
+
+	path_lookup.insert({ std::move(key), blob });
+
+	stats.load_time += clock::now() - start_time;
+	return blob;
+}
+
+const shader_store::statistics &shader_store::get_statistics() const
+{
+	return stats;
+}
+
+#pragma endregion
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace direct3d_11_eg
+{
+	// Compiled shader bytecode, backed directly by the mapped .cso file
+	class shader_blob
+	{
+	public:
+		shader_blob() = delete;
+		shader_blob(std::unique_ptr<mapped_file> &&file, uint64_t content_hash);
+		~shader_blob();
+
+		const byte *data() const;
+		size_t size() const;
+		uint64_t hash() const;
+
+	private:
+		std::unique_ptr<mapped_file> file;
+		uint64_t content_hash = 0;
+	};
+
+	using shader_blob_t = std::shared_ptr<const shader_blob>;
+
+	// Hands out shared read-only views of shader bytecode files.
+	// Files are mapped once per path, and paths with identical contents share one mapping.
+	// load is safe to call from asset streaming worker threads.
+	class shader_store
+	{
+	public:
+		struct statistics
+		{
+			uint32_t files_mapped;
+			uint32_t path_hits;
+			uint32_t content_hits;
+			uint64_t bytes_mapped;
+			std::chrono::duration<double, std::milli> load_time;
+		};
+
+	public:
+		shader_store() = default;
+		~shader_store();
+
+		shader_blob_t load(std::wstring_view file_name);
+
+		const statistics &get_statistics() const;
+
+	private:
+		std::mutex lookup_lock;
+		std::unordered_map<std::wstring, shader_blob_t> path_lookup;
+		std::unordered_map<uint64_t, shader_blob_t> content_lookup;
+
+		statistics stats{};
+	};
+}
@@ -0,0 +1,94 @@
+#include "simulation_clock.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace direct3d_11_eg;
+
+simulation_clock::simulation_clock(const description &clock_description, time_source now) :
+	settings(clock_description),
+	now(std::move(now))
+{
+	assert(settings.step > clock::duration::zero());
+	assert(settings.max_steps_per_frame > 0);
+	assert(settings.max_frame_time >= settings.step);
+}
+
+simulation_clock::~simulation_clock()
+{}
+
+uint32_t simulation_clock::advance()
+{
+	auto frame_time = now();
+	stats.frame_count++;
+
+	if (not is_running)
+	{
+		is_running = true;
+		last_time = frame_time;
+		return 0;
+	}
+
+	auto elapsed = frame_time - last_time;
+	last_time = frame_time;
+
+	auto clamped = false;
+	if (elapsed > settings.max_frame_time)
+	{
+		stats.dropped_time += elapsed - settings.max_frame_time;
+		elapsed = settings.max_frame_time;
+		clamped = true;
+	}
+	accumulator += elapsed;
+
+	auto due_steps = static_cast<uint64_t>(accumulator / settings.step);
+	auto steps = static_cast<uint32_t>(std::min<uint64_t>(due_steps, settings.max_steps_per_frame));
+	accumulator -= steps * settings.step;
+
+	// Keep less than a frame's worth of backlog, the rest could never be caught up
+	auto max_backlog = settings.max_steps_per_frame * settings.step;
+	if (accumulator >= max_backlog)
+	{
+		auto kept = max_backlog - settings.step + accumulator % settings.step;
+		stats.dropped_time += accumulator - kept;
+		accumulator = kept;
+		clamped = true;
+	}
+
+	step_index += steps;
+
+	stats.step_count += steps;
+	stats.clamped_frames += clamped ? 1 : 0;
+	stats.max_steps_in_frame = std::max(stats.max_steps_in_frame, steps);
+	return steps;
+}
+
+double simulation_clock::get_interpolation() const
+{
+	return std::chrono::duration<double>(accumulator % settings.step) / settings.step;
+}
+
+uint64_t simulation_clock::get_step_index() const
+{
+	return step_index;
+}
+
+simulation_clock::clock::duration simulation_clock::get_step() const
+{
+	return settings.step;
+}
+
+double simulation_clock::get_step_seconds() const
+{
+	return std::chrono::duration<double>(settings.step).count();
+}
+
+double simulation_clock::get_simulation_seconds() const
+{
+	return std::chrono::duration<double>(settings.step).count() * step_index;
+}
+
+const simulation_clock::statistics &simulation_clock::get_statistics() const
+{
+	return stats;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace direct3d_11_eg
+{
+	// Fixed timestep clock, decouples simulation updates from the render rate.
+	// Real time accumulates each frame and is paid out in whole steps, what is
+	// left over is the interpolation factor between the last two simulated states.
+	//  * a frame longer than max_frame_time only counts as max_frame_time
+	//  * at most max_steps_per_frame steps run in a frame, catching up over later frames,
+	//    and a backlog beyond that is dropped, so a slow simulation cannot spiral
+	// Accumulation is in integer clock ticks, a given sequence of times always
+	// yields the same steps. The time source is injectable for tests and benchmarks.
+	class simulation_clock
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+		using time_source = std::function<clock::time_point()>;
+
+		struct description
+		{
+			clock::duration step;
+			uint32_t max_steps_per_frame;
+			clock::duration max_frame_time;
+		};
+
+		struct statistics
+		{
+			uint64_t frame_count;
+			uint64_t step_count;
+			uint64_t clamped_frames; // frames that hit max_frame_time or max_steps_per_frame
+			uint32_t max_steps_in_frame;
+			std::chrono::duration<double, std::milli> dropped_time;
+		};
+
+	public:
+		simulation_clock() = delete;
+		simulation_clock(const description &clock_description, time_source now = clock::now);
+		~simulation_clock();
+
+		// Once per frame, returns how many steps to simulate now. The first call starts the clock.
+		uint32_t advance();
+
+		// Fraction of a step between the previous and the latest simulated state, [0, 1)
+		double get_interpolation() const;
+
+		uint64_t get_step_index() const;
+		clock::duration get_step() const;
+		double get_step_seconds() const;
+		double get_simulation_seconds() const;
+
+		const statistics &get_statistics() const;
+
+	private:
+		description settings{};
+		time_source now;
+
+		bool is_running = false;
+		clock::time_point last_time{};
+		clock::duration accumulator{};
+		uint64_t step_index = 0;
+
+		statistics stats{};
+	};
+}
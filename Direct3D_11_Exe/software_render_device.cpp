@@ -0,0 +1,1214 @@
+#include "software_render_device.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define SOFTWARE_RASTERIZER_SSE2 1
+#include <emmintrin.h>
+#else
+#define SOFTWARE_RASTERIZER_SSE2 0
+#endif
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	// 28.4 fixed point, as Direct3D 11 snaps to at least 8 bits we are coarser
+	constexpr int32_t subpixel_bits = 4;
+	constexpr int32_t subpixel_scale = 1 << subpixel_bits;
+	constexpr int32_t half_pixel = subpixel_scale / 2;
+
+	// Set on bin entries that refer to lines rather than triangles
+	constexpr uint32_t line_flag = 1U << 31;
+
+	constexpr uint32_t max_polygon_vertices = 3 + 6;
+
+	uint32_t round_up(uint32_t value, uint32_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	float half_to_float(uint16_t value)
+	{
+		uint32_t sign = uint32_t(value & 0x8000) << 16;
+		uint32_t exponent = (value >> 10) & 0x1f;
+		uint32_t mantissa = value & 0x3ff;
+
+		uint32_t bits = sign;
+		if (exponent == 0x1f)
+		{
+			bits |= 0x7f800000 | (mantissa << 13);
+		}
+		else if (exponent != 0)
+		{
+			bits |= ((exponent + 127 - 15) << 23) | (mantissa << 13);
+		}
+		else if (mantissa != 0)
+		{
+			// Subnormal, renormalise into the float exponent range
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0)
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits |= (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+
+		float result{};
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	uint32_t pack_color(const std::array<float, 4> &color)
+	{
+		uint32_t packed = 0;
+		for (uint32_t channel = 0; channel < 4; ++channel)
+		{
+			auto value = static_cast<uint32_t>(std::clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+			packed |= value << (channel * 8);
+		}
+		return packed;
+	}
+
+	std::array<float, 4> unpack_color(uint32_t packed)
+	{
+		std::array<float, 4> color{};
+		for (uint32_t channel = 0; channel < 4; ++channel)
+		{
+			color[channel] = static_cast<float>((packed >> (channel * 8)) & 0xff) / 255.0f;
+		}
+		return color;
+	}
+
+	// Same factors as d3d11_state_factory::make_blend_state, alpha blends like colour
+	uint32_t blend_pixel(render_device::blend_e blend, const std::array<float, 4> &source, uint32_t packed_source, uint32_t packed_destination)
+	{
+		if (blend == render_device::blend_e::Opaque)
+		{
+			return packed_source;
+		}
+
+		auto destination = unpack_color(packed_destination);
+		auto source_alpha = source[3];
+
+		std::array<float, 4> result{};
+		for (uint32_t channel = 0; channel < 4; ++channel)
+		{
+			switch (blend)
+			{
+				case render_device::blend_e::Alpha:
+					result[channel] = source[channel] + destination[channel] * (1.0f - source_alpha);
+					break;
+				case render_device::blend_e::Additive:
+					result[channel] = source[channel] * source_alpha + destination[channel];
+					break;
+				case render_device::blend_e::NonPremultipled:
+					result[channel] = source[channel] * source_alpha + destination[channel] * (1.0f - source_alpha);
+					break;
+				default:
+					result[channel] = source[channel];
+					break;
+			}
+		}
+		return pack_color(result);
+	}
+
+	// Direct3D treats clockwise as front facing
+	bool is_culled(render_device::rasterizer_e rasterizer, bool is_clockwise)
+	{
+		switch (rasterizer)
+		{
+			case render_device::rasterizer_e::CullNone:
+				return false;
+			case render_device::rasterizer_e::CullClockwise:
+				return is_clockwise;
+			case render_device::rasterizer_e::CullAntiClockwise:
+			case render_device::rasterizer_e::Wireframe:
+				return not is_clockwise;
+		}
+		return false;
+	}
+
+	// Bit per clip plane the vertex lies outside of, 0 <= z <= w as in Direct3D
+	template <typename vertex_t>
+	uint32_t get_outcode(const vertex_t &v)
+	{
+		return (v.x < -v.w ? 0x01 : 0)
+		     | (v.x > v.w ? 0x02 : 0)
+		     | (v.y < -v.w ? 0x04 : 0)
+		     | (v.y > v.w ? 0x08 : 0)
+		     | (v.z < 0.0f ? 0x10 : 0)
+		     | (v.z > v.w ? 0x20 : 0);
+	}
+
+	template <typename vertex_t>
+	float get_plane_distance(const vertex_t &v, uint32_t plane)
+	{
+		switch (plane)
+		{
+			case 0: return v.w + v.x;
+			case 1: return v.w - v.x;
+			case 2: return v.w + v.y;
+			case 3: return v.w - v.y;
+			case 4: return v.z;
+			default: return v.w - v.z;
+		}
+	}
+
+	template <typename vertex_t>
+	vertex_t lerp(const vertex_t &a, const vertex_t &b, float t)
+	{
+		return {
+			a.x + (b.x - a.x) * t,
+			a.y + (b.y - a.y) * t,
+			a.z + (b.z - a.z) * t,
+			a.w + (b.w - a.w) * t
+		};
+	}
+
+	// Sutherland-Hodgman against every plane in plane_mask. edge_flags[i] marks
+	// the edge from vertex i to the next as part of the original triangle, edges
+	// made by the clip are not, so wireframe does not draw them.
+	template <typename vertex_t>
+	uint32_t clip_polygon(std::array<vertex_t, max_polygon_vertices> &polygon,
+	                      std::array<bool, max_polygon_vertices> &edge_flags,
+	                      uint32_t vertex_count,
+	                      uint32_t plane_mask)
+	{
+		std::array<vertex_t, max_polygon_vertices> clipped{};
+		std::array<bool, max_polygon_vertices> clipped_flags{};
+
+		for (uint32_t plane = 0; plane < 6 and vertex_count >= 3; ++plane)
+		{
+			if ((plane_mask & (1 << plane)) == 0)
+			{
+				continue;
+			}
+
+			uint32_t clipped_count = 0;
+			for (uint32_t i = 0; i < vertex_count; ++i)
+			{
+				const auto &current = polygon[i];
+				const auto &next = polygon[(i + 1) % vertex_count];
+				auto current_distance = get_plane_distance(current, plane),
+				     next_distance = get_plane_distance(next, plane);
+				auto current_inside = current_distance >= 0.0f,
+				     next_inside = next_distance >= 0.0f;
+
+				if (current_inside)
+				{
+					clipped[clipped_count] = current;
+					clipped_flags[clipped_count++] = edge_flags[i];
+				}
+				if (current_inside != next_inside)
+				{
+					clipped[clipped_count] = lerp(current, next, current_distance / (current_distance - next_distance));
+					clipped_flags[clipped_count++] = current_inside ? false : edge_flags[i];
+				}
+			}
+
+			polygon = clipped;
+			edge_flags = clipped_flags;
+			vertex_count = clipped_count;
+		}
+
+		return (vertex_count >= 3) ? vertex_count : 0;
+	}
+
+	// Lanes written out of a 4 bit mask
+	uint32_t count_bits(uint32_t mask)
+	{
+		return static_cast<uint32_t>(std::bitset<4>(mask).count());
+	}
+}
+
+software_render_device::software_render_device(const description &device_description)
+{
+	// Identity until the renderer binds its own transforms
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		view_projection[i * 5] = 1.0f;
+		world[i * 5] = 1.0f;
+	}
+
+	use_sse2 = SOFTWARE_RASTERIZER_SSE2 and not device_description.scalar_only;
+	resize_target(device_description.width, device_description.height);
+	call_count = 0; // the caller's calls only
+
+	auto thread_count = device_description.thread_count ? device_description.thread_count
+	                                                    : std::max(1U, std::thread::hardware_concurrency());
+	workers.reserve(thread_count - 1);
+	for (uint32_t i = 1; i < thread_count; ++i)
+	{
+		workers.emplace_back(&software_render_device::worker_loop, this);
+	}
+}
+
+software_render_device::~software_render_device()
+{
+	{
+		std::lock_guard<std::mutex> lock(work_lock);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+render_device::pipeline_handle software_render_device::create_pipeline(const pipeline_description &description)
+{
+	call_count++;
+
+	pipelines.push_back({ description.blend,
+	                      description.depth_stencil,
+	                      description.rasterizer,
+	                      description.input_layout,
+	                      description.topology,
+	                      true });
+	return static_cast<pipeline_handle>(pipelines.size() - 1);
+}
+
+void software_render_device::destroy_pipeline(pipeline_handle pipeline)
+{
+	assert(pipeline < pipelines.size() and pipelines[pipeline].is_alive);
+
+	call_count++;
+
+	pipelines[pipeline].is_alive = false;
+}
+
+render_device::mesh_handle software_render_device::create_mesh(const mesh_description &description)
+{
+	call_count++;
+
+	mesh_entry mesh{};
+	mesh.vertex_stride = description.vertex_stride;
+	mesh.vertex_count = description.vertex_count;
+
+	auto vertex_bytes = static_cast<const uint8_t *>(description.vertex_data);
+	mesh.vertex_data.assign(vertex_bytes, vertex_bytes + size_t(description.vertex_stride) * description.vertex_count);
+
+	// Kept at 32 bits so primitive assembly has one index type
+	if (description.index_type == index_type_e::encoded)
+	{
+		auto encoded_indices = static_cast<const uint8_t *>(description.index_data);
+		mesh.indices.resize(index_codec::read_header(encoded_indices, description.index_count).index_count);
+		index_codec::decode(encoded_indices, description.index_count, mesh.indices.data());
+	}
+	else
+	{
+		auto wide_indices = static_cast<const uint32_t *>(description.index_data);
+		mesh.indices.assign(wide_indices, wide_indices + description.index_count);
+	}
+	mesh.is_alive = true;
+
+	meshes.push_back(std::move(mesh));
+	return static_cast<mesh_handle>(meshes.size() - 1);
+}
+
+void software_render_device::destroy_mesh(mesh_handle mesh)
+{
+	assert(mesh < meshes.size() and meshes[mesh].is_alive);
+
+	call_count++;
+
+	if (current_mesh == mesh)
+	{
+		current_mesh = invalid_handle;
+	}
+	meshes[mesh] = {};
+}
+
+render_device::instance_stream_handle software_render_device::create_instance_stream(const instance_stream_description &description)
+{
+	assert(description.instance_stride >= sizeof(world) and description.instance_stride % sizeof(instance_row) == 0);
+
+	call_count++;
+
+	instance_stream_entry stream{};
+	stream.rows.resize(size_t(description.instance_stride / sizeof(instance_row)) * description.max_instances);
+	stream.instance_stride = description.instance_stride;
+	stream.max_instances = description.max_instances;
+	stream.is_alive = true;
+
+	instance_streams.push_back(std::move(stream));
+	return static_cast<instance_stream_handle>(instance_streams.size() - 1);
+}
+
+void software_render_device::destroy_instance_stream(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream].is_alive);
+
+	call_count++;
+
+	if (current_instances == stream)
+	{
+		current_instances = invalid_handle;
+	}
+	instance_streams[stream] = {};
+}
+
+void *software_render_device::map_instances(instance_stream_handle stream, uint32_t instance_count)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream].is_alive);
+	assert(instance_count <= instance_streams[stream].max_instances);
+
+	call_count++;
+
+	instance_streams[stream].instance_count = instance_count;
+	return instance_streams[stream].rows.data();
+}
+
+void software_render_device::unmap_instances(instance_stream_handle)
+{
+	call_count++;
+}
+
+void software_render_device::wait_for_frame()
+{
+	call_count++;
+}
+
+void software_render_device::begin_frame()
+{
+	call_count++;
+}
+
+void software_render_device::end_frame()
+{
+	call_count++;
+
+	flush();
+
+	last_frame_stats = frame_stats;
+	frame_stats = {};
+}
+
+void software_render_device::present()
+{
+	call_count++;
+}
+
+void software_render_device::resize()
+{
+	call_count++;
+}
+
+void software_render_device::clear(const std::array<float, 4> &clear_color)
+{
+	call_count++;
+
+	flush();
+
+	std::fill(color_buffer.begin(), color_buffer.end(), pack_color(clear_color));
+	std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+}
+
+void software_render_device::set_pipeline(pipeline_handle pipeline)
+{
+	assert(pipeline < pipelines.size() and pipelines[pipeline].is_alive);
+
+	call_count++;
+
+	current_pipeline = pipeline;
+}
+
+void software_render_device::set_mesh(mesh_handle mesh)
+{
+	assert(mesh < meshes.size() and meshes[mesh].is_alive);
+
+	call_count++;
+
+	current_mesh = mesh;
+}
+
+void software_render_device::set_instances(instance_stream_handle stream)
+{
+	assert(stream < instance_streams.size() and instance_streams[stream].is_alive);
+
+	call_count++;
+
+	current_instances = stream;
+}
+
+void software_render_device::set_constants(shader_stage_e stage, uint32_t slot, const void *data, uint32_t size)
+{
+	call_count++;
+
+	if (slot == 1 and stage == shader_stage_e::vertex and size >= sizeof(world))
+	{
+		std::memcpy(world.data(), data, sizeof(world));
+		return;
+	}
+
+	if (slot != 0)
+	{
+		return;
+	}
+
+	if (stage == shader_stage_e::vertex and size >= sizeof(view_projection))
+	{
+		std::memcpy(view_projection.data(), data, sizeof(view_projection));
+	}
+	else if (stage == shader_stage_e::pixel and size >= sizeof(pixel_color))
+	{
+		std::memcpy(pixel_color.data(), data, sizeof(pixel_color));
+	}
+}
+
+void software_render_device::draw()
+{
+	// Counted once, by draw_instanced
+	draw_instanced(1);
+}
+
+void software_render_device::draw_instanced(uint32_t instance_count)
+{
+	assert(current_pipeline < pipelines.size() and pipelines[current_pipeline].is_alive);
+	assert(current_mesh < meshes.size() and meshes[current_mesh].is_alive);
+
+	call_count++;
+
+	auto start_time = clock::now();
+
+	const auto &pipeline = pipelines[current_pipeline];
+	const auto &mesh = meshes[current_mesh];
+
+	// Instanced layouts take their world matrix per instance from the stream,
+	// anything else is transformed once and repeated
+	auto is_instanced = (pipeline.input_layout == input_layout_e::position_instanced);
+	assert(not is_instanced or (current_instances < instance_streams.size()
+	                            and instance_count <= instance_streams[current_instances].instance_count));
+	if (not is_instanced)
+	{
+		transform_vertices(mesh, pipeline.input_layout, world);
+	}
+
+	auto draw_index = static_cast<uint32_t>(draw_states.size());
+	draw_states.push_back({ pipeline.blend, pipeline.depth_stencil, pixel_color, pack_color(pixel_color) });
+
+	const auto &indices = mesh.indices;
+	auto index_count = static_cast<uint32_t>(indices.size());
+	const auto &v = transformed_vertices;
+
+	for (uint32_t instance = 0; instance < instance_count; ++instance)
+	{
+		if (is_instanced)
+		{
+			const auto &stream = instance_streams[current_instances];
+
+			std::array<float, 16> instance_world{};
+			std::memcpy(instance_world.data(), reinterpret_cast<const uint8_t *>(stream.rows.data()) + size_t(instance) * stream.instance_stride, sizeof(instance_world));
+			transform_vertices(mesh, pipeline.input_layout, instance_world);
+		}
+
+		switch (pipeline.topology)
+		{
+			case topology_e::triangle_list:
+				for (uint32_t i = 0; i + 2 < index_count; i += 3)
+				{
+					add_triangle(v[indices[i]], v[indices[i + 1]], v[indices[i + 2]], pipeline.rasterizer, draw_index);
+				}
+				break;
+			case topology_e::triangle_strip:
+				// Odd triangles swap their first two vertices to keep the strip's winding
+				for (uint32_t i = 0; i + 2 < index_count; ++i)
+				{
+					auto first = indices[i + (i & 1)],
+					     second = indices[i + 1 - (i & 1)];
+					add_triangle(v[first], v[second], v[indices[i + 2]], pipeline.rasterizer, draw_index);
+				}
+				break;
+			case topology_e::line_list:
+				for (uint32_t i = 0; i + 1 < index_count; i += 2)
+				{
+					add_line(v[indices[i]], v[indices[i + 1]], draw_index);
+				}
+				break;
+			case topology_e::point_list:
+				for (uint32_t i = 0; i < index_count; ++i)
+				{
+					add_line(v[indices[i]], v[indices[i]], draw_index);
+				}
+				break;
+		}
+	}
+
+	frame_stats.setup_time += clock::now() - start_time;
+}
+
+void software_render_device::resize_target(uint32_t new_width, uint32_t new_height)
+{
+	call_count++;
+
+	flush();
+
+	// A minimised window reports zero
+	width = std::clamp(new_width, 1U, max_target_size);
+	height = std::clamp(new_height, 1U, max_target_size);
+
+	// Padded to whole tiles, so four wide loads never leave the buffers
+	pitch = round_up(width, tile_size);
+	tiles_x = pitch / tile_size;
+	tiles_y = round_up(height, tile_size) / tile_size;
+
+	color_buffer.assign(size_t(pitch) * tiles_y * tile_size, 0);
+	depth_buffer.assign(size_t(pitch) * tiles_y * tile_size, 1.0f);
+	bins.resize(size_t(tiles_x) * tiles_y);
+}
+
+uint32_t software_render_device::get_width() const
+{
+	return width;
+}
+
+uint32_t software_render_device::get_height() const
+{
+	return height;
+}
+
+uint32_t software_render_device::get_pitch() const
+{
+	return pitch;
+}
+
+const std::vector<uint32_t> &software_render_device::get_color_buffer() const
+{
+	return color_buffer;
+}
+
+const std::vector<float> &software_render_device::get_depth_buffer() const
+{
+	return depth_buffer;
+}
+
+uint64_t software_render_device::get_call_count() const
+{
+	return call_count;
+}
+
+const software_render_device::statistics &software_render_device::get_frame_statistics() const
+{
+	return frame_stats;
+}
+
+const software_render_device::statistics &software_render_device::get_last_frame_statistics() const
+{
+	return last_frame_stats;
+}
+
+#pragma region "Setup"
+
+// Fixed function stand-in for the vertex shader, clip = position * world * view_projection
+void software_render_device::transform_vertices(const mesh_entry &mesh, input_layout_e input_layout, const std::array<float, 16> &object_world)
+{
+	PROFILE_SCOPE("software_render_device::transform_vertices");
+
+	transformed_vertices.resize(mesh.vertex_count);
+
+	// Combined once per draw or instance, transposed like view_projection. object_world
+	// is row major, so its transpose reads down its columns.
+	std::array<float, 16> m{};
+	for (uint32_t row = 0; row < 4; ++row)
+	{
+		for (uint32_t column = 0; column < 4; ++column)
+		{
+			m[row * 4 + column] = view_projection[row * 4 + 0] * object_world[column * 4 + 0]
+			                    + view_projection[row * 4 + 1] * object_world[column * 4 + 1]
+			                    + view_projection[row * 4 + 2] * object_world[column * 4 + 2]
+			                    + view_projection[row * 4 + 3] * object_world[column * 4 + 3];
+		}
+	}
+	for (uint32_t i = 0; i < mesh.vertex_count; ++i)
+	{
+		auto vertex_data = mesh.vertex_data.data() + size_t(i) * mesh.vertex_stride;
+
+		std::array<float, 4> position{ 0.0f, 0.0f, 0.0f, 1.0f };
+		switch (input_layout)
+		{
+			case input_layout_e::position:
+			case input_layout_e::position_texcoord:
+			case input_layout_e::position_instanced:
+				std::memcpy(position.data(), vertex_data, 3 * sizeof(float));
+				break;
+			case input_layout_e::packed_position_normal_texcoord:
+			{
+				std::array<uint16_t, 4> half_position{};
+				std::memcpy(half_position.data(), vertex_data, sizeof(half_position));
+				for (uint32_t axis = 0; axis < 4; ++axis)
+				{
+					position[axis] = half_to_float(half_position[axis]);
+				}
+				break;
+			}
+		}
+
+		// Constants are stored transposed for HLSL, each row is one output component
+		auto &output = transformed_vertices[i];
+		output.x = m[0] * position[0] + m[1] * position[1] + m[2] * position[2] + m[3] * position[3];
+		output.y = m[4] * position[0] + m[5] * position[1] + m[6] * position[2] + m[7] * position[3];
+		output.z = m[8] * position[0] + m[9] * position[1] + m[10] * position[2] + m[11] * position[3];
+		output.w = m[12] * position[0] + m[13] * position[1] + m[14] * position[2] + m[15] * position[3];
+	}
+}
+
+void software_render_device::add_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2, rasterizer_e rasterizer, uint32_t draw_index)
+{
+	frame_stats.triangles_submitted++;
+
+	auto outcode0 = get_outcode(v0),
+	     outcode1 = get_outcode(v1),
+	     outcode2 = get_outcode(v2);
+	if (outcode0 & outcode1 & outcode2)
+	{
+		frame_stats.triangles_culled++;
+		return;
+	}
+
+	std::array<clip_vertex, max_polygon_vertices> polygon{ v0, v1, v2 };
+	std::array<bool, max_polygon_vertices> edge_flags{ true, true, true };
+	uint32_t vertex_count = 3;
+
+	if (rasterizer == rasterizer_e::Wireframe)
+	{
+		// Only the near plane is clipped, so the screen edges of a polygon are never drawn.
+		// Lines far off screen cost nothing, they are walked within each tile only.
+		constexpr uint32_t near_plane = 0x10;
+		if ((outcode0 | outcode1 | outcode2) & near_plane)
+		{
+			vertex_count = clip_polygon(polygon, edge_flags, vertex_count, near_plane);
+		}
+
+		std::array<std::array<float, 3>, max_polygon_vertices> screen{};
+		float area = 0.0f;
+		for (uint32_t i = 0; i < vertex_count; ++i)
+		{
+			screen[i] = to_screen(polygon[i]);
+		}
+		for (uint32_t i = 0; i < vertex_count; ++i)
+		{
+			const auto &a = screen[i], &b = screen[(i + 1) % vertex_count];
+			area += a[0] * b[1] - b[0] * a[1];
+		}
+
+		if (area == 0.0f or is_culled(rasterizer, area > 0.0f))
+		{
+			frame_stats.triangles_culled++;
+			return;
+		}
+
+		for (uint32_t i = 0; i < vertex_count; ++i)
+		{
+			if (edge_flags[i])
+			{
+				add_screen_line(screen[i], screen[(i + 1) % vertex_count], draw_index);
+			}
+		}
+		return;
+	}
+
+	if ((outcode0 | outcode1 | outcode2) == 0)
+	{
+		setup_triangle(v0, v1, v2, rasterizer, draw_index);
+		return;
+	}
+
+	frame_stats.triangles_clipped++;
+	vertex_count = clip_polygon(polygon, edge_flags, vertex_count, outcode0 | outcode1 | outcode2);
+	if (vertex_count == 0)
+	{
+		frame_stats.triangles_culled++;
+		return;
+	}
+
+	for (uint32_t i = 1; i + 1 < vertex_count; ++i)
+	{
+		setup_triangle(polygon[0], polygon[i], polygon[i + 1], rasterizer, draw_index);
+	}
+}
+
+// Vertices are inside every clip plane by now
+void software_render_device::setup_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2, rasterizer_e rasterizer, uint32_t draw_index)
+{
+	std::array<std::array<float, 3>, 3> screen{ to_screen(v0), to_screen(v1), to_screen(v2) };
+
+	// Clamped before rounding, clipped vertices may sit a rounding error outside the target
+	auto max_x = static_cast<float>(width * subpixel_scale),
+	     max_y = static_cast<float>(height * subpixel_scale);
+	std::array<int32_t, 3> x{}, y{};
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		x[i] = static_cast<int32_t>(std::clamp(screen[i][0] * subpixel_scale, 0.0f, max_x) + 0.5f);
+		y[i] = static_cast<int32_t>(std::clamp(screen[i][1] * subpixel_scale, 0.0f, max_y) + 0.5f);
+	}
+
+	// Positive area is clockwise on screen, y points down
+	auto area = int64_t(x[1] - x[0]) * (y[2] - y[0]) - int64_t(x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0 or is_culled(rasterizer, area > 0))
+	{
+		frame_stats.triangles_culled++;
+		return;
+	}
+
+	// Edge functions below assume clockwise
+	if (area < 0)
+	{
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(screen[1], screen[2]);
+		area = -area;
+	}
+
+	triangle setup{};
+	setup.draw_index = draw_index;
+
+	auto left = std::min({ x[0], x[1], x[2] }), right = std::max({ x[0], x[1], x[2] }),
+	     top = std::min({ y[0], y[1], y[2] }), bottom = std::max({ y[0], y[1], y[2] });
+
+	// Pixels whose centres fall inside the bounds
+	auto first_x = (left - half_pixel + subpixel_scale - 1) >> subpixel_bits,
+	     last_x = std::min((right - half_pixel) >> subpixel_bits, static_cast<int32_t>(width) - 1),
+	     first_y = (top - half_pixel + subpixel_scale - 1) >> subpixel_bits,
+	     last_y = std::min((bottom - half_pixel) >> subpixel_bits, static_cast<int32_t>(height) - 1);
+	if (first_x > last_x or first_y > last_y)
+	{
+		frame_stats.triangles_culled++;
+		return;
+	}
+	setup.bounds = { static_cast<uint16_t>(first_x), static_cast<uint16_t>(first_y),
+	                 static_cast<uint16_t>(last_x), static_cast<uint16_t>(last_y) };
+
+	for (uint32_t edge = 0; edge < 3; ++edge)
+	{
+		auto next = (edge + 1) % 3;
+		setup.x[edge] = x[edge];
+		setup.y[edge] = y[edge];
+		setup.a[edge] = y[edge] - y[next];
+		setup.b[edge] = x[next] - x[edge];
+
+		// Top-left rule, pixel centres exactly on any other edge belong to the neighbour
+		auto is_top_left = setup.a[edge] > 0 or (setup.a[edge] == 0 and setup.b[edge] > 0);
+		setup.bias[edge] = is_top_left ? 0 : -1;
+	}
+
+	// Depth plane over pixel coordinates, sampled at pixel centres
+	std::array<float, 3> snapped_x{}, snapped_y{};
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		snapped_x[i] = static_cast<float>(x[i]) / subpixel_scale;
+		snapped_y[i] = static_cast<float>(y[i]) / subpixel_scale;
+	}
+	auto dx1 = snapped_x[1] - snapped_x[0], dy1 = snapped_y[1] - snapped_y[0], dz1 = screen[1][2] - screen[0][2],
+	     dx2 = snapped_x[2] - snapped_x[0], dy2 = snapped_y[2] - snapped_y[0], dz2 = screen[2][2] - screen[0][2];
+	auto inverse_area = 1.0f / (dx1 * dy2 - dx2 * dy1);
+
+	setup.z_dx = (dz1 * dy2 - dz2 * dy1) * inverse_area;
+	setup.z_dy = (dx1 * dz2 - dx2 * dz1) * inverse_area;
+	setup.z_origin = screen[0][2] + setup.z_dx * (0.5f - snapped_x[0]) + setup.z_dy * (0.5f - snapped_y[0]);
+
+	auto primitive = static_cast<uint32_t>(triangles.size());
+	triangles.push_back(setup);
+	bin(setup.bounds, primitive);
+
+	frame_stats.triangles_rasterized++;
+}
+
+void software_render_device::add_line(const clip_vertex &v0, const clip_vertex &v1, uint32_t draw_index)
+{
+	auto outcode0 = get_outcode(v0),
+	     outcode1 = get_outcode(v1);
+	if (outcode0 & outcode1)
+	{
+		return;
+	}
+
+	// Near plane only, pixels beyond the far plane are dropped while rasterizing
+	auto start = v0, end = v1;
+	auto start_distance = get_plane_distance(start, 4),
+	     end_distance = get_plane_distance(end, 4);
+	if (start_distance < 0.0f)
+	{
+		start = lerp(start, end, start_distance / (start_distance - end_distance));
+	}
+	else if (end_distance < 0.0f)
+	{
+		end = lerp(start, end, start_distance / (start_distance - end_distance));
+	}
+
+	add_screen_line(to_screen(start), to_screen(end), draw_index);
+}
+
+void software_render_device::add_screen_line(const std::array<float, 3> &start, const std::array<float, 3> &end, uint32_t draw_index)
+{
+	auto min_x = std::floor(std::min(start[0], end[0])), max_x = std::floor(std::max(start[0], end[0])),
+	     min_y = std::floor(std::min(start[1], end[1])), max_y = std::floor(std::max(start[1], end[1]));
+	if (max_x < 0.0f or max_y < 0.0f or min_x >= static_cast<float>(width) or min_y >= static_cast<float>(height))
+	{
+		return;
+	}
+
+	line setup{};
+	setup.start = start;
+	setup.end = end;
+	setup.draw_index = draw_index;
+	setup.bounds = { static_cast<uint16_t>(std::max(min_x, 0.0f)),
+	                 static_cast<uint16_t>(std::max(min_y, 0.0f)),
+	                 static_cast<uint16_t>(std::min(max_x, static_cast<float>(width - 1))),
+	                 static_cast<uint16_t>(std::min(max_y, static_cast<float>(height - 1))) };
+
+	auto primitive = static_cast<uint32_t>(lines.size());
+	lines.push_back(setup);
+	bin(setup.bounds, primitive | line_flag);
+
+	frame_stats.lines_rasterized++;
+}
+
+void software_render_device::bin(const std::array<uint16_t, 4> &bounds, uint32_t primitive)
+{
+	for (uint32_t tile_y = bounds[1] / tile_size; tile_y <= bounds[3] / tile_size; ++tile_y)
+	{
+		for (uint32_t tile_x = bounds[0] / tile_size; tile_x <= bounds[2] / tile_size; ++tile_x)
+		{
+			bins[tile_y * tiles_x + tile_x].push_back(primitive);
+		}
+	}
+}
+
+std::array<float, 3> software_render_device::to_screen(const clip_vertex &v) const
+{
+	auto inverse_w = 1.0f / v.w;
+	return {
+		(v.x * inverse_w * 0.5f + 0.5f) * static_cast<float>(width),
+		(0.5f - v.y * inverse_w * 0.5f) * static_cast<float>(height),
+		v.z * inverse_w
+	};
+}
+
+#pragma endregion
+
+#pragma region "Rasterization"
+
+void software_render_device::flush()
+{
+	if (triangles.empty() and lines.empty())
+	{
+		draw_states.clear();
+		return;
+	}
+
+	PROFILE_SCOPE("software_render_device::flush");
+	auto start_time = clock::now();
+
+	next_tile.store(0, std::memory_order_relaxed);
+	pixels_written.store(0, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(work_lock);
+		work_generation++;
+		busy_workers = static_cast<uint32_t>(workers.size());
+	}
+	work_ready.notify_all();
+
+	rasterize_tiles();
+
+	{
+		std::unique_lock<std::mutex> lock(work_lock);
+		work_done.wait(lock, [this]()
+		{
+			return busy_workers == 0;
+		});
+	}
+
+	for (auto &tile_bin : bins)
+	{
+		tile_bin.clear();
+	}
+	triangles.clear();
+	lines.clear();
+	draw_states.clear();
+
+	frame_stats.pixels_written += pixels_written.load(std::memory_order_relaxed);
+	frame_stats.raster_time += clock::now() - start_time;
+}
+
+// Threads pull whole tiles until none are left, a tile is never shared
+void software_render_device::rasterize_tiles()
+{
+	auto tile_count = tiles_x * tiles_y;
+	uint64_t written = 0;
+
+	for (;;)
+	{
+		auto tile = next_tile.fetch_add(1, std::memory_order_relaxed);
+		if (tile >= tile_count)
+		{
+			break;
+		}
+		written += rasterize_tile(tile);
+	}
+
+	pixels_written.fetch_add(written, std::memory_order_relaxed);
+}
+
+uint64_t software_render_device::rasterize_tile(uint32_t tile)
+{
+	const auto &tile_bin = bins[tile];
+	if (tile_bin.empty())
+	{
+		return 0;
+	}
+
+	auto tile_x = (tile % tiles_x) * tile_size,
+	     tile_y = (tile / tiles_x) * tile_size;
+	std::array<uint32_t, 4> tile_bounds{ tile_x,
+	                                     tile_y,
+	                                     std::min(tile_x + tile_size, width) - 1,
+	                                     std::min(tile_y + tile_size, height) - 1 };
+
+	uint64_t written = 0;
+	for (auto primitive : tile_bin)
+	{
+		if (primitive & line_flag)
+		{
+			written += rasterize_line(lines[primitive & ~line_flag], tile_bounds);
+		}
+		else
+		{
+			written += rasterize_triangle(triangles[primitive], tile_bounds);
+		}
+	}
+	return written;
+}
+
+// Four pixels of a row at a time. Edge functions step by integer adds only,
+// coverage is the sign bit of the three edges or'd together.
+uint64_t software_render_device::rasterize_triangle(const triangle &setup, const std::array<uint32_t, 4> &tile_bounds)
+{
+	auto min_x = std::max<uint32_t>(setup.bounds[0], tile_bounds[0]),
+	     min_y = std::max<uint32_t>(setup.bounds[1], tile_bounds[1]),
+	     max_x = std::min<uint32_t>(setup.bounds[2], tile_bounds[2]),
+	     max_y = std::min<uint32_t>(setup.bounds[3], tile_bounds[3]);
+	if (min_x > max_x or min_y > max_y)
+	{
+		return 0;
+	}
+
+	const auto &state = draw_states[setup.draw_index];
+	auto depth_test = state.depth_stencil != depth_stencil_e::None,
+	     depth_write = state.depth_stencil == depth_stencil_e::ReadWrite;
+
+	// Groups start on a multiple of four, tiles are too, so no group leaves its tile
+	auto start_x = min_x & ~3U;
+	uint64_t written = 0;
+
+	for (auto py = min_y; py <= max_y; ++py)
+	{
+		auto center_x = static_cast<int32_t>(start_x) * subpixel_scale + half_pixel,
+		     center_y = static_cast<int32_t>(py) * subpixel_scale + half_pixel;
+
+		std::array<int32_t, 3> row{};
+		for (uint32_t edge = 0; edge < 3; ++edge)
+		{
+			row[edge] = setup.a[edge] * (center_x - setup.x[edge]) + setup.b[edge] * (center_y - setup.y[edge]) + setup.bias[edge];
+		}
+		auto row_z = setup.z_origin + setup.z_dy * static_cast<float>(py);
+		auto row_index = size_t(py) * pitch;
+
+#if SOFTWARE_RASTERIZER_SSE2
+		if (use_sse2)
+		{
+			__m128i edges[3], group_steps[3];
+			for (uint32_t edge = 0; edge < 3; ++edge)
+			{
+				auto pixel_step = setup.a[edge] * subpixel_scale;
+				edges[edge] = _mm_add_epi32(_mm_set1_epi32(row[edge]), _mm_setr_epi32(0, pixel_step, 2 * pixel_step, 3 * pixel_step));
+				group_steps[edge] = _mm_set1_epi32(4 * pixel_step);
+			}
+			// Depth as the scalar path computes it, so both write the same bits
+			const auto row_z_lanes = _mm_set1_ps(row_z),
+			           z_dx_lanes = _mm_set1_ps(setup.z_dx);
+			const auto end_x = _mm_set1_epi32(static_cast<int32_t>(max_x) + 1);
+			const auto color = _mm_set1_epi32(static_cast<int32_t>(state.packed_color));
+			auto lane_x = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(start_x)), _mm_setr_epi32(0, 1, 2, 3));
+
+			for (auto px = start_x; px <= max_x; px += 4)
+			{
+				auto outside = _mm_or_si128(_mm_or_si128(edges[0], edges[1]), edges[2]);
+				auto mask = _mm_andnot_si128(_mm_srai_epi32(outside, 31), _mm_cmpgt_epi32(end_x, lane_x));
+
+				if (_mm_movemask_ps(_mm_castsi128_ps(mask)))
+				{
+					auto index = row_index + px;
+					auto z = _mm_add_ps(row_z_lanes, _mm_mul_ps(z_dx_lanes, _mm_cvtepi32_ps(lane_x)));
+
+					if (depth_test)
+					{
+						auto depth = _mm_loadu_ps(&depth_buffer[index]);
+						mask = _mm_and_si128(mask, _mm_castps_si128(_mm_cmple_ps(z, depth)));
+						if (depth_write)
+						{
+							auto mask_ps = _mm_castsi128_ps(mask);
+							_mm_storeu_ps(&depth_buffer[index], _mm_or_ps(_mm_and_ps(mask_ps, z), _mm_andnot_ps(mask_ps, depth)));
+						}
+					}
+
+					auto lanes = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+					if (state.blend == blend_e::Opaque)
+					{
+						auto pixels = reinterpret_cast<__m128i *>(&color_buffer[index]);
+						auto destination = _mm_loadu_si128(pixels);
+						_mm_storeu_si128(pixels, _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, destination)));
+					}
+					else
+					{
+						for (uint32_t lane = 0; lane < 4; ++lane)
+						{
+							if (lanes & (1 << lane))
+							{
+								auto &pixel = color_buffer[index + lane];
+								pixel = blend_pixel(state.blend, state.color, state.packed_color, pixel);
+							}
+						}
+					}
+					written += count_bits(lanes);
+				}
+
+				for (uint32_t edge = 0; edge < 3; ++edge)
+				{
+					edges[edge] = _mm_add_epi32(edges[edge], group_steps[edge]);
+				}
+				lane_x = _mm_add_epi32(lane_x, _mm_set1_epi32(4));
+			}
+			continue;
+		}
+#endif
+		for (auto px = start_x; px <= max_x; ++px)
+		{
+			if (px >= min_x and (row[0] | row[1] | row[2]) >= 0)
+			{
+				auto index = row_index + px;
+				auto z = row_z + setup.z_dx * static_cast<float>(px);
+
+				if (not depth_test or z <= depth_buffer[index])
+				{
+					if (depth_write)
+					{
+						depth_buffer[index] = z;
+					}
+					color_buffer[index] = blend_pixel(state.blend, state.color, state.packed_color, color_buffer[index]);
+					written++;
+				}
+			}
+
+			for (uint32_t edge = 0; edge < 3; ++edge)
+			{
+				row[edge] += setup.a[edge] * subpixel_scale;
+			}
+		}
+	}
+
+	return written;
+}
+
+// Walks the major axis one pixel at a time, within the tile only
+uint64_t software_render_device::rasterize_line(const line &setup, const std::array<uint32_t, 4> &tile_bounds)
+{
+	auto min_x = std::max<uint32_t>(setup.bounds[0], tile_bounds[0]),
+	     min_y = std::max<uint32_t>(setup.bounds[1], tile_bounds[1]),
+	     max_x = std::min<uint32_t>(setup.bounds[2], tile_bounds[2]),
+	     max_y = std::min<uint32_t>(setup.bounds[3], tile_bounds[3]);
+	if (min_x > max_x or min_y > max_y)
+	{
+		return 0;
+	}
+
+	const auto &state = draw_states[setup.draw_index];
+	auto depth_test = state.depth_stencil != depth_stencil_e::None,
+	     depth_write = state.depth_stencil == depth_stencil_e::ReadWrite;
+
+	auto dx = setup.end[0] - setup.start[0],
+	     dy = setup.end[1] - setup.start[1],
+	     dz = setup.end[2] - setup.start[2];
+	auto is_x_major = std::abs(dx) >= std::abs(dy);
+	auto major_delta = is_x_major ? dx : dy;
+	auto major_start = is_x_major ? setup.start[0] : setup.start[1];
+	auto minor_start = is_x_major ? setup.start[1] : setup.start[0];
+	auto minor_delta = is_x_major ? dy : dx;
+
+	auto first = is_x_major ? min_x : min_y,
+	     last = is_x_major ? max_x : max_y;
+	auto minor_min = is_x_major ? min_y : min_x,
+	     minor_max = is_x_major ? max_y : max_x;
+
+	uint64_t written = 0;
+	for (auto major = first; major <= last; ++major)
+	{
+		auto t = (major_delta != 0.0f) ? std::clamp((static_cast<float>(major) + 0.5f - major_start) / major_delta, 0.0f, 1.0f) : 0.0f;
+		auto minor_position = std::floor(minor_start + minor_delta * t);
+		if (minor_position < static_cast<float>(minor_min) or minor_position > static_cast<float>(minor_max))
+		{
+			continue;
+		}
+
+		auto minor = static_cast<uint32_t>(minor_position);
+		auto index = is_x_major ? size_t(minor) * pitch + major : size_t(major) * pitch + minor;
+		auto z = setup.start[2] + dz * t;
+		if (z < 0.0f or z > 1.0f)
+		{
+			continue;
+		}
+
+		if (not depth_test or z <= depth_buffer[index])
+		{
+			if (depth_write)
+			{
+				depth_buffer[index] = z;
+			}
+			color_buffer[index] = blend_pixel(state.blend, state.color, state.packed_color, color_buffer[index]);
+			written++;
+		}
+	}
+	return written;
+}
+
+void software_render_device::worker_loop()
+{
+	profiler::set_thread_name("software_render_device");
+
+	uint64_t seen_generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(work_lock);
+			work_ready.wait(lock, [this, seen_generation]()
+			{
+				return stopping or work_generation != seen_generation;
+			});
+			if (stopping)
+			{
+				return;
+			}
+			seen_generation = work_generation;
+		}
+
+		rasterize_tiles();
+
+		std::lock_guard<std::mutex> lock(work_lock);
+		if (--busy_workers == 0)
+		{
+			work_done.notify_one();
+		}
+	}
+}
+
+#pragma endregion
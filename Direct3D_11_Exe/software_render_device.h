@@ -0,0 +1,239 @@
+#pragma once
+
+#include "render_device.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	// Reference rasterizer, renders on the CPU into an in-memory RGBA8 colour
+	// buffer and a float depth buffer. Runs anywhere and needs no GPU.
+	//
+	// Shader bytecode is not executed. Vertex positions are transformed by the
+	// row major object matrix bound to vertex constant slot 1, or for
+	// position_instanced by each instance's matrix in the bound instance stream,
+	// then by the float4x4 bound to slot 0, as position.vs does, and every pixel takes the
+	// float4 bound to pixel constant slot 0, or opaque white.
+	// Blend, depth and rasterizer modes match the d3d11_state_factory descriptions.
+	//
+	// Draws are clipped, set up and binned into tiles as they arrive. The tiles
+	// are rasterized in parallel when the frame ends or the target is cleared,
+	// each tile by one thread, so draws stay in order within every pixel.
+	// Output is deterministic but not bit exact with any GPU.
+	class software_render_device : public render_device
+	{
+	public:
+		static constexpr uint32_t tile_size = 32;
+		// Keeps every edge function inside 32 bits at subpixel precision
+		static constexpr uint32_t max_target_size = 2048;
+
+		struct description
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t thread_count; // including the calling thread, 0 for one per core
+			bool scalar_only;      // skips the SSE2 path, the output is the same either way
+		};
+
+		struct statistics
+		{
+			uint64_t triangles_submitted;
+			uint64_t triangles_culled;     // back facing, off screen or covering no pixel centre
+			uint64_t triangles_clipped;    // crossed a clip plane and were split
+			uint64_t triangles_rasterized; // after clipping, so may exceed those submitted
+			uint64_t lines_rasterized;     // wireframe edges, lines and points
+			uint64_t pixels_written;
+			std::chrono::duration<double, std::milli> setup_time;
+			std::chrono::duration<double, std::milli> raster_time;
+		};
+
+	public:
+		software_render_device() = delete;
+		software_render_device(const description &device_description);
+		~software_render_device() override;
+
+		pipeline_handle create_pipeline(const pipeline_description &description) override;
+		void destroy_pipeline(pipeline_handle pipeline) override;
+
+		mesh_handle create_mesh(const mesh_description &description) override;
+		void destroy_mesh(mesh_handle mesh) override;
+
+		instance_stream_handle create_instance_stream(const instance_stream_description &description) override;
+		void destroy_instance_stream(instance_stream_handle stream) override;
+		void *map_instances(instance_stream_handle stream, uint32_t instance_count) override;
+		void unmap_instances(instance_stream_handle stream) override;
+
+		void wait_for_frame() override;
+		void begin_frame() override;
+		void end_frame() override;
+		void present() override;
+		// There is no window, use resize_target
+		void resize() override;
+
+		void clear(const std::array<float, 4> &clear_color) override;
+		void set_pipeline(pipeline_handle pipeline) override;
+		void set_mesh(mesh_handle mesh) override;
+		void set_instances(instance_stream_handle stream) override;
+		void set_constants(shader_stage_e stage, uint32_t slot, const void *data, uint32_t size) override;
+
+		void draw() override;
+		// Without position_instanced every instance lands in the same place
+		void draw_instanced(uint32_t instance_count) override;
+
+		// Clamped to between 1 and max_target_size on each axis
+		void resize_target(uint32_t width, uint32_t height);
+
+		// Complete once end_frame returns. Rows are get_pitch() pixels apart,
+		// colours are R8G8B8A8 with red in the lowest byte.
+		uint32_t get_width() const;
+		uint32_t get_height() const;
+		uint32_t get_pitch() const;
+		const std::vector<uint32_t> &get_color_buffer() const;
+		const std::vector<float> &get_depth_buffer() const;
+
+		// Calls made outside begin_frame and end_frame count towards the next frame
+		const statistics &get_frame_statistics() const;
+		const statistics &get_last_frame_statistics() const;
+
+		// Every render_device call and resize_target over the device's lifetime
+		uint64_t get_call_count() const;
+
+	private:
+		struct clip_vertex
+		{
+			float x, y, z, w;
+		};
+
+		struct pipeline_entry
+		{
+			blend_e blend;
+			depth_stencil_e depth_stencil;
+			rasterizer_e rasterizer;
+			input_layout_e input_layout;
+			topology_e topology;
+			bool is_alive;
+		};
+
+		struct mesh_entry
+		{
+			std::vector<uint8_t> vertex_data;
+			uint32_t vertex_stride;
+			uint32_t vertex_count;
+			std::vector<uint32_t> indices;
+			bool is_alive;
+		};
+
+		struct alignas(16) instance_row
+		{
+			std::array<float, 4> values;
+		};
+
+		struct instance_stream_entry
+		{
+			std::vector<instance_row> rows;
+			uint32_t instance_stride;
+			uint32_t max_instances;
+			uint32_t instance_count;
+			bool is_alive;
+		};
+
+		// What pixels of one draw need, triangles and lines refer to it by index
+		struct draw_state
+		{
+			blend_e blend;
+			depth_stencil_e depth_stencil;
+			std::array<float, 4> color;
+			uint32_t packed_color;
+		};
+
+		// Edge functions in 28.4 fixed point, e = a * (x - x0) + b * (y - y0) + bias
+		// is positive inside. Depth is a plane over pixel coordinates.
+		struct triangle
+		{
+			std::array<int32_t, 3> x;
+			std::array<int32_t, 3> y;
+			std::array<int32_t, 3> a;
+			std::array<int32_t, 3> b;
+			std::array<int32_t, 3> bias;
+			float z_origin;
+			float z_dx;
+			float z_dy;
+			std::array<uint16_t, 4> bounds; // min x, min y, max x, max y, in pixels
+			uint32_t draw_index;
+		};
+
+		// Pixel coordinates, points are lines with both ends the same
+		struct line
+		{
+			std::array<float, 3> start;
+			std::array<float, 3> end;
+			std::array<uint16_t, 4> bounds;
+			uint32_t draw_index;
+		};
+
+	private:
+		void transform_vertices(const mesh_entry &mesh, input_layout_e input_layout, const std::array<float, 16> &object_world);
+		void add_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2, rasterizer_e rasterizer, uint32_t draw_index);
+		void setup_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2, rasterizer_e rasterizer, uint32_t draw_index);
+		void add_line(const clip_vertex &v0, const clip_vertex &v1, uint32_t draw_index);
+		void add_screen_line(const std::array<float, 3> &start, const std::array<float, 3> &end, uint32_t draw_index);
+		void bin(const std::array<uint16_t, 4> &bounds, uint32_t primitive);
+
+		void flush();
+		void rasterize_tiles();
+		uint64_t rasterize_tile(uint32_t tile);
+		uint64_t rasterize_triangle(const triangle &setup, const std::array<uint32_t, 4> &tile_bounds);
+		uint64_t rasterize_line(const line &setup, const std::array<uint32_t, 4> &tile_bounds);
+		void worker_loop();
+
+		std::array<float, 3> to_screen(const clip_vertex &v) const;
+
+	private:
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t pitch = 0;
+		uint32_t tiles_x = 0;
+		uint32_t tiles_y = 0;
+		bool use_sse2 = false;
+		std::vector<uint32_t> color_buffer;
+		std::vector<float> depth_buffer;
+
+		std::vector<pipeline_entry> pipelines;
+		std::vector<mesh_entry> meshes;
+		std::vector<instance_stream_entry> instance_streams;
+		pipeline_handle current_pipeline = invalid_handle;
+		mesh_handle current_mesh = invalid_handle;
+		instance_stream_handle current_instances = invalid_handle;
+		std::array<float, 16> view_projection{};
+		std::array<float, 16> world{};
+		std::array<float, 4> pixel_color{ 1.0f, 1.0f, 1.0f, 1.0f };
+
+		// Pending until the next flush, bins hold primitive indices in submission order
+		std::vector<clip_vertex> transformed_vertices;
+		std::vector<draw_state> draw_states;
+		std::vector<triangle> triangles;
+		std::vector<line> lines;
+		std::vector<std::vector<uint32_t>> bins;
+
+		std::vector<std::thread> workers;
+		std::mutex work_lock;
+		std::condition_variable work_ready;
+		std::condition_variable work_done;
+		uint64_t work_generation = 0;
+		uint32_t busy_workers = 0;
+		bool stopping = false;
+		std::atomic<uint32_t> next_tile{ 0 };
+		std::atomic<uint64_t> pixels_written{ 0 };
+
+		statistics frame_stats{};
+		statistics last_frame_stats{};
+		uint64_t call_count = 0;
+	};
+}
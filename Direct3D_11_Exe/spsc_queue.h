@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+namespace direct3d_11_eg
+{
+	// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+	// Slots are allocated up front, pushing and popping never allocate or lock.
+	// Each side keeps its own index on a separate cache line, plus a cached copy
+	// of the other side's, so the shared lines are only read when the cache says
+	// the queue looks full or empty.
+	template <typename value_t>
+	class spsc_queue
+	{
+	public:
+		spsc_queue() = delete;
+		// capacity must be a power of two
+		explicit spsc_queue(uint32_t capacity) :
+			mask(capacity - 1),
+			slots(std::make_unique<value_t[]>(capacity))
+		{
+			assert(capacity > 0 and (capacity & (capacity - 1)) == 0);
+		}
+
+		spsc_queue(const spsc_queue &) = delete;
+		spsc_queue &operator=(const spsc_queue &) = delete;
+
+		// Producer thread only, false when full
+		bool try_push(const value_t &value)
+		{
+			auto tail = producer.index.load(std::memory_order_relaxed);
+			if (tail - producer.cached_index > mask)
+			{
+				producer.cached_index = consumer.index.load(std::memory_order_acquire);
+				if (tail - producer.cached_index > mask)
+				{
+					return false;
+				}
+			}
+
+			slots[tail & mask] = value;
+			producer.index.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only, false when empty
+		bool try_pop(value_t &value)
+		{
+			auto head = consumer.index.load(std::memory_order_relaxed);
+			if (head == consumer.cached_index)
+			{
+				consumer.cached_index = producer.index.load(std::memory_order_acquire);
+				if (head == consumer.cached_index)
+				{
+					return false;
+				}
+			}
+
+			value = slots[head & mask];
+			consumer.index.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only, pops up to max_count in order and returns how many.
+		// Reads and publishes the indices once for the whole batch.
+		uint32_t try_pop_batch(value_t *values, uint32_t max_count)
+		{
+			auto head = consumer.index.load(std::memory_order_relaxed);
+			consumer.cached_index = producer.index.load(std::memory_order_acquire);
+
+			auto count = static_cast<uint32_t>(std::min<uint64_t>(consumer.cached_index - head, max_count));
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				values[i] = slots[(head + i) & mask];
+			}
+
+			consumer.index.store(head + count, std::memory_order_release);
+			return count;
+		}
+
+		// Either thread, exact only while the other side is idle
+		uint32_t size() const
+		{
+			auto head = consumer.index.load(std::memory_order_acquire),
+			     tail = producer.index.load(std::memory_order_acquire);
+			return static_cast<uint32_t>(tail - head);
+		}
+
+		uint32_t get_capacity() const
+		{
+			return static_cast<uint32_t>(mask + 1);
+		}
+
+	private:
+		static constexpr size_t cache_line_size = 64;
+
+		// Indices count every push and pop, 64 bits never wrap in practice
+		struct alignas(cache_line_size) side
+		{
+			std::atomic<uint64_t> index{ 0 };
+			uint64_t cached_index = 0; // last seen index of the other side
+		};
+
+		const uint64_t mask;
+		std::unique_ptr<value_t[]> slots;
+
+		side producer;
+		side consumer;
+	};
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "render_device.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace direct3d_11_eg
+{
+	// Shares blend, depth stencil, rasterizer and sampler objects between pipeline states,
+	// each distinct state value is only ever created once per device.
+	// factory_t owns the device and makes the objects, one make_ function and
+	// one state type per kind. direct3d.h instantiates it over Direct3D 11 as state_cache,
+	// the tests over a stand-in that records what it was asked to create.
+	template <typename factory_t>
+	class basic_state_cache
+	{
+	public:
+		using blend_state_t = typename factory_t::blend_state_t;
+		using depth_stencil_state_t = typename factory_t::depth_stencil_state_t;
+		using rasterizer_state_t = typename factory_t::rasterizer_state_t;
+		using sampler_state_t = typename factory_t::sampler_state_t;
+
+		struct statistics
+		{
+			uint32_t hits;
+			uint32_t misses;
+		};
+
+	public:
+		basic_state_cache() = delete;
+		explicit basic_state_cache(const factory_t &state_factory) :
+			factory(state_factory)
+		{}
+
+		blend_state_t get_blend_state(render_device::blend_e blend)
+		{
+			return find_or_make(blend_states, blend, [&]() { return factory.make_blend_state(blend); });
+		}
+
+		depth_stencil_state_t get_depth_stencil_state(render_device::depth_stencil_e depth_stencil)
+		{
+			return find_or_make(depth_stencil_states, depth_stencil, [&]() { return factory.make_depth_stencil_state(depth_stencil); });
+		}
+
+		rasterizer_state_t get_rasterizer_state(render_device::rasterizer_e rasterizer)
+		{
+			return find_or_make(rasterizer_states, rasterizer, [&]() { return factory.make_rasterizer_state(rasterizer); });
+		}
+
+		sampler_state_t get_sampler_state(render_device::sampler_e sampler)
+		{
+			return find_or_make(sampler_states, sampler, [&]() { return factory.make_sampler_state(sampler); });
+		}
+
+		const statistics &get_statistics() const
+		{
+			return stats;
+		}
+
+	private:
+		template <typename key_t, typename state_t, typename make_fn_t>
+		state_t find_or_make(std::unordered_map<key_t, state_t> &states, key_t key, const make_fn_t &make_state)
+		{
+			auto it = states.find(key);
+			if (it != states.end())
+			{
+				stats.hits++;
+				return it->second;
+			}
+
+			stats.misses++;
+			auto state = make_state();
+			states.insert({ key, state });
+			return state;
+		}
+
+	private:
+		factory_t factory;
+
+		std::unordered_map<render_device::blend_e, blend_state_t> blend_states;
+		std::unordered_map<render_device::depth_stencil_e, depth_stencil_state_t> depth_stencil_states;
+		std::unordered_map<render_device::rasterizer_e, rasterizer_state_t> rasterizer_states;
+		std::unordered_map<render_device::sampler_e, sampler_state_t> sampler_states;
+
+		statistics stats{};
+	};
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+namespace direct3d_11_eg
+{
+	// Shadow copy of the state bound to the immediate context.
+	// Set calls matching what is already bound are dropped before they reach the driver.
+	// context_t wraps the context, one type and one set_ function per piece of state.
+	// direct3d.h instantiates it over Direct3D 11 as state_tracker, the tests over
+	// a stand-in that records the calls reaching it.
+	template <typename context_t>
+	class basic_state_tracker
+	{
+	public:
+		using blend_state_t = typename context_t::blend_state_t;
+		using depth_stencil_state_t = typename context_t::depth_stencil_state_t;
+		using rasterizer_state_t = typename context_t::rasterizer_state_t;
+		using sampler_state_t = typename context_t::sampler_state_t;
+		using input_layout_t = typename context_t::input_layout_t;
+		using vertex_shader_t = typename context_t::vertex_shader_t;
+		using pixel_shader_t = typename context_t::pixel_shader_t;
+		using buffer_t = typename context_t::buffer_t;
+		using topology_t = typename context_t::topology_t;
+		using format_t = typename context_t::format_t;
+
+		static constexpr uint32_t max_vertex_buffers = 4;
+
+		struct statistics
+		{
+			uint32_t issued;
+			uint32_t skipped;
+		};
+
+	public:
+		basic_state_tracker() = delete;
+		explicit basic_state_tracker(const context_t &tracked_context) :
+			context(tracked_context)
+		{}
+
+		void begin_frame()
+		{
+			last_frame_stats = frame_stats;
+			frame_stats = {};
+		}
+
+		// Forget everything, for when the context was changed behind the tracker's back
+		void invalidate()
+		{
+			known_state = 0;
+
+			blend_state = {};
+			depth_stencil_state = {};
+			rasterizer_state = {};
+			sampler_state = {};
+
+			primitive_topology = {};
+			input_layout = {};
+			vertex_shader = {};
+			pixel_shader = {};
+
+			vertex_buffers = {};
+			index_buffer = {};
+			index_format = {};
+			index_offset = 0;
+		}
+
+		void set_blend_state(const blend_state_t &new_blend_state)
+		{
+			if (filter(blend_bit, blend_state == new_blend_state))
+			{
+				return;
+			}
+
+			blend_state = new_blend_state;
+			context.set_blend_state(blend_state);
+		}
+
+		void set_depth_stencil_state(const depth_stencil_state_t &new_depth_stencil_state)
+		{
+			if (filter(depth_stencil_bit, depth_stencil_state == new_depth_stencil_state))
+			{
+				return;
+			}
+
+			depth_stencil_state = new_depth_stencil_state;
+			context.set_depth_stencil_state(depth_stencil_state);
+		}
+
+		void set_rasterizer_state(const rasterizer_state_t &new_rasterizer_state)
+		{
+			if (filter(rasterizer_bit, rasterizer_state == new_rasterizer_state))
+			{
+				return;
+			}
+
+			rasterizer_state = new_rasterizer_state;
+			context.set_rasterizer_state(rasterizer_state);
+		}
+
+		void set_sampler_state(const sampler_state_t &new_sampler_state)
+		{
+			if (filter(sampler_bit, sampler_state == new_sampler_state))
+			{
+				return;
+			}
+
+			sampler_state = new_sampler_state;
+			context.set_sampler_state(sampler_state);
+		}
+
+		void set_primitive_topology(topology_t new_primitive_topology)
+		{
+			if (filter(primitive_topology_bit, primitive_topology == new_primitive_topology))
+			{
+				return;
+			}
+
+			primitive_topology = new_primitive_topology;
+			context.set_primitive_topology(primitive_topology);
+		}
+
+		void set_input_layout(const input_layout_t &new_input_layout)
+		{
+			if (filter(input_layout_bit, input_layout == new_input_layout))
+			{
+				return;
+			}
+
+			input_layout = new_input_layout;
+			context.set_input_layout(input_layout);
+		}
+
+		void set_vertex_shader(const vertex_shader_t &new_vertex_shader)
+		{
+			if (filter(vertex_shader_bit, vertex_shader == new_vertex_shader))
+			{
+				return;
+			}
+
+			vertex_shader = new_vertex_shader;
+			context.set_vertex_shader(vertex_shader);
+		}
+
+		void set_pixel_shader(const pixel_shader_t &new_pixel_shader)
+		{
+			if (filter(pixel_shader_bit, pixel_shader == new_pixel_shader))
+			{
+				return;
+			}
+
+			pixel_shader = new_pixel_shader;
+			context.set_pixel_shader(pixel_shader);
+		}
+
+		void set_vertex_buffer(uint32_t slot, const buffer_t &vertex_buffer, uint32_t stride, uint32_t offset)
+		{
+			assert(slot < max_vertex_buffers);
+			auto &binding = vertex_buffers.at(slot);
+
+			if (filter(vertex_buffer_bit << slot,
+			           binding.buffer == vertex_buffer
+			           and binding.stride == stride
+			           and binding.offset == offset))
+			{
+				return;
+			}
+
+			binding = { vertex_buffer, stride, offset };
+			context.set_vertex_buffer(slot, binding.buffer, binding.stride, binding.offset);
+		}
+
+		void set_index_buffer(const buffer_t &new_index_buffer, format_t format, uint32_t offset)
+		{
+			if (filter(index_buffer_bit,
+			           index_buffer == new_index_buffer
+			           and index_format == format
+			           and index_offset == offset))
+			{
+				return;
+			}
+
+			index_buffer = new_index_buffer;
+			index_format = format;
+			index_offset = offset;
+			context.set_index_buffer(index_buffer, index_format, index_offset);
+		}
+
+		const context_t &get_context() const
+		{
+			return context;
+		}
+
+		const statistics &get_frame_statistics() const
+		{
+			return frame_stats;
+		}
+
+		const statistics &get_last_frame_statistics() const
+		{
+			return last_frame_stats;
+		}
+
+	private:
+		enum state_bit : uint32_t
+		{
+			blend_bit = 1 << 0,
+			depth_stencil_bit = 1 << 1,
+			rasterizer_bit = 1 << 2,
+			sampler_bit = 1 << 3,
+			primitive_topology_bit = 1 << 4,
+			input_layout_bit = 1 << 5,
+			vertex_shader_bit = 1 << 6,
+			pixel_shader_bit = 1 << 7,
+			index_buffer_bit = 1 << 8,
+			vertex_buffer_bit = 1 << 9, // one bit per slot from here on
+		};
+
+		// True when the call can be dropped
+		bool filter(uint32_t state, bool is_redundant)
+		{
+			if ((known_state & state) and is_redundant)
+			{
+				frame_stats.skipped++;
+				return true;
+			}
+
+			known_state |= state;
+			frame_stats.issued++;
+			return false;
+		}
+
+	private:
+		struct vertex_buffer_binding
+		{
+			buffer_t buffer;
+			uint32_t stride;
+			uint32_t offset;
+		};
+
+		context_t context;
+
+		// Shadowed state is only trusted once it has been set through the tracker
+		uint32_t known_state = 0;
+
+		blend_state_t blend_state{};
+		depth_stencil_state_t depth_stencil_state{};
+		rasterizer_state_t rasterizer_state{};
+		sampler_state_t sampler_state{};
+
+		topology_t primitive_topology{};
+		input_layout_t input_layout{};
+		vertex_shader_t vertex_shader{};
+		pixel_shader_t pixel_shader{};
+
+		std::array<vertex_buffer_binding, max_vertex_buffers> vertex_buffers{};
+		buffer_t index_buffer{};
+		format_t index_format{};
+		uint32_t index_offset = 0;
+
+		statistics frame_stats{};
+		statistics last_frame_stats{};
+	};
+}
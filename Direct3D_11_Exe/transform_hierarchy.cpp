@@ -0,0 +1,376 @@
+#include "transform_hierarchy.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define TRANSFORM_HIERARCHY_SSE2 1
+#include <xmmintrin.h>
+#else
+#define TRANSFORM_HIERARCHY_SSE2 0
+#endif
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	// Levels smaller than this update on the calling thread
+	constexpr uint32_t nodes_per_job = 1'024;
+
+	// result = a * b, each result row is a's row weighting b's rows
+	void multiply(const transform_hierarchy::matrix &a, const transform_hierarchy::matrix &b, transform_hierarchy::matrix &result)
+	{
+#if TRANSFORM_HIERARCHY_SSE2
+		auto b0 = _mm_load_ps(b.m[0]),
+		     b1 = _mm_load_ps(b.m[1]),
+		     b2 = _mm_load_ps(b.m[2]),
+		     b3 = _mm_load_ps(b.m[3]);
+
+		for (uint32_t row = 0; row < 4; ++row)
+		{
+			const auto &r = a.m[row];
+			auto sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[0]), b0), _mm_mul_ps(_mm_set1_ps(r[1]), b1)),
+			                      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[2]), b2), _mm_mul_ps(_mm_set1_ps(r[3]), b3)));
+			_mm_store_ps(result.m[row], sum);
+		}
+#else
+		for (uint32_t row = 0; row < 4; ++row)
+		{
+			for (uint32_t column = 0; column < 4; ++column)
+			{
+				result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column]
+				                      + a.m[row][2] * b.m[2][column] + a.m[row][3] * b.m[3][column];
+			}
+		}
+#endif
+	}
+}
+
+transform_hierarchy::transform_hierarchy(uint32_t max_nodes) :
+	capacity(max_nodes)
+{
+	local.reserve(max_nodes);
+	world.reserve(max_nodes);
+	parent_index.reserve(max_nodes);
+	first_child.reserve(max_nodes);
+	child_count.reserve(max_nodes);
+	depth.reserve(max_nodes);
+	dirty.reserve(max_nodes);
+	updated_in.reserve(max_nodes);
+	index_node.reserve(max_nodes);
+	node_index.reserve(max_nodes);
+
+	level_start.push_back(0);
+}
+
+transform_hierarchy::~transform_hierarchy()
+{}
+
+transform_hierarchy::node_id transform_hierarchy::add(node_id parent, const matrix &local_matrix)
+{
+	assert(node_count < capacity && "transform hierarchy is full");
+	assert(parent == invalid_node or parent < node_count);
+
+	auto parent_slot = parent == invalid_node ? no_parent : node_index[parent];
+	auto node_depth = parent == invalid_node ? 0 : depth[parent_slot] + 1;
+
+	// Appending keeps the order when the node lands in the last level or starts
+	// a new one, and its parent's children are still the last nodes
+	auto level_count = static_cast<uint32_t>(level_start.size()) - 1;
+	if (is_sorted)
+	{
+		auto ends_levels = node_depth + 1 >= level_count;
+		auto ends_siblings = parent_slot == no_parent
+		                     or child_count[parent_slot] == 0
+		                     or first_child[parent_slot] + child_count[parent_slot] == node_count;
+		is_sorted = ends_levels and ends_siblings;
+	}
+
+	auto node = node_count++;
+	local.push_back(local_matrix);
+	world.push_back(local_matrix);
+	parent_index.push_back(parent_slot);
+	first_child.push_back(0);
+	child_count.push_back(0);
+	depth.push_back(node_depth);
+	dirty.push_back(1);
+	updated_in.push_back(0);
+	index_node.push_back(node);
+	node_index.push_back(node);
+
+	if (parent_slot != no_parent)
+	{
+		if (child_count[parent_slot] == 0)
+		{
+			first_child[parent_slot] = node;
+		}
+		child_count[parent_slot]++;
+	}
+
+	if (is_sorted)
+	{
+		if (node_depth == level_count)
+		{
+			level_start.push_back(node_count);
+			level_dirty.push_back(1);
+		}
+		level_start.back() = node_count;
+		level_dirty[node_depth] = 1;
+	}
+	return node;
+}
+
+void transform_hierarchy::set_local(node_id node, const matrix &local_matrix)
+{
+	assert(node < node_count);
+
+	auto index = node_index[node];
+	local[index] = local_matrix;
+	dirty[index] = 1;
+	if (is_sorted)
+	{
+		level_dirty[depth[index]] = 1;
+	}
+}
+
+const transform_hierarchy::matrix &transform_hierarchy::get_local(node_id node) const
+{
+	assert(node < node_count);
+
+	return local[node_index[node]];
+}
+
+uint32_t transform_hierarchy::update(job_system *jobs)
+{
+	PROFILE_SCOPE("transform_hierarchy::update");
+	auto start_time = clock::now();
+
+	if (not is_sorted)
+	{
+		sort_breadth_first();
+	}
+	update_count++;
+
+	stats.updated_nodes = 0;
+	stats.skipped_levels = 0;
+
+	auto level_count = static_cast<uint32_t>(level_start.size()) - 1;
+	for (uint32_t level = 0; level < level_count; ++level)
+	{
+		if (not level_dirty[level])
+		{
+			stats.skipped_levels++;
+			continue;
+		}
+		level_dirty[level] = 0;
+
+		auto first = level_start[level],
+		     last = level_start[level + 1];
+
+		uint32_t changed = 0;
+		if (jobs and last - first > nodes_per_job)
+		{
+			std::atomic<uint32_t> job_changed{ 0 };
+			jobs->parallel_for(last - first, nodes_per_job, [&](uint32_t begin, uint32_t end)
+			{
+				job_changed.fetch_add(update_range(first + begin, first + end), std::memory_order_relaxed);
+			});
+			changed = job_changed.load(std::memory_order_relaxed);
+		}
+		else
+		{
+			changed = update_range(first, last);
+		}
+
+		// Updated nodes marked their children dirty
+		if (changed > 0 and level + 1 < level_count)
+		{
+			level_dirty[level + 1] = 1;
+		}
+		stats.updated_nodes += changed;
+	}
+
+	stats.node_count = node_count;
+	stats.level_count = level_count;
+	stats.update_time = clock::now() - start_time;
+	return stats.updated_nodes;
+}
+
+const transform_hierarchy::matrix &transform_hierarchy::get_world(node_id node) const
+{
+	assert(node < node_count);
+
+	return world[node_index[node]];
+}
+
+bool transform_hierarchy::was_updated(node_id node) const
+{
+	assert(node < node_count);
+
+	return updated_in[node_index[node]] == update_count;
+}
+
+uint32_t transform_hierarchy::get_index(node_id node) const
+{
+	assert(node < node_count);
+
+	return node_index[node];
+}
+
+const transform_hierarchy::matrix *transform_hierarchy::get_world_matrices() const
+{
+	return world.data();
+}
+
+uint32_t transform_hierarchy::get_node_count() const
+{
+	return node_count;
+}
+
+const transform_hierarchy::statistics &transform_hierarchy::get_statistics() const
+{
+	return stats;
+}
+
+// Breadth first from the roots, which orders the nodes by depth and keeps
+// siblings together. Only runs after nodes were added out of that order, so it may allocate.
+void transform_hierarchy::sort_breadth_first()
+{
+	PROFILE_SCOPE("transform_hierarchy::sort_breadth_first");
+
+	// Children of every node by current index
+	std::vector<uint32_t> child_offsets(size_t(node_count) + 1, 0);
+	for (uint32_t i = 0; i < node_count; ++i)
+	{
+		if (parent_index[i] != no_parent)
+		{
+			child_offsets[parent_index[i] + 1]++;
+		}
+	}
+	for (uint32_t i = 0; i < node_count; ++i)
+	{
+		child_offsets[i + 1] += child_offsets[i];
+	}
+	std::vector<uint32_t> children(node_count);
+	auto next_child = child_offsets;
+	for (uint32_t i = 0; i < node_count; ++i)
+	{
+		if (parent_index[i] != no_parent)
+		{
+			children[next_child[parent_index[i]]++] = i;
+		}
+	}
+
+	std::vector<uint32_t> order;
+	order.reserve(node_count);
+	for (uint32_t i = 0; i < node_count; ++i)
+	{
+		if (parent_index[i] == no_parent)
+		{
+			order.push_back(i);
+		}
+	}
+	for (size_t k = 0; k < order.size(); ++k)
+	{
+		auto i = order[k];
+		order.insert(order.end(), children.begin() + child_offsets[i], children.begin() + child_offsets[i + 1]);
+	}
+
+	std::vector<uint32_t> new_index(node_count);
+	for (uint32_t k = 0; k < node_count; ++k)
+	{
+		new_index[order[k]] = k;
+	}
+
+	auto permute = [&](auto &values)
+	{
+		auto source = values;
+		for (uint32_t i = 0; i < node_count; ++i)
+		{
+			values[new_index[i]] = source[i];
+		}
+	};
+	permute(local);
+	permute(world);
+	permute(parent_index);
+	permute(depth);
+	permute(dirty);
+	permute(updated_in);
+	permute(index_node);
+
+	std::fill(child_count.begin(), child_count.end(), 0);
+	level_start.clear();
+	for (uint32_t i = 0; i < node_count; ++i)
+	{
+		auto &parent = parent_index[i];
+		if (parent != no_parent)
+		{
+			parent = new_index[parent];
+			if (child_count[parent] == 0)
+			{
+				first_child[parent] = i;
+			}
+			child_count[parent]++;
+		}
+		node_index[index_node[i]] = i;
+
+		if (i == 0 or depth[i] != depth[i - 1])
+		{
+			level_start.push_back(i);
+		}
+	}
+	level_start.push_back(node_count);
+
+	level_dirty.assign(level_start.size() - 1, 1);
+	is_sorted = true;
+}
+
+uint32_t transform_hierarchy::update_range(uint32_t first, uint32_t last)
+{
+	uint32_t changed = 0;
+	for (auto i = first; i < last;)
+	{
+		// Skip clean nodes eight at a time, never reading past the range
+		if (i + sizeof(uint64_t) <= last)
+		{
+			uint64_t word = 0;
+			std::memcpy(&word, &dirty[i], sizeof(word));
+			if (word == 0)
+			{
+				i += sizeof(word);
+				continue;
+			}
+		}
+
+		if (dirty[i])
+		{
+			dirty[i] = 0;
+
+			auto parent = parent_index[i];
+			if (parent == no_parent)
+			{
+				world[i] = local[i];
+			}
+			else
+			{
+				multiply(local[i], world[parent], world[i]);
+			}
+			updated_in[i] = update_count;
+			changed++;
+
+			// Children form one run in the next level, no other job writes it
+			if (child_count[i] > 0)
+			{
+				std::memset(&dirty[first_child[i]], 1, child_count[i]);
+			}
+		}
+		++i;
+	}
+	return changed;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace direct3d_11_eg
+{
+	class job_system;
+
+	// Parent relative transforms resolved to world matrices once per frame.
+	//  * nodes are stored breadth first, each level one contiguous range and the
+	//    children of a node next to each other, so a level only reads the one
+	//    above it and its nodes update in parallel
+	//  * setting a local matrix marks the node dirty, updating a node marks its
+	//    children, clean runs of nodes are skipped a word at a time and clean
+	//    levels entirely
+	//  * world matrices are row vector, as DirectXMath lays them out, and sit in
+	//    one array that can be bound as per object shader constants directly
+	// Node ids are stable, their index into the world array changes only when a
+	// node added since the last update broke that order and everything is re-sorted.
+	class transform_hierarchy
+	{
+	public:
+		using node_id = uint32_t;
+		static constexpr node_id invalid_node = UINT32_MAX;
+
+		struct alignas(16) matrix
+		{
+			float m[4][4];
+		};
+
+		struct statistics
+		{
+			uint32_t node_count;
+			uint32_t level_count;
+			uint32_t updated_nodes; // in the last update
+			uint32_t skipped_levels;
+			std::chrono::duration<double, std::micro> update_time;
+		};
+
+	public:
+		transform_hierarchy() = delete;
+		transform_hierarchy(uint32_t max_nodes);
+		~transform_hierarchy();
+
+		// The parent must already exist, invalid_node adds a root
+		node_id add(node_id parent, const matrix &local);
+		void set_local(node_id node, const matrix &local);
+		const matrix &get_local(node_id node) const;
+
+		// Recomputes what changed, level by level, spreading large levels over the jobs.
+		// Returns how many nodes were recomputed.
+		uint32_t update(job_system *jobs = nullptr);
+
+		// As of the last update
+		const matrix &get_world(node_id node) const;
+		bool was_updated(node_id node) const;
+
+		uint32_t get_index(node_id node) const;
+		const matrix *get_world_matrices() const;
+		uint32_t get_node_count() const;
+
+		const statistics &get_statistics() const;
+
+	private:
+		void sort_breadth_first();
+		uint32_t update_range(uint32_t first, uint32_t last);
+
+	private:
+		static constexpr uint32_t no_parent = UINT32_MAX;
+
+		uint32_t capacity = 0;
+		uint32_t node_count = 0;
+
+		// By index, breadth first
+		std::vector<matrix> local;
+		std::vector<matrix> world;
+		std::vector<uint32_t> parent_index;
+		std::vector<uint32_t> first_child;
+		std::vector<uint32_t> child_count;
+		std::vector<uint32_t> depth;
+		std::vector<uint8_t> dirty;
+		std::vector<uint32_t> updated_in; // update_count when the world matrix was last written
+		std::vector<node_id> index_node;
+
+		std::vector<uint32_t> node_index;
+
+		// Level n is [level_start[n], level_start[n + 1])
+		std::vector<uint32_t> level_start;
+		std::vector<uint8_t> level_dirty;
+		bool is_sorted = true;
+
+		uint32_t update_count = 1;
+		statistics stats{};
+	};
+}
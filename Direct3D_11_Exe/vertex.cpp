@@ -0,0 +1,45 @@
+#include "vertex.h"
+
+using namespace direct3d_11_eg;
+using namespace DirectX;
+
+namespace
+{
+	using position_format = format_traits<DXGI_FORMAT_R16G16B16A16_FLOAT>;
+	using normal_format = format_traits<DXGI_FORMAT_R8G8B8A8_SNORM>;
+	using texcoord_format = format_traits<DXGI_FORMAT_R16G16_UNORM>;
+}
+
+void direct3d_11_eg::pack_vertices(const XMFLOAT3 *positions,
+                                   const XMFLOAT3 *normals,
+                                   const XMFLOAT2 *texcoords,
+                                   size_t count,
+                                   packed_vertex *output)
+{
+	const XMVECTOR default_normal = XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f);
+	const XMVECTOR default_texcoord = XMVectorZero();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto &out = output[i];
+
+		// w = 1 so the shader can read position as a float4 point
+		position_format::encode(out.position, XMVectorSetW(XMLoadFloat3(&positions[i]), 1.0f));
+
+		normal_format::encode(out.normal, normals ? XMVector3Normalize(XMLoadFloat3(&normals[i]))
+		                                          : default_normal);
+
+		texcoord_format::encode(out.texcoord, texcoords ? XMLoadFloat2(&texcoords[i])
+		                                                : default_texcoord);
+	}
+}
+
+void direct3d_11_eg::pack_instances(const XMMATRIX *transforms,
+                                    size_t count,
+                                    instance *output)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		XMStoreFloat4x4A(&output[i].transform, transforms[i]);
+	}
+}
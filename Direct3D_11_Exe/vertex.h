@@ -1,11 +1,57 @@
 #pragma once
 
+#include "vertex_layout.h"
+
+#include <cstddef>
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 namespace direct3d_11_eg
 {
 	struct vertex
 	{
 		DirectX::XMFLOAT3 position;
+
+		using layout = vertex_layout<vertex_attribute<position_semantic, DXGI_FORMAT_R32G32B32_FLOAT>>;
+	};
+	static_assert(sizeof(vertex) == vertex::layout::vertex_stride, "vertex does not match its layout");
+
+	// Quantised vertex, 16 bytes against 32 for the float equivalent.
+	// Positions keep an 11 bit mantissa, normals 8 bits per axis and
+	// texcoords must lie in [0, 1] to survive UNORM packing.
+	struct packed_vertex
+	{
+		DirectX::PackedVector::XMHALF4 position;
+		DirectX::PackedVector::XMBYTEN4 normal;
+		DirectX::PackedVector::XMUSHORTN2 texcoord;
+
+		using layout = vertex_layout<vertex_attribute<position_semantic, DXGI_FORMAT_R16G16B16A16_FLOAT>,
+		                             vertex_attribute<normal_semantic, DXGI_FORMAT_R8G8B8A8_SNORM>,
+		                             vertex_attribute<texcoord_semantic, DXGI_FORMAT_R16G16_UNORM>>;
 	};
+	static_assert(sizeof(packed_vertex) == packed_vertex::layout::vertex_stride, "packed_vertex does not match its layout");
+	static_assert(offsetof(packed_vertex, normal) == packed_vertex::layout::offsets[1], "packed_vertex normal offset mismatch");
+	static_assert(offsetof(packed_vertex, texcoord) == packed_vertex::layout::offsets[2], "packed_vertex texcoord offset mismatch");
+	static_assert(sizeof(packed_vertex) == 16, "packed_vertex should stay 16 bytes");
+
+	// Encodes float source streams into packed vertices, normals and
+	// texcoords may be null
+	void pack_vertices(const DirectX::XMFLOAT3 *positions,
+	                   const DirectX::XMFLOAT3 *normals,
+	                   const DirectX::XMFLOAT2 *texcoords,
+	                   size_t count,
+	                   packed_vertex *output);
+
+	// Per-instance vertex data, rows are 16 byte aligned for SIMD stores
+	struct instance
+	{
+		DirectX::XMFLOAT4X4A transform;
+	};
+	static_assert(sizeof(instance) % 16 == 0, "instance must pack into whole float4 registers");
+
+	// Stores transforms row by row with aligned stores, output is usually
+	// mapped instance stream memory so it is never read
+	void pack_instances(const DirectX::XMMATRIX *transforms,
+	                    size_t count,
+	                    instance *output);
 }
\ No newline at end of file
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+namespace direct3d_11_eg
+{
+	// Storage type and SIMD encoder for each DXGI vertex format we accept.
+	// Encoders go through DirectXMath, which uses SSE for the normalised
+	// forms and F16C for half floats when _XM_F16C_INTRINSICS_ is defined.
+	template <DXGI_FORMAT format>
+	struct format_traits;
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R32G32B32A32_FLOAT>
+	{
+		using storage_t = DirectX::XMFLOAT4;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::XMStoreFloat4(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R32G32B32_FLOAT>
+	{
+		using storage_t = DirectX::XMFLOAT3;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::XMStoreFloat3(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R32G32_FLOAT>
+	{
+		using storage_t = DirectX::XMFLOAT2;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::XMStoreFloat2(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R16G16B16A16_FLOAT>
+	{
+		using storage_t = DirectX::PackedVector::XMHALF4;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreHalf4(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R16G16_FLOAT>
+	{
+		using storage_t = DirectX::PackedVector::XMHALF2;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreHalf2(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R16G16B16A16_SNORM>
+	{
+		using storage_t = DirectX::PackedVector::XMSHORTN4;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreShortN4(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R16G16B16A16_UNORM>
+	{
+		using storage_t = DirectX::PackedVector::XMUSHORTN4;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreUShortN4(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R16G16_SNORM>
+	{
+		using storage_t = DirectX::PackedVector::XMSHORTN2;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreShortN2(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R16G16_UNORM>
+	{
+		using storage_t = DirectX::PackedVector::XMUSHORTN2;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreUShortN2(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R8G8B8A8_SNORM>
+	{
+		using storage_t = DirectX::PackedVector::XMBYTEN4;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreByteN4(&out, value); }
+	};
+
+	template <>
+	struct format_traits<DXGI_FORMAT_R8G8B8A8_UNORM>
+	{
+		using storage_t = DirectX::PackedVector::XMUBYTEN4;
+		static void encode(storage_t &out, DirectX::FXMVECTOR value) { DirectX::PackedVector::XMStoreUByteN4(&out, value); }
+	};
+
+	// Semantic names, shared by every layout that uses them
+	struct position_semantic { static constexpr const char *name = "POSITION"; };
+	struct normal_semantic { static constexpr const char *name = "NORMAL"; };
+	struct texcoord_semantic { static constexpr const char *name = "TEXCOORD"; };
+	struct instance_transform_semantic { static constexpr const char *name = "INSTANCE_TRANSFORM"; };
+
+	// One input element; per-instance attributes step once per instance
+	template <typename semantic_t,
+	          DXGI_FORMAT format_v,
+	          uint32_t semantic_index_v = 0,
+	          uint32_t slot_v = 0,
+	          D3D11_INPUT_CLASSIFICATION classification_v = D3D11_INPUT_PER_VERTEX_DATA>
+	struct vertex_attribute
+	{
+		using traits = format_traits<format_v>;
+		using storage_t = typename traits::storage_t;
+
+		static constexpr const char *semantic_name = semantic_t::name;
+		static constexpr uint32_t semantic_index = semantic_index_v;
+		static constexpr DXGI_FORMAT format = format_v;
+		static constexpr uint32_t slot = slot_v;
+		static constexpr D3D11_INPUT_CLASSIFICATION classification = classification_v;
+		static constexpr uint32_t step_rate = (classification_v == D3D11_INPUT_PER_INSTANCE_DATA) ? 1 : 0;
+		static constexpr uint32_t size = sizeof(storage_t);
+	};
+
+	template <typename semantic_t, DXGI_FORMAT format_v, uint32_t semantic_index_v, uint32_t slot_v>
+	using instance_attribute = vertex_attribute<semantic_t, format_v, semantic_index_v, slot_v, D3D11_INPUT_PER_INSTANCE_DATA>;
+
+	// Input layout built entirely at compile time. Attributes are packed in
+	// declaration order per input slot, with no D3D11_APPEND_ALIGNED_ELEMENT,
+	// so the offsets can be checked against the C++ vertex struct.
+	template <typename... attribute_ts>
+	struct vertex_layout
+	{
+		static constexpr uint32_t element_count = sizeof...(attribute_ts);
+		static_assert(element_count > 0, "vertex layout needs at least one attribute");
+
+		static constexpr std::array<uint32_t, element_count> sizes = { attribute_ts::size... };
+		static constexpr std::array<uint32_t, element_count> slots = { attribute_ts::slot... };
+
+		static constexpr std::array<uint32_t, element_count> make_offsets()
+		{
+			std::array<uint32_t, element_count> offsets{};
+			for (uint32_t i = 0; i < element_count; ++i)
+			{
+				for (uint32_t j = 0; j < i; ++j)
+				{
+					if (slots[j] == slots[i])
+					{
+						offsets[i] += sizes[j];
+					}
+				}
+			}
+			return offsets;
+		}
+		static constexpr std::array<uint32_t, element_count> offsets = make_offsets();
+
+		static constexpr uint32_t stride(uint32_t slot)
+		{
+			uint32_t total = 0;
+			for (uint32_t i = 0; i < element_count; ++i)
+			{
+				if (slots[i] == slot)
+				{
+					total += sizes[i];
+				}
+			}
+			return total;
+		}
+		static constexpr uint32_t vertex_stride = stride(0);
+
+		static constexpr bool is_aligned()
+		{
+			// D3D11 wants every element on a 4 byte boundary
+			for (uint32_t i = 0; i < element_count; ++i)
+			{
+				if (offsets[i] % 4 != 0 or stride(slots[i]) % 4 != 0)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		static_assert(is_aligned(), "vertex attributes must be 4 byte aligned");
+
+		template <size_t... index>
+		static constexpr std::array<D3D11_INPUT_ELEMENT_DESC, element_count> make_elements(std::index_sequence<index...>)
+		{
+			return { D3D11_INPUT_ELEMENT_DESC{ attribute_ts::semantic_name,
+			                                   attribute_ts::semantic_index,
+			                                   attribute_ts::format,
+			                                   attribute_ts::slot,
+			                                   offsets[index],
+			                                   attribute_ts::classification,
+			                                   attribute_ts::step_rate }... };
+		}
+		static constexpr std::array<D3D11_INPUT_ELEMENT_DESC, element_count> elements = make_elements(std::index_sequence_for<attribute_ts...>{});
+	};
+
+	// Index buffer format for a width from index_codec::select_index_size
+	constexpr DXGI_FORMAT get_index_format(uint32_t index_size)
+	{
+		return (index_size == sizeof(uint16_t)) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	}
+}
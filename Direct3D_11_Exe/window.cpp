@@ -1,4 +1,5 @@
 #include "window.h"
+#include "profiler.h"
 
 #include "window_implementation.inl"
 
@@ -25,6 +26,10 @@ window::window(std::wstring_view title, const size &window_size, const style win
 	                    default_window_style,
 	                    default_window_style_ex);
 
+	// Relative mouse motion, free of pointer ballistics and the screen edge
+	RAWINPUTDEVICE raw_mouse{ 0x01, 0x02, 0, window_impl->m_hWnd };
+	RegisterRawInputDevices(&raw_mouse, 1, sizeof(raw_mouse));
+
 	change_style(window_style);
 	
 	if (window_icon)
@@ -39,12 +44,6 @@ window::window(std::wstring_view title, const size &window_size, const style win
 window::~window()
 {}
 
-void window::set_message_callback(message_type msg, const callback_method &callback)
-{
-	uint16_t message_index = static_cast<uint16_t>(msg);
-	window_impl->callback_methods[message_index] = callback;
-}
-
 void window::show()
 {
 	window_impl->ShowWindow(SW_SHOWNORMAL);
@@ -100,6 +99,8 @@ void direct3d_11_eg::window::change_size(const size &window_size)
 
 void window::process_messages()
 {
+	PROFILE_SCOPE("window::process_messages");
+
 	BOOL has_more_messages = TRUE;
 	while (has_more_messages)
 	{
@@ -121,8 +122,28 @@ void window::process_messages()
 	}
 }
 
+void window::wait_for_messages()
+{
+	WaitMessage();
+}
+
+void window::close()
+{
+	window_impl->PostMessage(WM_CLOSE);
+}
+
+void window::set_close_handler(std::function<void()> handler)
+{
+	window_impl->close_handler = std::move(handler);
+}
+
 HWND window::handle() const
 {
 	return window_impl->m_hWnd;
 }
 
+input_queue &window::get_input()
+{
+	return window_impl->input;
+}
+
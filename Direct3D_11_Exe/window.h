@@ -1,10 +1,12 @@
 #pragma once
 
+#include "input_queue.h"
+
 #include <Windows.h>
+#include <functional>
 #include <string_view>
 #include <memory>
 #include <cstdint>
-#include <functional>
 
 namespace direct3d_11_eg
 {
@@ -24,30 +26,32 @@ namespace direct3d_11_eg
 			fullscreen
 		};
 
-		enum class message_type
-		{
-			resize,
-			activate,
-			keypress
-		};
-		static constexpr uint8_t max_message_types = 3;
-
-		//using callback_method = auto (*) (uintptr_t, uintptr_t) -> bool;
-		using callback_method = std::function<bool(uintptr_t, uintptr_t)>;
+		// Input events the window can hold before its consumer drains them
+		static constexpr uint32_t input_capacity = 4096;
 
 	public:
 		window() = delete;
 		window(std::wstring_view title, const size &window_size, const style window_style = style::normal, uint16_t window_icon = 0);
 		~window();
 
-		void set_message_callback(message_type msg, const callback_method &callback);
 		void show();
 		void change_style(const style window_style);
 		void change_size(const size &window_size);
 		void process_messages();
+		// Sleeps until a message arrives, for a thread that only pumps messages
+		void wait_for_messages();
+
+		// Posts a close request, safe from any thread
+		void close();
+		// Runs on the window thread when it is asked to close, before the window is destroyed
+		void set_close_handler(std::function<void()> handler);
 
 		HWND handle() const;
 
+		// Keys, mouse, raw mouse motion, size and activation, pushed as they
+		// are dispatched. Drained by a single consumer on any thread.
+		input_queue &get_input();
+
 	private:
 		struct window_implementation;
 
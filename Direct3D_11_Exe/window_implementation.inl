@@ -2,7 +2,9 @@
 
 #include <atlbase.h>
 #include <atlwin.h>
-#include <array>
+#include <windowsx.h>
+
+#include <functional>
 
 using namespace direct3d_11_eg;
 
@@ -19,14 +21,40 @@ struct window::window_implementation : public CWindowImpl<window::window_impleme
 	}
 
 	BEGIN_MSG_MAP(atl_window)
+		MESSAGE_HANDLER(WM_CLOSE, on_wnd_close)
 		MESSAGE_HANDLER(WM_DESTROY, on_wnd_destroy)
 		MESSAGE_HANDLER(WM_PAINT, on_wnd_paint)
 
 		MESSAGE_HANDLER(WM_ACTIVATEAPP, on_wnd_activate)
 		MESSAGE_HANDLER(WM_SIZE, on_wnd_resize)
-		MESSAGE_HANDLER(WM_KEYUP, on_wnd_keypress)
+
+		MESSAGE_HANDLER(WM_KEYDOWN, on_wnd_key)
+		MESSAGE_HANDLER(WM_KEYUP, on_wnd_key)
+		MESSAGE_HANDLER(WM_SYSKEYDOWN, on_wnd_key)
+		MESSAGE_HANDLER(WM_SYSKEYUP, on_wnd_key)
+		MESSAGE_HANDLER(WM_CHAR, on_wnd_character)
+
+		MESSAGE_HANDLER(WM_MOUSEMOVE, on_wnd_mouse_move)
+		MESSAGE_RANGE_HANDLER(WM_LBUTTONDOWN, WM_MBUTTONDBLCLK, on_wnd_mouse_button)
+		MESSAGE_RANGE_HANDLER(WM_XBUTTONDOWN, WM_XBUTTONDBLCLK, on_wnd_mouse_button)
+		MESSAGE_HANDLER(WM_MOUSEWHEEL, on_wnd_mouse_wheel)
+		MESSAGE_HANDLER(WM_INPUT, on_wnd_raw_input)
 	END_MSG_MAP()
 
+	// Escape and Alt+F4 both end up here, whoever draws into the window
+	// is told to stop before the window goes
+	LRESULT on_wnd_close(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+	{
+		if (close_handler)
+		{
+			close_handler();
+		}
+
+		DestroyWindow();
+		bHandled = TRUE;
+		return 0;
+	}
+
 	LRESULT on_wnd_destroy(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 	{
 		PostQuitMessage(NULL);
@@ -44,50 +72,113 @@ struct window::window_implementation : public CWindowImpl<window::window_impleme
 		return 0;
 	}
 
+	// Everything below is recorded and then left to default processing,
+	// so system keys, Alt+F4 and the like keep working
+
 	LRESULT on_wnd_activate(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 	{
-		if (invoke_callback(message_type::activate, wParam, lParam))
-		{
-			bHandled = TRUE;
-			return 0;
-		}
-
-		return DefWindowProc(msg, wParam, lParam);
+		push(input_event::type_e::activate, wParam ? 1 : 0, 0);
+		bHandled = FALSE;
+		return 0;
 	}
 
 	LRESULT on_wnd_resize(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 	{
-		if (invoke_callback(message_type::resize, wParam, lParam))
-		{
-			bHandled = TRUE;
-			return 0;
-		}
+		push(input_event::type_e::resize, LOWORD(lParam), HIWORD(lParam));
+		bHandled = FALSE;
+		return 0;
+	}
 
-		return DefWindowProc(msg, wParam, lParam);
+	LRESULT on_wnd_key(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+	{
+		auto is_down = (msg == WM_KEYDOWN or msg == WM_SYSKEYDOWN);
+		push(is_down ? input_event::type_e::key_down : input_event::type_e::key_up, 0, 0,
+		     static_cast<uint32_t>(wParam),
+		     input_event::button_e::none,
+		     static_cast<uint16_t>(lParam & 0xffff));
+		bHandled = FALSE;
+		return 0;
+	}
+
+	LRESULT on_wnd_character(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+	{
+		push(input_event::type_e::character, 0, 0, static_cast<uint32_t>(wParam));
+		bHandled = FALSE;
+		return 0;
 	}
 
-	LRESULT on_wnd_keypress(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+	LRESULT on_wnd_mouse_move(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 	{
-		if (invoke_callback(message_type::keypress, wParam, lParam))
+		push(input_event::type_e::mouse_move, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		bHandled = FALSE;
+		return 0;
+	}
+
+	LRESULT on_wnd_mouse_button(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+	{
+		auto is_up = (msg == WM_LBUTTONUP or msg == WM_RBUTTONUP or msg == WM_MBUTTONUP or msg == WM_XBUTTONUP);
+
+		auto button = input_event::button_e::none;
+		switch (msg)
 		{
-			bHandled = TRUE;
-			return 0;
+			case WM_LBUTTONDOWN:
+			case WM_LBUTTONUP:
+			case WM_LBUTTONDBLCLK:
+				button = input_event::button_e::left;
+				break;
+			case WM_RBUTTONDOWN:
+			case WM_RBUTTONUP:
+			case WM_RBUTTONDBLCLK:
+				button = input_event::button_e::right;
+				break;
+			case WM_MBUTTONDOWN:
+			case WM_MBUTTONUP:
+			case WM_MBUTTONDBLCLK:
+				button = input_event::button_e::middle;
+				break;
+			case WM_XBUTTONDOWN:
+			case WM_XBUTTONUP:
+			case WM_XBUTTONDBLCLK:
+				button = (GET_XBUTTON_WPARAM(wParam) == XBUTTON1) ? input_event::button_e::x1 : input_event::button_e::x2;
+				break;
 		}
 
-		return DefWindowProc(msg, wParam, lParam);
+		push(is_up ? input_event::type_e::mouse_up : input_event::type_e::mouse_down, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), 0, button);
+		bHandled = FALSE;
+		return 0;
+	}
+
+	LRESULT on_wnd_mouse_wheel(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+	{
+		push(input_event::type_e::mouse_wheel, GET_WHEEL_DELTA_WPARAM(wParam), 0);
+		bHandled = FALSE;
+		return 0;
 	}
 
-	bool invoke_callback(message_type msg, WPARAM wParam, LPARAM lParam)
+	LRESULT on_wnd_raw_input(UINT msg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 	{
-		uint16_t idx = static_cast<uint16_t>(msg);
-		auto call = callback_methods.at(idx);
-		if (call)
+		RAWINPUT raw_input{};
+		UINT size = sizeof(raw_input);
+		if (GetRawInputData(reinterpret_cast<HRAWINPUT>(lParam), RID_INPUT, &raw_input, &size, sizeof(RAWINPUTHEADER)) != UINT(-1)
+		    and raw_input.header.dwType == RIM_TYPEMOUSE
+		    and (raw_input.data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE) == 0)
 		{
-			return call(wParam, lParam);
+			push(input_event::type_e::raw_mouse, raw_input.data.mouse.lLastX, raw_input.data.mouse.lLastY);
 		}
 
-		return false;
+		// WM_INPUT has to reach DefWindowProc for the system to clean up
+		bHandled = FALSE;
+		return 0;
+	}
+
+	void push(input_event::type_e type, int32_t x, int32_t y,
+	          uint32_t key = 0,
+	          input_event::button_e button = input_event::button_e::none,
+	          uint16_t repeat_count = 0)
+	{
+		input.push({ input_event::clock::now(), type, button, repeat_count, key, x, y });
 	}
 
-	std::array<callback_method, max_message_types> callback_methods{ nullptr };
-};
\ No newline at end of file
+	input_queue input{ input_capacity };
+	std::function<void()> close_handler;
+};
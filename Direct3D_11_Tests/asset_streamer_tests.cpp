@@ -0,0 +1,264 @@
+#include "tests.h"
+
+#include "asset_streamer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using namespace std::chrono_literals;
+
+	// Records what would have been created, in upload order, on the render thread only
+	class stand_in_device
+	{
+	public:
+		void create_resource(uint64_t bytes)
+		{
+			created.push_back(bytes);
+		}
+
+		std::vector<uint64_t> created;
+	};
+
+	// Only the render thread reads it, through process_uploads, and only uploads move it
+	class fake_time
+	{
+	public:
+		asset_streamer::time_source source()
+		{
+			return [this]() { return time; };
+		}
+
+		void advance(std::chrono::steady_clock::duration elapsed)
+		{
+			time += elapsed;
+		}
+
+	private:
+		asset_streamer::time_point time{};
+	};
+
+	asset_streamer::description make_settings(uint32_t worker_count, uint64_t frame_upload_budget, uint32_t max_pending_uploads)
+	{
+		return { worker_count, frame_upload_budget, max_pending_uploads, 2ms };
+	}
+
+	asset_streamer::load_function make_load(stand_in_device &device, uint64_t bytes)
+	{
+		return [&device, bytes]()
+		{
+			return asset_streamer::prepared_asset{ bytes, [&device, bytes]() { device.create_resource(bytes); } };
+		};
+	}
+
+	// Workers load in the background, give them up to a few seconds
+	bool wait_until(const std::function<bool()> &done)
+	{
+		auto deadline = std::chrono::steady_clock::now() + 10s;
+		while (not done())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				return false;
+			}
+			std::this_thread::sleep_for(100us);
+		}
+		return true;
+	}
+
+	bool wait_for_loads(const asset_streamer &streamer, uint32_t loaded)
+	{
+		return wait_until([&]() { return streamer.get_statistics().loaded >= loaded; });
+	}
+}
+
+void tests::asset_streamer_tests(test::runner &runner)
+{
+	runner.run("asset_streamer/over_budget_upload_goes_through", []()
+	{
+		stand_in_device device;
+		fake_time time;
+		asset_streamer streamer(make_settings(1, 100, 4), time.source());
+
+		auto asset = streamer.request(make_load(device, 1'000));
+		CHECK(wait_for_loads(streamer, 1));
+		CHECK(streamer.get_state(asset) == asset_streamer::asset_state::waiting_upload);
+
+		// Ten times the budget, still the one upload this frame
+		streamer.process_uploads();
+		CHECK(streamer.is_ready(asset));
+		CHECK(device.created == std::vector<uint64_t>({ 1'000 }));
+
+		auto stats = streamer.get_statistics();
+		CHECK(stats.uploaded == 1);
+		CHECK(stats.bytes_uploaded == 1'000);
+		CHECK(stats.budget_deferrals == 0);
+	});
+
+	runner.run("asset_streamer/budget_deferrals_across_frames", []()
+	{
+		// One worker so the upload queue holds the requests in order
+		stand_in_device device;
+		fake_time time;
+		asset_streamer streamer(make_settings(1, 100, 8), time.source());
+
+		std::vector<asset_streamer::asset_id> assets;
+		for (uint64_t bytes : { 40, 40, 40, 90, 10 })
+		{
+			assets.push_back(streamer.request(make_load(device, bytes)));
+		}
+		CHECK(wait_for_loads(streamer, 5));
+
+		// 40 + 40, then 40 alone as 90 more is over, then 90 + 10 lands exactly on budget
+		streamer.process_uploads();
+		CHECK(device.created == std::vector<uint64_t>({ 40, 40 }));
+		CHECK(streamer.get_statistics().budget_deferrals == 1);
+		CHECK(streamer.is_ready(assets[1]) and not streamer.is_ready(assets[2]));
+
+		streamer.process_uploads();
+		CHECK(device.created.size() == 3);
+		CHECK(streamer.get_statistics().budget_deferrals == 2);
+
+		streamer.process_uploads();
+		CHECK(device.created == std::vector<uint64_t>({ 40, 40, 40, 90, 10 }));
+
+		// Nothing left, nothing deferred
+		streamer.process_uploads();
+		auto stats = streamer.get_statistics();
+		CHECK(stats.budget_deferrals == 2);
+		CHECK(stats.uploaded == 5);
+		CHECK(stats.bytes_uploaded == 220);
+		CHECK(streamer.is_ready(assets[4]));
+	});
+
+	runner.run("asset_streamer/hitches_against_fake_clock", []()
+	{
+		stand_in_device device;
+		fake_time time;
+		asset_streamer streamer(make_settings(1, 1'000, 8), time.source());
+
+		// Each upload takes as long as the test says, on the fake clock
+		auto timed_load = [&](std::chrono::steady_clock::duration upload_time)
+		{
+			return [&device, &time, upload_time]()
+			{
+				return asset_streamer::prepared_asset{ 1, [&device, &time, upload_time]()
+				{
+					time.advance(upload_time);
+					device.create_resource(1);
+				} };
+			};
+		};
+
+		streamer.request(timed_load(5ms));
+		CHECK(wait_for_loads(streamer, 1));
+		streamer.process_uploads();
+
+		auto stats = streamer.get_statistics();
+		CHECK(stats.hitches == 1);
+		CHECK(stats.last_upload_time == 5ms);
+
+		// Under the 2 ms threshold, or no uploads at all, is no hitch
+		streamer.request(timed_load(1ms));
+		CHECK(wait_for_loads(streamer, 2));
+		streamer.process_uploads();
+		streamer.process_uploads();
+
+		stats = streamer.get_statistics();
+		CHECK(stats.hitches == 1);
+		CHECK(stats.last_upload_time == 0ms);
+		CHECK(stats.max_upload_time == 5ms);
+
+		// Two quick uploads in one frame add up to a hitch
+		streamer.request(timed_load(1500us));
+		streamer.request(timed_load(1500us));
+		CHECK(wait_for_loads(streamer, 4));
+		streamer.process_uploads();
+
+		stats = streamer.get_statistics();
+		CHECK(stats.hitches == 2);
+		CHECK(stats.last_upload_time == 3ms);
+		CHECK(device.created.size() == 4);
+	});
+
+	runner.run("asset_streamer/throwing_load_or_upload_fails", []()
+	{
+		stand_in_device device;
+		fake_time time;
+		asset_streamer streamer(make_settings(2, 1'000, 8), time.source());
+
+		auto bad_load = streamer.request([]() -> asset_streamer::prepared_asset
+		{
+			throw std::runtime_error("Cannot read asset");
+		});
+		auto bad_upload = streamer.request([]()
+		{
+			return asset_streamer::prepared_asset{ 10, []() { throw std::runtime_error("Cannot create resource"); } };
+		});
+		auto good = streamer.request(make_load(device, 10));
+
+		CHECK(wait_until([&]() { return streamer.get_state(bad_load) == asset_streamer::asset_state::failed; }));
+		CHECK(wait_for_loads(streamer, 2));
+		streamer.process_uploads();
+
+		// A failure takes only its own asset down
+		CHECK(streamer.get_state(bad_load) == asset_streamer::asset_state::failed);
+		CHECK(streamer.get_state(bad_upload) == asset_streamer::asset_state::failed);
+		CHECK(streamer.is_ready(good));
+		CHECK(device.created == std::vector<uint64_t>({ 10 }));
+
+		auto stats = streamer.get_statistics();
+		CHECK(stats.requested == 3);
+		CHECK(stats.loaded == 2);
+		CHECK(stats.uploaded == 1);
+		CHECK(stats.failed == 2);
+
+		// Ids never handed out read as failed too
+		CHECK(streamer.get_state(good + 1) == asset_streamer::asset_state::failed);
+	});
+
+	runner.run("asset_streamer/workers_stall_on_full_upload_queue", []()
+	{
+		constexpr uint32_t max_pending_uploads = 2,
+		                   asset_count = 7;
+
+		stand_in_device device;
+		fake_time time;
+		asset_streamer streamer(make_settings(1, 1'000, max_pending_uploads), time.source());
+
+		std::vector<asset_streamer::asset_id> assets;
+		for (uint32_t i = 0; i < asset_count; ++i)
+		{
+			assets.push_back(streamer.request(make_load(device, 1)));
+		}
+
+		// The worker fills the queue, loads one more and holds it, the rest stay queued
+		CHECK(wait_until([&]() { return streamer.get_state(assets[max_pending_uploads]) == asset_streamer::asset_state::loading; }));
+		std::this_thread::sleep_for(5ms);
+		CHECK(streamer.get_statistics().loaded == max_pending_uploads);
+		CHECK(streamer.get_state(assets[max_pending_uploads + 1]) == asset_streamer::asset_state::queued);
+
+		// Between frames the queue never holds more than its limit
+		uint32_t over_limit = 0,
+		         frame_count = 0;
+		while (streamer.get_statistics().uploaded < asset_count and frame_count < 1'000)
+		{
+			auto stats = streamer.get_statistics();
+			over_limit += (stats.loaded - stats.uploaded > max_pending_uploads) ? 1 : 0;
+
+			streamer.process_uploads();
+			frame_count++;
+			std::this_thread::sleep_for(1ms);
+		}
+		CHECK(over_limit == 0);
+		CHECK(streamer.get_statistics().uploaded == asset_count);
+		CHECK(device.created.size() == asset_count);
+	});
+}
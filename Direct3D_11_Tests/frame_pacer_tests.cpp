@@ -0,0 +1,156 @@
+#include "tests.h"
+
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using namespace std::chrono_literals;
+	using clock = frame_pacer::clock;
+
+	// Time only moves when a frame does work or the pacer waits
+	class fake_time
+	{
+	public:
+		frame_pacer::time_source source()
+		{
+			return [this]() { return time; };
+		}
+
+		// Returns early, as a timer wakeup may, so the pacer has to re-check the clock
+		frame_pacer::wait_function wait()
+		{
+			return [this](clock::duration remaining)
+			{
+				time += std::min<clock::duration>(remaining, 1ms);
+				wait_count++;
+			};
+		}
+
+		void advance(clock::duration elapsed)
+		{
+			time += elapsed;
+		}
+
+		clock::duration since_start() const
+		{
+			return time - clock::time_point{};
+		}
+
+		uint32_t wait_count = 0;
+
+	private:
+		clock::time_point time{};
+	};
+
+	// Does each frame's work then ends it, returns when each frame ended
+	std::vector<clock::duration> run_frames(frame_pacer &pacer, fake_time &time, const std::vector<clock::duration> &work_times)
+	{
+		std::vector<clock::duration> frame_ends;
+		for (auto work_time : work_times)
+		{
+			time.advance(work_time);
+			pacer.end_frame();
+			frame_ends.push_back(time.since_start());
+		}
+		return frame_ends;
+	}
+
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	bool near(milliseconds a, milliseconds b)
+	{
+		return std::abs((a - b).count()) < 1e-9;
+	}
+}
+
+void tests::frame_pacer_tests(test::runner &runner)
+{
+	runner.run("frame_pacer/waits_for_deadline", []()
+	{
+		fake_time time;
+		frame_pacer pacer(10ms, time.source(), time.wait());
+
+		// The first frame only sets the deadline, quick frames then wait out the rest
+		auto frame_ends = run_frames(pacer, time, { 0ms, 3ms, 3ms, 3ms });
+		CHECK(frame_ends == std::vector<clock::duration>({ 0ms, 10ms, 20ms, 30ms }));
+		CHECK(time.wait_count == 3 * 7);
+		CHECK(pacer.get_statistics().late_frames == 0);
+		CHECK(near(pacer.get_statistics().mean_interval, 10ms));
+	});
+
+	runner.run("frame_pacer/catches_up_small_overruns", []()
+	{
+		fake_time time;
+		frame_pacer pacer(10ms, time.source(), time.wait());
+
+		// 2 ms over, the next deadline stays on the 10 ms grid so the next frame is shorter
+		auto frame_ends = run_frames(pacer, time, { 0ms, 12ms, 3ms, 3ms });
+		CHECK(frame_ends == std::vector<clock::duration>({ 0ms, 12ms, 20ms, 30ms }));
+		CHECK(pacer.get_statistics().late_frames == 1);
+		CHECK(near(pacer.get_statistics().mean_interval, 10ms));
+
+		// Overrunning by just under an interval still catches up
+		frame_ends = run_frames(pacer, time, { 19ms, 1ms });
+		CHECK(frame_ends == std::vector<clock::duration>({ 49ms, 50ms }));
+		CHECK(pacer.get_statistics().late_frames == 2);
+	});
+
+	runner.run("frame_pacer/resyncs_after_long_frame", []()
+	{
+		fake_time time;
+		frame_pacer pacer(10ms, time.source(), time.wait());
+
+		// A whole interval or more late gives up on the old grid rather than
+		// rushing several short frames to make up for it
+		auto frame_ends = run_frames(pacer, time, { 0ms, 25ms, 3ms, 3ms });
+		CHECK(frame_ends == std::vector<clock::duration>({ 0ms, 25ms, 35ms, 45ms }));
+		CHECK(pacer.get_statistics().late_frames == 1);
+
+		frame_ends = run_frames(pacer, time, { 20ms, 3ms });
+		CHECK(frame_ends == std::vector<clock::duration>({ 65ms, 75ms }));
+		CHECK(pacer.get_statistics().late_frames == 2);
+	});
+
+	runner.run("frame_pacer/zero_interval_never_waits", []()
+	{
+		fake_time time;
+		frame_pacer pacer(0ms, time.source(), time.wait());
+
+		auto frame_ends = run_frames(pacer, time, { 0ms, 3ms, 50ms, 1ms });
+		CHECK(frame_ends == std::vector<clock::duration>({ 0ms, 3ms, 53ms, 54ms }));
+		CHECK(time.wait_count == 0);
+		CHECK(pacer.get_statistics().late_frames == 0);
+		CHECK(pacer.get_statistics().frame_count == 3);
+
+		// Turning limiting on starts a fresh grid from the next frame
+		pacer.set_target_interval(10ms);
+		frame_ends = run_frames(pacer, time, { 1ms, 1ms });
+		CHECK(frame_ends == std::vector<clock::duration>({ 55ms, 65ms }));
+		CHECK(pacer.get_statistics().late_frames == 0);
+	});
+
+	runner.run("frame_pacer/jitter_statistics", []()
+	{
+		fake_time time;
+		frame_pacer pacer(0ms, time.source(), time.wait());
+
+		// Intervals of 10, 14, 11 and 11 ms, jitter between them 4, 3 and 0 ms
+		run_frames(pacer, time, { 0ms, 10ms, 14ms, 11ms, 11ms });
+
+		const auto &stats = pacer.get_statistics();
+		CHECK(stats.frame_count == 4);
+		CHECK(near(stats.last_interval, 11ms));
+		CHECK(near(stats.mean_interval, 11.5ms));
+		CHECK(near(stats.last_jitter, 0ms));
+		CHECK(near(stats.mean_jitter, milliseconds(7.0 / 3.0)));
+		CHECK(near(stats.max_jitter, 4ms));
+	});
+}
@@ -0,0 +1,197 @@
+#include "tests.h"
+
+#include "index_codec.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	template <typename function_t>
+	bool throws_runtime_error(const function_t &function)
+	{
+		try
+		{
+			function();
+		}
+		catch (const std::runtime_error &)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	template <typename index_t>
+	std::vector<index_t> decode_all(const std::vector<uint8_t> &encoded)
+	{
+		auto header = index_codec::read_header(encoded.data(), encoded.size());
+		std::vector<index_t> decoded(header.index_count);
+		index_codec::decode(encoded.data(), encoded.size(), decoded.data());
+		return decoded;
+	}
+
+	// Grid of quads, the index order a cache optimised mesh would have
+	std::vector<uint32_t> make_grid_indices(uint32_t width, uint32_t height)
+	{
+		std::vector<uint32_t> indices;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				auto corner = y * (width + 1) + x;
+				indices.insert(indices.end(), { corner, corner + width + 1, corner + 1,
+				                                corner + 1, corner + width + 1, corner + width + 2 });
+			}
+		}
+		return indices;
+	}
+}
+
+void tests::index_codec_tests(test::runner &runner)
+{
+	runner.run("index_codec/round_trip_32bit", []()
+	{
+		// Large jumps both ways, and the extremes of the range
+		std::vector<uint32_t> indices{ 0, UINT32_MAX, 0, 1, 70'000, 3, UINT32_MAX - 1, 1'000'000 };
+		uint32_t state = 1;
+		for (uint32_t i = 0; i < 10'000; ++i)
+		{
+			state = state * 1664525U + 1013904223U;
+			indices.push_back(state >> (state & 15));
+		}
+
+		auto encoded = index_codec::encode(indices.data(), indices.size());
+		auto header = index_codec::read_header(encoded.data(), encoded.size());
+		CHECK(header.index_count == indices.size());
+		CHECK(header.max_index == UINT32_MAX);
+		CHECK(decode_all<uint32_t>(encoded) == indices);
+	});
+
+	runner.run("index_codec/round_trip_16bit", []()
+	{
+		auto indices = make_grid_indices(100, 100);
+		CHECK(index_codec::fits_16bit(indices.data(), indices.size()));
+
+		std::vector<uint16_t> narrow(indices.size());
+		index_codec::narrow_to_16bit(indices.data(), indices.size(), narrow.data());
+
+		auto encoded = index_codec::encode(indices.data(), indices.size());
+		CHECK(index_codec::read_header(encoded.data(), encoded.size()).max_index == 101 * 101 - 1);
+		CHECK(decode_all<uint16_t>(encoded) == narrow);
+
+		// Rows narrow enough for one byte steps take one byte per index
+		auto narrow_grid = make_grid_indices(30, 30);
+		auto narrow_encoded = index_codec::encode(narrow_grid.data(), narrow_grid.size());
+		CHECK(narrow_encoded.size() < narrow_grid.size() + 8);
+	});
+
+	runner.run("index_codec/fits_16bit_boundary", []()
+	{
+		std::vector<uint32_t> largest{ 0, index_codec::max_16bit_index };
+		std::vector<uint32_t> strip_cut{ 0, index_codec::max_16bit_index + 1 };
+		CHECK(index_codec::fits_16bit(largest.data(), largest.size()));
+		CHECK(not index_codec::fits_16bit(strip_cut.data(), strip_cut.size()));
+		CHECK(index_codec::fits_16bit(nullptr, 0));
+	});
+
+	runner.run("index_codec/packs_to_selected_width", []()
+	{
+		CHECK(index_codec::select_index_size(index_codec::max_16bit_index) == sizeof(uint16_t));
+		CHECK(index_codec::select_index_size(index_codec::max_16bit_index + 1) == sizeof(uint32_t));
+
+		// Plain and encoded input land on the same bytes
+		for (uint32_t size : { 100U, 300U })
+		{
+			auto indices = make_grid_indices(size, size);
+			auto encoded = index_codec::encode(indices.data(), indices.size());
+
+			auto packed = index_codec::pack_indices(indices.data(), indices.size()),
+			     decoded = index_codec::pack_indices(encoded.data(), encoded.size());
+			auto expected_size = (size == 100) ? sizeof(uint16_t) : sizeof(uint32_t);
+
+			CHECK(packed.index_size == expected_size);
+			CHECK(packed.index_count == indices.size());
+			CHECK(packed.data.size() == indices.size() * expected_size);
+			CHECK(decoded.index_size == packed.index_size);
+			CHECK(decoded.index_count == packed.index_count);
+			CHECK(decoded.data == packed.data);
+		}
+
+		// 16 bit output is written unaligned, little endian
+		std::vector<uint32_t> indices{ 1, 0x1234, 3 };
+		std::vector<uint8_t> output(1 + indices.size() * sizeof(uint16_t));
+		index_codec::write_indices(indices.data(), indices.size(), sizeof(uint16_t), output.data() + 1);
+		CHECK(output[3] == 0x34 and output[4] == 0x12);
+	});
+
+	runner.run("index_codec/empty_stream", []()
+	{
+		auto encoded = index_codec::encode(nullptr, 0);
+		auto header = index_codec::read_header(encoded.data(), encoded.size());
+		CHECK(header.index_count == 0 and header.max_index == 0);
+		CHECK(header.header_size == encoded.size());
+		CHECK(decode_all<uint32_t>(encoded).empty());
+	});
+
+	runner.run("index_codec/rejects_truncated", []()
+	{
+		std::vector<uint32_t> indices{ 5, 300'000, 2 };
+		auto encoded = index_codec::encode(indices.data(), indices.size());
+
+		for (size_t size = 0; size < encoded.size(); ++size)
+		{
+			std::vector<uint8_t> truncated(encoded.begin(), encoded.begin() + size);
+			CHECK(throws_runtime_error([&]() { decode_all<uint32_t>(truncated); }));
+		}
+
+		// Count far beyond what the body could hold fails before anything is sized from it
+		std::vector<uint8_t> huge_count{ 0xff, 0xff, 0xff, 0xff, 0x0f, 0x00, 0x00 };
+		CHECK(throws_runtime_error([&]() { index_codec::read_header(huge_count.data(), huge_count.size()); }));
+	});
+
+	runner.run("index_codec/rejects_overlong_varint", []()
+	{
+		// Fifth byte carrying bits past 32, and a varint that never ends
+		std::vector<uint8_t> overflow{ 0x01, 0xff, 0xff, 0xff, 0xff, 0x1f, 0x00 };
+		std::vector<uint8_t> unterminated{ 0x01, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+		CHECK(throws_runtime_error([&]() { index_codec::read_header(overflow.data(), overflow.size()); }));
+		CHECK(throws_runtime_error([&]() { decode_all<uint32_t>(unterminated); }));
+
+		// Five byte varints whose value does fit are still accepted
+		std::vector<uint8_t> largest{ 0x01, 0xff, 0xff, 0xff, 0xff, 0x0f, 0xfe, 0xff, 0xff, 0xff, 0x0f };
+		auto header = index_codec::read_header(largest.data(), largest.size());
+		CHECK(header.max_index == UINT32_MAX);
+		CHECK(decode_all<uint32_t>(largest) == std::vector<uint32_t>{ INT32_MAX });
+	});
+
+	runner.run("index_codec/rejects_index_above_header", []()
+	{
+		// Header claims max 5, body steps to 6
+		std::vector<uint8_t> above_max{ 0x02, 0x05, 0x0a, 0x02 };
+		CHECK(throws_runtime_error([&]() { decode_all<uint32_t>(above_max); }));
+
+		// A negative step wrapping below zero is just as far out of range
+		std::vector<uint8_t> below_zero{ 0x01, 0x05, 0x01 };
+		CHECK(throws_runtime_error([&]() { decode_all<uint32_t>(below_zero); }));
+	});
+
+	runner.run("index_codec/rejects_trailing_data", []()
+	{
+		std::vector<uint32_t> indices{ 1, 2, 3 };
+		auto encoded = index_codec::encode(indices.data(), indices.size());
+		encoded.push_back(0);
+		CHECK(throws_runtime_error([&]() { decode_all<uint32_t>(encoded); }));
+	});
+
+	runner.run("index_codec/rejects_narrow_output", []()
+	{
+		std::vector<uint32_t> indices{ 0, 70'000 };
+		auto encoded = index_codec::encode(indices.data(), indices.size());
+
+		std::vector<uint16_t> narrow(indices.size());
+		CHECK(throws_runtime_error([&]() { index_codec::decode(encoded.data(), encoded.size(), narrow.data()); }));
+	});
+}
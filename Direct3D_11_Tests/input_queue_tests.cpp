@@ -0,0 +1,226 @@
+#include "tests.h"
+
+#include "input_queue.h"
+#include "spsc_queue.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	input_event make_key(uint32_t key)
+	{
+		return { input_event::clock::now(), input_event::type_e::key_down, input_event::button_e::none, 0, key, 0, 0 };
+	}
+
+	input_event make_resize(int32_t width, int32_t height)
+	{
+		return { input_event::clock::now(), input_event::type_e::resize, input_event::button_e::none, 0, 0, width, height };
+	}
+}
+
+void tests::input_queue_tests(test::runner &runner)
+{
+	runner.run("spsc_queue/full_and_empty", []()
+	{
+		spsc_queue<uint32_t> queue(4);
+
+		uint32_t value = 0;
+		CHECK(not queue.try_pop(value));
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			CHECK(queue.try_push(i));
+		}
+		CHECK(not queue.try_push(4));
+		CHECK(queue.size() == 4);
+
+		CHECK(queue.try_pop(value) and value == 0);
+		CHECK(queue.try_push(4));
+		CHECK(not queue.try_push(5));
+	});
+
+	runner.run("spsc_queue/wraps_in_order", []()
+	{
+		// Many times round a small ring, with pushes and pops out of step
+		spsc_queue<uint32_t> queue(8);
+
+		uint32_t next_push = 0,
+		         next_pop = 0;
+		for (uint32_t round = 0; round < 10000; ++round)
+		{
+			for (uint32_t i = 0; i < (round % 7) + 1; ++i)
+			{
+				if (queue.try_push(next_push))
+				{
+					next_push++;
+				}
+			}
+
+			uint32_t values[8]{};
+			auto count = queue.try_pop_batch(values, (round % 5) + 1);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				CHECK(values[i] == next_pop);
+				next_pop++;
+			}
+		}
+
+		uint32_t value = 0;
+		while (queue.try_pop(value))
+		{
+			CHECK(value == next_pop);
+			next_pop++;
+		}
+		CHECK(next_pop == next_push);
+	});
+
+	runner.run("spsc_queue/threads_keep_order", []()
+	{
+		// Producer and consumer hammer a small ring, every value arrives once and in order
+		constexpr uint32_t value_count = 1 << 20;
+		spsc_queue<uint32_t> queue(64);
+
+		std::thread producer([&]()
+		{
+			for (uint32_t i = 0; i < value_count; ++i)
+			{
+				while (not queue.try_push(i))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		uint32_t expected = 0,
+		         out_of_order = 0;
+		std::vector<uint32_t> values(16);
+		while (expected < value_count)
+		{
+			// Alternate single and batch pops, both walk the same indices
+			uint32_t count = 0;
+			if (expected & 1)
+			{
+				count = queue.try_pop(values[0]) ? 1 : 0;
+			}
+			else
+			{
+				count = queue.try_pop_batch(values.data(), static_cast<uint32_t>(values.size()));
+			}
+
+			if (count == 0)
+			{
+				std::this_thread::yield();
+			}
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				out_of_order += (values[i] != expected) ? 1 : 0;
+				expected++;
+			}
+		}
+		producer.join();
+
+		CHECK(out_of_order == 0);
+		CHECK(queue.size() == 0);
+	});
+
+	runner.run("input_queue/full_ring_drops_and_counts", []()
+	{
+		input_queue queue(8);
+
+		for (uint32_t i = 0; i < 12; ++i)
+		{
+			queue.push(make_key(i));
+		}
+
+		auto stats = queue.get_statistics();
+		CHECK(stats.pushed == 8);
+		CHECK(stats.dropped == 4);
+		CHECK(queue.get_queued_count() == 8);
+
+		input_event events[8]{};
+		CHECK(queue.pop_batch(events, 8) == 8);
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			CHECK(events[i].key == i);
+		}
+	});
+
+	runner.run("input_queue/resize_survives_full_ring", []()
+	{
+		input_queue queue(4);
+
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			queue.push(make_key(i));
+		}
+		CHECK(not queue.push(make_resize(640, 480)));
+		CHECK(not queue.push(make_resize(800, 600)));
+
+		uint32_t width = 0,
+		         height = 0;
+		CHECK(queue.take_resize(width, height));
+		CHECK(width == 800 and height == 600);
+		CHECK(not queue.take_resize(width, height));
+
+		auto stats = queue.get_statistics();
+		CHECK(stats.resizes == 2);
+		CHECK(stats.coalesced_resizes == 1);
+	});
+
+	runner.run("input_queue/threads_coalesce_resizes", []()
+	{
+		// Sizes only grow, so the consumer must never see one go backwards,
+		// and the last size pushed is the last one taken
+		constexpr int32_t resize_count = 100000;
+		input_queue queue(256);
+
+		std::thread producer([&]()
+		{
+			for (int32_t i = 1; i <= resize_count; ++i)
+			{
+				queue.push(make_resize(i, i * 2));
+				queue.push(make_key(static_cast<uint32_t>(i)));
+			}
+		});
+
+		uint32_t last_width = 0,
+		         taken = 0,
+		         went_backwards = 0,
+		         mismatched = 0;
+		std::vector<input_event> events(64);
+		auto drain = [&]()
+		{
+			while (queue.pop_batch(events.data(), static_cast<uint32_t>(events.size())) > 0)
+			{}
+
+			uint32_t width = 0,
+			         height = 0;
+			if (queue.take_resize(width, height))
+			{
+				went_backwards += (width <= last_width) ? 1 : 0;
+				mismatched += (height != width * 2) ? 1 : 0;
+				last_width = width;
+				taken++;
+			}
+		};
+
+		while (last_width < resize_count)
+		{
+			drain();
+			std::this_thread::yield();
+		}
+		producer.join();
+		drain();
+
+		auto stats = queue.get_statistics();
+		CHECK(went_backwards == 0);
+		CHECK(mismatched == 0);
+		CHECK(last_width == resize_count);
+		CHECK(stats.resizes == resize_count);
+		CHECK(stats.coalesced_resizes + taken == resize_count);
+		CHECK(stats.pushed + stats.dropped == 2 * resize_count);
+	});
+}
@@ -0,0 +1,228 @@
+#include "tests.h"
+
+#include "job_system.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using namespace std::chrono_literals;
+
+	// More threads than this machine may have cores, so they contend and get preempted
+	constexpr uint32_t thread_counts[] = { 1, 2, 4, 8 };
+
+	// Every index in [0, count) visited exactly once
+	bool covers_once(const std::vector<std::atomic<uint32_t>> &visits)
+	{
+		for (const auto &visit : visits)
+		{
+			if (visit.load(std::memory_order_relaxed) != 1)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct tree_counts
+	{
+		std::atomic<uint32_t> leaves{ 0 };
+		std::atomic<uint32_t> parents_early{ 0 }; // a parent seen finished before its children
+	};
+
+	// Spawns fan_out children per level, each counting its leaves once done
+	void spawn_tree(job_system *jobs, job_system::job *parent, uint32_t depth, uint32_t fan_out, tree_counts *counts)
+	{
+		if (depth == 0)
+		{
+			counts->leaves.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		for (uint32_t i = 0; i < fan_out; ++i)
+		{
+			jobs->run(jobs->create([=]()
+			{
+				spawn_tree(jobs, parent, depth - 1, fan_out, counts);
+			}, parent));
+		}
+	}
+}
+
+void tests::job_system_tests(test::runner &runner)
+{
+	runner.run("job_system/parallel_for_covers_once", []()
+	{
+		// The first half split off stays queued while the rest runs, so the job ring
+		// needs room for every piece, here one per item
+		for (auto thread_count : thread_counts)
+		{
+			job_system jobs({ thread_count, 16'384 });
+
+			for (uint32_t grain_size : { 0U, 1U, 7U, 64U, 100'000U })
+			{
+				std::vector<std::atomic<uint32_t>> visits(10'007);
+				jobs.parallel_for(static_cast<uint32_t>(visits.size()), grain_size, [&](uint32_t first, uint32_t last)
+				{
+					for (auto i = first; i < last; ++i)
+					{
+						visits[i].fetch_add(1, std::memory_order_relaxed);
+					}
+				});
+				CHECK(covers_once(visits));
+			}
+
+			// Nothing to do returns straight away
+			auto called = false;
+			jobs.parallel_for(0, 1, [&](uint32_t, uint32_t) { called = true; });
+			CHECK(not called);
+		}
+	});
+
+	runner.run("job_system/repeated_frames_under_contention", []()
+	{
+		// As the renderer uses it, many small parallel_fors back to back from one thread
+		constexpr uint32_t frame_count = 500,
+		                   item_count = 4'096;
+
+		for (auto thread_count : thread_counts)
+		{
+			job_system jobs({ thread_count, 256 });
+			std::vector<uint64_t> values(item_count);
+
+			uint32_t wrong_frames = 0;
+			for (uint32_t frame = 0; frame < frame_count; ++frame)
+			{
+				jobs.parallel_for(item_count, 64, [&](uint32_t first, uint32_t last)
+				{
+					for (auto i = first; i < last; ++i)
+					{
+						values[i] = uint64_t(frame) * item_count + i;
+					}
+				});
+
+				// Everything written inside is visible once parallel_for returns
+				for (uint32_t i = 0; i < item_count; ++i)
+				{
+					if (values[i] != uint64_t(frame) * item_count + i)
+					{
+						wrong_frames++;
+						break;
+					}
+				}
+			}
+			CHECK(wrong_frames == 0);
+
+			auto stats = jobs.get_statistics();
+			CHECK(stats.jobs_run >= frame_count * (item_count / 64));
+			CHECK(thread_count > 1 or stats.jobs_stolen == 0);
+		}
+	});
+
+	runner.run("job_system/parents_wait_for_children", []()
+	{
+		for (auto thread_count : thread_counts)
+		{
+			job_system jobs({ thread_count, 1'024 });
+			tree_counts counts;
+
+			// Three levels of four, the root only finishes once all 64 leaves have run
+			for (uint32_t round = 0; round < 50; ++round)
+			{
+				counts.leaves.store(0);
+				auto root = jobs.create([]() {});
+				spawn_tree(&jobs, root, 3, 4, &counts);
+				jobs.run(root);
+				jobs.wait(root);
+
+				if (counts.leaves.load() != 64)
+				{
+					counts.parents_early.fetch_add(1);
+				}
+			}
+			CHECK(counts.parents_early.load() == 0);
+		}
+	});
+
+	runner.run("job_system/jobs_may_wait", []()
+	{
+		// A waiting job runs other jobs, possibly further outer ones, never blocks a worker
+		for (auto thread_count : thread_counts)
+		{
+			job_system jobs({ thread_count, 2'048 });
+			std::vector<std::atomic<uint32_t>> visits(8 * 128);
+
+			// Each outer job fans out again, from whichever thread it landed on
+			auto root = jobs.create([]() {});
+			for (uint32_t outer = 0; outer < 8; ++outer)
+			{
+				auto *visits_out = &visits;
+				auto *system = &jobs;
+				jobs.run(jobs.create([=]()
+				{
+					auto inner = system->create([]() {});
+					for (uint32_t i = 0; i < 128; ++i)
+					{
+						system->run(system->create([=]() { (*visits_out)[outer * 128 + i].fetch_add(1, std::memory_order_relaxed); }, inner));
+					}
+					system->run(inner);
+					system->wait(inner);
+				}, root));
+			}
+			jobs.run(root);
+			jobs.wait(root);
+
+			CHECK(covers_once(visits));
+		}
+	});
+
+	runner.run("job_system/sleeping_workers_wake", []()
+	{
+		// The caller never helps here, so a worker has to wake up for the job to run at all
+		for (auto thread_count : { 2U, 4U })
+		{
+			job_system jobs({ thread_count, 64 });
+
+			for (uint32_t round = 0; round < 20; ++round)
+			{
+				std::this_thread::sleep_for(2ms);
+
+				std::atomic<bool> ran{ false };
+				auto pending = jobs.create([&ran]() { ran.store(true); });
+				jobs.run(pending);
+
+				auto deadline = std::chrono::steady_clock::now() + 10s;
+				while (not jobs.is_finished(pending) and std::chrono::steady_clock::now() < deadline)
+				{
+					std::this_thread::sleep_for(100us);
+				}
+				CHECK(jobs.is_finished(pending));
+				CHECK(ran.load());
+			}
+		}
+	});
+
+	runner.run("job_system/systems_come_and_go", []()
+	{
+		// Start up and shut down over and over, with workers busy, spinning or asleep
+		for (uint32_t round = 0; round < 100; ++round)
+		{
+			auto jobs = std::make_unique<job_system>(job_system::description{ 1 + round % 8, 128 });
+			std::atomic<uint32_t> sum{ 0 };
+			jobs->parallel_for(256, 4, [&](uint32_t first, uint32_t last)
+			{
+				sum.fetch_add(last - first, std::memory_order_relaxed);
+			});
+			CHECK(sum.load() == 256);
+			CHECK(jobs->get_thread_count() == 1 + round % 8);
+			jobs.reset();
+		}
+	});
+}
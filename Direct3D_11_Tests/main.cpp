@@ -0,0 +1,44 @@
+// Unit and stress tests for the renderer's portable parts. Backend code is
+// tested through the same templates it is built from, instantiated over
+// recording stand-ins, so everything here runs without a GPU or Windows.
+//
+//   Direct3D_11_Tests [filter]
+//
+// Exits with the number of failed tests. Outside Visual Studio, from this directory:
+//   g++ -std=c++17 -O2 -pthread -I../Direct3D_11_Exe *.cpp ../Direct3D_11_Exe/{asset_streamer,frame_pacer,index_codec,input_queue,job_system,mesh_optimizer,offset_allocator,profiler,render_thread,ring_allocator,simulation_clock,software_render_device}.cpp -o tests
+
+#include "tests.h"
+
+#include <cstdio>
+#include <string_view>
+
+using namespace direct3d_11_eg;
+
+auto main(int argc, char *argv[]) -> int
+{
+	test::runner::description settings{};
+	if (argc > 1)
+	{
+		settings.filter = std::string_view(argv[1]);
+	}
+
+	test::runner runner(settings);
+
+	tests::asset_streamer_tests(runner);
+	tests::frame_pacer_tests(runner);
+	tests::index_codec_tests(runner);
+	tests::input_queue_tests(runner);
+	tests::job_system_tests(runner);
+	tests::mesh_optimizer_tests(runner);
+	tests::offset_allocator_tests(runner);
+	tests::profiler_tests(runner);
+	tests::render_thread_tests(runner);
+	tests::ring_allocator_tests(runner);
+	tests::simulation_clock_tests(runner);
+	tests::software_render_device_tests(runner);
+	tests::state_cache_tests(runner);
+	tests::state_tracker_tests(runner);
+
+	std::printf("%u of %u tests failed\n", runner.get_failed_count(), runner.get_run_count());
+	return static_cast<int>(runner.get_failed_count());
+}
@@ -0,0 +1,83 @@
+#include "tests.h"
+
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Grid of quads with its triangles shuffled, the worst order for the cache
+	std::vector<uint32_t> make_shuffled_grid(uint32_t width, uint32_t height)
+	{
+		std::vector<uint32_t> indices;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				auto corner = y * (width + 1) + x;
+				indices.insert(indices.end(), { corner, corner + width + 1, corner + 1,
+				                                corner + 1, corner + width + 1, corner + width + 2 });
+			}
+		}
+
+		uint32_t state = 99;
+		for (auto t = indices.size() / 3 - 1; t > 0; --t)
+		{
+			state = state * 1664525U + 1013904223U;
+			auto other = (state >> 8) % (t + 1);
+			std::swap_ranges(indices.begin() + t * 3, indices.begin() + t * 3 + 3, indices.begin() + other * 3);
+		}
+		return indices;
+	}
+
+	// Triangles as rotation independent keys, to compare meshes regardless of order
+	std::vector<std::array<uint32_t, 3>> get_sorted_triangles(const std::vector<uint32_t> &indices)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t t = 0; t < indices.size() / 3; ++t)
+		{
+			std::array<uint32_t, 3> triangle{ indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+void tests::mesh_optimizer_tests(test::runner &runner)
+{
+	runner.run("mesh_optimizer/vertex_cache_single_chunk", []()
+	{
+		auto indices = make_shuffled_grid(60, 60);
+		auto vertex_count = 61U * 61U;
+		auto before = mesh_optimizer::analyze_vertex_cache(indices, vertex_count);
+		auto triangles = get_sorted_triangles(indices);
+
+		mesh_optimizer::optimize_vertex_cache(indices, vertex_count);
+
+		auto after = mesh_optimizer::analyze_vertex_cache(indices, vertex_count);
+		CHECK(get_sorted_triangles(indices) == triangles);
+		CHECK(after.acmr < 1.0f and after.acmr < before.acmr);
+	});
+
+	runner.run("mesh_optimizer/vertex_cache_chunked", []()
+	{
+		// Several chunks, each renumbered to its own vertices and back
+		auto indices = make_shuffled_grid(400, 400);
+		auto vertex_count = 401U * 401U;
+		auto before = mesh_optimizer::analyze_vertex_cache(indices, vertex_count);
+		auto triangles = get_sorted_triangles(indices);
+
+		mesh_optimizer::optimize_vertex_cache(indices, vertex_count);
+
+		auto after = mesh_optimizer::analyze_vertex_cache(indices, vertex_count);
+		CHECK(get_sorted_triangles(indices) == triangles);
+		CHECK(after.acmr < 1.0f and after.acmr < before.acmr);
+	});
+}
@@ -0,0 +1,257 @@
+#include "tests.h"
+
+#include "offset_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Small deterministic generator, runs must be repeatable
+	class random_sequence
+	{
+	public:
+		explicit random_sequence(uint32_t seed) :
+			state(seed)
+		{}
+
+		uint32_t next(uint32_t bound)
+		{
+			state = state * 1664525U + 1013904223U;
+			return (state >> 8) % bound;
+		}
+
+	private:
+		uint32_t state;
+	};
+
+	struct live_range
+	{
+		uint32_t handle;
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	// Live ranges inside the capacity, none overlapping
+	bool is_disjoint(std::vector<live_range> ranges, uint32_t capacity)
+	{
+		std::sort(ranges.begin(), ranges.end(), [](const live_range &a, const live_range &b) { return a.offset < b.offset; });
+
+		uint32_t end = 0;
+		for (auto &range : ranges)
+		{
+			if (range.offset < end or range.offset + range.size > capacity)
+			{
+				return false;
+			}
+			end = range.offset + range.size;
+		}
+		return true;
+	}
+}
+
+void tests::offset_allocator_tests(test::runner &runner)
+{
+	runner.run("offset_allocator/rejects_zero_and_oversized", []()
+	{
+		offset_allocator allocator(1024);
+
+		auto empty = allocator.allocate(0);
+		auto oversized = allocator.allocate(1025);
+		CHECK(empty.handle == offset_allocator::invalid_handle and empty.offset == offset_allocator::invalid_offset);
+		CHECK(oversized.handle == offset_allocator::invalid_handle);
+		CHECK(allocator.get_statistics().used_size == 0);
+
+		offset_allocator no_capacity(0);
+		CHECK(no_capacity.allocate(1).handle == offset_allocator::invalid_handle);
+	});
+
+	runner.run("offset_allocator/fills_exactly", []()
+	{
+		offset_allocator allocator(1000);
+
+		std::vector<live_range> ranges;
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			auto result = allocator.allocate(100);
+			CHECK(result.handle != offset_allocator::invalid_handle);
+			ranges.push_back({ result.handle, result.offset, 100 });
+		}
+
+		CHECK(is_disjoint(ranges, 1000));
+		CHECK(allocator.allocate(1).handle == offset_allocator::invalid_handle);
+
+		auto stats = allocator.get_statistics();
+		CHECK(stats.used_size == 1000 and stats.free_size == 0);
+		CHECK(stats.allocation_count == 10 and stats.free_block_count == 0);
+	});
+
+	runner.run("offset_allocator/free_merges_neighbours", []()
+	{
+		offset_allocator allocator(3000);
+
+		auto a = allocator.allocate(1000),
+		     b = allocator.allocate(1000),
+		     c = allocator.allocate(1000);
+
+		// A hole between two live blocks stays on its own
+		allocator.free(b.handle);
+		CHECK(allocator.get_statistics().free_block_count == 1);
+		CHECK(allocator.get_statistics().largest_free_block == 1000);
+
+		// Freeing either side merges into it, ending with the whole range
+		allocator.free(a.handle);
+		CHECK(allocator.get_statistics().free_block_count == 1);
+		CHECK(allocator.get_statistics().largest_free_block == 2000);
+
+		allocator.free(c.handle);
+		auto stats = allocator.get_statistics();
+		CHECK(stats.free_block_count == 1 and stats.largest_free_block == 3000);
+		CHECK(stats.fragmentation == 0.0f);
+		CHECK(allocator.allocate(3000).offset == 0);
+	});
+
+	runner.run("offset_allocator/fragmentation_reported", []()
+	{
+		offset_allocator allocator(800);
+
+		std::vector<offset_allocator::allocation> allocations;
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			allocations.push_back(allocator.allocate(100));
+		}
+		for (uint32_t i = 0; i < 8; i += 2)
+		{
+			allocator.free(allocations[i].handle);
+		}
+
+		// Four separate 100 blocks, 400 free but nothing larger than 100 fits
+		auto stats = allocator.get_statistics();
+		CHECK(stats.free_size == 400 and stats.free_block_count == 4 and stats.largest_free_block == 100);
+		CHECK(stats.fragmentation == 0.75f);
+		CHECK(allocator.allocate(101).handle == offset_allocator::invalid_handle);
+		CHECK(allocator.allocate(100).handle != offset_allocator::invalid_handle);
+	});
+
+	runner.run("offset_allocator/defragment_packs_to_front", []()
+	{
+		offset_allocator allocator(10'000);
+
+		// Tag every unit with its owner, then relocate by the returned moves
+		std::vector<uint32_t> memory(10'000, UINT32_MAX);
+		std::vector<live_range> ranges;
+		random_sequence random(7);
+
+		for (uint32_t i = 0; i < 60; ++i)
+		{
+			auto size = 1 + random.next(150);
+			auto result = allocator.allocate(size);
+			CHECK(result.handle != offset_allocator::invalid_handle);
+			std::fill_n(memory.begin() + result.offset, size, result.handle);
+			ranges.push_back({ result.handle, result.offset, size });
+		}
+		std::vector<live_range> kept_ranges;
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			if (i % 3 == 0)
+			{
+				allocator.free(ranges[i].handle);
+			}
+			else
+			{
+				kept_ranges.push_back(ranges[i]);
+			}
+		}
+		ranges = kept_ranges;
+
+		auto used_size = allocator.get_statistics().used_size;
+		auto moves = allocator.defragment();
+
+		uint32_t previous_offset = 0;
+		for (auto &move : moves)
+		{
+			CHECK(move.new_offset < move.old_offset);
+			CHECK(move.old_offset >= previous_offset);
+			previous_offset = move.old_offset;
+
+			// Ascending order means a forward copy never overwrites a range yet to move
+			std::copy_n(memory.begin() + move.old_offset, move.size, memory.begin() + move.new_offset);
+		}
+
+		for (auto &range : ranges)
+		{
+			auto offset = allocator.get_offset(range.handle);
+			CHECK(allocator.get_size(range.handle) == range.size);
+			CHECK(std::all_of(memory.begin() + offset, memory.begin() + offset + range.size, [&](uint32_t owner) { return owner == range.handle; }));
+			range.offset = offset;
+		}
+		CHECK(is_disjoint(ranges, used_size));
+
+		auto stats = allocator.get_statistics();
+		CHECK(stats.used_size == used_size);
+		CHECK(stats.free_block_count == 1 and stats.largest_free_block == 10'000 - used_size);
+		CHECK(allocator.allocate(10'000 - used_size).offset == used_size);
+	});
+
+	runner.run("offset_allocator/random_churn", []()
+	{
+		// Against a list of live ranges: never overlaps, accounting matches,
+		// and an allocation only fails when no free block is large enough
+		constexpr uint32_t capacity = 1 << 20;
+		offset_allocator allocator(capacity);
+
+		std::vector<live_range> ranges;
+		random_sequence random(12345);
+		uint32_t used_size = 0,
+		         failures = 0;
+
+		for (uint32_t step = 0; step < 50'000; ++step)
+		{
+			if (ranges.empty() or random.next(100) < 55)
+			{
+				auto size = 1 + random.next(random.next(4) == 0 ? 65'536 : 512);
+				auto largest_free_block = allocator.get_statistics().largest_free_block;
+				auto result = allocator.allocate(size);
+				if (result.handle == offset_allocator::invalid_handle)
+				{
+					CHECK(largest_free_block < size);
+					failures++;
+					continue;
+				}
+
+				ranges.push_back({ result.handle, result.offset, size });
+				used_size += size;
+			}
+			else
+			{
+				auto index = random.next(static_cast<uint32_t>(ranges.size()));
+				allocator.free(ranges[index].handle);
+				used_size -= ranges[index].size;
+				ranges[index] = ranges.back();
+				ranges.pop_back();
+			}
+
+			if (step % 1000 == 0)
+			{
+				CHECK(is_disjoint(ranges, capacity));
+				CHECK(allocator.get_statistics().used_size == used_size);
+			}
+		}
+
+		CHECK(is_disjoint(ranges, capacity));
+		CHECK(failures > 0);
+
+		for (auto &range : ranges)
+		{
+			CHECK(allocator.get_offset(range.handle) == range.offset);
+			allocator.free(range.handle);
+		}
+
+		auto stats = allocator.get_statistics();
+		CHECK(stats.used_size == 0 and stats.allocation_count == 0);
+		CHECK(stats.free_block_count == 1 and stats.largest_free_block == capacity);
+	});
+}
@@ -0,0 +1,88 @@
+#include "tests.h"
+
+#include "profiler.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	std::string write_trace()
+	{
+		auto path = std::filesystem::temp_directory_path() / "profiler_tests_trace.json";
+		profiler::write_chrome_trace(path.wstring());
+
+		std::ifstream file(path);
+		std::string trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+		std::filesystem::remove(path);
+		return trace;
+	}
+
+	size_t count_occurrences(const std::string &text, const std::string &pattern)
+	{
+		size_t count = 0;
+		for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+		{
+			count++;
+		}
+		return count;
+	}
+}
+
+void tests::profiler_tests(test::runner &runner)
+{
+	runner.run("profiler/trace_has_names_and_scopes", []()
+	{
+		std::thread worker([]()
+		{
+			profiler::set_thread_name("profiler_tests_named");
+			profiler::scope outer("profiler_tests_outer");
+			profiler::scope inner("profiler_tests_inner");
+		});
+		worker.join();
+
+		auto trace = write_trace();
+		CHECK(trace.find("\"traceEvents\"") != std::string::npos);
+		CHECK(count_occurrences(trace, "\"profiler_tests_named\"") == 1);
+		CHECK(count_occurrences(trace, "\"profiler_tests_outer\"") == 1);
+		CHECK(count_occurrences(trace, "\"profiler_tests_inner\"") == 1);
+	});
+
+	runner.run("profiler/exited_threads_reuse_buffers", []()
+	{
+		// Waves of short lived threads, as job_systems coming and going would start.
+		// Buffers are handed on, so the trace never holds more than one wave plus earlier threads.
+		constexpr uint32_t wave_count = 50,
+		                   threads_per_wave = 4;
+
+		auto buffers_before = count_occurrences(write_trace(), "\"thread_name\"");
+		for (uint32_t wave = 0; wave < wave_count; ++wave)
+		{
+			std::vector<std::thread> threads;
+			for (uint32_t i = 0; i < threads_per_wave; ++i)
+			{
+				threads.emplace_back([]()
+				{
+					profiler::set_thread_name("profiler_tests_wave");
+					profiler::scope work("profiler_tests_wave_scope");
+				});
+			}
+			for (auto &thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		auto trace = write_trace();
+		CHECK(count_occurrences(trace, "\"profiler_tests_wave\"") <= threads_per_wave);
+		CHECK(count_occurrences(trace, "\"thread_name\"") <= buffers_before + threads_per_wave);
+	});
+}
@@ -0,0 +1,212 @@
+#include "tests.h"
+
+#include "input_queue.h"
+#include "render_thread.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using namespace std::chrono_literals;
+
+	constexpr render_thread::description thread_settings{ 32, 1ms };
+
+	input_event make_key(uint32_t key)
+	{
+		return { input_event::clock::now(), input_event::type_e::key_down, input_event::button_e::none, 0, key, 0, 0 };
+	}
+
+	input_event make_resize(int32_t width, int32_t height)
+	{
+		return { input_event::clock::now(), input_event::type_e::resize, input_event::button_e::none, 0, 0, width, height };
+	}
+
+	// Polls until the condition holds or a generous deadline passes
+	template <typename condition_t>
+	bool wait_until(const condition_t &condition)
+	{
+		auto deadline = std::chrono::steady_clock::now() + 10s;
+		while (not condition())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				return false;
+			}
+			std::this_thread::yield();
+		}
+		return true;
+	}
+}
+
+void tests::render_thread_tests(test::runner &runner)
+{
+	runner.run("render_thread/events_arrive_in_order", []()
+	{
+		// The window thread floods a small queue, every event that got in reaches the handler in order
+		constexpr uint32_t event_count = 20000;
+		input_queue queue(64);
+
+		std::vector<uint32_t> keys;
+		keys.reserve(event_count);
+		std::atomic<uint32_t> received{ 0 };
+
+		render_thread thread(thread_settings, queue, render_thread::handlers{
+			[&](const input_event &event)
+			{
+				keys.push_back(event.key);
+				received.store(static_cast<uint32_t>(keys.size()), std::memory_order_release);
+			},
+			[](uint32_t, uint32_t) {},
+			[](render_thread::clock::duration) {}
+		});
+
+		for (uint32_t i = 0; i < event_count; ++i)
+		{
+			while (not queue.push(make_key(i)))
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		CHECK(wait_until([&]() { return received.load(std::memory_order_acquire) == event_count; }));
+		thread.stop();
+
+		uint32_t out_of_order = 0;
+		for (uint32_t i = 0; i < keys.size(); ++i)
+		{
+			out_of_order += (keys[i] != i) ? 1 : 0;
+		}
+		CHECK(keys.size() == event_count);
+		CHECK(out_of_order == 0);
+		CHECK(thread.get_statistics().events == event_count);
+	});
+
+	runner.run("render_thread/resizes_are_coalesced", []()
+	{
+		// Sizes only grow, each one applied is newer than the last and the final one always lands
+		constexpr int32_t resize_count = 20000;
+		input_queue queue(64);
+
+		uint32_t last_width = 0,
+		         went_backwards = 0;
+		std::atomic<uint32_t> latest_width{ 0 };
+
+		render_thread thread(thread_settings, queue, render_thread::handlers{
+			[](const input_event &) {},
+			[&](uint32_t width, uint32_t)
+			{
+				went_backwards += (width <= last_width) ? 1 : 0;
+				last_width = width;
+				latest_width.store(width, std::memory_order_release);
+			},
+			[](render_thread::clock::duration) {}
+		});
+
+		for (int32_t i = 1; i <= resize_count; ++i)
+		{
+			queue.push(make_resize(i, i));
+		}
+
+		CHECK(wait_until([&]() { return latest_width.load(std::memory_order_acquire) == resize_count; }));
+		thread.stop();
+
+		CHECK(went_backwards == 0);
+		CHECK(thread.get_statistics().resizes <= static_cast<uint64_t>(resize_count));
+	});
+
+	runner.run("render_thread/zero_size_pauses_frames", []()
+	{
+		input_queue queue(64);
+		std::atomic<uint64_t> frames{ 0 };
+
+		render_thread thread(thread_settings, queue, render_thread::handlers{
+			[](const input_event &) {},
+			[](uint32_t, uint32_t) {},
+			[&](render_thread::clock::duration) { frames.fetch_add(1, std::memory_order_relaxed); }
+		});
+
+		CHECK(wait_until([&]() { return frames.load() > 0; }));
+
+		// Minimised, one frame may already be in flight when the size is taken
+		queue.push(make_resize(0, 0));
+		CHECK(wait_until([&]() { return queue.get_queued_count() == 0; }));
+		std::this_thread::sleep_for(20ms);
+		auto paused_frames = frames.load();
+		std::this_thread::sleep_for(20ms);
+		CHECK(frames.load() == paused_frames);
+
+		queue.push(make_resize(640, 480));
+		CHECK(wait_until([&]() { return frames.load() > paused_frames; }));
+		thread.stop();
+	});
+
+	runner.run("render_thread/stop_from_another_thread", []()
+	{
+		// As the window thread does on WM_CLOSE, while frames are running and input is arriving.
+		// Once stop returns no handler may run again, and stopping twice is harmless.
+		for (uint32_t round = 0; round < 50; ++round)
+		{
+			input_queue queue(64);
+			std::atomic<bool> stopped{ false };
+			std::atomic<uint32_t> calls_after_stop{ 0 };
+
+			auto after_stop = [&]()
+			{
+				if (stopped.load(std::memory_order_acquire))
+				{
+					calls_after_stop.fetch_add(1, std::memory_order_relaxed);
+				}
+			};
+
+			render_thread thread(thread_settings, queue, render_thread::handlers{
+				[&](const input_event &) { after_stop(); },
+				[&](uint32_t, uint32_t) { after_stop(); },
+				[&](render_thread::clock::duration) { after_stop(); }
+			});
+
+			for (uint32_t i = 0; i < round * 10; ++i)
+			{
+				queue.push(make_key(i));
+			}
+
+			std::thread closer([&]()
+			{
+				thread.stop();
+				stopped.store(true, std::memory_order_release);
+			});
+			closer.join();
+
+			queue.push(make_key(0));
+			queue.push(make_resize(320, 200));
+			std::this_thread::sleep_for(1ms);
+
+			thread.stop();
+			CHECK(calls_after_stop.load() == 0);
+		}
+	});
+
+	runner.run("render_thread/stop_wakes_paused_thread", []()
+	{
+		// A minimised window closing must not wait out the poll interval
+		input_queue queue(64);
+		render_thread thread({ 32, 10s }, queue, render_thread::handlers{
+			[](const input_event &) {},
+			[](uint32_t, uint32_t) {},
+			[](render_thread::clock::duration) {}
+		});
+
+		queue.push(make_resize(0, 0));
+		CHECK(wait_until([&]() { return queue.get_queued_count() == 0; }));
+		std::this_thread::sleep_for(5ms);
+
+		auto start_time = std::chrono::steady_clock::now();
+		thread.stop();
+		CHECK(std::chrono::steady_clock::now() - start_time < 5s);
+	});
+}
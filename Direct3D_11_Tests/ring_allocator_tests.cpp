@@ -0,0 +1,235 @@
+#include "tests.h"
+
+#include "ring_allocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// As constant_buffer_ring uses it
+	constexpr uint32_t constant_alignment = 256;
+
+	struct live_range
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	bool overlaps(const live_range &a, const live_range &b)
+	{
+		return a.offset < b.offset + b.size and b.offset < a.offset + a.size;
+	}
+
+	// Allocations of every frame still in flight, oldest first
+	using frames_in_flight = std::deque<std::vector<live_range>>;
+
+	bool overlaps_any(const frames_in_flight &frames, const std::vector<live_range> &current, const live_range &range)
+	{
+		for (const auto &frame : frames)
+		{
+			for (const auto &other : frame)
+			{
+				if (overlaps(range, other))
+				{
+					return true;
+				}
+			}
+		}
+		for (const auto &other : current)
+		{
+			if (overlaps(range, other))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+void tests::ring_allocator_tests(test::runner &runner)
+{
+	runner.run("ring_allocator/rejects_zero_and_oversized", []()
+	{
+		ring_allocator ring(1024, 3);
+
+		CHECK(ring.allocate(0, constant_alignment) == ring_allocator::invalid_offset);
+		CHECK(ring.allocate(1025, constant_alignment) == ring_allocator::invalid_offset);
+		CHECK(ring.get_statistics().failed_allocations == 2);
+		CHECK(ring.allocate(1024, constant_alignment) == 0);
+	});
+
+	runner.run("ring_allocator/aligns_to_256", []()
+	{
+		ring_allocator ring(4096, 3);
+
+		CHECK(ring.allocate(16, constant_alignment) == 0);
+		CHECK(ring.allocate(100, constant_alignment) == 256);
+		CHECK(ring.allocate(256, constant_alignment) == 512);
+		CHECK(ring.allocate(300, constant_alignment) == 768);
+		CHECK(ring.allocate(1, constant_alignment) == 1280);
+
+		// Padding is whatever the previous allocation left of its slot
+		const auto &stats = ring.get_statistics();
+		CHECK(stats.allocations == 5);
+		CHECK(stats.bytes_allocated == 16 + 100 + 256 + 300 + 1);
+		CHECK(stats.bytes_wasted == 240 + 156 + 0 + 212);
+		CHECK(ring.get_used_size() == 1281);
+	});
+
+	runner.run("ring_allocator/wraps_at_end", []()
+	{
+		ring_allocator ring(1024, 3);
+
+		CHECK(ring.allocate(512, constant_alignment) == 0);
+		CHECK(ring.end_frame(1));
+		CHECK(ring.allocate(384, constant_alignment) == 512);
+		CHECK(ring.end_frame(2));
+		ring.release_frames(1);
+		CHECK(ring.get_used_size() == 384);
+
+		// 128 bytes left at the end, too few, so it starts again at the front
+		CHECK(ring.allocate(256, constant_alignment) == 0);
+		const auto &stats = ring.get_statistics();
+		CHECK(stats.wraps == 1);
+		CHECK(stats.bytes_wasted == 128);
+		CHECK(ring.get_used_size() == 384 + 128 + 256);
+
+		// And carries on from there up to the frame still in flight
+		CHECK(ring.allocate(256, constant_alignment) == 256);
+		CHECK(ring.allocate(256, constant_alignment) == ring_allocator::invalid_offset);
+	});
+
+	runner.run("ring_allocator/never_overwrites_unreleased_frames", []()
+	{
+		ring_allocator ring(1024, 3);
+
+		CHECK(ring.allocate(768, constant_alignment) == 0);
+		CHECK(ring.end_frame(1));
+
+		// Neither the tail nor a wrap has room while frame 1 is in flight
+		CHECK(ring.allocate(512, constant_alignment) == ring_allocator::invalid_offset);
+		CHECK(ring.allocate(256, constant_alignment) == 768);
+		CHECK(ring.allocate(16, constant_alignment) == ring_allocator::invalid_offset);
+		CHECK(ring.get_statistics().failed_allocations == 2);
+
+		// Fences short of the frame's release nothing
+		ring.release_frames(0);
+		CHECK(ring.get_frames_in_flight() == 1);
+		CHECK(ring.allocate(16, constant_alignment) == ring_allocator::invalid_offset);
+
+		ring.release_frames(1);
+		CHECK(ring.get_frames_in_flight() == 0);
+		CHECK(ring.get_used_size() == 256);
+		CHECK(ring.allocate(512, constant_alignment) == 0);
+	});
+
+	runner.run("ring_allocator/frames_in_flight_are_capped", []()
+	{
+		ring_allocator ring(1024, 2);
+
+		CHECK(ring.end_frame(1));
+		CHECK(ring.end_frame(2));
+		CHECK(not ring.end_frame(3));
+		CHECK(ring.get_frames_in_flight() == 2);
+
+		ring.release_frames(1);
+		CHECK(ring.end_frame(3));
+	});
+
+	runner.run("ring_allocator/release_frames_in_fence_order", []()
+	{
+		ring_allocator ring(4096, 4);
+
+		CHECK(ring.allocate(256, constant_alignment) == 0);
+		CHECK(ring.end_frame(10));
+		CHECK(ring.allocate(512, constant_alignment) == 256);
+		CHECK(ring.end_frame(20));
+		CHECK(ring.end_frame(30)); // allocated nothing
+		CHECK(ring.allocate(256, constant_alignment) == 768);
+		CHECK(ring.end_frame(40));
+		CHECK(ring.get_used_size() == 1024);
+
+		// Each release retires every frame up to the fence, and only those
+		ring.release_frames(15);
+		CHECK(ring.get_frames_in_flight() == 3);
+		CHECK(ring.get_used_size() == 768);
+
+		ring.release_frames(30);
+		CHECK(ring.get_frames_in_flight() == 1);
+		CHECK(ring.get_used_size() == 256);
+
+		// Everything retired, the next allocation starts again at the front
+		ring.release_frames(40);
+		CHECK(ring.get_frames_in_flight() == 0);
+		CHECK(ring.get_used_size() == 0);
+		CHECK(ring.allocate(256, constant_alignment) == 0);
+	});
+
+	runner.run("ring_allocator/reset_drops_everything", []()
+	{
+		ring_allocator ring(1024, 3);
+
+		CHECK(ring.allocate(1024, constant_alignment) == 0);
+		CHECK(ring.end_frame(1));
+		ring.reset();
+
+		CHECK(ring.get_used_size() == 0);
+		CHECK(ring.get_frames_in_flight() == 0);
+		CHECK(ring.allocate(1024, constant_alignment) == 0);
+	});
+
+	runner.run("ring_allocator/lagging_fences_keep_frames_disjoint", []()
+	{
+		// The GPU finishes each frame two frames after it was submitted, as with
+		// constant_buffer_ring, and no allocation may land on a frame in flight
+		constexpr uint32_t capacity = 64 * 1024,
+		                   frame_lag = 2;
+		ring_allocator ring(capacity, frame_lag + 1);
+
+		frames_in_flight frames;
+		uint32_t overlapping = 0,
+		         misaligned = 0,
+		         failed = 0;
+		uint32_t state = 3;
+		for (uint64_t fence = 1; fence <= 2000; ++fence)
+		{
+			if (frames.size() > frame_lag)
+			{
+				ring.release_frames(fence - frame_lag - 1);
+				frames.pop_front();
+			}
+
+			std::vector<live_range> current;
+			state = state * 1664525U + 1013904223U;
+			auto allocation_count = (state >> 8) % 40;
+			for (uint32_t i = 0; i < allocation_count; ++i)
+			{
+				state = state * 1664525U + 1013904223U;
+				live_range range{ 0, 1 + (state >> 8) % 1024 };
+
+				range.offset = ring.allocate(range.size, constant_alignment);
+				if (range.offset == ring_allocator::invalid_offset)
+				{
+					failed++;
+					continue;
+				}
+
+				misaligned += (range.offset % constant_alignment != 0) ? 1 : 0;
+				overlapping += overlaps_any(frames, current, range) ? 1 : 0;
+				current.push_back(range);
+			}
+
+			CHECK(ring.end_frame(fence));
+			frames.push_back(std::move(current));
+		}
+
+		CHECK(overlapping == 0);
+		CHECK(misaligned == 0);
+		CHECK(ring.get_statistics().wraps > 0);
+		CHECK(ring.get_statistics().failed_allocations == failed);
+	});
+}
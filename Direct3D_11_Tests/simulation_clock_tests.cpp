@@ -0,0 +1,191 @@
+#include "tests.h"
+
+#include "simulation_clock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using namespace std::chrono_literals;
+	using clock = simulation_clock::clock;
+
+	// As the application runs it, 120 Hz with at most 8 steps a frame
+	constexpr simulation_clock::description clock_settings{
+		std::chrono::duration_cast<clock::duration>(std::chrono::duration<int64_t, std::ratio<1, 120>>(1)),
+		8,
+		250ms
+	};
+
+	// Time only moves when the test moves it
+	class fake_time
+	{
+	public:
+		simulation_clock::time_source source()
+		{
+			return [this]() { return time; };
+		}
+
+		void advance(clock::duration elapsed)
+		{
+			time += elapsed;
+		}
+
+	private:
+		clock::time_point time{};
+	};
+
+	// Runs frames of the given lengths, returns the steps each paid out. The extra
+	// first advance starts the clock, or is an empty frame if it already runs.
+	std::vector<uint32_t> run_frames(simulation_clock &sim_clock, fake_time &time, const std::vector<clock::duration> &frame_times)
+	{
+		std::vector<uint32_t> steps;
+		sim_clock.advance();
+		for (auto frame_time : frame_times)
+		{
+			time.advance(frame_time);
+			steps.push_back(sim_clock.advance());
+		}
+		return steps;
+	}
+
+	// Frames of uneven length adding up to exactly total, deterministic
+	std::vector<clock::duration> jittered_frames(clock::duration total, uint32_t seed)
+	{
+		std::vector<clock::duration> frame_times;
+		auto remaining = total;
+		auto state = seed;
+		while (remaining > clock::duration::zero())
+		{
+			state = state * 1664525U + 1013904223U;
+			clock::duration frame_time = 4ms + std::chrono::microseconds((state >> 8) % 30000);
+			frame_time = std::min(frame_time, remaining);
+			frame_times.push_back(frame_time);
+			remaining -= frame_time;
+		}
+		return frame_times;
+	}
+
+	uint64_t sum(const std::vector<uint32_t> &steps)
+	{
+		uint64_t total = 0;
+		for (auto step_count : steps)
+		{
+			total += step_count;
+		}
+		return total;
+	}
+}
+
+void tests::simulation_clock_tests(test::runner &runner)
+{
+	runner.run("simulation_clock/first_advance_starts", []()
+	{
+		fake_time time;
+		simulation_clock sim_clock(clock_settings, time.source());
+
+		time.advance(1s);
+		CHECK(sim_clock.advance() == 0);
+		CHECK(sim_clock.get_step_index() == 0);
+		CHECK(sim_clock.get_interpolation() == 0.0);
+	});
+
+	runner.run("simulation_clock/ten_seconds_is_1200_steps", []()
+	{
+		// Whatever the frame rate, 10 s of frames pays out 120 Hz worth of steps
+		for (auto frame_time : { clock::duration(1ms), clock::duration(7ms), clock::duration(16667us), clock::duration(33333us), clock::duration(50ms) })
+		{
+			fake_time time;
+			simulation_clock sim_clock(clock_settings, time.source());
+
+			std::vector<clock::duration> frame_times(10s / frame_time, frame_time);
+			frame_times.push_back(10s - frame_time * frame_times.size());
+			auto steps = run_frames(sim_clock, time, frame_times);
+
+			CHECK(sum(steps) == 1200);
+			CHECK(sim_clock.get_step_index() == 1200);
+			CHECK(sim_clock.get_statistics().clamped_frames == 0);
+			CHECK(sim_clock.get_simulation_seconds() > 9.99 and sim_clock.get_simulation_seconds() <= 10.0);
+		}
+	});
+
+	runner.run("simulation_clock/jittered_frames_are_exact", []()
+	{
+		fake_time time;
+		simulation_clock sim_clock(clock_settings, time.source());
+
+		auto steps = run_frames(sim_clock, time, jittered_frames(10s, 7));
+
+		uint32_t out_of_range = 0;
+		CHECK(sum(steps) == 1200);
+		CHECK(sim_clock.get_interpolation() >= 0.0 and sim_clock.get_interpolation() < 1.0);
+		for (auto step_count : steps)
+		{
+			out_of_range += (step_count > clock_settings.max_steps_per_frame) ? 1 : 0;
+		}
+		CHECK(out_of_range == 0);
+	});
+
+	runner.run("simulation_clock/same_times_same_steps", []()
+	{
+		auto frame_times = jittered_frames(3s, 11);
+
+		fake_time first_time,
+		          second_time;
+		simulation_clock first_clock(clock_settings, first_time.source()),
+		                 second_clock(clock_settings, second_time.source());
+
+		CHECK(run_frames(first_clock, first_time, frame_times) == run_frames(second_clock, second_time, frame_times));
+		CHECK(first_clock.get_interpolation() == second_clock.get_interpolation());
+	});
+
+	runner.run("simulation_clock/stall_is_capped", []()
+	{
+		// A 5 s stall, as from a debugger break or a dragged window
+		fake_time time;
+		simulation_clock sim_clock(clock_settings, time.source());
+
+		sim_clock.advance();
+		time.advance(5s);
+		CHECK(sim_clock.advance() == clock_settings.max_steps_per_frame);
+
+		// Less than a frame's worth of backlog is kept, the rest is dropped for good
+		const auto &stats = sim_clock.get_statistics();
+		CHECK(stats.clamped_frames == 1);
+		CHECK(stats.max_steps_in_frame == clock_settings.max_steps_per_frame);
+		CHECK(stats.dropped_time > 4750ms);
+		CHECK(stats.dropped_time < 5s);
+
+		CHECK(sim_clock.advance() == clock_settings.max_steps_per_frame - 1);
+		CHECK(sim_clock.advance() == 0);
+		CHECK(sim_clock.get_step_index() == 2 * clock_settings.max_steps_per_frame - 1);
+
+		// And the clock carries on at the normal rate afterwards
+		auto steps = run_frames(sim_clock, time, std::vector<clock::duration>(60, 16667us));
+		CHECK(sum(steps) == 120);
+		CHECK(sim_clock.get_statistics().clamped_frames == 1);
+	});
+
+	runner.run("simulation_clock/slow_frames_never_spiral", []()
+	{
+		// Frames just under max_frame_time all clamp on steps, the backlog stays bounded
+		fake_time time;
+		simulation_clock sim_clock(clock_settings, time.source());
+
+		auto steps = run_frames(sim_clock, time, std::vector<clock::duration>(100, 200ms));
+
+		uint32_t over_cap = 0;
+		for (auto step_count : steps)
+		{
+			over_cap += (step_count > clock_settings.max_steps_per_frame) ? 1 : 0;
+		}
+		CHECK(over_cap == 0);
+		CHECK(sum(steps) == 100 * clock_settings.max_steps_per_frame);
+		CHECK(sim_clock.get_statistics().clamped_frames == 100);
+		CHECK(sim_clock.get_interpolation() >= 0.0 and sim_clock.get_interpolation() < 1.0);
+	});
+}
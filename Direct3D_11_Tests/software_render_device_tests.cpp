@@ -0,0 +1,287 @@
+#include "tests.h"
+
+#include "software_render_device.h"
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using position = std::array<float, 3>;
+
+	// Sizes that are not whole tiles, so partial tiles and padded rows are covered
+	constexpr uint32_t target_width = 301,
+	                   target_height = 173;
+
+	float next_float(uint32_t &state, float low, float high)
+	{
+		state = state * 1664525U + 1013904223U;
+		return low + (high - low) * static_cast<float>(state >> 8) / static_cast<float>(1U << 24);
+	}
+
+	render_device::pipeline_description make_pipeline(render_device::blend_e blend,
+	                                                  render_device::depth_stencil_e depth_stencil,
+	                                                  render_device::rasterizer_e rasterizer,
+	                                                  render_device::topology_e topology)
+	{
+		return { blend, depth_stencil, rasterizer, render_device::sampler_e::PointClamp,
+		         render_device::input_layout_e::position, topology, { nullptr, 0 }, { nullptr, 0 } };
+	}
+
+	void draw_mesh(software_render_device &device, render_device::pipeline_handle pipeline,
+	               const std::vector<position> &positions, const std::vector<uint32_t> &indices)
+	{
+		auto mesh = device.create_mesh({ positions.data(),
+		                                 sizeof(position),
+		                                 static_cast<uint32_t>(positions.size()),
+		                                 indices.data(),
+		                                 render_device::index_type_e::uint32,
+		                                 static_cast<uint32_t>(indices.size()) });
+		device.set_pipeline(pipeline);
+		device.set_mesh(mesh);
+		device.draw();
+	}
+
+	// Each cover adds one to red, so red counts how often a pixel was drawn
+	void draw_counting(software_render_device &device, const std::vector<position> &positions, const std::vector<uint32_t> &indices)
+	{
+		auto pipeline = device.create_pipeline(make_pipeline(render_device::blend_e::Additive,
+		                                                     render_device::depth_stencil_e::None,
+		                                                     render_device::rasterizer_e::CullNone,
+		                                                     render_device::topology_e::triangle_list));
+
+		device.clear({ 0.0f, 0.0f, 0.0f, 0.0f });
+		std::array<float, 4> one_step{ 1.0f / 255.0f, 0.0f, 0.0f, 1.0f };
+		device.set_constants(render_device::shader_stage_e::pixel, 0, one_step.data(), sizeof(one_step));
+		draw_mesh(device, pipeline, positions, indices);
+		device.end_frame();
+	}
+
+	// Pixels of the visible target not drawn exactly once
+	uint32_t count_not_once(const software_render_device &device)
+	{
+		const auto &color_buffer = device.get_color_buffer();
+		uint32_t wrong = 0;
+		for (uint32_t y = 0; y < device.get_height(); ++y)
+		{
+			for (uint32_t x = 0; x < device.get_width(); ++x)
+			{
+				wrong += ((color_buffer[size_t(y) * device.get_pitch() + x] & 0xff) != 1) ? 1 : 0;
+			}
+		}
+		return wrong;
+	}
+
+	// Covers the whole target, inner vertices jittered while every quad stays convex,
+	// diagonals and windings alternating
+	void make_jittered_grid(uint32_t cells, uint32_t seed, std::vector<position> &positions, std::vector<uint32_t> &indices)
+	{
+		auto state = seed;
+		auto cell_size = 2.0f / static_cast<float>(cells);
+		for (uint32_t y = 0; y <= cells; ++y)
+		{
+			for (uint32_t x = 0; x <= cells; ++x)
+			{
+				position p{ -1.0f + cell_size * static_cast<float>(x), -1.0f + cell_size * static_cast<float>(y), 0.5f };
+				if (x > 0 and x < cells and y > 0 and y < cells)
+				{
+					p[0] += next_float(state, -0.2f, 0.2f) * cell_size;
+					p[1] += next_float(state, -0.2f, 0.2f) * cell_size;
+				}
+				positions.push_back(p);
+			}
+		}
+
+		for (uint32_t y = 0; y < cells; ++y)
+		{
+			for (uint32_t x = 0; x < cells; ++x)
+			{
+				auto v00 = y * (cells + 1) + x, v10 = v00 + 1,
+				     v01 = v00 + cells + 1, v11 = v01 + 1;
+				std::array<uint32_t, 6> quad = ((x + y) & 1) ? std::array<uint32_t, 6>{ v00, v10, v11, v00, v11, v01 }
+				                                             : std::array<uint32_t, 6>{ v00, v10, v01, v10, v11, v01 };
+				if (x & 1)
+				{
+					std::swap(quad[1], quad[2]);
+					std::swap(quad[4], quad[5]);
+				}
+				indices.insert(indices.end(), quad.begin(), quad.end());
+			}
+		}
+	}
+
+	// Long slivers around one point inside the target, out to the clip square
+	void make_fan(uint32_t spokes_per_side, std::vector<position> &positions, std::vector<uint32_t> &indices)
+	{
+		positions.push_back({ 0.113f, -0.071f, 0.5f });
+		std::array<position, 4> corners{ position{ -1.0f, -1.0f, 0.5f }, position{ 1.0f, -1.0f, 0.5f },
+		                                 position{ 1.0f, 1.0f, 0.5f }, position{ -1.0f, 1.0f, 0.5f } };
+		for (uint32_t side = 0; side < 4; ++side)
+		{
+			const auto &from = corners[side], &to = corners[(side + 1) % 4];
+			for (uint32_t i = 0; i < spokes_per_side; ++i)
+			{
+				auto t = static_cast<float>(i) / static_cast<float>(spokes_per_side);
+				positions.push_back({ from[0] + (to[0] - from[0]) * t, from[1] + (to[1] - from[1]) * t, 0.5f });
+			}
+		}
+
+		auto rim_count = 4 * spokes_per_side;
+		for (uint32_t i = 0; i < rim_count; ++i)
+		{
+			indices.insert(indices.end(), { 0, 1 + i, 1 + (i + 1) % rim_count });
+		}
+	}
+
+	// Overlapping triangles in every blend, depth and cull mode, some crossing the
+	// clip planes, then wireframe and lines on top
+	void draw_scene(software_render_device &device, uint32_t seed)
+	{
+		using blend_e = render_device::blend_e;
+		using depth_stencil_e = render_device::depth_stencil_e;
+		using rasterizer_e = render_device::rasterizer_e;
+		using topology_e = render_device::topology_e;
+
+		const std::array<render_device::pipeline_description, 6> pipelines{
+			make_pipeline(blend_e::Opaque, depth_stencil_e::ReadWrite, rasterizer_e::CullNone, topology_e::triangle_list),
+			make_pipeline(blend_e::Alpha, depth_stencil_e::ReadOnly, rasterizer_e::CullClockwise, topology_e::triangle_list),
+			make_pipeline(blend_e::Additive, depth_stencil_e::None, rasterizer_e::CullAntiClockwise, topology_e::triangle_strip),
+			make_pipeline(blend_e::NonPremultipled, depth_stencil_e::ReadWrite, rasterizer_e::CullNone, topology_e::triangle_list),
+			make_pipeline(blend_e::Opaque, depth_stencil_e::ReadWrite, rasterizer_e::Wireframe, topology_e::triangle_list),
+			make_pipeline(blend_e::Opaque, depth_stencil_e::None, rasterizer_e::CullNone, topology_e::line_list)
+		};
+
+		device.clear({ 0.1f, 0.2f, 0.3f, 1.0f });
+
+		auto state = seed;
+		for (uint32_t draw = 0; draw < 24; ++draw)
+		{
+			std::vector<position> positions(30);
+			for (auto &p : positions)
+			{
+				p = { next_float(state, -1.5f, 1.5f), next_float(state, -1.5f, 1.5f), next_float(state, -0.2f, 1.2f) };
+			}
+			std::vector<uint32_t> indices(positions.size());
+			for (uint32_t i = 0; i < indices.size(); ++i)
+			{
+				indices[i] = i;
+			}
+
+			std::array<float, 4> color{ next_float(state, 0.0f, 1.0f), next_float(state, 0.0f, 1.0f),
+			                            next_float(state, 0.0f, 1.0f), next_float(state, 0.2f, 1.0f) };
+			device.set_constants(render_device::shader_stage_e::pixel, 0, color.data(), sizeof(color));
+			draw_mesh(device, device.create_pipeline(pipelines[draw % pipelines.size()]), positions, indices);
+		}
+
+		device.end_frame();
+	}
+
+	// Compares only the visible pixels, padding is never written
+	bool same_output(const software_render_device &a, const software_render_device &b)
+	{
+		if (a.get_width() != b.get_width() or a.get_height() != b.get_height())
+		{
+			return false;
+		}
+
+		for (uint32_t y = 0; y < a.get_height(); ++y)
+		{
+			for (uint32_t x = 0; x < a.get_width(); ++x)
+			{
+				auto index_a = size_t(y) * a.get_pitch() + x,
+				     index_b = size_t(y) * b.get_pitch() + x;
+				if (a.get_color_buffer()[index_a] != b.get_color_buffer()[index_b]
+				    or a.get_depth_buffer()[index_a] != b.get_depth_buffer()[index_b])
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+void tests::software_render_device_tests(test::runner &runner)
+{
+	runner.run("software_render_device/resize_target_clamps", []()
+	{
+		software_render_device device({ 0, 64, 1, false });
+		CHECK(device.get_width() == 1);
+		CHECK(device.get_call_count() == 0);
+
+		device.resize_target(software_render_device::max_target_size + 1, 0);
+		CHECK(device.get_call_count() == 1);
+		CHECK(device.get_width() == software_render_device::max_target_size);
+		CHECK(device.get_height() == 1);
+		CHECK(device.get_color_buffer().size() >= size_t(device.get_pitch()) * device.get_height());
+
+		// Still renders after clamping
+		std::vector<position> positions;
+		std::vector<uint32_t> indices;
+		make_jittered_grid(2, 1, positions, indices);
+		draw_counting(device, positions, indices);
+		CHECK(count_not_once(device) == 0);
+
+		// Pipeline, clear, constants, mesh, two binds, draw and end_frame
+		CHECK(device.get_call_count() == 1 + 8);
+	});
+
+	runner.run("software_render_device/shared_edges_are_watertight", []()
+	{
+		// Every pixel belongs to exactly one triangle, on either raster path
+		for (auto scalar_only : { false, true })
+		{
+			software_render_device device({ target_width, target_height, 4, scalar_only });
+
+			for (uint32_t seed : { 1U, 2U, 3U })
+			{
+				std::vector<position> positions;
+				std::vector<uint32_t> indices;
+				make_jittered_grid(13, seed, positions, indices);
+				draw_counting(device, positions, indices);
+				CHECK(count_not_once(device) == 0);
+			}
+
+			std::vector<position> positions;
+			std::vector<uint32_t> indices;
+			make_fan(37, positions, indices);
+			draw_counting(device, positions, indices);
+			CHECK(count_not_once(device) == 0);
+		}
+	});
+
+	runner.run("software_render_device/same_output_on_any_thread_count", []()
+	{
+		software_render_device reference({ target_width, target_height, 1, false });
+		draw_scene(reference, 5);
+		CHECK(reference.get_last_frame_statistics().pixels_written > 0);
+		CHECK(reference.get_last_frame_statistics().triangles_clipped > 0);
+
+		for (uint32_t thread_count : { 2U, 3U, 8U })
+		{
+			software_render_device device({ target_width, target_height, thread_count, false });
+			draw_scene(device, 5);
+			CHECK(same_output(reference, device));
+			CHECK(device.get_last_frame_statistics().pixels_written == reference.get_last_frame_statistics().pixels_written);
+		}
+	});
+
+	runner.run("software_render_device/sse2_matches_scalar", []()
+	{
+		// Without SSE2 both devices take the scalar path, trivially the same
+		for (uint32_t seed : { 5U, 6U, 7U })
+		{
+			software_render_device sse2({ target_width, target_height, 2, false }),
+			                       scalar({ target_width, target_height, 2, true });
+			draw_scene(sse2, seed);
+			draw_scene(scalar, seed);
+
+			CHECK(same_output(sse2, scalar));
+			CHECK(sse2.get_last_frame_statistics().pixels_written == scalar.get_last_frame_statistics().pixels_written);
+		}
+	});
+}
@@ -0,0 +1,128 @@
+#include "tests.h"
+
+#include "state_cache.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Stand-in for the device, state objects are ids and every creation is logged
+	class recording_device
+	{
+	public:
+		using blend_state_t = uint32_t;
+		using depth_stencil_state_t = uint32_t;
+		using rasterizer_state_t = uint32_t;
+		using sampler_state_t = uint32_t;
+
+		struct creation
+		{
+			char kind;
+			uint32_t value;
+		};
+
+	public:
+		explicit recording_device(std::vector<creation> &log) :
+			log(&log)
+		{}
+
+		blend_state_t make_blend_state(render_device::blend_e blend) const { return record('b', static_cast<uint32_t>(blend)); }
+		depth_stencil_state_t make_depth_stencil_state(render_device::depth_stencil_e depth_stencil) const { return record('d', static_cast<uint32_t>(depth_stencil)); }
+		rasterizer_state_t make_rasterizer_state(render_device::rasterizer_e rasterizer) const { return record('r', static_cast<uint32_t>(rasterizer)); }
+		sampler_state_t make_sampler_state(render_device::sampler_e sampler) const { return record('s', static_cast<uint32_t>(sampler)); }
+
+	private:
+		uint32_t record(char kind, uint32_t value) const
+		{
+			log->push_back({ kind, value });
+			return static_cast<uint32_t>(log->size());
+		}
+
+		std::vector<creation> *log;
+	};
+
+	using recording_cache = basic_state_cache<recording_device>;
+
+	constexpr uint32_t blend_count = 4,
+	                   depth_stencil_count = 3,
+	                   rasterizer_count = 4,
+	                   sampler_count = 6;
+}
+
+void tests::state_cache_tests(test::runner &runner)
+{
+	runner.run("state_cache/first_request_creates", []()
+	{
+		std::vector<recording_device::creation> log;
+		recording_cache cache{ recording_device(log) };
+
+		auto blend = cache.get_blend_state(render_device::blend_e::Alpha);
+		CHECK(log.size() == 1);
+		CHECK(log[0].kind == 'b' and log[0].value == static_cast<uint32_t>(render_device::blend_e::Alpha));
+		CHECK(blend == 1);
+		CHECK(cache.get_statistics().misses == 1 and cache.get_statistics().hits == 0);
+	});
+
+	runner.run("state_cache/repeat_request_shares", []()
+	{
+		std::vector<recording_device::creation> log;
+		recording_cache cache{ recording_device(log) };
+
+		auto first = cache.get_rasterizer_state(render_device::rasterizer_e::CullNone);
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			CHECK(cache.get_rasterizer_state(render_device::rasterizer_e::CullNone) == first);
+		}
+		CHECK(log.size() == 1);
+		CHECK(cache.get_statistics().misses == 1 and cache.get_statistics().hits == 10);
+	});
+
+	runner.run("state_cache/kinds_are_keyed_apart", []()
+	{
+		// Every enum starts at zero, equal values of different kinds are different objects
+		std::vector<recording_device::creation> log;
+		recording_cache cache{ recording_device(log) };
+
+		auto blend = cache.get_blend_state(static_cast<render_device::blend_e>(0));
+		auto depth_stencil = cache.get_depth_stencil_state(static_cast<render_device::depth_stencil_e>(0));
+		auto rasterizer = cache.get_rasterizer_state(static_cast<render_device::rasterizer_e>(0));
+		auto sampler = cache.get_sampler_state(static_cast<render_device::sampler_e>(0));
+
+		CHECK(log.size() == 4);
+		CHECK(blend != depth_stencil and depth_stencil != rasterizer and rasterizer != sampler);
+		CHECK(cache.get_statistics().misses == 4);
+	});
+
+	runner.run("state_cache/pipelines_share_small_set", []()
+	{
+		// Every combination, as that many pipeline_states would ask for them
+		std::vector<recording_device::creation> log;
+		recording_cache cache{ recording_device(log) };
+
+		auto pipeline_count = blend_count * depth_stencil_count * rasterizer_count * sampler_count;
+		for (uint32_t i = 0; i < pipeline_count; ++i)
+		{
+			cache.get_blend_state(static_cast<render_device::blend_e>(i % blend_count));
+			cache.get_depth_stencil_state(static_cast<render_device::depth_stencil_e>(i / blend_count % depth_stencil_count));
+			cache.get_rasterizer_state(static_cast<render_device::rasterizer_e>(i / (blend_count * depth_stencil_count) % rasterizer_count));
+			cache.get_sampler_state(static_cast<render_device::sampler_e>(i / (blend_count * depth_stencil_count * rasterizer_count)));
+		}
+
+		auto distinct_states = blend_count + depth_stencil_count + rasterizer_count + sampler_count;
+		CHECK(log.size() == distinct_states);
+		CHECK(cache.get_statistics().misses == distinct_states);
+		CHECK(cache.get_statistics().hits == pipeline_count * 4 - distinct_states);
+
+		// Each created once, no value twice
+		for (size_t i = 0; i < log.size(); ++i)
+		{
+			for (size_t j = i + 1; j < log.size(); ++j)
+			{
+				CHECK(not (log[i].kind == log[j].kind and log[i].value == log[j].value));
+			}
+		}
+	});
+}
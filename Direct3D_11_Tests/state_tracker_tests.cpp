@@ -0,0 +1,191 @@
+#include "tests.h"
+
+#include "state_tracker.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	// Stand-in for the immediate context, state objects are ids and every call reaching it is logged
+	class recording_context
+	{
+	public:
+		using blend_state_t = uint32_t;
+		using depth_stencil_state_t = uint32_t;
+		using rasterizer_state_t = uint32_t;
+		using sampler_state_t = uint32_t;
+		using input_layout_t = uint32_t;
+		using vertex_shader_t = uint32_t;
+		using pixel_shader_t = uint32_t;
+		using buffer_t = uint32_t;
+		using topology_t = uint32_t;
+		using format_t = uint32_t;
+
+		struct call
+		{
+			char kind;
+			uint32_t slot;
+			uint32_t value;
+			uint32_t stride_or_format;
+			uint32_t offset;
+		};
+
+	public:
+		explicit recording_context(std::vector<call> &log) :
+			log(&log)
+		{}
+
+		void set_blend_state(blend_state_t blend_state) { log->push_back({ 'b', 0, blend_state, 0, 0 }); }
+		void set_depth_stencil_state(depth_stencil_state_t depth_stencil_state) { log->push_back({ 'd', 0, depth_stencil_state, 0, 0 }); }
+		void set_rasterizer_state(rasterizer_state_t rasterizer_state) { log->push_back({ 'r', 0, rasterizer_state, 0, 0 }); }
+		void set_sampler_state(sampler_state_t sampler_state) { log->push_back({ 's', 0, sampler_state, 0, 0 }); }
+
+		void set_primitive_topology(topology_t primitive_topology) { log->push_back({ 't', 0, primitive_topology, 0, 0 }); }
+		void set_input_layout(input_layout_t input_layout) { log->push_back({ 'l', 0, input_layout, 0, 0 }); }
+		void set_vertex_shader(vertex_shader_t vertex_shader) { log->push_back({ 'v', 0, vertex_shader, 0, 0 }); }
+		void set_pixel_shader(pixel_shader_t pixel_shader) { log->push_back({ 'p', 0, pixel_shader, 0, 0 }); }
+
+		void set_vertex_buffer(uint32_t slot, buffer_t vertex_buffer, uint32_t stride, uint32_t offset) { log->push_back({ 'V', slot, vertex_buffer, stride, offset }); }
+		void set_index_buffer(buffer_t index_buffer, format_t format, uint32_t offset) { log->push_back({ 'I', 0, index_buffer, format, offset }); }
+
+	private:
+		std::vector<call> *log;
+	};
+
+	using recording_tracker = basic_state_tracker<recording_context>;
+
+	// What a pipeline_state::activate hands the tracker
+	void activate_pipeline(recording_tracker &tracker, uint32_t id)
+	{
+		tracker.set_blend_state(id);
+		tracker.set_depth_stencil_state(id);
+		tracker.set_rasterizer_state(id);
+		tracker.set_sampler_state(id);
+		tracker.set_primitive_topology(id);
+		tracker.set_input_layout(id);
+		tracker.set_vertex_shader(id);
+		tracker.set_pixel_shader(id);
+	}
+}
+
+void tests::state_tracker_tests(test::runner &runner)
+{
+	runner.run("state_tracker/first_set_issues", []()
+	{
+		// Zero is also the shadow's initial value, it still has to reach the context
+		std::vector<recording_context::call> log;
+		recording_tracker tracker{ recording_context(log) };
+
+		activate_pipeline(tracker, 0);
+		tracker.set_vertex_buffer(0, 0, 0, 0);
+		tracker.set_index_buffer(0, 0, 0);
+
+		CHECK(log.size() == 10);
+		CHECK(tracker.get_frame_statistics().issued == 10 and tracker.get_frame_statistics().skipped == 0);
+	});
+
+	runner.run("state_tracker/redundant_sets_skipped", []()
+	{
+		std::vector<recording_context::call> log;
+		recording_tracker tracker{ recording_context(log) };
+
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			activate_pipeline(tracker, 7);
+		}
+
+		CHECK(log.size() == 8);
+		CHECK(tracker.get_frame_statistics().issued == 8);
+		CHECK(tracker.get_frame_statistics().skipped == 99 * 8);
+	});
+
+	runner.run("state_tracker/changes_issued", []()
+	{
+		// Alternating two pipelines, only what differs between them reaches the context
+		std::vector<recording_context::call> log;
+		recording_tracker tracker{ recording_context(log) };
+
+		activate_pipeline(tracker, 1);
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			tracker.set_blend_state(1);
+			tracker.set_rasterizer_state(1);
+			tracker.set_pixel_shader(2 + i % 2);
+		}
+
+		CHECK(log.size() == 8 + 10);
+		CHECK(log.back().kind == 'p' and log.back().value == 3);
+		CHECK(tracker.get_frame_statistics().skipped == 20);
+	});
+
+	runner.run("state_tracker/vertex_buffer_slots_apart", []()
+	{
+		std::vector<recording_context::call> log;
+		recording_tracker tracker{ recording_context(log) };
+
+		tracker.set_vertex_buffer(0, 5, 32, 0);
+		tracker.set_vertex_buffer(1, 5, 32, 0);
+		tracker.set_vertex_buffer(0, 5, 32, 0);
+		tracker.set_vertex_buffer(1, 5, 32, 0);
+		CHECK(log.size() == 2);
+		CHECK(log[0].slot == 0 and log[1].slot == 1);
+
+		// Same buffer at another stride or offset is a different binding
+		tracker.set_vertex_buffer(1, 5, 16, 0);
+		tracker.set_vertex_buffer(1, 5, 16, 64);
+		CHECK(log.size() == 4);
+		CHECK(log[3].slot == 1 and log[3].stride_or_format == 16 and log[3].offset == 64);
+	});
+
+	runner.run("state_tracker/index_buffer_format_and_offset", []()
+	{
+		std::vector<recording_context::call> log;
+		recording_tracker tracker{ recording_context(log) };
+
+		tracker.set_index_buffer(9, 16, 0);
+		tracker.set_index_buffer(9, 16, 0);
+		tracker.set_index_buffer(9, 32, 0);
+		tracker.set_index_buffer(9, 32, 1024);
+		tracker.set_index_buffer(9, 32, 1024);
+
+		CHECK(log.size() == 3);
+		CHECK(log[1].stride_or_format == 32 and log[1].offset == 0);
+		CHECK(log[2].stride_or_format == 32 and log[2].offset == 1024);
+	});
+
+	runner.run("state_tracker/invalidate_reissues", []()
+	{
+		std::vector<recording_context::call> log;
+		recording_tracker tracker{ recording_context(log) };
+
+		activate_pipeline(tracker, 4);
+		tracker.set_vertex_buffer(2, 4, 12, 0);
+		tracker.invalidate();
+		activate_pipeline(tracker, 4);
+		tracker.set_vertex_buffer(2, 4, 12, 0);
+
+		CHECK(log.size() == 18);
+		CHECK(tracker.get_frame_statistics().skipped == 0);
+	});
+
+	runner.run("state_tracker/frame_statistics_roll", []()
+	{
+		std::vector<recording_context::call> log;
+		recording_tracker tracker{ recording_context(log) };
+
+		activate_pipeline(tracker, 1);
+		activate_pipeline(tracker, 1);
+		tracker.begin_frame();
+		CHECK(tracker.get_last_frame_statistics().issued == 8 and tracker.get_last_frame_statistics().skipped == 8);
+		CHECK(tracker.get_frame_statistics().issued == 0 and tracker.get_frame_statistics().skipped == 0);
+
+		// Bindings outlive the frame, the next one starts off skipping
+		activate_pipeline(tracker, 1);
+		tracker.begin_frame();
+		CHECK(tracker.get_last_frame_statistics().issued == 0 and tracker.get_last_frame_statistics().skipped == 8);
+		CHECK(log.size() == 8);
+	});
+}
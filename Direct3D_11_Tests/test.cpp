@@ -0,0 +1,71 @@
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+using namespace direct3d_11_eg;
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	// Failed checks of the test in progress, stress tests check from their worker threads
+	std::atomic<uint32_t> failed_checks{ 0 };
+	std::mutex output_lock;
+}
+
+test::runner::runner(const description &runner_description) :
+	settings(runner_description)
+{}
+
+test::runner::~runner()
+{}
+
+void test::runner::run(std::string_view name, const std::function<void()> &test)
+{
+	if (not settings.filter.empty() and name.find(settings.filter) == std::string_view::npos)
+	{
+		return;
+	}
+
+	failed_checks.store(0, std::memory_order_relaxed);
+	auto start_time = clock::now();
+	test();
+	std::chrono::duration<double, std::milli> elapsed = clock::now() - start_time;
+
+	auto has_failed = failed_checks.load(std::memory_order_relaxed) > 0;
+	run_count++;
+	failed_count += has_failed ? 1 : 0;
+
+	std::lock_guard<std::mutex> lock(output_lock);
+	std::printf("%-6s %-56s %10.1f ms\n", has_failed ? "FAIL" : "pass", std::string(name).c_str(), elapsed.count());
+	std::fflush(stdout);
+}
+
+uint32_t test::runner::get_run_count() const
+{
+	return run_count;
+}
+
+uint32_t test::runner::get_failed_count() const
+{
+	return failed_count;
+}
+
+void test::check(bool passed, const char *expression, const char *file, int line)
+{
+	if (passed)
+	{
+		return;
+	}
+
+	// Only the first few of a failing loop are worth reading
+	constexpr uint32_t max_reported = 8;
+	if (failed_checks.fetch_add(1, std::memory_order_relaxed) < max_reported)
+	{
+		std::lock_guard<std::mutex> lock(output_lock);
+		std::printf("    %s(%d): CHECK(%s)\n", file, line, expression);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace direct3d_11_eg
+{
+	// Minimal test harness. A test is a function making CHECKs, the runner
+	// calls it and reports it failed if any check did. Checks carry on after
+	// a failure, so one run lists everything that is broken.
+	namespace test
+	{
+		class runner
+		{
+		public:
+			struct description
+			{
+				std::string filter; // substring of the names to run, empty runs everything
+			};
+
+		public:
+			runner() = delete;
+			runner(const description &runner_description);
+			~runner();
+
+			void run(std::string_view name, const std::function<void()> &test);
+
+			uint32_t get_run_count() const;
+			uint32_t get_failed_count() const;
+
+		private:
+			description settings{};
+			uint32_t run_count = 0;
+			uint32_t failed_count = 0;
+		};
+
+		// Counts against the test running now, safe to call from any thread
+		void check(bool passed, const char *expression, const char *file, int line);
+	}
+}
+
+#define CHECK(expression) ::direct3d_11_eg::test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
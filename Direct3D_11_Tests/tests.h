@@ -0,0 +1,25 @@
+#pragma once
+
+#include "test.h"
+
+namespace direct3d_11_eg
+{
+	// One suite per module, each runs its tests through the runner
+	namespace tests
+	{
+		void asset_streamer_tests(test::runner &runner);
+		void frame_pacer_tests(test::runner &runner);
+		void index_codec_tests(test::runner &runner);
+		void input_queue_tests(test::runner &runner);
+		void job_system_tests(test::runner &runner);
+		void mesh_optimizer_tests(test::runner &runner);
+		void offset_allocator_tests(test::runner &runner);
+		void profiler_tests(test::runner &runner);
+		void render_thread_tests(test::runner &runner);
+		void ring_allocator_tests(test::runner &runner);
+		void simulation_clock_tests(test::runner &runner);
+		void software_render_device_tests(test::runner &runner);
+		void state_cache_tests(test::runner &runner);
+		void state_tracker_tests(test::runner &runner);
+	}
+}